@@ -2,9 +2,15 @@
 
 #include <erebus/system/exception.hxx>
 #include <erebus/system/property_bag.hxx>
+#include <erebus/system/property_batch.hxx>
 #include <erebus/system/result.hxx>
 
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <chrono>
+#include <cmath>
+#include <vector>
 
 namespace Er::Ipc
 {
@@ -47,15 +53,164 @@ struct IClient
 
         virtual CallbackResult onFrame(Er::PropertyBag&& frame) = 0;
         virtual void onException(Er::Exception&& exception) = 0;
+
+        // a server may send a whole batch of frames at once; by default it is delivered row by row
+        virtual CallbackResult onBatch(Er::PropertyBatch&& batch)
+        {
+            for (std::size_t row = 0; row < batch.rows(); ++row)
+            {
+                if (onFrame(batch.row(row)) == CallbackResult::Cancel)
+                    return CallbackResult::Cancel;
+            }
+
+            return CallbackResult::Continue;
+        }
+    };
+
+    // a request marshaled once and sent many times
+    // updating an argument re-marshals only that argument; calls already in flight keep the old contents
+    struct IPreparedCall
+    {
+        using Ptr = std::shared_ptr<IPreparedCall>;
+
+        virtual ~IPreparedCall() {}
+
+        virtual std::string_view request() const noexcept = 0;
+        virtual std::size_t argCount() const noexcept = 0;
+        virtual void updateArg(std::size_t index, const Er::Property& arg) = 0;
+    };
+
+    // receiver-driven flow control for a stream
+    // reading stops when the granted frames are used up, so the server is held back by transport flow control
+    // dropping the last reference lifts the flow control
+    struct IStreamControl
+    {
+        using Ptr = std::shared_ptr<IStreamControl>;
+
+        virtual ~IStreamControl() {}
+
+        virtual void grant(std::uint32_t frames) = 0;
+        virtual void cancel() = 0;
+    };
+
+    struct StreamOptions
+    {
+        std::uint32_t initialCredits = 0; // frames delivered before more are granted; 0 disables flow control
+        bool stringDictionary = false; // repeated strings are sent once and shared by the frames that have them
+        bool internStrings = false; // the dictionary strings also go to Er::StringPool, to be shared beyond the stream
+
+        constexpr StreamOptions() noexcept = default;
+
+        constexpr explicit StreamOptions(std::uint32_t initialCredits) noexcept
+            : initialCredits(initialCredits)
+        {
+        }
+    };
+
+    // log2-bucketed distribution of durations
+    // bucket 0 counts zero values, bucket i counts values in [2^(i-1), 2^i) microseconds; the last bucket is open-ended
+    struct Histogram
+    {
+        static constexpr std::size_t BucketCount = 32;
+
+        std::array<std::uint64_t, BucketCount> buckets = {};
+        std::uint64_t count = 0;
+        std::chrono::microseconds sum = std::chrono::microseconds::zero();
+        std::chrono::microseconds min = std::chrono::microseconds::zero();
+        std::chrono::microseconds max = std::chrono::microseconds::zero();
+
+        static constexpr std::size_t bucket(std::chrono::microseconds value) noexcept
+        {
+            if (value.count() <= 0)
+                return 0;
+
+            auto index = static_cast<std::size_t>(std::bit_width(static_cast<std::uint64_t>(value.count())));
+            return (index < BucketCount) ? index : BucketCount - 1;
+        }
+
+        static constexpr std::chrono::microseconds upperBound(std::size_t bucket) noexcept
+        {
+            return std::chrono::microseconds((bucket == 0) ? 0 : (std::int64_t(1) << bucket) - 1);
+        }
+
+        std::chrono::microseconds mean() const noexcept
+        {
+            return count ? sum / static_cast<std::int64_t>(count) : std::chrono::microseconds::zero();
+        }
+
+        // upper bound of the bucket holding the given quantile, clamped to the observed maximum
+        std::chrono::microseconds percentile(double q) const noexcept
+        {
+            if (!count)
+                return std::chrono::microseconds::zero();
+
+            auto rank = static_cast<std::uint64_t>(std::ceil(q * static_cast<double>(count)));
+            if (rank == 0)
+                rank = 1;
+
+            std::uint64_t seen = 0;
+            for (std::size_t i = 0; i < BucketCount; ++i)
+            {
+                seen += buckets[i];
+                if (seen >= rank)
+                    return std::min(upperBound(i), max);
+            }
+
+            return max;
+        }
+    };
+
+    // calls are counted per request for up to this many requests; the calls of any other request are counted together, with an empty request name
+    static constexpr std::size_t MaxTrackedRequests = 256;
+
+    struct CallStatistics
+    {
+        std::string request;
+        std::uint64_t succeeded = 0;
+        std::uint64_t failed = 0;       // transport errors, remote exceptions and expired property mappings
+        std::uint64_t timedOut = 0;
+        Histogram latency;              // calls that received a reply
+    };
+
+    struct HealthSnapshot
+    {
+        std::chrono::steady_clock::time_point taken;
+        bool monitoring = false;
+        std::uint64_t pingsSucceeded = 0;
+        std::uint64_t pingsFailed = 0;
+        std::uint64_t pingsTimedOut = 0;
+        std::uint64_t consecutivePingFailures = 0;
+        std::chrono::microseconds lastRtt = std::chrono::microseconds::zero();
+        std::chrono::microseconds smoothedJitter = std::chrono::microseconds::zero(); // RFC 3550 estimator
+        Histogram rtt;
+        Histogram jitter;               // differences between consecutive RTTs
+        std::vector<CallStatistics> calls;
+    };
+
+    struct HealthMonitorOptions
+    {
+        std::chrono::milliseconds interval = std::chrono::milliseconds(1000);
+        std::chrono::milliseconds timeout = std::chrono::milliseconds(1000);
+        std::size_t payloadSize = 0;
     };
 
     using Ptr = std::unique_ptr<IClient>;
 
+    // pings issued by the monitor and by ping() both feed the RTT statistics
+    virtual void startHealthMonitor(const HealthMonitorOptions& options) = 0;
+    virtual void stopHealthMonitor() = 0;
+    virtual HealthSnapshot health() const = 0;
+
     virtual void ping(std::size_t payloadSize, IPingCompletion::Ptr handler, std::chrono::milliseconds timeout) = 0;
     virtual void getPropertyMapping(ICompletion::Ptr handler) = 0;
     virtual void putPropertyMapping(ICompletion::Ptr handler) = 0;
     virtual void call(std::string_view request, const Er::PropertyBag& args, ICallCompletion::Ptr handler, std::chrono::milliseconds timeout) = 0;
+    // a prepared call may only be passed to the client that prepared it, and only while that client lives
+    // it may be released after the client is gone
+    virtual IPreparedCall::Ptr prepareCall(std::string_view request, const Er::PropertyBag& args) = 0;
+    virtual void call(IPreparedCall::Ptr prepared, ICallCompletion::Ptr handler, std::chrono::milliseconds timeout) = 0;
     virtual void stream(std::string_view request, const Er::PropertyBag& args, IStreamCompletion::Ptr handler) = 0;
+    virtual IStreamControl::Ptr stream(std::string_view request, const Er::PropertyBag& args, IStreamCompletion::Ptr handler, const StreamOptions& options) = 0;
 
     virtual ~IClient() {};
 };
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <erebus/system/property_bag.hxx>
+#include <erebus/system/property_batch.hxx>
 
 
 namespace Er::Ipc
@@ -18,10 +19,18 @@ struct IService
     virtual void registerService(IServer* container) = 0;
     virtual void unregisterService(IServer* container) = 0;
 
+    // args live only as long as the call: keep copies of them, not references
     virtual Er::PropertyBag request(std::string_view request, std::uint32_t clientId, const Er::PropertyBag& args) = 0; 
     [[nodiscard]] virtual StreamId beginStream(std::string_view request, std::uint32_t clientId, const Er::PropertyBag& args) = 0;
     virtual void endStream(StreamId id) = 0;
     virtual Er::PropertyBag next(StreamId id) = 0;
+
+    // bulk alternative to next(): fill the batch with as many frames as is convenient
+    // an empty batch ends the stream; returning false means the stream is served by next() instead
+    virtual bool nextBatch([[maybe_unused]] StreamId id, [[maybe_unused]] Er::PropertyBatch& batch)
+    {
+        return false;
+    }
 };
 
 
@@ -2,6 +2,8 @@
 
 #include <erebus/system/erebus.hxx>
 
+#include <string_view>
+
 
 namespace Er
 {
@@ -10,80 +12,121 @@ namespace Er
  * @brief Binary data container
  *
  * Contains arbitrary binary data and is useful to explicitly mark it as such, in contrast with plain-text data
+ *
+ * The bytes live in an immutable refcounted buffer: copies and slices share it instead of copying the data.
+ * The buffer may also be owned by someone else, like a received message or a mapped file,
+ * in which case the Binary keeps the owner alive.
+ * Long binaries in service replies are handed to gRPC as they are, without copying
  */
 struct Binary final
 {
     Binary() noexcept
     {}
 
-    Binary(const Binary& b)
-        : m_bytes(b.m_bytes)
+    Binary(const Binary& b) noexcept
+        : m_owner(b.m_owner)
+        , m_data(b.m_data)
     {}
 
     Binary(Binary&& b) noexcept
-        : m_bytes(std::move(b.m_bytes))
+        : m_owner(std::move(b.m_owner))
+        , m_data(std::exchange(b.m_data, std::string_view()))
     {}
 
     Binary(std::nullptr_t) = delete;
 
     Binary(const char* s)
-        : m_bytes(s)
+        : Binary(std::string(s))
     {}
 
     explicit Binary(std::string_view s)
-        : m_bytes(s)
+        : Binary(std::string(s))
     {}
 
     explicit Binary(const std::string& s)
-        : m_bytes(s)
+        : Binary(std::string(s))
     {}
 
-    explicit Binary(std::string&& s) noexcept
-        : m_bytes(std::move(s))
+    // takes over the string's buffer
+    explicit Binary(std::string&& s)
+    {
+        auto owner = std::make_shared<const std::string>(std::move(s));
+        m_data = *owner;
+        m_owner = std::move(owner);
+    }
+
+    // references bytes that live as long as the owner does
+    Binary(std::shared_ptr<const void> owner, std::string_view data) noexcept
+        : m_owner(std::move(owner))
+        , m_data(data)
     {}
 
-    Binary& operator=(const Binary& o)
+    Binary& operator=(const Binary& o) noexcept
     {
         Binary tmp(o);
-        m_bytes.swap(tmp.m_bytes);
+        swap(tmp);
         return *this;
     }
 
     Binary& operator=(Binary&& o) noexcept
     {
         Binary tmp(std::move(o));
-        m_bytes.swap(tmp.m_bytes);
+        swap(tmp);
         return *this;
     }
 
+    void swap(Binary& o) noexcept
+    {
+        m_owner.swap(o.m_owner);
+        std::swap(m_data, o.m_data);
+    }
+
     friend auto operator==(const Binary& a, const Binary& b) noexcept
     {
-        return a.m_bytes == b.m_bytes;
+        return a.m_data == b.m_data;
     }
 
     friend auto operator<=>(const Binary& a, const Binary& b) noexcept
     {
-        return a.m_bytes <=> b.m_bytes;
+        return a.m_data <=> b.m_data;
     }
 
-    const std::string& bytes() const noexcept
+    // not a const std::string& as it used to be: the bytes of a slice, a received message or a mapped file are not a string
+    // of their own, and making one would copy them; std::string(b.bytes()) does that where it is needed
+    std::string_view bytes() const noexcept
     {
-        return m_bytes;
+        return m_data;
     }
 
+    // not NUL-terminated for slices and foreign buffers
     const char* data() const noexcept
     {
-        return m_bytes.data();
+        return m_data.data();
     }
 
     std::size_t size() const noexcept
     {
-        return m_bytes.size();
+        return m_data.size();
     }
 
     bool empty() const noexcept
     {
-        return m_bytes.empty();
+        return m_data.empty();
+    }
+
+    // shares the buffer; the range is clamped to the available bytes
+    Binary slice(std::size_t offset, std::size_t length = std::string_view::npos) const noexcept
+    {
+        if (offset > m_data.size())
+            offset = m_data.size();
+
+        return Binary(m_owner, m_data.substr(offset, length));
+    }
+
+    // whatever keeps the bytes alive; null for an empty Binary
+    const std::shared_ptr<const void>& owner() const noexcept
+    {
+        return m_owner;
     }
 
     template <class OStreamT>
@@ -91,7 +134,7 @@ struct Binary final
     {
         static const char HexDigits[16] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F' };
         bool first = true;
-        for (auto b : bytes.m_bytes)
+        for (auto b : bytes.m_data)
         {
             if (first)
                 first = false;
@@ -109,13 +152,14 @@ struct Binary final
 
     std::size_t hash() const noexcept
     {
-        std::hash<std::string> h;
-        return h(m_bytes);
+        std::hash<std::string_view> h;
+        return h(m_data);
     }
 
 private:
-    std::string m_bytes;
+    std::shared_ptr<const void> m_owner;
+    std::string_view m_data;
 };
 
 
-} // namespace Er {}
\ No newline at end of file
+} // namespace Er {}
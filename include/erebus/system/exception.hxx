@@ -1,6 +1,6 @@
 #pragma once
 
-#include <erebus/system/property.hxx>
+#include <erebus/system/property_bag.hxx>
 
 #include <stdexcept>
 #include <vector>
@@ -61,13 +61,8 @@ public:
 
     const Property* find(const PropertyInfo& type) const noexcept
     {
-        for (auto& prop : m_context->properties)
-        {
-            if (type.name() == prop.info()->name())
-                return &prop;
-        }
-
-        return nullptr;
+        // uniques are assigned per name, so this matches the same property registered twice
+        return Er::find(m_context->properties, type);
     }
 
     operator bool() const noexcept
@@ -10,6 +10,9 @@ namespace Er
 
 namespace Format = ::fmt;
 
+// a growable character buffer with inline storage for short texts
+using FormatBuffer = Format::memory_buffer;
+
 template <class... Args>
 std::string format(std::string_view formatString, Args&&... args) 
 {
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <erebus/system/property_bag.hxx>
+
+#include <bit>
+
+
+namespace Er
+{
+
+//
+// a PropertyBag with an open-addressing index keyed by PropertyInfo::unique()
+// properties are kept in a vector in insertion order, so iteration costs the same as for a plain bag
+// if a property occurs more than once, lookups find the first occurrence, like Er::get() on a PropertyBag does
+//
+
+class IndexedPropertyBag final
+{
+public:
+    using value_type = Property;
+    using const_iterator = PropertyBag::const_iterator;
+    using size_type = PropertyBag::size_type;
+
+    IndexedPropertyBag() noexcept = default;
+
+    explicit IndexedPropertyBag(PropertyBag&& bag)
+        : m_props(std::move(bag))
+    {
+        rebuildIndex(indexCapacityFor(m_props.size()));
+    }
+
+    explicit IndexedPropertyBag(const PropertyBag& bag)
+        : IndexedPropertyBag(PropertyBag(bag))
+    {
+    }
+
+    // the underlying bag for code that takes a PropertyBag
+    [[nodiscard]] const PropertyBag& bag() const noexcept
+    {
+        return m_props;
+    }
+
+    [[nodiscard]] PropertyBag release() noexcept
+    {
+        m_slots.clear();
+        m_mask = 0;
+        m_shift = 0;
+        return std::move(m_props);
+    }
+
+    [[nodiscard]] const_iterator begin() const noexcept
+    {
+        return m_props.begin();
+    }
+
+    [[nodiscard]] const_iterator end() const noexcept
+    {
+        return m_props.end();
+    }
+
+    [[nodiscard]] size_type size() const noexcept
+    {
+        return m_props.size();
+    }
+
+    [[nodiscard]] bool empty() const noexcept
+    {
+        return m_props.empty();
+    }
+
+    [[nodiscard]] const Property& operator[](size_type index) const noexcept
+    {
+        ErAssert(index < m_props.size());
+        return m_props[index];
+    }
+
+    void reserve(size_type count)
+    {
+        m_props.reserve(count);
+
+        auto capacity = indexCapacityFor(count);
+        if (capacity > m_slots.size())
+            rebuildIndex(capacity);
+    }
+
+    void clear() noexcept
+    {
+        m_props.clear();
+        std::fill(m_slots.begin(), m_slots.end(), Slot{});
+    }
+
+    void push_back(const Property& prop)
+    {
+        push_back(Property(prop));
+    }
+
+    void push_back(Property&& prop)
+    {
+        auto index = m_props.size();
+        m_props.push_back(std::move(prop));
+        indexLast(index);
+    }
+
+    [[nodiscard]] const Property* find(std::uint32_t unique) const noexcept
+    {
+        auto index = findIndex(unique);
+        return (index != NotFound) ? &m_props[index] : nullptr;
+    }
+
+    [[nodiscard]] const Property* find(const PropertyInfo& info) const noexcept
+    {
+        return find(info.unique());
+    }
+
+    // replaces the first property with the same unique or appends a new one
+    // returns false if an equal property is already there
+    bool update(Property&& prop)
+    {
+        auto index = findIndex(prop.unique());
+        if (index == NotFound)
+        {
+            push_back(std::move(prop));
+            return true;
+        }
+
+        auto& existing = m_props[index];
+        if ((existing.info() == prop.info()) && (existing == prop))
+            return false;
+
+        existing = std::move(prop);
+        return true;
+    }
+
+private:
+    struct Slot
+    {
+        std::uint32_t key = PropertyInfo::InvalidUnique;
+        std::uint32_t index = 0;
+    };
+
+    static constexpr std::size_t NotFound = std::size_t(-1);
+
+    // uniques are small consecutive integers; Fibonacci hashing spreads them over the table
+    std::size_t hash(std::uint32_t key) const noexcept
+    {
+        return static_cast<std::size_t>((std::uint64_t(key) * 0x9E3779B97F4A7C15ULL) >> m_shift);
+    }
+
+    std::size_t findIndex(std::uint32_t unique) const noexcept
+    {
+        if (m_slots.empty() || (unique == PropertyInfo::InvalidUnique))
+            return NotFound;
+
+        for (auto pos = hash(unique); ; pos = (pos + 1) & m_mask)
+        {
+            auto& slot = m_slots[pos];
+            if (slot.key == unique)
+                return slot.index;
+            if (slot.key == PropertyInfo::InvalidUnique)
+                return NotFound;
+        }
+    }
+
+    // keep the load factor at or below 1/2 so probe sequences stay short
+    static std::size_t indexCapacityFor(std::size_t count) noexcept
+    {
+        return count ? std::bit_ceil(std::max<std::size_t>(count * 2, 8)) : 0;
+    }
+
+    void rebuildIndex(std::size_t capacity)
+    {
+        m_slots.assign(capacity, Slot{});
+        m_mask = capacity ? capacity - 1 : 0;
+        m_shift = capacity ? 64 - std::countr_zero(capacity) : 0;
+
+        for (std::size_t i = 0; i < m_props.size(); ++i)
+            insert(m_props[i].unique(), i);
+    }
+
+    void indexLast(std::size_t index)
+    {
+        auto capacity = indexCapacityFor(m_props.size());
+        if (capacity > m_slots.size())
+            rebuildIndex(capacity);
+        else
+            insert(m_props[index].unique(), index);
+    }
+
+    void insert(std::uint32_t key, std::size_t index) noexcept
+    {
+        ErAssert(index < PropertyInfo::InvalidUnique);
+
+        if (key == PropertyInfo::InvalidUnique)
+            return;
+
+        for (auto pos = hash(key); ; pos = (pos + 1) & m_mask)
+        {
+            auto& slot = m_slots[pos];
+            if (slot.key == key)
+                return; // keep the first occurrence
+
+            if (slot.key == PropertyInfo::InvalidUnique)
+            {
+                slot.key = key;
+                slot.index = static_cast<std::uint32_t>(index);
+                return;
+            }
+        }
+    }
+
+    PropertyBag m_props;
+    std::vector<Slot> m_slots;
+    std::size_t m_mask = 0;
+    int m_shift = 0;
+};
+
+
+template <typename T>
+auto get(const IndexedPropertyBag& bag, const PropertyInfo& info)
+{
+    using Value = decltype(get<T>(std::declval<const Property&>()));
+
+    auto prop = bag.find(info);
+
+    if constexpr (std::is_reference_v<Value>)
+        return prop ? &get<T>(*prop) : static_cast<const T*>(nullptr);
+    else
+        return prop ? std::optional<Value>(get<T>(*prop)) : std::optional<Value>();
+}
+
+inline bool update(IndexedPropertyBag& bag, Property&& prop)
+{
+    return bag.update(std::move(prop));
+}
+
+} // namespace Er {}
@@ -4,10 +4,51 @@
 #include <erebus/system/system/packed_time.hxx>
 #include <erebus/system/system/thread.hxx>
 
+#include <boost/intrusive_ptr.hpp>
 #include <boost/noncopyable.hpp>
 
+#include <atomic>
 #include <chrono>
+#include <cstring>
 #include <functional>
+#include <tuple>
+
+
+namespace Erp::Log2
+{
+
+// rounds the size up to the block actually given out
+ER_SYSTEM_EXPORT [[nodiscard]] void* allocateRecord(std::size_t& size);
+ER_SYSTEM_EXPORT void freeRecord(void* p, std::size_t size) noexcept;
+
+} // namespace Erp::Log2 {}
+
+
+namespace Er::Log2
+{
+
+// what a deferred record may keep a copy of, besides strings
+// specialize it for types that own all their data; views would dangle by the time the record is formatted
+template <class T>
+struct IsDeferrable
+    : public std::bool_constant<std::is_arithmetic_v<T> || std::is_enum_v<T>>
+{
+};
+
+} // namespace Er::Log2 {}
+
+
+namespace Erp::Log2
+{
+
+// strings are copied into the record, the rest is kept as is
+template <class T>
+constexpr bool IsString = std::is_convertible_v<const std::decay_t<T>&, std::string_view>;
+
+template <class T>
+using Captured = std::conditional_t<IsString<T>, std::string_view, std::decay_t<T>>;
+
+} // namespace Erp::Log2 {}
 
 
 namespace Er::Log2
@@ -24,29 +65,38 @@ enum class Level
 };
 
 
+//
+// a record and its message text share a single block
+// blocks come from thread-local free lists and get back there when the last reference goes
+//
+
 struct Record
     : public boost::noncopyable
 {
 private:
     struct PrivateOnly{};
 
+    // the tail of the block is for text
+    struct Block
+    {
+        char* text;
+        std::size_t textCapacity;
+        std::size_t size;
+    };
+
 public:
-    using Ptr = std::shared_ptr<Record>;
+    using Ptr = boost::intrusive_ptr<Record>;
 
-    Record(PrivateOnly, Level level, System::PackedTime::ValueType time, uintptr_t tid, auto&& message)
-        : m_level(level)
-        , m_time(time)
-        , m_tid(tid)
-        , m_message(std::forward<decltype(message)>(message))
-    {
-    }
+    virtual ~Record() = default;
 
-    Record(PrivateOnly, std::string_view component, Level level, System::PackedTime::ValueType time, uintptr_t tid, auto&& message)
+    Record(PrivateOnly, const Block& block, std::string_view component, Level level, System::PackedTime::ValueType time, uintptr_t tid) noexcept
         : m_component(component)
         , m_level(level)
         , m_time(time)
         , m_tid(tid)
-        , m_message(std::forward<decltype(message)>(message))
+        , m_text(block.text)
+        , m_textCapacity(std::uint32_t(block.textCapacity))
+        , m_blockSize(std::uint32_t(block.size))
     {
     }
 
@@ -70,8 +120,12 @@ public:
         return m_component;
     }
 
-    [[nodiscard]] constexpr const auto& message() const noexcept
+    // a deferred record formats its message on first access
+    [[nodiscard]] std::string_view message() const
     {
+        if (m_render) [[unlikely]]
+            render();
+
         return m_message;
     }
 
@@ -80,6 +134,18 @@ public:
         return m_indent;
     }
 
+    [[nodiscard]] bool deferred() const noexcept
+    {
+        return m_render != nullptr;
+    }
+
+    // not thread-safe; loggers call it before handing the record over to sinks
+    void render() const
+    {
+        if (auto render = std::exchange(m_render, nullptr))
+            render(this);
+    }
+
     void setComponent(std::string_view component) noexcept
     {
         // use in the top level logger only
@@ -94,26 +160,198 @@ public:
         m_indent = indent;
     }
 
-    [[nodiscard]] static auto make(Level level, System::PackedTime::ValueType time, uintptr_t tid, auto&& message)
+    [[nodiscard]] static Ptr make(Level level, System::PackedTime::ValueType time, uintptr_t tid, std::string_view message)
+    {
+        return make({}, level, time, tid, message);
+    }
+
+    [[nodiscard]] static Ptr make(std::string_view component, Level level, System::PackedTime::ValueType time, uintptr_t tid, std::string_view message)
     {
-        return std::make_shared<Record>(PrivateOnly{}, level, time, tid, std::forward<decltype(message)>(message));
+        auto r = create<Record>(message.size(), component, level, time, tid);
+        r->setMessage(message);
+        return r;
     }
 
-    [[nodiscard]] static auto make(std::string_view component, Level level, System::PackedTime::ValueType time, uintptr_t tid, auto&& message)
+    // checked against the types actually formatted later
+    template <class... Args>
+    using DeferredFormat = Format::format_string<Erp::Log2::Captured<Args>...>;
+
+    // keeps a copy of the arguments and formats them when the message is needed
+    // the format string must be a literal since only a view of it is kept
+    template <class... Args>
+    [[nodiscard]] static Ptr makeDeferred(Level level, System::PackedTime::ValueType time, uintptr_t tid, DeferredFormat<Args...> format, Args&&... args)
     {
-        return std::make_shared<Record>(PrivateOnly{}, component, level, time, tid, std::forward<decltype(message)>(message));
+        static_assert((... && (Erp::Log2::IsString<Args> || IsDeferrable<std::decay_t<Args>>::value)), "Deferred log arguments must be strings, numbers, enums or types that own their data (see IsDeferrable)");
+
+        Format::string_view f = format;
+        auto text = (capturedSize(args) + ... + DeferredReserve);
+        return create<Deferred<Erp::Log2::Captured<Args>...>>(text, std::string_view(f.data(), f.size()), level, time, tid, std::forward<Args>(args)...);
+    }
+
+    friend void intrusive_ptr_add_ref(const Record* r) noexcept
+    {
+        r->m_refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    friend void intrusive_ptr_release(const Record* r) noexcept
+    {
+        if (r->m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            destroy(const_cast<Record*>(r));
     }
 
 private:
+    // room for the formatted text of a deferred record
+    static constexpr std::size_t DeferredReserve = 128;
+
+    template <class T>
+    static std::size_t capturedSize(const T& v) noexcept
+    {
+        if constexpr (Erp::Log2::IsString<T>)
+            return std::string_view(v).size();
+        else
+            return 0;
+    }
+
+    template <class... Args>
+    struct Deferred;
+
+    using Render = void(*)(const Record*);
+
+    template <class T, class... Args>
+    static Ptr create(std::size_t text, Args&&... args)
+    {
+        auto size = sizeof(T) + text;
+        auto block = Erp::Log2::allocateRecord(size);
+
+        T* r = nullptr;
+        try
+        {
+            r = new (block) T(PrivateOnly{}, Block{ static_cast<char*>(block) + sizeof(T), size - sizeof(T), size }, std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+            Erp::Log2::freeRecord(block, size);
+            throw;
+        }
+
+        return Ptr(r);
+    }
+
+    static void destroy(Record* r) noexcept
+    {
+        auto size = r->m_blockSize;
+        r->~Record();
+        Erp::Log2::freeRecord(r, size);
+    }
+
+    void setMessage(std::string_view text) const noexcept
+    {
+        ErAssert(text.size() <= m_textCapacity);
+        std::memcpy(m_text, text.data(), text.size());
+        m_message = std::string_view(m_text, text.size());
+    }
+
     std::string_view m_component;
     const Level m_level = Level::Info;
     const System::PackedTime::ValueType m_time;
     const uintptr_t m_tid = 0;
-    const std::string m_message;
+    mutable std::string_view m_message;
+    mutable Render m_render = nullptr;
+    char* m_text = nullptr; // the tail of the block
+    std::uint32_t m_textCapacity = 0;
+    std::uint32_t m_blockSize = 0;
+    mutable std::atomic<std::uint32_t> m_refs = 0;
     unsigned m_indent = 0;
 };
 
 
+template <class... Args>
+struct Record::Deferred
+    : public Record
+{
+    Deferred(PrivateOnly, const Block& block, std::string_view format, Level level, System::PackedTime::ValueType time, uintptr_t tid, auto&&... args)
+        : Record(PrivateOnly{}, block, {}, level, time, tid)
+        , m_format(format)
+        , m_args(capture(std::forward<decltype(args)>(args))...)
+    {
+        m_render = &Deferred::render;
+    }
+
+private:
+    // the strings go first, the text follows them
+    template <class T>
+    decltype(auto) capture(T&& v) noexcept
+    {
+        if constexpr (Erp::Log2::IsString<T>)
+        {
+            std::string_view s(v);
+            ErAssert(s.size() <= m_textCapacity);
+            std::memcpy(m_text, s.data(), s.size());
+
+            std::string_view copy(m_text, s.size());
+            m_text += s.size();
+            m_textCapacity -= std::uint32_t(s.size());
+            return copy;
+        }
+        else
+        {
+            return std::forward<T>(v);
+        }
+    }
+
+    // runs on the Logger thread, so it must not throw
+    static void render(const Record* r) noexcept
+    {
+        auto self = static_cast<const Deferred*>(r);
+        try
+        {
+            std::apply(
+                [self](const auto&... args)
+                {
+                    auto formatArgs = Format::make_format_args(args...);
+                    auto result = Format::vformat_to_n(self->m_text, self->m_textCapacity, self->m_format, formatArgs);
+                    if (result.size <= self->m_textCapacity)
+                    {
+                        self->m_message = std::string_view(self->m_text, result.size);
+                    }
+                    else
+                    {
+                        // too long for the block
+                        self->m_overflow = Format::vformat(self->m_format, formatArgs);
+                        self->m_message = self->m_overflow;
+                    }
+                },
+                self->m_args);
+        }
+        catch (std::exception& e)
+        {
+            self->fallback(e.what());
+        }
+        catch (...)
+        {
+            self->fallback("unexpected exception");
+        }
+    }
+
+    void fallback(const char* what) const noexcept
+    {
+        try
+        {
+            m_overflow = Format::format("{} [failed to format: {}]", m_format, what);
+            m_message = m_overflow;
+        }
+        catch (...)
+        {
+            m_message = m_format;
+        }
+    }
+
+    const std::string_view m_format;
+    const std::tuple<Args...> m_args;
+    mutable std::string m_overflow;
+};
+
+
 struct IFormatter
 {
     using Ptr = std::unique_ptr<IFormatter>;
@@ -121,6 +359,13 @@ struct IFormatter
     virtual ~IFormatter() = default;
 
     [[nodiscard]] virtual std::string format(const Record* r) const = 0;
+
+    // appends to the buffer; formatters override it to skip the intermediate string
+    virtual void formatTo(const Record* r, FormatBuffer& out) const
+    {
+        auto s = format(r);
+        out.append(s.data(), s.data() + s.size());
+    }
 };
 
 
@@ -137,7 +382,7 @@ public:
 
     [[nodiscard]] std::string format(const Record* r) const override
     {
-        return r->message();
+        return std::string(r->message());
     }
 
     [[nodiscard]] static auto make()
@@ -158,6 +403,12 @@ struct ISink
 
     virtual void write(Record::Ptr r) = 0;
     virtual void flush() = 0;
+
+    // false if the sink is sure to drop the record
+    virtual bool accepts([[maybe_unused]] const Record* r) const
+    {
+        return true;
+    }
 };
 
 
@@ -178,11 +429,23 @@ struct SinkBase
         return true;
     }
 
+    bool accepts(const Record* r) const override
+    {
+        return filter(r);
+    }
+
     std::string format(const Record* r) const
     {
         return m_formatter->format(r);
     }
 
+    std::string_view format(const Record* r, FormatBuffer& buffer) const
+    {
+        buffer.clear();
+        m_formatter->formatTo(r, buffer);
+        return std::string_view(buffer.data(), buffer.size());
+    }
+
 private:
     IFormatter::Ptr m_formatter;
     Filter m_filter;
@@ -231,7 +494,28 @@ protected:
     Level m_level = Level::Debug;
 };
 
-ER_SYSTEM_EXPORT ILogger::Ptr makeLogger(std::string_view component = {}, std::chrono::milliseconds threshold = {});
+// what an asynchronous logger does when a thread has written more records than the Logger thread has taken yet
+enum class Overflow
+{
+    Drop,  // wait up to maxWait for room, then drop the record and those that follow until there is room
+    Block, // wait for room as long as it takes
+    Grow   // give the thread a bigger queue; memory is the only limit
+};
+
+struct AsyncLoggerOptions
+{
+    std::size_t capacity = 1024; // records queued per writing thread, rounded up to a power of 2
+    Overflow overflow = Overflow::Drop;
+    std::chrono::milliseconds maxWait{ 100 }; // for Overflow::Drop
+};
+
+// records are queued per writing thread and sent to the sinks from a Logger thread
+// the default is lossy: a thread that gets capacity records ahead of the Logger thread waits up to maxWait once,
+// then its records are dropped until the Logger thread makes room
+// whatever the sinks write to the logger they are attached to is dropped too, since the Logger thread
+// cannot wait for itself unless the queue may grow
+// dropped records are counted and reported to the sinks in a warning
+ER_SYSTEM_EXPORT ILogger::Ptr makeLogger(std::string_view component = {}, std::chrono::milliseconds threshold = {}, const AsyncLoggerOptions& options = {});
 ER_SYSTEM_EXPORT ILogger::Ptr makeSyncLogger(std::string_view component = {});
 
 
@@ -263,11 +547,14 @@ struct IndentScope
         
         if (m_enable)
         {
+            FormatBuffer buffer;
+            Format::vformat_to(std::back_inserter(buffer), format, Format::make_format_args(args...));
+
             log->write(Record::make(
                 level,
                 System::PackedTime::now(),
                 System::CurrentThread::id(),
-                Format::vformat(format, Format::make_format_args(args...))
+                std::string_view(buffer.data(), buffer.size())
             ));
 
             log->indent();
@@ -280,7 +567,7 @@ private:
 };
 
 
-inline void writeln(ILogger* sink, Level level, const std::string& text)
+inline void writeln(ILogger* sink, Level level, std::string_view text)
 {
     sink->write(Record::make(
         level,
@@ -290,24 +577,31 @@ inline void writeln(ILogger* sink, Level level, const std::string& text)
     ));
 }
 
-inline void writeln(ILogger* sink, Level level, std::string&& text)
-{
-    sink->write(Record::make(
-        level,
-        System::PackedTime::now(),
-        System::CurrentThread::id(),
-        std::move(text)
-    ));
-}
-
 template <class... Args>
 void write(ILogger* sink, Level level, std::string_view format, Args&&... args)
 {
+    // the text is copied into the record anyway
+    FormatBuffer buffer;
+    Format::vformat_to(std::back_inserter(buffer), format, Format::make_format_args(args...));
+
     sink->write(Record::make(
         level, 
         System::PackedTime::now(), 
         System::CurrentThread::id(), 
-        Format::vformat(format, Format::make_format_args(args...))
+        std::string_view(buffer.data(), buffer.size())
+    ));
+}
+
+// the arguments are formatted by the logger, and only if some sink takes the record
+template <class... Args>
+void writeDeferred(ILogger* sink, Level level, Record::DeferredFormat<Args...> format, Args&&... args)
+{
+    sink->write(Record::makeDeferred<Args...>(
+        level,
+        System::PackedTime::now(),
+        System::CurrentThread::id(),
+        format,
+        std::forward<Args>(args)...
     ));
 }
 
@@ -427,3 +721,12 @@ ER_SYSTEM_EXPORT void setGlobal(Er::Log2::ILogger::Ptr log) noexcept;
         ::Er::Log2::write(sink, l, format, ##__VA_ARGS__); \
     ::Er::Log2::IndentScope __ids(sink, l)
 
+
+#define ErLogDeferred(l, format, ...) \
+    if (::Er::Log2::get()->level() <= l) \
+        ::Er::Log2::writeDeferred(::Er::Log2::get(), l, format, ##__VA_ARGS__)
+
+#define ErLogDeferred2(sink, l, format, ...) \
+    if (sink->level() <= l) \
+        ::Er::Log2::writeDeferred(sink, l, format, ##__VA_ARGS__)
+
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <erebus/system/exception.hxx>
+#include <erebus/system/format.hxx>
+#include <erebus/system/property.hxx>
+#include <erebus/system/luaxx/luaxx_int64.hxx>
+
+
+namespace Er::Lua
+{
+
+class State;
+
+//
+// read-only view of a numeric array property
+// holds a copy of the Property, which shares the array instead of copying it
+// indices are 1-based, like in Lua tables; 64-bit elements come as Er.Int64/Er.UInt64
+//
+
+template <ArrayElement T>
+class ArrayWrapper
+{
+public:
+    using Element = std::conditional_t<std::is_integral_v<T> && (sizeof(T) == 8), IntegerWrapper<T>, T>;
+
+    ArrayWrapper() noexcept = default;
+
+    explicit ArrayWrapper(const Property& prop)
+        : m_prop(prop)
+    {
+        ErAssert(prop.type() == ArrayTypeOf<T>::value);
+    }
+
+    unsigned int size() const
+    {
+        return m_prop.empty() ? 0 : static_cast<unsigned int>(m_prop.getArray<T>().size());
+    }
+
+    Element get(unsigned int index) const
+    {
+        if ((index < 1) || (index > size())) [[unlikely]]
+            ErThrow(Er::format("Array index {} is out of range [1, {}]", index, size()));
+
+        return Element(m_prop.getArray<T>()[index - 1]);
+    }
+
+    unsigned int __len() const
+    {
+        return size();
+    }
+
+    std::string __tostring() const
+    {
+        return m_prop.str();
+    }
+
+private:
+    Property m_prop;
+};
+
+using Int32ArrayWrapper = ArrayWrapper<std::int32_t>;
+using UInt32ArrayWrapper = ArrayWrapper<std::uint32_t>;
+using Int64ArrayWrapper = ArrayWrapper<std::int64_t>;
+using UInt64ArrayWrapper = ArrayWrapper<std::uint64_t>;
+using DoubleArrayWrapper = ArrayWrapper<double>;
+
+ER_SYSTEM_EXPORT void registerArrays(State& state);
+
+} // namespace Er::Lua {}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <erebus/system/exception.hxx>
+#include <erebus/system/format.hxx>
+#include <erebus/system/property_bag.hxx>
+
+
+namespace Er::Lua
+{
+
+class State;
+
+//
+// view of a Map property
+// holds its own copy of the bag, so the pointers get() and find() hand out never reach a bag shared with C++ code
+// nested properties are handed out the way properties are passed to Lua functions, and stay valid while the view lives
+//
+
+class MapWrapper
+{
+public:
+    MapWrapper() noexcept = default;
+
+    explicit MapWrapper(const Property& prop)
+        : m_prop(prop)
+    {
+        ErAssert(prop.type() == PropertyType::Map);
+        detach();
+    }
+
+    MapWrapper(const MapWrapper& other)
+        : m_prop(other.m_prop)
+    {
+        detach();
+    }
+
+    MapWrapper& operator=(const MapWrapper& other)
+    {
+        MapWrapper tmp(other);
+        m_prop = std::move(tmp.m_prop);
+        return *this;
+    }
+
+    MapWrapper(MapWrapper&&) noexcept = default;
+    MapWrapper& operator=(MapWrapper&&) noexcept = default;
+
+    unsigned int size() const
+    {
+        return m_prop.empty() ? 0 : static_cast<unsigned int>(m_prop.getMap().size());
+    }
+
+    // 1-based, like Lua tables
+    Property* get(unsigned int index)
+    {
+        if ((index < 1) || (index > size())) [[unlikely]]
+            ErThrow(Er::format("Map index {} is out of range [1, {}]", index, size()));
+
+        return &m_prop.mutableMap()[index - 1];
+    }
+
+    // nil if there is no such property
+    Property* find(std::string name)
+    {
+        if (m_prop.empty())
+            return nullptr;
+
+        for (auto& prop : m_prop.mutableMap())
+        {
+            if (prop.name() == name)
+                return &prop;
+        }
+
+        return nullptr;
+    }
+
+    unsigned int __len() const
+    {
+        return size();
+    }
+
+    std::string __tostring() const
+    {
+        return m_prop.str();
+    }
+
+private:
+    void detach()
+    {
+        if (!m_prop.empty())
+            (void)m_prop.mutableMap();
+    }
+
+    Property m_prop;
+};
+
+ER_SYSTEM_EXPORT void registerMap(State& state);
+
+} // namespace Er::Lua {}
@@ -3,12 +3,43 @@
 #include <erebus/system/property_info.hxx>
 
 #include <atomic>
+#include <bit>
+#include <cstring>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 #include <variant>
+#include <vector>
 
 
 namespace Er
 {
-    
+
+// packed numeric arrays, stored contiguously and shared between copies of a Property
+using Int32Array = std::vector<std::int32_t>;
+using UInt32Array = std::vector<std::uint32_t>;
+using Int64Array = std::vector<std::int64_t>;
+using UInt64Array = std::vector<std::uint64_t>;
+using DoubleArray = std::vector<double>;
+
+// nested properties; a Map property holds a whole PropertyBag
+using PropertyBag = std::vector<Property>;
+
+template <typename T>
+struct ArrayTypeOf;
+
+template <> struct ArrayTypeOf<std::int32_t> : std::integral_constant<PropertyType, PropertyType::Int32Array> {};
+template <> struct ArrayTypeOf<std::uint32_t> : std::integral_constant<PropertyType, PropertyType::UInt32Array> {};
+template <> struct ArrayTypeOf<std::int64_t> : std::integral_constant<PropertyType, PropertyType::Int64Array> {};
+template <> struct ArrayTypeOf<std::uint64_t> : std::integral_constant<PropertyType, PropertyType::UInt64Array> {};
+template <> struct ArrayTypeOf<double> : std::integral_constant<PropertyType, PropertyType::DoubleArray> {};
+
+template <typename T>
+concept ArrayElement = requires { ArrayTypeOf<T>::value; };
+
 /**
  * @brief An (almost) universal property
  *
@@ -20,7 +51,8 @@ struct ER_SYSTEM_EXPORT Property final
 public:
     ~Property()
     {
-        if (_allocatesStorage(type()))
+        auto raw = m_type.rawType();
+        if (_allocatesStorage(raw) || (raw == InfoAndType::InlineString))
             _free();
     }
 
@@ -83,25 +115,60 @@ public:
         ErAssert(info.type() == PropertyType::Double);
     }
 
+    // strings of up to InlineCapacity characters are kept inline
     Property(const char* v, const PropertyInfo& info)
-        : m_u(std::make_unique<SharedData>(std::string(v)).release())
-        , m_type(PropertyType::String, &info)
+        : Property(std::string_view(v), info)
+    {
+    }
+
+    Property(std::string_view v, const PropertyInfo& info)
+        : m_u(DontInit{})
+        , m_type(DontInit{})
     {
         ErAssert(info.type() == PropertyType::String);
+
+        if (v.size() <= InlineCapacity)
+            _setInline(v, info);
+        else
+            _setShared(std::make_unique<SharedData>(std::string(v)).release(), info);
     }
 
     Property(const std::string& v, const PropertyInfo& info)
-        : m_u(std::make_unique<SharedData>(v).release())
-        , m_type(PropertyType::String, &info)
+        : Property(std::string_view(v), info)
+    {
+    }
+
+    // a long string goes to the memory resource in a single allocation
+    // copies of the Property are made on the heap, so they may outlive the resource; moves keep the node in the resource,
+    // so a moved-to Property must be gone before the resource is
+    Property(std::string_view v, const PropertyInfo& info, std::pmr::memory_resource* resource)
+        : m_u(DontInit{})
+        , m_type(DontInit{})
     {
         ErAssert(info.type() == PropertyType::String);
+
+        if (v.size() <= InlineCapacity)
+            _setInline(v, info);
+        else
+            _setShared(resource ? SharedData::make(v, resource) : std::make_unique<SharedData>(std::string(v)).release(), info);
     }
 
     Property(std::string&& v, const PropertyInfo& info)
-        : m_u(std::make_unique<SharedData>(std::move(v)).release())
-        , m_type(PropertyType::String, &info)
+        : m_u(DontInit{})
+        , m_type(DontInit{})
     {
         ErAssert(info.type() == PropertyType::String);
+
+        if (v.size() <= InlineCapacity)
+        {
+            // taken like a long one would be
+            _setInline(v, info);
+            v.clear();
+        }
+        else
+        {
+            _setShared(std::make_unique<SharedData>(std::move(v)).release(), info);
+        }
     }
 
     Property(const Binary& v, const PropertyInfo& info)
@@ -118,6 +185,43 @@ public:
         ErAssert(info.type() == PropertyType::Binary);
     }
 
+    template <ArrayElement T>
+    Property(const std::vector<T>& v, const PropertyInfo& info)
+        : m_u(std::make_unique<SharedData>(v).release())
+        , m_type(ArrayTypeOf<T>::value, &info)
+    {
+        ErAssert(info.type() == ArrayTypeOf<T>::value);
+    }
+
+    // takes over the buffer, so large arrays are not copied
+    template <ArrayElement T>
+    Property(std::vector<T>&& v, const PropertyInfo& info)
+        : m_u(std::make_unique<SharedData>(std::move(v)).release())
+        , m_type(ArrayTypeOf<T>::value, &info)
+    {
+        ErAssert(info.type() == ArrayTypeOf<T>::value);
+    }
+
+    template <ArrayElement T>
+    Property(std::span<const T> v, const PropertyInfo& info)
+        : Property(std::vector<T>(v.begin(), v.end()), info)
+    {
+    }
+
+    Property(const PropertyBag& v, const PropertyInfo& info)
+        : m_u(std::make_unique<SharedData>(v).release())
+        , m_type(PropertyType::Map, &info)
+    {
+        ErAssert(info.type() == PropertyType::Map);
+    }
+
+    Property(PropertyBag&& v, const PropertyInfo& info)
+        : m_u(std::make_unique<SharedData>(std::move(v)).release())
+        , m_type(PropertyType::Map, &info)
+    {
+        ErAssert(info.type() == PropertyType::Map);
+    }
+
     friend constexpr void swap(Property& a, Property& b) noexcept
     {
         std::swap(a.m_type, b.m_type);
@@ -131,6 +235,13 @@ public:
         _clone(other);
     }
 
+    // the same value under another PropertyInfo; strings, binaries, arrays and maps stay shared
+    Property(const Property& other, const PropertyInfo& info)
+        : Property(other)
+    {
+        m_type = InfoAndType(m_type.rawType(), &info);
+    }
+
     Property& operator=(const Property& other)
     {
         Property tmp(other);
@@ -202,12 +313,34 @@ public:
         return m_u.v_double;
     }
 
-    [[nodiscard]] constexpr const std::string& getString() const noexcept
+    // an inline string gets a std::string of its own the first time it is read this way; getStringView() never allocates
+    [[nodiscard]] const std::string& getString() const
     {
         ErAssert(type() == PropertyType::String);
+
+        if (isInline())
+            return _inlineString();
+
         ErAssert(m_u._shared);
-        
-        return std::get<std::string>(m_u._shared->data);
+
+        if (auto s = std::get_if<std::string>(&m_u._shared->data))
+            return *s;
+
+        return m_u._shared->heapString();
+    }
+
+    [[nodiscard]] constexpr std::string_view getStringView() const noexcept
+    {
+        ErAssert(type() == PropertyType::String);
+
+        if (m_type.rawType() == InfoAndType::InlineString)
+            return std::string_view(m_u._inline.data, m_u._inline.size);
+
+        ErAssert(m_u._shared);
+        if (auto s = std::get_if<std::string>(&m_u._shared->data))
+            return *s;
+
+        return std::get<std::string_view>(m_u._shared->data);
     }
 
     [[nodiscard]] constexpr const Binary& getBinary() const noexcept
@@ -218,14 +351,73 @@ public:
         return std::get<Binary>(m_u._shared->data);
     }
 
+    template <ArrayElement T>
+    [[nodiscard]] constexpr const std::vector<T>& getArray() const noexcept
+    {
+        ErAssert(type() == ArrayTypeOf<T>::value);
+        ErAssert(m_u._shared);
+
+        return std::get<std::vector<T>>(m_u._shared->data);
+    }
+
+    [[nodiscard]] constexpr const Int32Array& getInt32Array() const noexcept
+    {
+        return getArray<std::int32_t>();
+    }
+
+    [[nodiscard]] constexpr const UInt32Array& getUInt32Array() const noexcept
+    {
+        return getArray<std::uint32_t>();
+    }
+
+    [[nodiscard]] constexpr const Int64Array& getInt64Array() const noexcept
+    {
+        return getArray<std::int64_t>();
+    }
+
+    [[nodiscard]] constexpr const UInt64Array& getUInt64Array() const noexcept
+    {
+        return getArray<std::uint64_t>();
+    }
+
+    [[nodiscard]] constexpr const DoubleArray& getDoubleArray() const noexcept
+    {
+        return getArray<double>();
+    }
+
+    [[nodiscard]] const PropertyBag& getMap() const noexcept
+    {
+        ErAssert(type() == PropertyType::Map);
+        ErAssert(m_u._shared);
+
+        return std::get<PropertyBag>(m_u._shared->data);
+    }
+
+    // copies of a Map share the bag until one of them is modified
+    // this makes the bag private to this Property, cloning it if it is shared, and drops its cached hash
+    // the bag stays private: copies of this Property made later get a bag of their own
+    [[nodiscard]] PropertyBag& mutableMap();
+
     [[nodiscard]] bool operator==(const Property& other) const noexcept
     {
         return _eq(other);
     }
 
+    // consistent with ==, so the PropertyInfo is not hashed
+    // strings, binaries, arrays and maps are hashed once; the hash is cached along with the shared value
+    [[nodiscard]] std::size_t hash() const noexcept;
+
     [[nodiscard]] std::string str() const
     {
-        return _str();
+        FormatBuffer out;
+        _str(out);
+        return Format::to_string(out);
+    }
+
+    // appends what str() returns
+    void strTo(FormatBuffer& out) const
+    {
+        _str(out);
     }
 
     [[nodiscard]] const std::string& name() const
@@ -248,27 +440,51 @@ public:
         return inf ? inf->unique() : 0;
     }
 
+    // strings of up to this length are stored inline and don't allocate unless read with getString()
+    // the rest of the storage holds the std::string that getString() makes
+    static constexpr std::size_t InlineCapacity = 2 * sizeof(std::uint64_t) - sizeof(std::string*) - 1;
+
+    [[nodiscard]] bool isInline() const noexcept
+    {
+        return m_type.rawType() == InfoAndType::InlineString;
+    }
+
 private:
-    inline static bool _allocatesStorage(PropertyType type) noexcept
+    friend class StringPool;
+
+    inline static bool _allocatesStorage(std::uintptr_t rawType) noexcept
     {
-        return (type >= PropertyType::String);
+        // the inline string tag is above PropertyType::Max
+        return (rawType >= static_cast<std::uintptr_t>(PropertyType::String)) && (rawType < static_cast<std::uintptr_t>(PropertyType::Max));
     }
-    
+
+    bool _fromResource() const noexcept
+    {
+        return (m_type.rawType() == static_cast<std::uintptr_t>(PropertyType::String)) && m_u._shared->resource;
+    }
+
     void _free() noexcept;
     void _clone(const Property& other);
     bool _eq(const Property& other) const noexcept;
     bool _eqString(const Property& other) const noexcept;
     bool _eqBinary(const Property& other) const noexcept;
-    std::string _str() const;
-    std::string _strEmpty() const;
-    std::string _strBool() const;
-    std::string _strInt32() const;
-    std::string _strUInt32() const;
-    std::string _strInt64() const;
-    std::string _strUInt64() const;
-    std::string _strDouble() const;
-    std::string _strString() const;
-    std::string _strBinary() const;
+    template <ArrayElement T>
+    bool _eqArray(const Property& other) const noexcept;
+    bool _eqMap(const Property& other) const noexcept;
+    std::size_t _hashShared() const noexcept;
+    void _str(FormatBuffer& out) const;
+    void _strEmpty(FormatBuffer& out) const;
+    void _strBool(FormatBuffer& out) const;
+    void _strInt32(FormatBuffer& out) const;
+    void _strUInt32(FormatBuffer& out) const;
+    void _strInt64(FormatBuffer& out) const;
+    void _strUInt64(FormatBuffer& out) const;
+    void _strDouble(FormatBuffer& out) const;
+    void _strString(FormatBuffer& out) const;
+    void _strBinary(FormatBuffer& out) const;
+    template <ArrayElement T>
+    void _strArray(FormatBuffer& out) const;
+    void _strMap(FormatBuffer& out) const;
 
     struct DontInit
     {
@@ -281,14 +497,52 @@ private:
         {
             String,
             Binary,
-            Map
+            Map,
+            Array
         };
 
         Type type;
+        bool interned = false; // owned by the StringPool, the only node with this value
+        bool mutableBag = false; // handed out by mutableMap() and may change behind our back, so its hash is never cached
         std::atomic<std::size_t> refs;
-        std::variant<std::string, Binary> data;
+        std::pmr::memory_resource* resource = nullptr; // null for the heap
+        std::atomic<std::size_t> hash = 0; // 0 until computed
+        // a std::string_view references characters allocated from the resource right after this node
+        std::variant<std::string, Binary, Int32Array, UInt32Array, Int64Array, UInt64Array, DoubleArray, PropertyBag, std::string_view> data;
+        mutable std::atomic<std::string*> heapCopy = nullptr; // made by getString() for characters from the resource
         
-        ~SharedData() = default;
+        ~SharedData()
+        {
+            delete heapCopy.load(std::memory_order_acquire);
+        }
+
+        const std::string& heapString() const
+        {
+            auto s = heapCopy.load(std::memory_order_acquire);
+            if (!s)
+            {
+                auto fresh = std::make_unique<std::string>(std::get<std::string_view>(data));
+                if (heapCopy.compare_exchange_strong(s, fresh.get(), std::memory_order_acq_rel, std::memory_order_acquire))
+                    s = fresh.release();
+            }
+
+            return *s;
+        }
+
+        static SharedData* make(std::string_view v, std::pmr::memory_resource* resource)
+        {
+            auto p = resource->allocate(sizeof(SharedData) + v.size(), alignof(SharedData));
+            auto chars = static_cast<char*>(p) + sizeof(SharedData);
+            std::memcpy(chars, v.data(), v.size());
+            return new (p) SharedData(std::string_view(chars, v.size()), resource);
+        }
+
+        SharedData(std::string_view v, std::pmr::memory_resource* resource) noexcept
+            : type(Type::String)
+            , refs(1)
+            , resource(resource)
+            , data(std::in_place_type<std::string_view>, v)
+        {}
 
         SharedData(const std::string& v)
             : type(Type::String)
@@ -314,6 +568,39 @@ private:
             , data(std::move(v))
         {}
 
+        template <ArrayElement T>
+        SharedData(const std::vector<T>& v)
+            : type(Type::Array)
+            , refs(1)
+            , data(v)
+        {}
+
+        template <ArrayElement T>
+        SharedData(std::vector<T>&& v)
+            : type(Type::Array)
+            , refs(1)
+            , data(std::move(v))
+        {}
+
+        SharedData(const PropertyBag& v)
+            : type(Type::Map)
+            , refs(1)
+            , data(v)
+        {}
+
+        // properties from a memory resource are copied to the heap, since the Map may outlive it
+        SharedData(PropertyBag&& v)
+            : type(Type::Map)
+            , refs(1)
+            , data(std::move(v))
+        {
+            for (auto& prop : std::get<PropertyBag>(data))
+            {
+                if (prop._fromResource())
+                    prop = Property(prop);
+            }
+        }
+
         std::size_t addRef() noexcept
         {
             auto prev = refs.fetch_add(1, std::memory_order_acq_rel);
@@ -324,10 +611,59 @@ private:
         {
             auto prev = refs.fetch_sub(1, std::memory_order_acq_rel);
             if (prev == 1)
-                delete this;
+                destroy();
 
             return prev - 1;
         }
+
+        void destroy() noexcept
+        {
+            if (!resource)
+            {
+                delete this;
+                return;
+            }
+
+            auto r = resource;
+            auto size = sizeof(SharedData) + std::get<std::string_view>(data).size();
+            this->~SharedData();
+            r->deallocate(this, size, alignof(SharedData));
+        }
+    };
+
+    // copies share the node, and cached hashes that differ prove the values differ, as do two interned nodes
+    // nullopt means the values have to be compared
+    static std::optional<bool> _eqShared(const SharedData* a, const SharedData* b) noexcept
+    {
+        if (a == b)
+            return true;
+
+        if (a->interned && b->interned)
+            return false;
+
+        auto ha = a->hash.load(std::memory_order_relaxed);
+        auto hb = b->hash.load(std::memory_order_relaxed);
+        if (ha && hb && (ha != hb))
+            return false;
+
+        return std::nullopt;
+    }
+
+    // short strings live right in the storage, zero-padded, followed by their length
+    // getString() needs a std::string to return a reference to, so it makes one on the heap once and keeps it in 'heap'
+    struct InlineString
+    {
+        char data[InlineCapacity];
+        std::uint8_t size;
+        mutable std::string* heap;
+    };
+
+    struct Largest
+    {
+        std::uint64_t lo;
+        std::uint64_t hi;
+
+        friend constexpr bool operator==(const Largest&, const Largest&) noexcept = default;
     };
 
     union Storage
@@ -339,65 +675,126 @@ private:
         uint64_t v_uint64;
         double v_double;
         SharedData* _shared;
-        uint64_t _largest; // must be the largest type
+        InlineString _inline;
+        Largest _largest; // must be the largest type
 
         constexpr Storage(DontInit) noexcept
         {
         }
 
         constexpr Storage() noexcept
-            : _largest(0)
+            : _largest{}
         {
         }
 
+        // values are stored through _largest so that the unused higher bits are always zero
         constexpr Storage(double v) noexcept
-            : v_double(v)
+            : _largest{ std::bit_cast<std::uint64_t>(v), 0 }
         {
         }
 
         constexpr Storage(int64_t v) noexcept
-            : v_int64(v)
+            : _largest{ static_cast<std::uint64_t>(v), 0 }
         {
         }
 
         constexpr Storage(uint64_t v) noexcept
-            : v_uint64(v)
+            : _largest{ v, 0 }
         {
         }
 
         constexpr Storage(SharedData* v) noexcept
-            : _shared(v)
+            : _largest{}
         {
+            _shared = v;
         }
 
         // we don't have constructors for smaller types like int32 here
         // because we have to zero-initialize higher bits of _largest in the default constructor anyway
     } ;
 
+    static_assert(sizeof(InlineString) == sizeof(Largest));
     static_assert(sizeof(Storage) == sizeof(Storage::_largest));
 
+    // holds a reference to a transient PropertyInfo, so that it lives as long as the properties using it
     struct InfoAndType
     {
         std::uintptr_t ty;
         static constexpr std::uintptr_t TypeMask = 0x0FULL; // 4 lower pointer bits
+        static constexpr std::uintptr_t InlineString = 0x0FULL; // a String stored in Storage::_inline
+
+        static_assert(static_cast<std::uintptr_t>(PropertyType::Max) <= InlineString);
+
+        ~InfoAndType()
+        {
+            auto pi = info();
+            if (pi && pi->isTransient()) [[unlikely]]
+                Erp::releaseTransientProperty(pi);
+        }
 
+        // no PropertyInfo until assigned
         constexpr InfoAndType(DontInit) noexcept
+            : ty(0)
         {
         }
 
         InfoAndType(PropertyType type, const PropertyInfo* info) noexcept
-            : ty(reinterpret_cast<std::uintptr_t>(info) | static_cast<std::uintptr_t>(type))
+            : InfoAndType(static_cast<std::uintptr_t>(type), info)
+        {
+        }
+
+        InfoAndType(std::uintptr_t rawType, const PropertyInfo* info) noexcept
+            : ty(reinterpret_cast<std::uintptr_t>(info) | rawType)
         {
             ErAssert((reinterpret_cast<std::uintptr_t>(info) & TypeMask) == 0); // misaligned PropertyInfo
+            retain();
         }
 
         InfoAndType() noexcept
             : InfoAndType(PropertyType::Empty, &Unspecified::Empty)
         {}
 
+        InfoAndType(const InfoAndType& other) noexcept
+            : ty(other.ty)
+        {
+            retain();
+        }
+
+        InfoAndType(InfoAndType&& other) noexcept
+            : ty(std::exchange(other.ty, 0))
+        {
+        }
+
+        InfoAndType& operator=(const InfoAndType& other) noexcept
+        {
+            InfoAndType tmp(other);
+            std::swap(ty, tmp.ty);
+            return *this;
+        }
+
+        InfoAndType& operator=(InfoAndType&& other) noexcept
+        {
+            InfoAndType tmp(std::move(other));
+            std::swap(ty, tmp.ty);
+            return *this;
+        }
+
+        void retain() const noexcept
+        {
+            auto pi = info();
+            if (pi && pi->isTransient()) [[unlikely]]
+                Erp::retainTransientProperty(pi);
+        }
+
+        constexpr std::uintptr_t rawType() const noexcept
+        {
+            return ty & TypeMask;
+        }
+
         constexpr PropertyType type() const noexcept
         {
-            return static_cast<PropertyType>(ty & TypeMask);
+            auto raw = rawType();
+            return (raw == InlineString) ? PropertyType::String : static_cast<PropertyType>(raw);
         }
 
         const PropertyInfo* info() const noexcept
@@ -413,62 +810,153 @@ private:
     
     Storage m_u;
     InfoAndType m_type;
+
+    const std::string& _inlineString() const
+    {
+        std::atomic_ref<std::string*> heap(m_u._inline.heap);
+        auto s = heap.load(std::memory_order_acquire);
+        if (!s)
+        {
+            auto fresh = std::make_unique<std::string>(m_u._inline.data, m_u._inline.size);
+            if (heap.compare_exchange_strong(s, fresh.get(), std::memory_order_acq_rel, std::memory_order_acquire))
+                s = fresh.release();
+        }
+
+        return *s;
+    }
+
+    void _setInline(std::string_view v, const PropertyInfo& info) noexcept
+    {
+        m_u._largest = {};
+        std::memcpy(m_u._inline.data, v.data(), v.size());
+        m_u._inline.size = static_cast<std::uint8_t>(v.size());
+        m_type = InfoAndType(InfoAndType::InlineString, &info);
+    }
+
+    void _setShared(SharedData* shared, const PropertyInfo& info) noexcept
+    {
+        m_u = Storage(shared);
+        m_type = InfoAndType(PropertyType::String, &info);
+    }
 };
 
 
+// returns a reference to the value; get<std::string_view> returns a view, which never allocates for an inline string
 template <typename T>
-const T& get(const Property& v) noexcept;
+decltype(auto) get(const Property& v) noexcept(!std::is_same_v<T, std::string>);
 
 template <>
-[[nodiscard]] inline const Bool& get<>(const Property& v) noexcept
+[[nodiscard]] inline decltype(auto) get<Bool>(const Property& v) noexcept
 {
     return v.getBool();
 }
 
 template <>
-[[nodiscard]] inline const int32_t& get<>(const Property& v) noexcept
+[[nodiscard]] inline decltype(auto) get<int32_t>(const Property& v) noexcept
 {
     return v.getInt32();
 }
 
 template <>
-[[nodiscard]] inline const uint32_t& get<>(const Property& v) noexcept
+[[nodiscard]] inline decltype(auto) get<uint32_t>(const Property& v) noexcept
 {
     return v.getUInt32();
 }
 
 template <>
-[[nodiscard]] inline const int64_t& get<>(const Property& v) noexcept
+[[nodiscard]] inline decltype(auto) get<int64_t>(const Property& v) noexcept
 {
     return v.getInt64();
 }
 
 template <>
-[[nodiscard]] inline const uint64_t& get<>(const Property& v) noexcept
+[[nodiscard]] inline decltype(auto) get<uint64_t>(const Property& v) noexcept
 {
     return v.getUInt64();
 }
 
 template <>
-[[nodiscard]] inline const double& get<>(const Property& v) noexcept
+[[nodiscard]] inline decltype(auto) get<double>(const Property& v) noexcept
 {
     return v.getDouble();
 }
 
 template <>
-[[nodiscard]] inline const std::string& get<>(const Property& v) noexcept
+[[nodiscard]] inline decltype(auto) get<std::string>(const Property& v)
 {
     return v.getString();
 }
 
 template <>
-[[nodiscard]] inline const Binary& get<>(const Property& v) noexcept
+[[nodiscard]] inline decltype(auto) get<std::string_view>(const Property& v) noexcept
+{
+    return v.getStringView();
+}
+
+template <>
+[[nodiscard]] inline decltype(auto) get<Binary>(const Property& v) noexcept
 {
     return v.getBinary();
 }
 
+template <>
+[[nodiscard]] inline decltype(auto) get<Int32Array>(const Property& v) noexcept
+{
+    return v.getInt32Array();
+}
+
+template <>
+[[nodiscard]] inline decltype(auto) get<UInt32Array>(const Property& v) noexcept
+{
+    return v.getUInt32Array();
+}
+
+template <>
+[[nodiscard]] inline decltype(auto) get<Int64Array>(const Property& v) noexcept
+{
+    return v.getInt64Array();
+}
+
+template <>
+[[nodiscard]] inline decltype(auto) get<UInt64Array>(const Property& v) noexcept
+{
+    return v.getUInt64Array();
+}
+
+template <>
+[[nodiscard]] inline decltype(auto) get<DoubleArray>(const Property& v) noexcept
+{
+    return v.getDoubleArray();
+}
+
+template <>
+[[nodiscard]] inline decltype(auto) get<PropertyBag>(const Property& v) noexcept
+{
+    return v.getMap();
+}
+
 
 
 [[nodiscard]] std::string_view propertyTypeToString(PropertyType type);
 
+// appends the value as its PropertyInfo formats it
+inline void formatTo(FormatBuffer& out, const Property& prop)
+{
+    auto info = prop.info();
+    if (info)
+        info->formatTo(prop, out);
+    else
+        prop.strTo(out);
+}
+
 } // namespace Er {}
+
+
+template <>
+struct std::hash<Er::Property>
+{
+    std::size_t operator()(const Er::Property& prop) const noexcept
+    {
+        return prop.hash();
+    }
+};
@@ -2,27 +2,72 @@
 
 #include <erebus/system/property.hxx>
 
+#include <optional>
 #include <vector>
 
 
 namespace Er
 {
 
-using PropertyBag = std::vector<Property>;
+inline const Property* find(const PropertyBag& bag, const PropertyInfo& info) noexcept
+{
+    auto unique = info.unique();
+    for (auto& prop : bag)
+    {
+        if (prop.unique() == unique)
+            return &prop;
+    }
 
+    return nullptr;
+}
 
+// returns a pointer to the value; get<std::string_view> returns an optional view instead
 template <typename T>
-const T* get(const PropertyBag& bag, const PropertyInfo& info)
+auto get(const PropertyBag& bag, const PropertyInfo& info)
 {
+    using Value = decltype(get<T>(std::declval<const Property&>()));
+
     for (auto& prop : bag)
     {
         if (prop.info() == &info)
-            return &get<T>(prop);
+        {
+            if constexpr (std::is_reference_v<Value>)
+                return &get<T>(prop);
+            else
+                return std::optional<Value>(get<T>(prop));
+        }
     }
 
-    return nullptr;
+    if constexpr (std::is_reference_v<Value>)
+        return static_cast<const T*>(nullptr);
+    else
+        return std::optional<Value>();
 }
 
+// hashes the PropertyInfos and the values in order, consistent with equal()
+// the property hashes are folded in independent lanes, so long bags don't wait on a single multiply chain
+ER_SYSTEM_EXPORT std::size_t hash(const PropertyBag& bag) noexcept;
+
+// the same PropertyInfos with equal values in the same order; == on bags compares the values only
+ER_SYSTEM_EXPORT bool equal(const PropertyBag& a, const PropertyBag& b) noexcept;
+
+// for bags used as keys, e.g. of request caches
+struct PropertyBagHash
+{
+    std::size_t operator()(const PropertyBag& bag) const noexcept
+    {
+        return hash(bag);
+    }
+};
+
+struct PropertyBagEqual
+{
+    bool operator()(const PropertyBag& a, const PropertyBag& b) const noexcept
+    {
+        return equal(a, b);
+    }
+};
+
 template <typename T>
 bool update(PropertyBag& src, std::size_t index, Er::Property&& prop)
 {
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <erebus/system/property_bag.hxx>
+
+#include <optional>
+#include <span>
+#include <variant>
+
+
+namespace Er
+{
+
+//
+// a batch of PropertyBags sharing one schema, stored column by column
+// each column is a typed vector; strings and binaries of a column are packed into one buffer with offsets
+// a row costs only its values, with no Property boxes, PropertyInfo pointers or per-string allocations
+//
+
+class ER_SYSTEM_EXPORT PropertyBatch final
+{
+public:
+    using Schema = std::vector<const PropertyInfo*>;
+
+    // values of a String or Binary column, back to back
+    // offsets has rows + 1 entries; value i spans [offsets[i], offsets[i + 1])
+    struct Blobs
+    {
+        std::string data;
+        std::vector<std::uint32_t> offsets = { 0 };
+
+        std::string_view at(std::size_t index) const noexcept
+        {
+            ErAssert(index + 1 < offsets.size());
+            return std::string_view(data.data() + offsets[index], offsets[index + 1] - offsets[index]);
+        }
+    };
+
+    using ColumnData = std::variant<
+        std::monostate,             // Empty
+        std::vector<Bool>,
+        std::vector<std::int32_t>,
+        std::vector<std::uint32_t>,
+        std::vector<std::int64_t>,
+        std::vector<std::uint64_t>,
+        std::vector<double>,
+        Blobs                       // String and Binary
+    >;
+
+    struct Column
+    {
+        const PropertyInfo* info = nullptr;
+        ColumnData data;
+    };
+
+    // a row as seen through the batch; converts to a PropertyBag when needed
+    class RowView
+    {
+    public:
+        RowView(const PropertyBatch* batch, std::size_t row) noexcept
+            : m_batch(batch)
+            , m_row(row)
+        {
+        }
+
+        [[nodiscard]] std::size_t size() const noexcept
+        {
+            return m_batch->columns();
+        }
+
+        [[nodiscard]] Property operator[](std::size_t column) const
+        {
+            return m_batch->get(m_row, column);
+        }
+
+        [[nodiscard]] std::optional<Property> find(const PropertyInfo& info) const
+        {
+            auto column = m_batch->columnOf(info);
+            if (column == NotFound)
+                return std::nullopt;
+
+            return m_batch->get(m_row, column);
+        }
+
+        [[nodiscard]] PropertyBag bag() const
+        {
+            return m_batch->row(m_row);
+        }
+
+        operator PropertyBag() const
+        {
+            return bag();
+        }
+
+    private:
+        const PropertyBatch* m_batch;
+        std::size_t m_row;
+    };
+
+    static constexpr std::size_t NotFound = std::size_t(-1);
+
+    PropertyBatch() noexcept = default;
+    explicit PropertyBatch(Schema schema);
+
+    // adopt columns unmarshaled elsewhere; throws if they are inconsistent
+    PropertyBatch(std::vector<Column>&& columns, std::size_t rows);
+
+    [[nodiscard]] std::size_t rows() const noexcept
+    {
+        return m_rows;
+    }
+
+    [[nodiscard]] std::size_t columns() const noexcept
+    {
+        return m_columns.size();
+    }
+
+    [[nodiscard]] bool empty() const noexcept
+    {
+        return m_rows == 0;
+    }
+
+    [[nodiscard]] const Column& column(std::size_t index) const noexcept
+    {
+        ErAssert(index < m_columns.size());
+        return m_columns[index];
+    }
+
+    [[nodiscard]] std::size_t columnOf(const PropertyInfo& info) const noexcept;
+
+    template <typename T>
+    [[nodiscard]] std::span<const T> values(std::size_t column) const noexcept
+    {
+        ErAssert(column < m_columns.size());
+        auto v = std::get_if<std::vector<T>>(&m_columns[column].data);
+        ErAssert(v);
+        return std::span<const T>(*v);
+    }
+
+    [[nodiscard]] std::string_view blob(std::size_t row, std::size_t column) const noexcept
+    {
+        ErAssert(column < m_columns.size());
+        auto v = std::get_if<Blobs>(&m_columns[column].data);
+        ErAssert(v);
+        return v->at(row);
+    }
+
+    [[nodiscard]] RowView operator[](std::size_t row) const noexcept
+    {
+        ErAssert(row < m_rows);
+        return RowView(this, row);
+    }
+
+    [[nodiscard]] Property get(std::size_t row, std::size_t column) const;
+    [[nodiscard]] PropertyBag row(std::size_t row) const;
+
+    // the first row appended to a batch without a schema defines it
+    // returns false if the row does not match the schema; the caller is expected to start a new batch then
+    // a first row with array or Map properties is refused as well, and leaves the batch without a schema
+    bool append(const PropertyBag& row);
+
+    void reserve(std::size_t rows, std::size_t bytesPerBlob = 0);
+
+    // drops the rows but keeps the schema and the allocated capacity
+    void clear() noexcept;
+
+private:
+    void setSchema(const Schema& schema);
+    bool matches(const PropertyBag& row) const noexcept;
+
+    std::vector<Column> m_columns;
+    std::size_t m_rows = 0;
+};
+
+
+} // namespace Er {}
@@ -2,7 +2,9 @@
 
 #include <erebus/system/binary.hxx>
 #include <erebus/system/bool.hxx>
+#include <erebus/system/format.hxx>
 
+#include <atomic>
 #include <functional>
 #include <vector>
 
@@ -22,6 +24,12 @@ enum class PropertyType : uint32_t
     Double,
     String,
     Binary,
+    Int32Array,
+    UInt32Array,
+    Int64Array,
+    UInt64Array,
+    DoubleArray,
+    Map,
     Max // should go last
 };
 
@@ -30,6 +38,7 @@ static_assert(unsigned(PropertyType::Max) <= 0x10, "Align PropertyInfo so that w
 
 struct Property;
 struct PropertyInfo;
+class PropertyInfoRef;
 
 } // namespace Er {]
 
@@ -38,15 +47,35 @@ namespace Erp
 
 ER_SYSTEM_EXPORT std::uint32_t registerPersistentProperty(const Er::PropertyInfo* info);
 ER_SYSTEM_EXPORT std::string formatProperty(const Er::PropertyInfo* info, const Er::Property& prop);
+ER_SYSTEM_EXPORT void formatPropertyTo(const Er::PropertyInfo* info, const Er::Property& prop, Er::FormatBuffer& out);
+
+// counts persistent properties only; transient ones come and go without invalidating peer mappings
 ER_SYSTEM_EXPORT std::uint32_t propertyMappingVersion() noexcept;
-ER_SYSTEM_EXPORT const Er::PropertyInfo* allocateTransientProperty(Er::PropertyType type, const std::string& name, const std::string& readableName);
+
+// returns the persistent property of that name if there is one
+// otherwise finds or creates a transient property that lives while someone holds a reference to it,
+// either a PropertyInfoRef or a Property using it
+ER_SYSTEM_EXPORT Er::PropertyInfoRef allocateTransientProperty(Er::PropertyType type, const std::string& name, const std::string& readableName);
+
+// no-ops for persistent properties
+ER_SYSTEM_EXPORT void retainTransientProperty(const Er::PropertyInfo* info) noexcept;
+ER_SYSTEM_EXPORT void releaseTransientProperty(const Er::PropertyInfo* info) noexcept;
+
+// fails if the last reference is already gone, in which case the property is about to be freed
+ER_SYSTEM_EXPORT bool retainTransientPropertyIfAlive(const Er::PropertyInfo* info) noexcept;
+
+// replaced name indices not freed yet; for diagnostics
+ER_SYSTEM_EXPORT std::size_t retiredPropertyIndices() noexcept;
 
 } // namespace Erp {}
 
 namespace Er
 {
 
-ER_SYSTEM_EXPORT const PropertyInfo* lookupProperty(const std::string& name) noexcept;
+// the reference keeps a transient property alive; it is taken before the property could go away
+ER_SYSTEM_EXPORT PropertyInfoRef lookupProperty(const std::string& name) noexcept;
+
+// the callback is invoked with the registry locked; it may retain transient properties
 ER_SYSTEM_EXPORT std::uint32_t enumerateProperties(std::function<bool(const PropertyInfo*)> cb) noexcept;
 
 
@@ -59,8 +88,14 @@ struct alignas(16) PropertyInfo
 {
     using Formatter = std::function<std::string(const Property&)>;
 
+    // appends to the buffer instead of returning a string
+    using BufferFormatter = std::function<void(const Property&, FormatBuffer&)>;
+
     static constexpr std::uint32_t InvalidUnique = std::uint32_t(-1);
 
+    // transient properties are numbered separately from persistent ones
+    static constexpr std::uint32_t TransientBit = 0x80000000;
+
     constexpr void* self()
     {
         return this;
@@ -71,6 +106,11 @@ struct alignas(16) PropertyInfo
         return m_unique;
     }
 
+    constexpr bool isTransient() const noexcept
+    {
+        return (m_unique & TransientBit) && (m_unique != InvalidUnique);
+    }
+
     constexpr PropertyType type() const noexcept
     {
         return m_type;
@@ -90,6 +130,11 @@ struct alignas(16) PropertyInfo
     {
         return m_formatter;
     }
+
+    constexpr const BufferFormatter& bufferFormatter() const noexcept
+    {
+        return m_bufferFormatter;
+    }
     
     ~PropertyInfo() = default;
     
@@ -102,6 +147,15 @@ struct alignas(16) PropertyInfo
     {
     }
 
+    PropertyInfo(PropertyType type, std::string_view name, std::string_view readableName, BufferFormatter&& formatter)
+        : m_type(type)
+        , m_name(name)
+        , m_readableName(readableName)
+        , m_bufferFormatter(std::move(formatter))
+        , m_unique(Erp::registerPersistentProperty(this))
+    {
+    }
+
     struct Transient {};
 
     PropertyInfo(Transient tag, std::uint32_t id, PropertyType type, std::string_view name, std::string_view readableName)
@@ -111,19 +165,118 @@ struct alignas(16) PropertyInfo
         , m_formatter()
         , m_unique(id)
     {
+        ErAssert(isTransient());
     }
 
+    PropertyInfo(const PropertyInfo&) = delete;
+    PropertyInfo& operator=(const PropertyInfo&) = delete;
+
     std::string format(const Property& prop) const
     {
         return Erp::formatProperty(this, prop);
     }
 
+    void formatTo(const Property& prop, FormatBuffer& out) const
+    {
+        Erp::formatPropertyTo(this, prop, out);
+    }
+
 private:
     PropertyType m_type;
     std::string m_name;
     std::string m_readableName;
     Formatter m_formatter;
+    BufferFormatter m_bufferFormatter;
     std::uint32_t m_unique;
+    mutable std::atomic<std::uint32_t> m_refs = 0; // transient properties only
+
+    friend void Erp::retainTransientProperty(const Er::PropertyInfo* info) noexcept;
+    friend void Erp::releaseTransientProperty(const Er::PropertyInfo* info) noexcept;
+    friend bool Erp::retainTransientPropertyIfAlive(const Er::PropertyInfo* info) noexcept;
+    friend Er::PropertyInfoRef Erp::allocateTransientProperty(Er::PropertyType type, const std::string& name, const std::string& readableName);
+};
+
+
+//
+// a counted reference that keeps a transient PropertyInfo alive
+// holds persistent properties too, without counting them
+//
+class PropertyInfoRef final
+{
+public:
+    struct Adopt {};
+
+    ~PropertyInfoRef()
+    {
+        Erp::releaseTransientProperty(m_info);
+    }
+
+    PropertyInfoRef() noexcept = default;
+
+    explicit PropertyInfoRef(const PropertyInfo* info) noexcept
+        : m_info(info)
+    {
+        Erp::retainTransientProperty(m_info);
+    }
+
+    // takes over a reference that has already been counted
+    PropertyInfoRef(Adopt, const PropertyInfo* info) noexcept
+        : m_info(info)
+    {
+    }
+
+    PropertyInfoRef(const PropertyInfoRef& other) noexcept
+        : PropertyInfoRef(other.m_info)
+    {
+    }
+
+    PropertyInfoRef(PropertyInfoRef&& other) noexcept
+        : m_info(std::exchange(other.m_info, nullptr))
+    {
+    }
+
+    PropertyInfoRef& operator=(const PropertyInfoRef& other) noexcept
+    {
+        PropertyInfoRef tmp(other);
+        std::swap(m_info, tmp.m_info);
+        return *this;
+    }
+
+    PropertyInfoRef& operator=(PropertyInfoRef&& other) noexcept
+    {
+        PropertyInfoRef tmp(std::move(other));
+        std::swap(m_info, tmp.m_info);
+        return *this;
+    }
+
+    [[nodiscard]] const PropertyInfo* get() const noexcept
+    {
+        return m_info;
+    }
+
+    const PropertyInfo* operator->() const noexcept
+    {
+        ErAssert(m_info);
+        return m_info;
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return !!m_info;
+    }
+
+    friend bool operator==(const PropertyInfoRef& a, const PropertyInfo* b) noexcept
+    {
+        return a.m_info == b;
+    }
+
+    friend bool operator==(const PropertyInfoRef& a, const PropertyInfoRef& b) noexcept
+    {
+        return a.m_info == b.m_info;
+    }
+
+private:
+    const PropertyInfo* m_info = nullptr;
 };
 
 
@@ -148,6 +301,12 @@ extern ER_SYSTEM_EXPORT const PropertyInfo UInt64;
 extern ER_SYSTEM_EXPORT const PropertyInfo Double;
 extern ER_SYSTEM_EXPORT const PropertyInfo String;
 extern ER_SYSTEM_EXPORT const PropertyInfo Binary;
+extern ER_SYSTEM_EXPORT const PropertyInfo Int32Array;
+extern ER_SYSTEM_EXPORT const PropertyInfo UInt32Array;
+extern ER_SYSTEM_EXPORT const PropertyInfo Int64Array;
+extern ER_SYSTEM_EXPORT const PropertyInfo UInt64Array;
+extern ER_SYSTEM_EXPORT const PropertyInfo DoubleArray;
+extern ER_SYSTEM_EXPORT const PropertyInfo Map;
 
 
 } // namespace Unspecified {}
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <erebus/system/exception.hxx>
+#include <erebus/system/format.hxx>
+#include <erebus/system/property_bag.hxx>
+
+#include <optional>
+#include <tuple>
+
+
+namespace Er
+{
+
+//
+// C++ types that can be stored in a Property
+//
+
+template <typename T>
+struct PropertyTypeOf;
+
+template <> struct PropertyTypeOf<Bool> : std::integral_constant<PropertyType, PropertyType::Bool> {};
+template <> struct PropertyTypeOf<std::int32_t> : std::integral_constant<PropertyType, PropertyType::Int32> {};
+template <> struct PropertyTypeOf<std::uint32_t> : std::integral_constant<PropertyType, PropertyType::UInt32> {};
+template <> struct PropertyTypeOf<std::int64_t> : std::integral_constant<PropertyType, PropertyType::Int64> {};
+template <> struct PropertyTypeOf<std::uint64_t> : std::integral_constant<PropertyType, PropertyType::UInt64> {};
+template <> struct PropertyTypeOf<double> : std::integral_constant<PropertyType, PropertyType::Double> {};
+template <> struct PropertyTypeOf<std::string> : std::integral_constant<PropertyType, PropertyType::String> {};
+template <> struct PropertyTypeOf<Binary> : std::integral_constant<PropertyType, PropertyType::Binary> {};
+template <> struct PropertyTypeOf<Int32Array> : std::integral_constant<PropertyType, PropertyType::Int32Array> {};
+template <> struct PropertyTypeOf<UInt32Array> : std::integral_constant<PropertyType, PropertyType::UInt32Array> {};
+template <> struct PropertyTypeOf<Int64Array> : std::integral_constant<PropertyType, PropertyType::Int64Array> {};
+template <> struct PropertyTypeOf<UInt64Array> : std::integral_constant<PropertyType, PropertyType::UInt64Array> {};
+template <> struct PropertyTypeOf<DoubleArray> : std::integral_constant<PropertyType, PropertyType::DoubleArray> {};
+
+template <typename T>
+concept PropertyValue = requires { PropertyTypeOf<T>::value; };
+
+
+//
+// a PropertyInfo whose value type is known at compile time
+//
+
+template <PropertyValue T>
+struct TypedPropertyInfo final
+    : public PropertyInfo
+{
+    using ValueType = T;
+    static constexpr PropertyType Type = PropertyTypeOf<T>::value;
+
+    TypedPropertyInfo(std::string_view name, std::string_view readableName, Formatter&& formatter = Formatter{})
+        : PropertyInfo(Type, name, readableName, std::move(formatter))
+    {
+    }
+
+    TypedPropertyInfo(std::string_view name, std::string_view readableName, BufferFormatter&& formatter)
+        : PropertyInfo(Type, name, readableName, std::move(formatter))
+    {
+    }
+};
+
+
+namespace Private
+{
+
+template <typename T>
+struct FieldValue
+{
+    using Type = T;
+    static constexpr bool Optional = false;
+};
+
+template <typename T>
+struct FieldValue<std::optional<T>>
+{
+    using Type = T;
+    static constexpr bool Optional = true;
+};
+
+template <typename T>
+struct MemberTraits;
+
+template <typename C, typename T>
+struct MemberTraits<T C::*>
+{
+    using Class = C;
+    using Member = T;
+};
+
+} // namespace Private {}
+
+
+//
+// binds a struct member to a property
+// the member type has to match the property type exactly; std::optional members may be absent from bags
+//
+
+template <auto Member>
+struct Field final
+{
+    using Class = typename Private::MemberTraits<decltype(Member)>::Class;
+    using MemberType = typename Private::MemberTraits<decltype(Member)>::Member;
+    using ValueType = typename Private::FieldValue<MemberType>::Type;
+
+    static constexpr bool Optional = Private::FieldValue<MemberType>::Optional;
+
+    static_assert(PropertyValue<ValueType>, "Field type cannot be stored in a Property");
+
+    const TypedPropertyInfo<ValueType>* info;
+
+    constexpr explicit Field(const TypedPropertyInfo<ValueType>& info) noexcept
+        : info(&info)
+    {
+    }
+
+    static constexpr const MemberType& get(const Class& s) noexcept
+    {
+        return s.*Member;
+    }
+
+    static constexpr MemberType& get(Class& s) noexcept
+    {
+        return s.*Member;
+    }
+
+    // nullptr for an empty optional
+    static constexpr const ValueType* value(const Class& s) noexcept
+    {
+        if constexpr (Optional)
+            return (s.*Member) ? &*(s.*Member) : nullptr;
+        else
+            return &(s.*Member);
+    }
+};
+
+template <auto Member, typename T>
+constexpr auto field(const TypedPropertyInfo<T>& info) noexcept
+{
+    return Field<Member>(info);
+}
+
+
+//
+// a record schema: a struct plus the properties its members are bound to
+//
+//    struct Process { std::uint64_t pid; std::string comm; std::optional<std::uint64_t> ppid; };
+//
+//    constexpr auto ProcessSchema = Er::schema<Process>(
+//        Er::field<&Process::pid>(PidProperty),
+//        Er::field<&Process::comm>(CommProperty),
+//        Er::field<&Process::ppid>(PPidProperty));
+//
+// toBag() emits properties in field order; fromBag() expects that order and falls back to a search otherwise
+//
+
+template <typename Struct, typename... Fields>
+class Schema final
+{
+    static_assert((std::is_same_v<Struct, typename Fields::Class> && ...), "All fields must belong to the schema struct");
+
+public:
+    static constexpr std::size_t FieldCount = sizeof...(Fields);
+
+    constexpr explicit Schema(Fields... fields) noexcept
+        : m_fields(fields...)
+    {
+    }
+
+    template <typename Fn>
+    constexpr void forEach(Fn&& fn) const
+    {
+        std::apply([&fn](auto&... f) { (fn(f), ...); }, m_fields);
+    }
+
+    void toBag(const Struct& s, PropertyBag& bag) const
+    {
+        bag.reserve(bag.size() + FieldCount);
+
+        forEach(
+            [&s, &bag](auto& f)
+            {
+                if (auto v = f.value(s))
+                    bag.emplace_back(*v, *f.info);
+            });
+    }
+
+    [[nodiscard]] PropertyBag toBag(const Struct& s) const
+    {
+        PropertyBag bag;
+        toBag(s, bag);
+        return bag;
+    }
+
+    // returns false if a required field is missing; fields already read stay assigned
+    bool tryFromBag(const PropertyBag& bag, Struct& s) const
+    {
+        return read<false>(bag, s);
+    }
+
+    // throws if a required field is missing
+    [[nodiscard]] Struct fromBag(const PropertyBag& bag) const
+    {
+        Struct s{};
+        read<true>(bag, s);
+        return s;
+    }
+
+private:
+    template <bool Throw>
+    bool read(const PropertyBag& bag, Struct& s) const
+    {
+        bool complete = true;
+        std::size_t position = 0;
+
+        forEach(
+            [&](auto& f)
+            {
+                using F = std::decay_t<decltype(f)>;
+
+                auto prop = findAt(bag, position, *f.info);
+                if (!prop)
+                {
+                    if constexpr (F::Optional)
+                        f.get(s).reset();
+                    else if constexpr (Throw)
+                        ErThrow(Er::format("Property {} not found", f.info->name()));
+                    else
+                        complete = false;
+
+                    return;
+                }
+
+                f.get(s) = typename F::ValueType(Er::get<typename F::ValueType>(*prop));
+            });
+
+        return complete;
+    }
+
+    // optional fields make positions drift, so the expected position follows the last hit
+    static const Property* findAt(const PropertyBag& bag, std::size_t& position, const PropertyInfo& info) noexcept
+    {
+        auto unique = info.unique();
+
+        const Property* prop = nullptr;
+        if ((position < bag.size()) && (bag[position].unique() == unique))
+        {
+            prop = &bag[position];
+        }
+        else
+        {
+            for (std::size_t i = 0; i < bag.size(); ++i)
+            {
+                if (bag[i].unique() == unique)
+                {
+                    prop = &bag[i];
+                    position = i;
+                    break;
+                }
+            }
+        }
+
+        // a property with the right id but a foreign type is as good as missing
+        if (!prop || (prop->type() != info.type()))
+            return nullptr;
+
+        ++position;
+        return prop;
+    }
+
+    std::tuple<Fields...> m_fields;
+};
+
+template <typename Struct, typename... Fields>
+constexpr auto schema(Fields... fields) noexcept
+{
+    return Schema<Struct, Fields...>(fields...);
+}
+
+} // namespace Er {}
@@ -0,0 +1,321 @@
+#pragma once
+
+#include <erebus/system/exception.hxx>
+#include <erebus/system/property_bag.hxx>
+#include <erebus/system/property_schema.hxx>
+
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <unordered_map>
+
+
+namespace Er
+{
+
+//
+// a file of PropertyBags that is mapped into memory and read in place
+//
+// all integers are little-endian and every block starts at a multiple of 8 bytes:
+//    header        magic, version, counts and the offsets of the blocks below
+//    records       one per bag: [uint32 field count][uint32 size of the fields], then the fields
+//                  a field is [uint32 key][uint32 length][value], padded to 8 bytes
+//                  the key indexes the dictionary; the value of a Map is a nested record
+//    dictionary    per property: [uint32 type][uint32 name length][uint32 readable name length][name][readable name], padded
+//    index         uint64 offset of each record
+//
+
+namespace PropertySnapshot
+{
+
+inline constexpr std::uint32_t Version = 1;
+inline constexpr std::size_t Alignment = 8;
+
+struct Header
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t dictionarySize;
+    std::uint64_t recordCount;
+    std::uint64_t dictionaryOffset;
+    std::uint64_t indexOffset;
+};
+
+inline constexpr char Magic[8] = { 'E', 'r', 'S', 'n', 'a', 'p', '\0', '\0' };
+
+} // namespace PropertySnapshot {}
+
+
+class ER_SYSTEM_EXPORT PropertySnapshotWriter final
+{
+public:
+    // finishes the file unless close() has been called; errors are lost then
+    ~PropertySnapshotWriter();
+
+    // throws if the file cannot be created
+    explicit PropertySnapshotWriter(const std::string& path);
+
+    PropertySnapshotWriter(const PropertySnapshotWriter&) = delete;
+    PropertySnapshotWriter& operator=(const PropertySnapshotWriter&) = delete;
+
+    void write(const PropertyBag& bag);
+
+    // writes the dictionary and the index; the writer cannot be used afterwards
+    void close();
+
+    [[nodiscard]] std::uint64_t records() const noexcept
+    {
+        return m_index.size();
+    }
+
+private:
+    struct Entry
+    {
+        PropertyType type;
+        std::string name;
+        std::string readableName;
+    };
+
+    std::uint32_t keyOf(const PropertyInfo* info);
+    void encodeRecord(const PropertyBag& bag);
+    void encodeField(const Property& prop);
+    void writeBlock(const std::string& data);
+
+    std::ofstream m_file;
+    std::string m_path;
+    std::uint64_t m_offset = 0;
+    std::unordered_map<std::uint32_t, std::uint32_t> m_keys; // PropertyInfo::unique() -> key
+    std::vector<Entry> m_dictionary;
+    std::vector<std::uint64_t> m_index;
+    std::string m_buffer;
+    bool m_closed = false;
+};
+
+
+class ER_SYSTEM_EXPORT PropertySnapshotReader final
+{
+public:
+    class Record;
+
+    // a property as stored in the file
+    class Field
+    {
+    public:
+        Field(const PropertySnapshotReader* reader, std::uint32_t key, const char* data, std::uint32_t length) noexcept
+            : m_reader(reader)
+            , m_key(key)
+            , m_data(data)
+            , m_length(length)
+        {
+        }
+
+        [[nodiscard]] const PropertyInfo* info() const noexcept
+        {
+            return m_reader->info(m_key);
+        }
+
+        [[nodiscard]] PropertyType type() const noexcept
+        {
+            return info()->type();
+        }
+
+        [[nodiscard]] std::string_view raw() const noexcept
+        {
+            return std::string_view(m_data, m_length);
+        }
+
+        // numbers are returned by value, strings as std::string_view, arrays as std::span pointing into the file
+        template <typename T>
+        [[nodiscard]] T get() const;
+
+        // Map fields only
+        [[nodiscard]] Record record() const;
+
+        // a heap Property that may outlive the reader; binaries keep the file mapped
+        [[nodiscard]] Property property() const;
+
+    private:
+        friend class Record;
+
+        Property property(unsigned depth) const;
+
+        const PropertySnapshotReader* m_reader;
+        std::uint32_t m_key;
+        const char* m_data;
+        std::uint32_t m_length;
+    };
+
+    // a bag as stored in the file; iterating it yields Fields
+    class Record
+    {
+    public:
+        class Iterator
+        {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = Field;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = Field;
+
+            Iterator(const PropertySnapshotReader* reader, const char* pos, const char* end) noexcept
+                : m_reader(reader)
+                , m_pos(pos)
+                , m_end(end)
+            {
+            }
+
+            [[nodiscard]] Field operator*() const;
+
+            Iterator& operator++();
+
+            Iterator operator++(int)
+            {
+                auto tmp = *this;
+                ++*this;
+                return tmp;
+            }
+
+            [[nodiscard]] bool operator==(const Iterator& other) const noexcept
+            {
+                return m_pos == other.m_pos;
+            }
+
+        private:
+            const PropertySnapshotReader* m_reader;
+            const char* m_pos;
+            const char* m_end;
+        };
+
+        Record(const PropertySnapshotReader* reader, std::uint32_t count, const char* begin, const char* end) noexcept
+            : m_reader(reader)
+            , m_count(count)
+            , m_begin(begin)
+            , m_end(end)
+        {
+        }
+
+        [[nodiscard]] std::size_t size() const noexcept
+        {
+            return m_count;
+        }
+
+        [[nodiscard]] Iterator begin() const noexcept
+        {
+            return Iterator(m_reader, m_begin, m_end);
+        }
+
+        [[nodiscard]] Iterator end() const noexcept
+        {
+            return Iterator(m_reader, m_end, m_end);
+        }
+
+        // see Field::property(); throws if Map fields are nested deeper than MaxDepth
+        [[nodiscard]] PropertyBag bag() const;
+
+    private:
+        friend class Field;
+
+        PropertyBag bag(unsigned depth) const;
+
+        const PropertySnapshotReader* m_reader;
+        std::uint32_t m_count;
+        const char* m_begin;
+        const char* m_end;
+    };
+
+    // how deep bag() and property() follow nested Map fields
+    static constexpr unsigned MaxDepth = 64;
+
+    ~PropertySnapshotReader();
+
+    // maps the file and resolves its dictionary; throws if the file is malformed
+    explicit PropertySnapshotReader(const std::string& path);
+
+    PropertySnapshotReader(const PropertySnapshotReader&) = delete;
+    PropertySnapshotReader& operator=(const PropertySnapshotReader&) = delete;
+
+    [[nodiscard]] std::size_t size() const noexcept
+    {
+        return m_index.size();
+    }
+
+    [[nodiscard]] Record operator[](std::size_t index) const;
+
+    [[nodiscard]] const PropertyInfo* info(std::uint32_t key) const noexcept
+    {
+        ErAssert(key < m_properties.size());
+        return m_properties[key].get();
+    }
+
+private:
+    Record recordAt(const char* pos, const char* limit) const;
+    Binary binary(const char* data, std::size_t length) const;
+
+    struct Mapping;
+
+    std::shared_ptr<const Mapping> m_mapping;
+    const char* m_data = nullptr;
+    const char* m_records = nullptr; // records end where the dictionary starts
+    const char* m_recordsEnd = nullptr;
+    std::span<const std::uint64_t> m_index;
+    std::vector<PropertyInfoRef> m_properties;
+};
+
+
+namespace Private
+{
+
+template <typename T>
+T readScalar(const char* data, std::uint32_t length)
+{
+    if (length != sizeof(T)) [[unlikely]]
+        ErThrow("Malformed property snapshot field");
+
+    T v;
+    std::memcpy(&v, data, sizeof(T));
+    return v;
+}
+
+} // namespace Private {}
+
+
+template <typename T>
+T PropertySnapshotReader::Field::get() const
+{
+    ErAssert(type() != PropertyType::Map);
+
+    if constexpr (std::is_same_v<T, Bool>)
+    {
+        ErAssert(type() == PropertyType::Bool);
+        return Private::readScalar<std::uint8_t>(m_data, m_length) ? True : False;
+    }
+    else if constexpr (std::is_same_v<T, std::string_view>)
+    {
+        ErAssert((type() == PropertyType::String) || (type() == PropertyType::Binary));
+        return raw();
+    }
+    else if constexpr (std::is_same_v<T, Binary>)
+    {
+        ErAssert(type() == PropertyType::Binary);
+        return m_reader->binary(m_data, m_length);
+    }
+    else if constexpr (requires { typename T::element_type; })
+    {
+        using Element = std::remove_const_t<typename T::element_type>;
+        ErAssert(type() == ArrayTypeOf<Element>::value);
+        if (m_length % sizeof(Element)) [[unlikely]]
+            ErThrow("Malformed property snapshot field");
+
+        // values are 8-byte aligned in the file
+        return T(reinterpret_cast<const Element*>(m_data), m_length / sizeof(Element));
+    }
+    else
+    {
+        ErAssert(type() == PropertyTypeOf<T>::value);
+        return Private::readScalar<T>(m_data, m_length);
+    }
+}
+
+
+} // namespace Er {}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <erebus/system/property_bag.hxx>
+
+#include <unordered_map>
+
+
+namespace Er
+{
+
+//
+// turns repeated snapshots, e.g. of every process, into a stream of changes
+//
+// records are identified by the value of a key property; each frame starts with a ChangeProperty:
+//    Reset       first frame of a full snapshot, nothing else in it; drop all records
+//    Added       the whole record, replacing any record with the same key
+//    Modified    the key followed by the properties that changed
+//    Removed     just the key
+// a record that lost some of its properties is sent as Added
+//
+// the first snapshot is sent in full, later ones as changes to the previous one
+//
+
+class ER_SYSTEM_EXPORT SnapshotDiff final
+{
+public:
+    enum class Change : std::uint32_t
+    {
+        Reset,
+        Added,
+        Modified,
+        Removed
+    };
+
+    static const PropertyInfo ChangeProperty;
+
+    using Records = std::unordered_map<Property, PropertyBag>;
+
+    //
+    // the frames of a single diff, served one by one from IService::next()
+    // the snapshot becomes the base of the next diff only after the last frame has been taken;
+    // a Delta destroyed before that resets the diff, since the client may have missed some changes
+    //
+    class ER_SYSTEM_EXPORT Delta final
+    {
+    public:
+        ~Delta();
+        Delta(Delta&& other) noexcept;
+        Delta& operator=(Delta&& other) noexcept;
+
+        Delta(const Delta&) = delete;
+        Delta& operator=(const Delta&) = delete;
+
+        [[nodiscard]] std::size_t size() const noexcept
+        {
+            return m_frames.size();
+        }
+
+        [[nodiscard]] const std::vector<PropertyBag>& frames() const noexcept
+        {
+            return m_frames;
+        }
+
+        // moves the frames out one by one; an empty bag once all of them have been taken
+        [[nodiscard]] PropertyBag next();
+
+    private:
+        friend class SnapshotDiff;
+
+        Delta(SnapshotDiff* owner, std::uint64_t generation, std::vector<PropertyBag>&& frames) noexcept
+            : m_owner(owner)
+            , m_generation(generation)
+            , m_frames(std::move(frames))
+        {
+        }
+
+        SnapshotDiff* m_owner;
+        std::uint64_t m_generation;
+        std::vector<PropertyBag> m_frames;
+        std::size_t m_next = 0;
+    };
+
+    explicit SnapshotDiff(const PropertyInfo& key) noexcept
+        : m_key(&key)
+    {
+    }
+
+    SnapshotDiff(const SnapshotDiff&) = delete;
+    SnapshotDiff& operator=(const SnapshotDiff&) = delete;
+
+    // throws if a record has no key property or two records share a key
+    // the Delta must not outlive this object; a diff taken while another one is pending makes that one stale
+    [[nodiscard]] Delta diff(const std::vector<PropertyBag>& snapshot);
+
+    // the next diff is a full snapshot
+    void reset() noexcept;
+
+    [[nodiscard]] const Records& base() const noexcept
+    {
+        return m_base;
+    }
+
+private:
+    void commit(std::uint64_t generation) noexcept;
+    void abandon(std::uint64_t generation) noexcept;
+
+    const PropertyInfo* m_key;
+    Records m_base;
+    bool m_valid = false;   // m_base is what the client has
+    Records m_pending;
+    bool m_outstanding = false;
+    std::uint64_t m_generation = 0;
+};
+
+
+//
+// the client side: rebuilds the snapshot from the frames of a SnapshotDiff
+//
+
+class ER_SYSTEM_EXPORT SnapshotMirror final
+{
+public:
+    using Records = SnapshotDiff::Records;
+
+    explicit SnapshotMirror(const PropertyInfo& key) noexcept
+        : m_key(&key)
+    {
+    }
+
+    // throws on frames without a change or a key
+    void apply(const PropertyBag& frame);
+
+    [[nodiscard]] const Records& records() const noexcept
+    {
+        return m_records;
+    }
+
+    [[nodiscard]] const PropertyBag* find(const Property& key) const noexcept
+    {
+        auto it = m_records.find(key);
+        return (it != m_records.end()) ? &it->second : nullptr;
+    }
+
+private:
+    const PropertyInfo* m_key;
+    Records m_records;
+};
+
+
+} // namespace Er {}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <erebus/system/property.hxx>
+
+
+namespace Er
+{
+
+//
+// process-wide interning of string property values
+// equal interned strings share a single SharedData, so comparing them compares pointers
+// and long-lived caches keep one copy of each value
+//
+// the pool holds a reference to every string it has; those nobody else references any more
+// are freed as the pool grows, or by purge()
+// strings short enough to be stored inline are never interned; they come back inline, as any Property constructor makes them
+//
+
+class ER_SYSTEM_EXPORT StringPool final
+{
+public:
+    [[nodiscard]] static Property intern(std::string_view v, const PropertyInfo& info);
+
+    // the interned copy of a string property; short strings and properties of other types are returned as they are
+    [[nodiscard]] static Property intern(const Property& prop);
+
+    [[nodiscard]] static std::size_t size() noexcept;
+
+    // returns the number of strings freed
+    static std::size_t purge() noexcept;
+
+private:
+    using Node = Property::SharedData;
+
+    static constexpr std::size_t ShardCount = 16;
+
+    struct Shard;
+    static Shard* shards() noexcept;
+    static Shard& shard(std::string_view v) noexcept;
+};
+
+
+} // namespace Er {}
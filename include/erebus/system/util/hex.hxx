@@ -0,0 +1,12 @@
+#pragma once
+
+#include <erebus/system/format.hxx>
+
+
+namespace Er::Util
+{
+
+// appends bytes as uppercase hex pairs separated by spaces, like "0A FF 10"
+ER_SYSTEM_EXPORT void hexEncodeTo(FormatBuffer& out, const void* data, std::size_t size);
+
+} // namespace Er::Util {}
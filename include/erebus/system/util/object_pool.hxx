@@ -0,0 +1,179 @@
+#pragma once
+
+#include <erebus/system/erebus.hxx>
+
+#include <boost/noncopyable.hpp>
+
+#include <mutex>
+#include <vector>
+
+namespace Er
+{
+
+//
+// recycles objects through per-thread free lists backed by a shared depot
+// objects acquired on one thread and released on another travel between threads through the depot
+// released objects are kept as they are; resetting their state is up to the owner
+// the depot is never destroyed, and objects released after their thread's cache is gone are simply deleted,
+// so pooled objects may outlive statics and thread-locals
+//
+
+template <class T, std::size_t ThreadCacheSize = 64, std::size_t DepotSize = 16 * ThreadCacheSize>
+class ObjectPool final
+    : public boost::noncopyable
+{
+    static_assert(ThreadCacheSize >= 2);
+
+public:
+    using Object = T;
+
+    [[nodiscard]] static T* acquire()
+    {
+        if (t_tornDown) [[unlikely]]
+            return new T;
+
+        auto& cache = threadCache();
+        if (cache.objects.empty())
+            depot().take(cache.objects, ThreadCacheSize / 2);
+
+        if (!cache.objects.empty())
+        {
+            auto p = cache.objects.back();
+            cache.objects.pop_back();
+            return p;
+        }
+
+        return new T;
+    }
+
+    static void release(T* p) noexcept
+    {
+        if (!p)
+            return;
+
+        if (t_tornDown) [[unlikely]]
+        {
+            delete p;
+            return;
+        }
+
+        auto& cache = threadCache();
+        if (cache.objects.size() >= ThreadCacheSize)
+            depot().put(cache.objects, ThreadCacheSize / 2);
+
+        cache.objects.push_back(p);
+    }
+
+private:
+    struct Depot
+        : public boost::noncopyable
+    {
+        Depot()
+        {
+            objects.reserve(DepotSize);
+        }
+
+        void take(std::vector<T*>& to, std::size_t count) noexcept
+        {
+            std::lock_guard l(lock);
+
+            while (count-- && !objects.empty())
+            {
+                to.push_back(objects.back());
+                objects.pop_back();
+            }
+        }
+
+        void put(std::vector<T*>& from, std::size_t count) noexcept
+        {
+            std::lock_guard l(lock);
+
+            while (count-- && !from.empty())
+            {
+                auto p = from.back();
+                from.pop_back();
+
+                if (objects.size() < DepotSize)
+                    objects.push_back(p);
+                else
+                    delete p;
+            }
+        }
+
+        std::mutex lock;
+        std::vector<T*> objects;
+    };
+
+    struct ThreadCache
+        : public boost::noncopyable
+    {
+        ~ThreadCache()
+        {
+            t_tornDown = true;
+            depot().put(objects, objects.size());
+        }
+
+        ThreadCache()
+        {
+            objects.reserve(ThreadCacheSize);
+        }
+
+        std::vector<T*> objects;
+    };
+
+    [[nodiscard]] static Depot& depot() noexcept
+    {
+        // leaked on purpose: objects may come back during static destruction
+        static Depot* d = new Depot;
+        return *d;
+    }
+
+    [[nodiscard]] static ThreadCache& threadCache() noexcept
+    {
+        static thread_local ThreadCache tc;
+        return tc;
+    }
+
+    // trivially destructible, so it can be read after the cache is gone
+    static inline thread_local bool t_tornDown = false;
+};
+
+
+//
+// recycles the memory of T (but not T itself) through an ObjectPool
+// derive T from PooledAllocation<T>; objects of further derived classes fall back to the global heap
+//
+
+template <std::size_t Size, std::size_t Align>
+struct alignas(Align) PoolBlock
+{
+    std::byte storage[Size];
+};
+
+template <class T>
+struct PooledAllocation
+{
+    static void* operator new(std::size_t size)
+    {
+        using Pool = ObjectPool<PoolBlock<sizeof(T), alignof(T)>>;
+
+        if (size != sizeof(T))
+            return ::operator new(size);
+
+        return Pool::acquire();
+    }
+
+    static void operator delete(void* p, std::size_t size) noexcept
+    {
+        using Block = PoolBlock<sizeof(T), alignof(T)>;
+        using Pool = ObjectPool<Block>;
+
+        if (size != sizeof(T))
+            return ::operator delete(p);
+
+        Pool::release(static_cast<Block*>(p));
+    }
+};
+
+
+} // namespace Er {}
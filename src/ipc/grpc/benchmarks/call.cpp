@@ -0,0 +1,166 @@
+#include "common.hpp"
+
+namespace
+{
+
+
+class BenchService
+    : public Er::Ipc::IService
+    , public std::enable_shared_from_this<BenchService>
+{
+public:
+    void registerService(Er::Ipc::IServer* container) override
+    {
+        container->registerService("sink", shared_from_this());
+        container->registerService("echo", shared_from_this());
+    }
+
+    void unregisterService(Er::Ipc::IServer* container) override
+    {
+        container->unregisterService(this);
+    }
+
+    Er::PropertyBag request(std::string_view request, std::uint32_t clientId, const Er::PropertyBag& args) override
+    {
+        if (request == "echo")
+            return args;
+
+        return {};
+    }
+
+    StreamId beginStream(std::string_view request, std::uint32_t clientId, const Er::PropertyBag& args) override
+    {
+        ErThrow(Er::format("Unsupported request {}", request));
+    }
+
+    void endStream(StreamId id) override
+    {
+    }
+
+    Er::PropertyBag next(StreamId id) override
+    {
+        return {};
+    }
+};
+
+
+struct CallCompletion
+    : public CompletionBase<Er::Ipc::IClient::ICallCompletion>
+{
+    void onReply(Er::PropertyBag&& reply) override
+    {
+    }
+
+    void onException(Er::Exception&& exception) override
+    {
+        m_failed = true;
+    }
+};
+
+
+class CallBenchmark
+    : public BenchmarkBase
+{
+public:
+    void SetUp(const benchmark::State& state) override
+    {
+        BenchmarkBase::SetUp(state);
+
+        auto service = std::make_shared<BenchService>();
+        service->registerService(m_server.get());
+
+        m_args = makeArgs(static_cast<std::size_t>(state.range(0)));
+    }
+
+protected:
+    static Er::PropertyBag makeArgs(std::size_t count)
+    {
+        Er::PropertyBag args;
+        args.reserve(count);
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            if (i % 2)
+                args.push_back(Er::Property(Er::format("argument #{}", i), Er::Unspecified::String));
+            else
+                args.push_back(Er::Property(std::uint64_t(i), Er::Unspecified::UInt64));
+        }
+
+        return args;
+    }
+
+    Er::PropertyBag m_args;
+};
+
+} // namespace {}
+
+
+BENCHMARK_DEFINE_F(CallBenchmark, Call)(benchmark::State& state)
+{
+    auto completion = std::make_shared<CallCompletion>();
+    AllocationCounters counters;
+
+    for (auto _ : state)
+    {
+        completion->reset();
+        m_client->call("sink", m_args, completion, g_callTimeout);
+
+        if (!completion->wait(g_callTimeout) || completion->failed())
+        {
+            state.SkipWithError("Call failed");
+            break;
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    counters.report(state);
+}
+
+BENCHMARK_DEFINE_F(CallBenchmark, PreparedCall)(benchmark::State& state)
+{
+    auto completion = std::make_shared<CallCompletion>();
+    auto prepared = m_client->prepareCall("sink", m_args);
+    AllocationCounters counters;
+
+    for (auto _ : state)
+    {
+        completion->reset();
+        m_client->call(prepared, completion, g_callTimeout);
+
+        if (!completion->wait(g_callTimeout) || completion->failed())
+        {
+            state.SkipWithError("Call failed");
+            break;
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    counters.report(state);
+}
+
+BENCHMARK_DEFINE_F(CallBenchmark, EchoCall)(benchmark::State& state)
+{
+    auto completion = std::make_shared<CallCompletion>();
+    auto prepared = m_client->prepareCall("echo", m_args);
+    AllocationCounters counters;
+
+    for (auto _ : state)
+    {
+        completion->reset();
+        m_client->call(prepared, completion, g_callTimeout);
+
+        if (!completion->wait(g_callTimeout) || completion->failed())
+        {
+            state.SkipWithError("Call failed");
+            break;
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    counters.report(state);
+}
+
+// CPU time is measured on the calling thread, i.e. it is the client-side cost of issuing a call
+BENCHMARK_REGISTER_F(CallBenchmark, Call)->Arg(1)->Arg(16)->Arg(256);
+BENCHMARK_REGISTER_F(CallBenchmark, PreparedCall)->Arg(1)->Arg(16)->Arg(256);
+BENCHMARK_REGISTER_F(CallBenchmark, EchoCall)->Arg(1)->Arg(16)->Arg(256);
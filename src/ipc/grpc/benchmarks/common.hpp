@@ -0,0 +1,158 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+
+#include <erebus/system/exception.hxx>
+#include <erebus/system/logger2.hxx>
+#include <erebus/system/result.hxx>
+#include <erebus/system/waitable.hxx>
+#include <erebus/ipc/grpc/grpc_client.hxx>
+#include <erebus/ipc/grpc/grpc_server.hxx>
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+extern std::string g_serverEndpoint;
+
+extern std::chrono::milliseconds g_callTimeout;
+extern std::chrono::milliseconds g_streamTimeout;
+
+
+// heap traffic of the whole process (client and server run in the same one)
+// counted by the global operator new/delete replacements in main.cpp
+struct AllocationCounters
+{
+    static std::atomic<std::uint64_t> allocations;
+    static std::atomic<std::uint64_t> frees;
+
+    AllocationCounters() noexcept
+        : m_allocations(allocations.load(std::memory_order_relaxed))
+        , m_frees(frees.load(std::memory_order_relaxed))
+    {
+    }
+
+    void report(benchmark::State& state) const
+    {
+        auto a = allocations.load(std::memory_order_relaxed) - m_allocations;
+        auto f = frees.load(std::memory_order_relaxed) - m_frees;
+
+        state.counters["allocs"] = benchmark::Counter(double(a), benchmark::Counter::kAvgIterations);
+        state.counters["frees"] = benchmark::Counter(double(f), benchmark::Counter::kAvgIterations);
+    }
+
+private:
+    std::uint64_t m_allocations;
+    std::uint64_t m_frees;
+};
+
+
+template <class Interface>
+struct CompletionBase
+    : public Interface
+{
+    CompletionBase() = default;
+
+    bool wait(std::chrono::milliseconds timeout)
+    {
+        return m_complete.waitValueFor(true, timeout);
+    }
+
+    void reset()
+    {
+        m_complete.setAndNotifyAll(false);
+        m_failed = false;
+    }
+
+    bool failed() const noexcept
+    {
+        return m_failed;
+    }
+
+    void onServerPropertyMappingExpired() override
+    {
+        m_failed = true;
+    }
+
+    void onClientPropertyMappingExpired() override
+    {
+        m_failed = true;
+    }
+
+    void onTransportError(Er::ResultCode result, std::string&& message) override
+    {
+        m_failed = true;
+    }
+
+    void done() override
+    {
+        m_complete.setAndNotifyAll(true);
+    }
+
+protected:
+    Er::Waitable<bool> m_complete;
+    bool m_failed = false;
+};
+
+using SimpleCompletion = CompletionBase<Er::Ipc::IClient::ICompletion>;
+
+
+class BenchmarkBase
+    : public benchmark::Fixture
+{
+public:
+    void SetUp(const benchmark::State& state) override
+    {
+        m_serverLog = makeLogger("server");
+        m_clientLog = makeLogger("client");
+
+        Er::Ipc::Grpc::ServerArgs args(m_serverLog);
+        args.endpoints.push_back(Er::Ipc::Grpc::ServerArgs::Endpoint(g_serverEndpoint));
+
+        m_server = Er::Ipc::Grpc::create(args);
+
+        auto channel = Er::Ipc::Grpc::createChannel(Er::Ipc::Grpc::ChannelSettings(g_serverEndpoint));
+        m_client = Er::Ipc::Grpc::createClient(channel, m_clientLog);
+
+        exchangePropertyMapping();
+    }
+
+    void TearDown(const benchmark::State& state) override
+    {
+        m_client.reset();
+        m_server.reset();
+        m_clientLog.reset();
+        m_serverLog.reset();
+    }
+
+protected:
+    static Er::Log2::ILogger::Ptr makeLogger(std::string_view component)
+    {
+        auto underlying = Er::Log2::global();
+        ErAssert(underlying);
+        auto log = Er::Log2::makeSyncLogger(component);
+        log->addSink("global", std::static_pointer_cast<Er::Log2::ISink>(underlying));
+        log->setLevel(Er::Log2::Level::Fatal);
+        return log;
+    }
+
+    void exchangePropertyMapping()
+    {
+        {
+            auto completion = std::make_shared<SimpleCompletion>();
+            m_client->putPropertyMapping(completion);
+            completion->wait(g_streamTimeout);
+        }
+
+        {
+            auto completion = std::make_shared<SimpleCompletion>();
+            m_client->getPropertyMapping(completion);
+            completion->wait(g_streamTimeout);
+        }
+    }
+
+    Er::Log2::ILogger::Ptr m_serverLog;
+    Er::Log2::ILogger::Ptr m_clientLog;
+    Er::Ipc::IServer::Ptr m_server;
+    Er::Ipc::IClient::Ptr m_client;
+};
@@ -0,0 +1,112 @@
+#include "common.hpp"
+
+#include <erebus/system/program.hxx>
+#include <erebus/system/logger/ostream_sink2.hxx>
+#include <erebus/system/logger/simple_formatter2.hxx>
+
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#if ER_LINUX
+static constexpr std::string_view DefaultEnpoint = "unix:///tmp/erebus_grpc_benchmark";
+#else
+static constexpr std::string_view DefaultEnpoint = "127.0.0.1:999";
+#endif
+
+std::string g_serverEndpoint;
+
+std::atomic<std::uint64_t> AllocationCounters::allocations = 0;
+std::atomic<std::uint64_t> AllocationCounters::frees = 0;
+
+std::chrono::milliseconds g_callTimeout{ 5 * 1000 };
+std::chrono::milliseconds g_streamTimeout{ 30 * 1000 };
+
+
+void* operator new(std::size_t size)
+{
+    AllocationCounters::allocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (auto p = std::malloc(size ? size : 1))
+        return p;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    if (p)
+        AllocationCounters::frees.fetch_add(1, std::memory_order_relaxed);
+
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    ::operator delete(p);
+}
+
+
+class App final
+    : public Er::Program
+{
+public:
+    App()
+        : Er::Program(Er::Program::Options::SyncLogger)
+    {
+    }
+
+private:
+    void addCmdLineOptions(boost::program_options::options_description& options) override
+    {
+        Er::Program::addCmdLineOptions(options);
+
+        options.add_options()
+            ("endpoint", boost::program_options::value<std::string>(&g_serverEndpoint)->default_value(std::string(DefaultEnpoint)), "Temporary endpoint address")
+            ;
+    }
+
+    void addLoggers(Er::Log2::ITee* main) override
+    {
+        auto sink = Er::Log2::makeOStreamSink(
+            std::cerr,
+            Er::Log2::SimpleFormatter::make(Er::Log2::SimpleFormatter::Options{ Er::Log2::SimpleFormatter::Option::Lf }),
+            [](const Er::Log2::Record* r)
+            {
+                return r->level() >= Er::Log2::Level::Warning;
+            }
+        );
+
+        main->addSink("std::cerr", sink);
+    }
+
+    int run(int argc, char** argv) override
+    {
+        benchmark::Initialize(&argc, argv);
+        benchmark::RunSpecifiedBenchmarks();
+        benchmark::Shutdown();
+
+        return 0;
+    }
+};
+
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        App app;
+
+        return app.exec(argc, argv);
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+    }
+    catch (...)
+    {
+        std::cerr << "Unexpected exception" << std::endl;
+    }
+
+    return -1;
+}
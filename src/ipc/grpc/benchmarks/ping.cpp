@@ -0,0 +1,44 @@
+#include "common.hpp"
+
+namespace
+{
+
+struct PingCompletion
+    : public CompletionBase<Er::Ipc::IClient::IPingCompletion>
+{
+    void onReply(std::size_t payloadSize, std::chrono::milliseconds rtt) override
+    {
+    }
+};
+
+class PingBenchmark
+    : public BenchmarkBase
+{
+};
+
+} // namespace {}
+
+
+BENCHMARK_DEFINE_F(PingBenchmark, Ping)(benchmark::State& state)
+{
+    auto payloadSize = static_cast<std::size_t>(state.range(0));
+    auto completion = std::make_shared<PingCompletion>();
+    AllocationCounters counters;
+
+    for (auto _ : state)
+    {
+        completion->reset();
+        m_client->ping(payloadSize, completion, g_callTimeout);
+
+        if (!completion->wait(g_callTimeout) || completion->failed())
+        {
+            state.SkipWithError("Ping failed");
+            break;
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    counters.report(state);
+}
+
+BENCHMARK_REGISTER_F(PingBenchmark, Ping)->Arg(0)->Arg(1024);
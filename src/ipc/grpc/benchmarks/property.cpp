@@ -0,0 +1,820 @@
+#include "common.hpp"
+
+#include "../protocol.hxx"
+
+#include <erebus/erebus.grpc.pb.h>
+
+#include <erebus/system/property_bag.hxx>
+#include <erebus/system/property_batch.hxx>
+#include <erebus/system/property_schema.hxx>
+#include <erebus/system/property_snapshot.hxx>
+#include <erebus/system/snapshot_diff.hxx>
+
+#include <filesystem>
+#include <fstream>
+
+
+namespace
+{
+
+const Er::TypedPropertyInfo<std::uint64_t> Pid{ "Er.Bench.Schema.pid", "PID" };
+const Er::TypedPropertyInfo<std::uint64_t> PPid{ "Er.Bench.Schema.ppid", "Parent PID" };
+const Er::TypedPropertyInfo<std::string> Comm{ "Er.Bench.Schema.comm", "Command" };
+const Er::TypedPropertyInfo<std::string> Exe{ "Er.Bench.Schema.exe", "Executable" };
+const Er::TypedPropertyInfo<double> Cpu{ "Er.Bench.Schema.cpu", "CPU usage" };
+const Er::TypedPropertyInfo<std::uint64_t> Rss{ "Er.Bench.Schema.rss", "Resident set" };
+
+struct Process
+{
+    std::uint64_t pid = 0;
+    std::uint64_t ppid = 0;
+    std::string comm;
+    std::string exe;
+    double cpu = 0.0;
+    std::uint64_t rss = 0;
+};
+
+constexpr auto ProcessSchema = Er::schema<Process>(
+    Er::field<&Process::pid>(Pid),
+    Er::field<&Process::ppid>(PPid),
+    Er::field<&Process::comm>(Comm),
+    Er::field<&Process::exe>(Exe),
+    Er::field<&Process::cpu>(Cpu),
+    Er::field<&Process::rss>(Rss)
+);
+
+Process makeProcess()
+{
+    return Process{ 4242, 1, "systemd-journald", "/usr/lib/systemd/systemd-journald", 0.25, 1 << 20 };
+}
+
+struct IdentityMapping
+    : public Er::IPropertyMapping
+{
+    const Er::PropertyInfo* mapProperty(std::uint32_t id, std::uint32_t context) override
+    {
+        if (id == Er::Unspecified::UInt64.unique())
+            return &Er::Unspecified::UInt64;
+        if (id == Er::Unspecified::String.unique())
+            return &Er::Unspecified::String;
+        if (id == Er::Unspecified::DoubleArray.unique())
+            return &Er::Unspecified::DoubleArray;
+        if (id == Er::Unspecified::Binary.unique())
+            return &Er::Unspecified::Binary;
+
+        for (const Er::PropertyInfo* pi : { static_cast<const Er::PropertyInfo*>(&Pid), static_cast<const Er::PropertyInfo*>(&PPid), 
+            static_cast<const Er::PropertyInfo*>(&Comm), static_cast<const Er::PropertyInfo*>(&Exe), 
+            static_cast<const Er::PropertyInfo*>(&Cpu), static_cast<const Er::PropertyInfo*>(&Rss) })
+        {
+            if (pi->unique() == id)
+                return pi;
+        }
+
+        return nullptr;
+    }
+};
+
+constexpr std::size_t BagSize = 16;
+
+Er::PropertyBag makeBag(std::size_t stringLength)
+{
+    Er::PropertyBag bag;
+    bag.reserve(BagSize);
+    for (std::size_t i = 0; i < BagSize / 2; ++i)
+    {
+        auto s = std::to_string(i);
+        s.resize(stringLength, 'x');
+
+        bag.push_back(Er::Property(std::uint64_t(i), Er::Unspecified::UInt64));
+        bag.push_back(Er::Property(std::move(s), Er::Unspecified::String));
+    }
+
+    return bag;
+}
+
+
+void Property_Marshal(benchmark::State& state)
+{
+    auto bag = makeBag(static_cast<std::size_t>(state.range(0)));
+    erebus::ServiceReply reply;
+
+    AllocationCounters counters;
+
+    for (auto _ : state)
+    {
+        // reused the way server replies are
+        reply.Clear();
+
+        auto props = reply.mutable_props();
+        props->Reserve(static_cast<int>(bag.size()));
+        for (auto& prop : bag)
+            Erp::Protocol::assignProperty(*props->Add(), prop);
+
+        benchmark::DoNotOptimize(reply.props_size());
+    }
+
+    counters.report(state);
+}
+
+void Property_Unmarshal(benchmark::State& state)
+{
+    auto bag = makeBag(static_cast<std::size_t>(state.range(0)));
+    erebus::ServiceReply reply;
+    for (auto& prop : bag)
+        Erp::Protocol::assignProperty(*reply.add_props(), prop);
+
+    IdentityMapping mapping;
+
+    AllocationCounters counters;
+
+    for (auto _ : state)
+    {
+        Er::PropertyBag out;
+        out.reserve(reply.props_size());
+        for (auto& prop : reply.props())
+            out.push_back(Erp::Protocol::getProperty(prop, &mapping, 0));
+
+        benchmark::DoNotOptimize(out.data());
+    }
+
+    counters.report(state);
+}
+
+// the same with a per-call arena, the way the server unmarshals arguments
+void Property_UnmarshalArena(benchmark::State& state)
+{
+    auto bag = makeBag(static_cast<std::size_t>(state.range(0)));
+    erebus::ServiceReply reply;
+    for (auto& prop : bag)
+        Erp::Protocol::assignProperty(*reply.add_props(), prop);
+
+    IdentityMapping mapping;
+    std::array<std::byte, 16 * 1024> buffer;
+    std::pmr::monotonic_buffer_resource arena(buffer.data(), buffer.size());
+
+    Er::PropertyBag out;
+
+    AllocationCounters counters;
+
+    for (auto _ : state)
+    {
+        out.reserve(reply.props_size());
+        for (auto& prop : reply.props())
+            out.push_back(Erp::Protocol::getProperty(prop, &mapping, 0, &arena));
+
+        benchmark::DoNotOptimize(out.data());
+
+        out.clear();
+        arena.release();
+    }
+
+    counters.report(state);
+}
+
+// what marshaling a packed array is up against
+void Array_Memcpy(benchmark::State& state)
+{
+    Er::DoubleArray src(static_cast<std::size_t>(state.range(0)), 0.5);
+    Er::DoubleArray dst(src.size());
+
+    for (auto _ : state)
+    {
+        std::memcpy(dst.data(), src.data(), src.size() * sizeof(double));
+        benchmark::DoNotOptimize(dst.data());
+        benchmark::ClobberMemory();
+    }
+
+    state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(src.size() * sizeof(double)));
+}
+
+void Array_Marshal(benchmark::State& state)
+{
+    Er::Property prop(Er::DoubleArray(static_cast<std::size_t>(state.range(0)), 0.5), Er::Unspecified::DoubleArray);
+    erebus::Property out;
+
+    for (auto _ : state)
+    {
+        out.Clear();
+        Erp::Protocol::assignProperty(out, prop);
+        benchmark::DoNotOptimize(out.v_double_array().v().data());
+    }
+
+    state.SetBytesProcessed(state.iterations() * state.range(0) * static_cast<std::int64_t>(sizeof(double)));
+}
+
+void Array_Unmarshal(benchmark::State& state)
+{
+    Er::Property prop(Er::DoubleArray(static_cast<std::size_t>(state.range(0)), 0.5), Er::Unspecified::DoubleArray);
+    erebus::Property in;
+    Erp::Protocol::assignProperty(in, prop);
+
+    IdentityMapping mapping;
+
+    for (auto _ : state)
+    {
+        auto out = Erp::Protocol::getProperty(in, &mapping, 0);
+        benchmark::DoNotOptimize(out.getDoubleArray().data());
+    }
+
+    state.SetBytesProcessed(state.iterations() * state.range(0) * static_cast<std::int64_t>(sizeof(double)));
+}
+
+void Binary_UnmarshalCopy(benchmark::State& state)
+{
+    erebus::Property in;
+    in.set_id(Er::Unspecified::Binary.unique());
+    in.set_v_binary(std::string(static_cast<std::size_t>(state.range(0)), 'x'));
+
+    IdentityMapping mapping;
+
+    for (auto _ : state)
+    {
+        auto out = Erp::Protocol::getProperty(in, &mapping, 0);
+        benchmark::DoNotOptimize(out.getBinary().data());
+    }
+
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+// what a client does with a reply it has received
+void Binary_UnmarshalMove(benchmark::State& state)
+{
+    erebus::Property in;
+    IdentityMapping mapping;
+    std::string payload(static_cast<std::size_t>(state.range(0)), 'x');
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        in.set_id(Er::Unspecified::Binary.unique());
+        in.set_v_binary(payload);
+        state.ResumeTiming();
+
+        auto out = Erp::Protocol::getProperty(std::move(in), &mapping, 0);
+        benchmark::DoNotOptimize(out.getBinary().data());
+    }
+
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+// a reply marshaled and serialized by the protobuf codec, the way it is done for every message but the service replies
+void Binary_SendCopy(benchmark::State& state)
+{
+    Er::PropertyBag props;
+    props.push_back(Er::Property(Er::Binary(std::string(static_cast<std::size_t>(state.range(0)), 'x')), Er::Unspecified::Binary));
+
+    erebus::ServiceReply reply;
+
+    for (auto _ : state)
+    {
+        reply.Clear();
+        for (auto& prop : props)
+            Erp::Protocol::assignProperty(*reply.add_props(), prop);
+
+        grpc::ByteBuffer out;
+        bool ownBuffer = false;
+        benchmark::DoNotOptimize(grpc::SerializationTraits<erebus::ServiceReply>::Serialize(reply, &out, &ownBuffer));
+    }
+
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+// what the server does with a reply
+void Binary_SendAttached(benchmark::State& state)
+{
+    Er::PropertyBag props;
+    props.push_back(Er::Property(Er::Binary(std::string(static_cast<std::size_t>(state.range(0)), 'x')), Er::Unspecified::Binary));
+
+    erebus::ServiceReply reply;
+    Erp::Protocol::ReplyWriter writer;
+
+    for (auto _ : state)
+    {
+        reply.Clear();
+        writer.clear();
+        writer.assignProps(reply, props);
+
+        grpc::ByteBuffer out;
+        benchmark::DoNotOptimize(writer.serialize(reply, out));
+    }
+
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+// the struct goes through a PropertyBag
+void Schema_MarshalViaBag(benchmark::State& state)
+{
+    auto p = makeProcess();
+    erebus::ServiceReply reply;
+
+    AllocationCounters counters;
+
+    for (auto _ : state)
+    {
+        reply.Clear();
+
+        auto bag = ProcessSchema.toBag(p);
+        auto props = reply.mutable_props();
+        props->Reserve(static_cast<int>(bag.size()));
+        for (auto& prop : bag)
+            Erp::Protocol::assignProperty(*props->Add(), prop);
+
+        benchmark::DoNotOptimize(reply.props_size());
+    }
+
+    counters.report(state);
+}
+
+// the struct goes straight into the message
+void Schema_MarshalDirect(benchmark::State& state)
+{
+    auto p = makeProcess();
+    erebus::ServiceReply reply;
+
+    AllocationCounters counters;
+
+    for (auto _ : state)
+    {
+        reply.Clear();
+        Erp::Protocol::assignStruct(*reply.mutable_props(), ProcessSchema, p);
+
+        benchmark::DoNotOptimize(reply.props_size());
+    }
+
+    counters.report(state);
+}
+
+void Schema_UnmarshalViaBag(benchmark::State& state)
+{
+    erebus::ServiceReply reply;
+    Erp::Protocol::assignStruct(*reply.mutable_props(), ProcessSchema, makeProcess());
+
+    IdentityMapping mapping;
+
+    AllocationCounters counters;
+
+    for (auto _ : state)
+    {
+        Er::PropertyBag bag;
+        bag.reserve(reply.props_size());
+        for (auto& prop : reply.props())
+            bag.push_back(Erp::Protocol::getProperty(prop, &mapping, 0));
+
+        auto p = ProcessSchema.fromBag(bag);
+        benchmark::DoNotOptimize(p.pid);
+    }
+
+    counters.report(state);
+}
+
+void Schema_UnmarshalDirect(benchmark::State& state)
+{
+    erebus::ServiceReply reply;
+    Erp::Protocol::assignStruct(*reply.mutable_props(), ProcessSchema, makeProcess());
+
+    IdentityMapping mapping;
+
+    AllocationCounters counters;
+
+    for (auto _ : state)
+    {
+        auto p = Erp::Protocol::getStruct(reply.props(), &mapping, 0, ProcessSchema);
+        benchmark::DoNotOptimize(p.pid);
+    }
+
+    counters.report(state);
+}
+
+constexpr std::size_t FramesPerBatch = 64;
+
+// what a stream of FramesPerBatch frames costs to marshal and serialize one reply per frame
+void Stream_Frames(benchmark::State& state)
+{
+    auto bag = makeBag(static_cast<std::size_t>(state.range(0)));
+    erebus::ServiceReply reply;
+    std::string wire;
+    std::size_t bytes = 0;
+
+    AllocationCounters counters;
+
+    for (auto _ : state)
+    {
+        bytes = 0;
+        for (std::size_t i = 0; i < FramesPerBatch; ++i)
+        {
+            reply.Clear();
+
+            auto props = reply.mutable_props();
+            props->Reserve(static_cast<int>(bag.size()));
+            for (auto& prop : bag)
+                Erp::Protocol::assignProperty(*props->Add(), prop);
+
+            reply.SerializeToString(&wire);
+            bytes += wire.size();
+        }
+
+        benchmark::DoNotOptimize(bytes);
+    }
+
+    counters.report(state);
+    state.counters["wire_bytes_per_frame"] = static_cast<double>(bytes) / FramesPerBatch;
+    state.SetItemsProcessed(state.iterations() * FramesPerBatch);
+}
+
+// the same frames sent as one columnar batch
+void Stream_Batch(benchmark::State& state)
+{
+    auto bag = makeBag(static_cast<std::size_t>(state.range(0)));
+    erebus::ServiceReply reply;
+    Er::PropertyBatch batch;
+    std::string wire;
+
+    AllocationCounters counters;
+
+    for (auto _ : state)
+    {
+        batch.clear();
+        for (std::size_t i = 0; i < FramesPerBatch; ++i)
+            batch.append(bag);
+
+        reply.Clear();
+        Erp::Protocol::assignBatch(*reply.mutable_batch(), batch);
+
+        reply.SerializeToString(&wire);
+        benchmark::DoNotOptimize(wire.data());
+    }
+
+    counters.report(state);
+    state.counters["wire_bytes_per_frame"] = static_cast<double>(wire.size()) / FramesPerBatch;
+    state.SetItemsProcessed(state.iterations() * FramesPerBatch);
+}
+
+void Stream_BatchUnmarshal(benchmark::State& state)
+{
+    auto bag = makeBag(static_cast<std::size_t>(state.range(0)));
+    Er::PropertyBatch batch;
+    for (std::size_t i = 0; i < FramesPerBatch; ++i)
+        batch.append(bag);
+
+    erebus::ServiceReply reply;
+    Erp::Protocol::assignBatch(*reply.mutable_batch(), batch);
+
+    IdentityMapping mapping;
+
+    AllocationCounters counters;
+
+    for (auto _ : state)
+    {
+        auto out = Erp::Protocol::getBatch(reply.batch(), &mapping, 0);
+        benchmark::DoNotOptimize(out.rows());
+    }
+
+    counters.report(state);
+    state.SetItemsProcessed(state.iterations() * FramesPerBatch);
+}
+
+
+constexpr std::size_t SnapshotRecords = 1024;
+
+std::string tempPath(const char* name)
+{
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+// loading a file of SnapshotRecords bags and reading every property
+void Snapshot_Load(benchmark::State& state)
+{
+    auto bag = makeBag(static_cast<std::size_t>(state.range(0)));
+    auto path = tempPath("erebus-bench-snapshot");
+    {
+        Er::PropertySnapshotWriter writer(path);
+        for (std::size_t i = 0; i < SnapshotRecords; ++i)
+            writer.write(bag);
+    }
+
+    AllocationCounters counters;
+
+    for (auto _ : state)
+    {
+        Er::PropertySnapshotReader reader(path);
+
+        std::uint64_t sum = 0;
+        for (std::size_t i = 0; i < reader.size(); ++i)
+        {
+            for (auto field : reader[i])
+            {
+                if (field.type() == Er::PropertyType::UInt64)
+                    sum += field.get<std::uint64_t>();
+                else
+                    sum += field.raw().size();
+            }
+        }
+
+        benchmark::DoNotOptimize(sum);
+    }
+
+    counters.report(state);
+    state.SetItemsProcessed(state.iterations() * SnapshotRecords);
+    std::filesystem::remove(path);
+}
+
+// the same, with every record materialized into a PropertyBag
+void Snapshot_LoadBags(benchmark::State& state)
+{
+    auto bag = makeBag(static_cast<std::size_t>(state.range(0)));
+    auto path = tempPath("erebus-bench-snapshot-bags");
+    {
+        Er::PropertySnapshotWriter writer(path);
+        for (std::size_t i = 0; i < SnapshotRecords; ++i)
+            writer.write(bag);
+    }
+
+    AllocationCounters counters;
+
+    for (auto _ : state)
+    {
+        Er::PropertySnapshotReader reader(path);
+
+        std::vector<Er::PropertyBag> out;
+        out.reserve(reader.size());
+        for (std::size_t i = 0; i < reader.size(); ++i)
+            out.push_back(reader[i].bag());
+
+        benchmark::DoNotOptimize(out.data());
+    }
+
+    counters.report(state);
+    state.SetItemsProcessed(state.iterations() * SnapshotRecords);
+    std::filesystem::remove(path);
+}
+
+// the protobuf baseline: a file of size-prefixed replies, read, parsed and unmarshaled
+void Snapshot_LoadProtobuf(benchmark::State& state)
+{
+    auto bag = makeBag(static_cast<std::size_t>(state.range(0)));
+    auto path = tempPath("erebus-bench-snapshot-pb");
+    {
+        erebus::ServiceReply reply;
+        for (auto& prop : bag)
+            Erp::Protocol::assignProperty(*reply.add_props(), prop);
+
+        auto wire = reply.SerializeAsString();
+        auto size = static_cast<std::uint32_t>(wire.size());
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        for (std::size_t i = 0; i < SnapshotRecords; ++i)
+        {
+            out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+            out.write(wire.data(), wire.size());
+        }
+    }
+
+    IdentityMapping mapping;
+
+    AllocationCounters counters;
+
+    for (auto _ : state)
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+        std::vector<Er::PropertyBag> out;
+        out.reserve(SnapshotRecords);
+
+        erebus::ServiceReply reply;
+        std::size_t pos = 0;
+        while (pos + sizeof(std::uint32_t) <= data.size())
+        {
+            std::uint32_t size;
+            std::memcpy(&size, data.data() + pos, sizeof(size));
+            pos += sizeof(size);
+
+            reply.ParseFromArray(data.data() + pos, static_cast<int>(size));
+            pos += size;
+
+            Er::PropertyBag frame;
+            frame.reserve(reply.props_size());
+            for (auto& prop : *reply.mutable_props())
+                frame.push_back(Erp::Protocol::getProperty(std::move(prop), &mapping, 0));
+
+            out.push_back(std::move(frame));
+        }
+
+        benchmark::DoNotOptimize(out.data());
+    }
+
+    counters.report(state);
+    state.SetItemsProcessed(state.iterations() * SnapshotRecords);
+    std::filesystem::remove(path);
+}
+
+
+constexpr std::size_t DiffRecords = 1024;
+
+std::vector<Er::PropertyBag> makeProcesses()
+{
+    std::vector<Er::PropertyBag> processes;
+    processes.reserve(DiffRecords);
+    for (std::size_t i = 0; i < DiffRecords; ++i)
+    {
+        auto process = makeProcess();
+        Er::PropertyBag bag;
+        bag.push_back(Er::Property(std::uint64_t(i + 1), Pid));
+        bag.push_back(Er::Property(process.ppid, PPid));
+        bag.push_back(Er::Property(process.comm, Comm));
+        bag.push_back(Er::Property(process.exe, Exe));
+        bag.push_back(Er::Property(process.cpu, Cpu));
+        bag.push_back(Er::Property(process.rss, Rss));
+        processes.push_back(std::move(bag));
+    }
+
+    return processes;
+}
+
+// state.range(0) percent of the processes change their CPU usage between snapshots
+void nextSnapshot(std::vector<Er::PropertyBag>& processes, std::int64_t percent, std::size_t& round)
+{
+    auto changed = DiffRecords * static_cast<std::size_t>(percent) / 100;
+    for (std::size_t i = 0; i < changed; ++i)
+    {
+        auto& bag = processes[(round * changed + i) % DiffRecords];
+        bag[4] = Er::Property(bag[4].getDouble() + 0.01, Cpu);
+    }
+
+    ++round;
+}
+
+std::size_t sendFrame(erebus::ServiceReply& reply, std::string& wire, const Er::PropertyBag& frame)
+{
+    reply.Clear();
+
+    auto props = reply.mutable_props();
+    props->Reserve(static_cast<int>(frame.size()));
+    for (auto& prop : frame)
+        Erp::Protocol::assignProperty(*props->Add(), prop);
+
+    reply.SerializeToString(&wire);
+    return wire.size();
+}
+
+// every snapshot sent in full, one reply per process
+void Diff_Full(benchmark::State& state)
+{
+    auto processes = makeProcesses();
+    erebus::ServiceReply reply;
+    std::string wire;
+    std::size_t round = 0;
+    std::size_t bytes = 0;
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        nextSnapshot(processes, state.range(0), round);
+        state.ResumeTiming();
+
+        bytes = 0;
+        for (auto& bag : processes)
+            bytes += sendFrame(reply, wire, bag);
+
+        benchmark::DoNotOptimize(bytes);
+    }
+
+    state.counters["wire_bytes"] = static_cast<double>(bytes);
+    state.SetItemsProcessed(state.iterations() * DiffRecords);
+}
+
+// only the changes since the previous snapshot
+void Diff_Delta(benchmark::State& state)
+{
+    auto processes = makeProcesses();
+    Er::SnapshotDiff diff(Pid);
+    {
+        auto first = diff.diff(processes);
+        while (!first.next().empty())
+            ;
+    }
+
+    erebus::ServiceReply reply;
+    std::string wire;
+    std::size_t round = 0;
+    std::size_t bytes = 0;
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        nextSnapshot(processes, state.range(0), round);
+        state.ResumeTiming();
+
+        bytes = 0;
+        auto delta = diff.diff(processes);
+        while (true)
+        {
+            auto frame = delta.next();
+            if (frame.empty())
+                break;
+
+            bytes += sendFrame(reply, wire, frame);
+        }
+
+        benchmark::DoNotOptimize(bytes);
+    }
+
+    state.counters["wire_bytes"] = static_cast<double>(bytes);
+    state.SetItemsProcessed(state.iterations() * DiffRecords);
+}
+
+
+// a stream of FramesPerBatch processes, from marshaling on the server to unmarshaling on the client
+template <bool Dictionary>
+void streamStrings(benchmark::State& state)
+{
+    auto processes = makeProcesses();
+    IdentityMapping mapping;
+    erebus::ServiceReply reply;
+    std::string wire;
+    std::size_t bytes = 0;
+
+    AllocationCounters counters;
+
+    for (auto _ : state)
+    {
+        Erp::Protocol::StringEncoder encoder;
+        Erp::Protocol::StringDecoder decoder;
+
+        bytes = 0;
+        for (std::size_t i = 0; i < FramesPerBatch; ++i)
+        {
+            auto& bag = processes[i];
+
+            reply.Clear();
+            auto props = reply.mutable_props();
+            props->Reserve(static_cast<int>(bag.size()));
+            for (auto& prop : bag)
+            {
+                if constexpr (Dictionary)
+                    encoder.assignProperty(*props->Add(), prop);
+                else
+                    Erp::Protocol::assignProperty(*props->Add(), prop);
+            }
+
+            reply.SerializeToString(&wire);
+            bytes += wire.size();
+
+            reply.ParseFromString(wire);
+
+            Er::PropertyBag frame;
+            frame.reserve(reply.props_size());
+            for (auto& prop : *reply.mutable_props())
+            {
+                if constexpr (Dictionary)
+                    frame.push_back(decoder.getProperty(std::move(prop), &mapping, 0));
+                else
+                    frame.push_back(Erp::Protocol::getProperty(std::move(prop), &mapping, 0));
+            }
+
+            benchmark::DoNotOptimize(frame.data());
+        }
+    }
+
+    counters.report(state);
+    state.counters["wire_bytes_per_frame"] = static_cast<double>(bytes) / FramesPerBatch;
+    state.SetItemsProcessed(state.iterations() * FramesPerBatch);
+}
+
+void Stream_Strings(benchmark::State& state)
+{
+    streamStrings<false>(state);
+}
+
+void Stream_StringsDictionary(benchmark::State& state)
+{
+    streamStrings<true>(state);
+}
+
+} // namespace {}
+
+
+BENCHMARK(Property_Marshal)->Arg(Er::Property::InlineCapacity)->Arg(15)->Arg(32);
+BENCHMARK(Property_Unmarshal)->Arg(Er::Property::InlineCapacity)->Arg(15)->Arg(32);
+BENCHMARK(Property_UnmarshalArena)->Arg(Er::Property::InlineCapacity)->Arg(15)->Arg(32);
+BENCHMARK(Stream_Frames)->Arg(8)->Arg(32);
+BENCHMARK(Stream_Batch)->Arg(8)->Arg(32);
+BENCHMARK(Stream_BatchUnmarshal)->Arg(8)->Arg(32);
+BENCHMARK(Array_Memcpy)->Arg(1 << 10)->Arg(1 << 20);
+BENCHMARK(Array_Marshal)->Arg(1 << 10)->Arg(1 << 20);
+BENCHMARK(Array_Unmarshal)->Arg(1 << 10)->Arg(1 << 20);
+BENCHMARK(Binary_UnmarshalCopy)->Arg(1 << 10)->Arg(1 << 20);
+BENCHMARK(Binary_UnmarshalMove)->Arg(1 << 10)->Arg(1 << 20);
+BENCHMARK(Binary_SendCopy)->Arg(1 << 10)->Arg(1 << 20);
+BENCHMARK(Binary_SendAttached)->Arg(1 << 10)->Arg(1 << 20);
+BENCHMARK(Schema_MarshalViaBag);
+BENCHMARK(Schema_MarshalDirect);
+BENCHMARK(Schema_UnmarshalViaBag);
+BENCHMARK(Schema_UnmarshalDirect);
+BENCHMARK(Snapshot_Load)->Arg(8)->Arg(32);
+BENCHMARK(Snapshot_LoadBags)->Arg(8)->Arg(32);
+BENCHMARK(Snapshot_LoadProtobuf)->Arg(8)->Arg(32);
+BENCHMARK(Diff_Full)->Arg(2)->Arg(20);
+BENCHMARK(Diff_Delta)->Arg(2)->Arg(20);
+BENCHMARK(Stream_Strings);
+BENCHMARK(Stream_StringsDictionary);
@@ -1,10 +1,124 @@
 #include "erebus_service.hxx"
 
 #include <grpcpp/grpcpp.h>
+#include <grpcpp/support/proto_buffer_reader.h>
+
+#include <array>
 
 namespace Erp::Ipc::Grpc
 {
 
+namespace
+{
+
+//
+// call arguments die together when the call returns, so their strings come from a per-thread arena
+// that is reset afterwards instead of being freed one by one, and the bag itself is reused
+// a call nested on the same thread gets no arena and allocates from the heap
+// services get the arguments by const reference, and copies of them go to the heap, so nothing
+// from the arena may outlive the call; the arena counts its live nodes to make sure of that
+//
+
+class CallArena final
+    : public boost::noncopyable
+{
+public:
+    ~CallArena()
+    {
+        if (m_state)
+        {
+            m_state->args.clear();
+            ErAssert(m_state->resource.live() == 0);
+            m_state->resource.release();
+            m_state->busy = false;
+        }
+    }
+
+    CallArena() noexcept
+        : m_state(&state())
+    {
+        if (m_state->busy)
+            m_state = nullptr;
+        else
+            m_state->busy = true;
+    }
+
+    std::pmr::memory_resource* resource() noexcept
+    {
+        return m_state ? &m_state->resource : nullptr;
+    }
+
+    Er::PropertyBag& args() noexcept
+    {
+        return m_state ? m_state->args : m_args;
+    }
+
+private:
+    static constexpr std::size_t InitialSize = 16 * 1024;
+
+    class Resource final
+        : public std::pmr::memory_resource
+    {
+    public:
+        Resource(void* buffer, std::size_t size) noexcept
+            : m_upstream(buffer, size)
+        {
+        }
+
+        std::size_t live() const noexcept
+        {
+            return m_live;
+        }
+
+        void release() noexcept
+        {
+            m_upstream.release();
+        }
+
+    private:
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override
+        {
+            auto p = m_upstream.allocate(bytes, alignment);
+            ++m_live;
+            return p;
+        }
+
+        void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+        {
+            --m_live;
+            m_upstream.deallocate(p, bytes, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            return this == &other;
+        }
+
+        std::pmr::monotonic_buffer_resource m_upstream;
+        std::size_t m_live = 0;
+    };
+
+    struct State
+    {
+        std::array<std::byte, InitialSize> buffer;
+        Resource resource{ buffer.data(), buffer.size() };
+        Er::PropertyBag args; // keeps its capacity between calls
+        bool busy = false;
+    };
+
+    static State& state() noexcept
+    {
+        thread_local State s;
+        return s;
+    }
+
+    State* m_state;
+    Er::PropertyBag m_args; // for a nested call
+};
+
+} // namespace {}
+
+
 ErebusService::~ErebusService()
 {
     m_server->Shutdown();
@@ -48,6 +162,9 @@ ErebusService::ErebusService(const Er::Ipc::Grpc::ServerArgs& params)
         builder.AddChannelArgument(GRPC_ARG_HTTP2_MAX_PING_STRIKES, 5);
     }
 
+    // unary request and reply messages are recycled; GenericCall() takes its own from m_callAllocator
+    SetMessageAllocatorFor_Ping(&m_pingAllocator);
+
     builder.RegisterService(this);
 
     // finally assemble the server
@@ -71,10 +188,8 @@ Er::Ipc::IService::Ptr ErebusService::findService(const std::string& id) const
     return {};
 }
 
-Er::PropertyBag ErebusService::unmarshalArgs(const erebus::ServiceRequest* request, std::uint32_t clientId)
+void ErebusService::unmarshalArgs(const erebus::ServiceRequest* request, std::uint32_t clientId, std::pmr::memory_resource* resource, Er::PropertyBag& bag)
 {
-    Er::PropertyBag bag;
-
     int count = request->args_size();
     if (count > 0)
     {
@@ -83,24 +198,16 @@ Er::PropertyBag ErebusService::unmarshalArgs(const erebus::ServiceRequest* reque
         for (int i = 0; i < count; ++i)
         {
             auto& arg = request->args(i);
-            bag.push_back(Erp::Protocol::getProperty(arg, this, clientId));
+            bag.push_back(Erp::Protocol::getProperty(arg, this, clientId, resource));
         }
     }
-
-    return bag;
 }
 
-void ErebusService::marshalReplyProps(const Er::PropertyBag& props, erebus::ServiceReply* reply)
+bool ErebusService::parseRequest(const grpc::ByteBuffer* buffer, erebus::ServiceRequest& request)
 {
-    if (props.empty())
-        return;
-
-    auto out = reply->mutable_props();
-    for (auto& prop : props)
-    {
-        auto mutableProp = out->Add();
-        Erp::Protocol::assignProperty(*mutableProp, prop);
-    }
+    // the reader does not modify the buffer
+    grpc::ProtoBufferReader reader(const_cast<grpc::ByteBuffer*>(buffer));
+    return request.ParseFromZeroCopyStream(&reader);
 }
 
 void ErebusService::marshalException(erebus::ServiceReply* reply, const std::exception& e)
@@ -169,17 +276,28 @@ grpc::ServerUnaryReactor* ErebusService::Ping(grpc::CallbackServerContext* conte
     return reactor.release();
 }
 
-grpc::ServerUnaryReactor* ErebusService::GenericCall(grpc::CallbackServerContext* context, const erebus::ServiceRequest* request, erebus::ServiceReply* reply)
+grpc::ServerUnaryReactor* ErebusService::GenericCall(grpc::CallbackServerContext* context, const grpc::ByteBuffer* requestBuffer, grpc::ByteBuffer* replyBuffer)
 {
     ServerTraceIndent2(m_log, "{}.ErebusService::GenericCall", Er::Format::ptr(this));
 
-    auto reactor = std::make_unique<ReplyUnaryReactor>(m_log);
+    auto messages = m_callAllocator.AllocateMessages();
+    auto request = messages->request();
+    auto reply = messages->response();
+
+    auto reactor = std::make_unique<ReplyUnaryReactor>(m_log, messages);
     if (context->IsCancelled()) [[unlikely]]
     {
         ErLogWarning2(m_log, "Request cancelled");
         return reactor.release();
     }
 
+    if (!parseRequest(requestBuffer, *request)) [[unlikely]]
+    {
+        ErLogError2(m_log, "Failed to parse a request from {}", context->peer());
+        reactor->Finish(grpc::Status(grpc::INTERNAL, "Failed to parse the request"));
+        return reactor.release();
+    }
+
     auto& requestStr = request->request();
     
     auto service = findService(requestStr);
@@ -199,6 +317,7 @@ grpc::ServerUnaryReactor* ErebusService::GenericCall(grpc::CallbackServerContext
 
     auto mappingVer = request->mappingver();
 
+    Erp::Protocol::ReplyWriter writer;
     ExceptionMarshaler xcptHandler(m_log, *reply);
     try
     {
@@ -211,9 +330,11 @@ grpc::ServerUnaryReactor* ErebusService::GenericCall(grpc::CallbackServerContext
         }
         else
         {
-            auto args = unmarshalArgs(request, clientId);
+            CallArena arena;
+            auto& args = arena.args();
+            unmarshalArgs(request, clientId, arena.resource(), args);
             auto result = service->request(requestStr, clientId, args);
-            marshalReplyProps(result, reply);
+            writer.assignProps(*reply, result);
 
             reply->set_result(erebus::SUCCESS);
         }
@@ -225,17 +346,25 @@ grpc::ServerUnaryReactor* ErebusService::GenericCall(grpc::CallbackServerContext
         reply->set_result(erebus::FAILURE);
     }
 
-    reactor->Finish(grpc::Status::OK);
+    reactor->Finish(writer.serialize(*reply, *replyBuffer));
     return reactor.release();
 }
 
-grpc::ServerWriteReactor<erebus::ServiceReply>* ErebusService::GenericStream(grpc::CallbackServerContext* context, const erebus::ServiceRequest* request)
+grpc::ServerWriteReactor<grpc::ByteBuffer>* ErebusService::GenericStream(grpc::CallbackServerContext* context, const grpc::ByteBuffer* requestBuffer)
 {
     ServerTraceIndent2(m_log, "{}.ErebusService::GenericStream", Er::Format::ptr(this));
 
     auto reactor = std::make_unique<ReplyStreamWriteReactor>(m_log);
 
-    auto& requestStr = request->request();
+    erebus::ServiceRequest request;
+    if (!parseRequest(requestBuffer, request)) [[unlikely]]
+    {
+        ErLogError2(m_log, "Failed to parse a request from {}", context->peer());
+        reactor->Finish(grpc::Status(grpc::INTERNAL, "Failed to parse the request"));
+        return reactor.release();
+    }
+
+    auto& requestStr = request.request();
     ErLogInfo2(m_log, "Strm [{}] to {}", requestStr, context->peer());
 
     auto service = findService(requestStr);
@@ -247,23 +376,29 @@ grpc::ServerWriteReactor<erebus::ServiceReply>* ErebusService::GenericStream(grp
         return reactor.release();
     }
 
-    std::uint32_t clientId = request->has_clientid() ? request->clientid() : std::uint32_t(-1);
+    std::uint32_t clientId = request.has_clientid() ? request.clientid() : std::uint32_t(-1);
     
-    auto mappingVer = request->mappingver();
+    auto mappingVer = request.mappingver();
 
     std::string errorMsg;
     Er::Util::ExceptionLogger xcptLogger(m_log);
     try
     {
         auto valid = propertyMappingValid(clientId, mappingVer);
-        if ((request->args_size() > 0) && ((clientId == std::uint32_t(-1)) || !valid.first))
+        if ((request.args_size() > 0) && ((clientId == std::uint32_t(-1)) || !valid.first))
         {
             ErLogDebug2(m_log, "Property mapping expired: remote v.{} vs local v.{}", mappingVer, valid.second);
             reactor->SendPropertyMappingExpired();
         }
         else
         {
-            auto args = unmarshalArgs(request, clientId);
+            CallArena arena;
+            auto& args = arena.args();
+            unmarshalArgs(&request, clientId, arena.resource(), args);
+
+            if (request.stringdictionary())
+                reactor->EnableStringDictionary();
+
             reactor->Begin(service, requestStr, clientId, args);
         }
         return reactor.release();
@@ -345,10 +480,7 @@ const Er::PropertyInfo* ErebusService::mapProperty(std::uint32_t id, std::uint32
 
     auto& mapping = session.get();
 
-    if (id < mapping.propertyMapping.size())
-        return mapping.propertyMapping[id];
-
-    return nullptr;
+    return mapping.propertyMapping.find(id);
 }
 
 std::pair<bool, std::uint32_t> ErebusService::propertyMappingValid(std::uint32_t clientId, std::uint32_t mappingVer)
@@ -370,13 +502,11 @@ void ErebusService::registerPropertyMapping(std::uint32_t version, std::uint32_t
     auto session = m_sessions.get(clientId);
     ErAssert(session);
 
+    auto info = Erp::allocateTransientProperty(type, name, readableName);
+
     auto& mapping = session.get();
     mapping.mappingVersion = version;
-    auto& m = mapping.propertyMapping;
-    if (id >= m.size())
-        m.resize(id + 1);
-
-    m[id] = Erp::allocateTransientProperty(type, name, readableName);
+    mapping.propertyMapping.set(id, std::move(info));
 }
 
 } // namespace Erp::Ipc::Grpc {}
@@ -1,15 +1,20 @@
 #pragma once
 
+#include "protocol.hxx"
+
 #include <erebus/erebus.grpc.pb.h>
 
-#include "protocol.hxx"
+#include "message_allocator.hxx"
+#include "property_mapping.hxx"
 #include "session_data.hxx"
 #include "trace.hxx"
 
 #include <erebus/ipc/grpc/grpc_server.hxx>
 #include <erebus/system/property_info.hxx>
 #include <erebus/system/util/exception_util.hxx>
+#include <erebus/system/util/object_pool.hxx>
 
+#include <algorithm>
 #include <atomic>
 #include <shared_mutex>
 #include <unordered_map>
@@ -17,8 +22,11 @@
 namespace Erp::Ipc::Grpc
 {
 
+// GenericCall and GenericStream replies are serialized by Protocol::ReplyWriter, so those two methods take raw buffers
+using ErebusServiceBase = erebus::Erebus::WithRawCallbackMethod_GenericCall<erebus::Erebus::WithRawCallbackMethod_GenericStream<erebus::Erebus::CallbackService>>;
+
 class ErebusService final
-    : public erebus::Erebus::CallbackService
+    : public ErebusServiceBase
     , public Er::Ipc::IServer
     , public Er::IPropertyMapping
 {
@@ -29,8 +37,8 @@ public:
     grpc::ServerUnaryReactor* Ping(grpc::CallbackServerContext* context, const erebus::PingRequest* request, erebus::PingReply* reply) override;
     grpc::ServerWriteReactor<erebus::GetPropertyMappingReply>* GetPropertyMapping(grpc::CallbackServerContext* context, const erebus::Void* request) override;
     grpc::ServerReadReactor<erebus::PutPropertyMappingRequest>* PutPropertyMapping(grpc::CallbackServerContext*, ::erebus::Void* reply) override;
-    grpc::ServerUnaryReactor* GenericCall(grpc::CallbackServerContext* context, const erebus::ServiceRequest* request, erebus::ServiceReply* reply) override;
-    grpc::ServerWriteReactor<erebus::ServiceReply>* GenericStream(grpc::CallbackServerContext* context, const erebus::ServiceRequest* request) override;
+    grpc::ServerUnaryReactor* GenericCall(grpc::CallbackServerContext* context, const grpc::ByteBuffer* request, grpc::ByteBuffer* reply) override;
+    grpc::ServerWriteReactor<grpc::ByteBuffer>* GenericStream(grpc::CallbackServerContext* context, const grpc::ByteBuffer* request) override;
 
     void registerService(std::string_view request, Er::Ipc::IService::Ptr service) override;
     void unregisterService(Er::Ipc::IService* service) override;
@@ -107,15 +115,23 @@ private:
 
     class ReplyUnaryReactor
         : public grpc::ServerUnaryReactor
+        , public Er::PooledAllocation<ReplyUnaryReactor>
     {
     public:
+        using CallMessages = grpc::MessageHolder<erebus::ServiceRequest, erebus::ServiceReply>;
+
         ~ReplyUnaryReactor()
         {
             ServerTrace2(m_log, "{}.ReplyUnaryReactor::~ReplyUnaryReactor", Er::Format::ptr(this));
+
+            if (m_messages)
+                m_messages->Release();
         }
 
-        ReplyUnaryReactor(Er::Log2::ILogger* log) noexcept
+        // a raw method has no allocator of its own, so the reactor gives its messages back
+        ReplyUnaryReactor(Er::Log2::ILogger* log, CallMessages* messages = nullptr) noexcept
             : m_log(log)
+            , m_messages(messages)
         {
             ServerTrace2(m_log, "{}.ReplyUnaryReactor::ReplyUnaryReactor", Er::Format::ptr(this));
         }
@@ -134,10 +150,12 @@ private:
         }
 
         Er::Log2::ILogger* const m_log;
+        CallMessages* const m_messages;
     };
 
     class ReplyStreamWriteReactor
-        : public grpc::ServerWriteReactor<erebus::ServiceReply>
+        : public grpc::ServerWriteReactor<grpc::ByteBuffer>
+        , public Er::PooledAllocation<ReplyStreamWriteReactor>
     {
     public:
         ~ReplyStreamWriteReactor()
@@ -149,11 +167,25 @@ private:
                 if (m_service)
                     m_service->endStream(m_streamId);
             }
+
+            // keep the message with its allocated capacity for the next stream unless it has grown too big
+            // every frame went through the serializer, which cached its size
+            auto largestFrame = std::max(m_largestFrame, static_cast<std::size_t>(m_response.GetCachedSize()));
+            if (largestFrame > MaxRecycledMessageSize)
+            {
+                delete &m_response;
+            }
+            else
+            {
+                m_response.Clear();
+                ResponsePool::release(&m_response);
+            }
         }
 
-        ReplyStreamWriteReactor(Er::Log2::ILogger* log) noexcept
+        ReplyStreamWriteReactor(Er::Log2::ILogger* log)
             : m_log(log)
             , m_mappingVersion(Erp::propertyMappingVersion())
+            , m_response(*ResponsePool::acquire())
         {
             ServerTrace2(m_log, "{}.ReplyStreamWriteReactor::ReplyStreamWriteReactor", Er::Format::ptr(this));
         }
@@ -164,7 +196,13 @@ private:
 
             m_response.set_result(erebus::PROPERTY_MAPPING_EXPIRED);
             m_response.set_mappingver(m_mappingVersion);
-            StartWriteAndFinish(&m_response, grpc::WriteOptions(), grpc::Status::OK);
+            Send(true);
+        }
+
+        // must come before Begin()
+        void EnableStringDictionary()
+        {
+            m_strings = std::make_unique<Erp::Protocol::StringEncoder>();
         }
 
         void Begin(Er::Ipc::IService::Ptr service, std::string_view request, std::uint32_t clientId, const Er::PropertyBag& args)
@@ -192,7 +230,7 @@ private:
             if (error)
             {
                 m_response.set_result(erebus::FAILURE);
-                StartWriteAndFinish(&m_response, grpc::WriteOptions(), grpc::Status::OK); // just send the exception
+                Send(true); // just send the exception
             }
             else
             {
@@ -204,6 +242,8 @@ private:
         {
             ServerTraceIndent2(m_log, "{}.ReplyStreamWriteReactor::OnWriteDone", Er::Format::ptr(this));
 
+            m_largestFrame = std::max(m_largestFrame, static_cast<std::size_t>(m_response.GetCachedSize()));
+
             if (!ok) 
                 Finish(grpc::Status(grpc::StatusCode::CANCELLED, "Operation canceled"));
             else
@@ -229,14 +269,18 @@ private:
 
             m_response.Clear();
             m_response.set_mappingver(m_mappingVersion);
+            m_writer.clear();
 
             bool error = false;
             ExceptionMarshaler xcptHandler(m_log, m_response);
 
             try
             {
-                auto item = m_service->next(m_streamId);
-                if (item.empty())
+                bool more = m_batched ? nextBatch() : false;
+                if (!m_batched)
+                    more = nextItem();
+
+                if (!more)
                 {
                     ServerTrace2(m_log, "End of stream");
                     
@@ -245,11 +289,8 @@ private:
                     Finish(grpc::Status::OK);
                     return;
                 }
-                else
-                {
-                    m_response.set_result(erebus::SUCCESS);
-                    marshalReplyProps(item, &m_response);
-                }
+
+                m_response.set_result(erebus::SUCCESS);
             }
             catch (...)
             {
@@ -260,19 +301,74 @@ private:
             if (error)
             {
                 m_response.set_result(erebus::FAILURE);
-                StartWriteAndFinish(&m_response, grpc::WriteOptions(), grpc::Status::OK); // just send the exception
+                Send(true); // just send the exception
             }
             else
             {
-                StartWrite(&m_response);
+                Send(false);
             }
         }
 
+        void Send(bool last)
+        {
+            auto status = m_writer.serialize(m_response, m_frame);
+            if (!status.ok()) [[unlikely]]
+            {
+                ErLogError2(m_log, "Failed to serialize a stream frame: {}", status.error_message());
+                Finish(status);
+            }
+            else if (last)
+            {
+                StartWriteAndFinish(&m_frame, grpc::WriteOptions(), grpc::Status::OK);
+            }
+            else
+            {
+                StartWrite(&m_frame);
+            }
+        }
+
+        bool nextBatch()
+        {
+            // the batch keeps its schema and capacity from the previous round
+            m_batch.clear();
+            if (!m_service->nextBatch(m_streamId, m_batch))
+            {
+                // the service does not do batches
+                m_batched = false;
+                return false;
+            }
+
+            if (m_batch.empty())
+                return false;
+
+            Erp::Protocol::assignBatch(*m_response.mutable_batch(), m_batch);
+            return true;
+        }
+
+        bool nextItem()
+        {
+            auto item = m_service->next(m_streamId);
+            if (item.empty())
+                return false;
+
+            m_writer.assignProps(m_response, item, m_strings.get());
+            return true;
+        }
+
+        using ResponsePool = Er::ObjectPool<erebus::ServiceReply>;
+        static constexpr std::size_t MaxRecycledMessageSize = 64 * 1024;
+
         Er::Log2::ILogger* const m_log;
         std::uint32_t m_mappingVersion;
+        erebus::ServiceReply& m_response;
+        Erp::Protocol::ReplyWriter m_writer;
+        grpc::ByteBuffer m_frame; // m_response as sent
+        std::size_t m_largestFrame = 0; // Clear() keeps the capacity of the largest frame written
         Er::Ipc::IService::Ptr m_service;
         Er::Ipc::IService::StreamId m_streamId = {};
-        erebus::ServiceReply m_response;
+        bool m_batched = true;
+        Er::PropertyBatch m_batch;
+        std::unique_ptr<Erp::Protocol::StringEncoder> m_strings;
     };
 
     class PropertyInfoStreamWriteReactor
@@ -299,7 +395,7 @@ private:
 
             m_version = Er::enumerateProperties([this](const Er::PropertyInfo* pi) -> bool
             {
-                m_properties.push_back(pi);
+                m_properties.emplace_back(pi);
                 return true;
             });
 
@@ -339,7 +435,7 @@ private:
             {
                 m_response.Clear();
 
-                auto pi = m_properties[m_next++];
+                auto& pi = m_properties[m_next++];
                 auto m = m_response.mutable_mapping();
                 m->set_id(pi->unique());
                 m->set_type(static_cast<std::uint32_t>(pi->type()));
@@ -358,7 +454,7 @@ private:
 
         Er::Log2::ILogger* const m_log;
         std::uint32_t m_version = std::uint32_t(-1);
-        std::vector<const Er::PropertyInfo*> m_properties;
+        std::vector<Er::PropertyInfoRef> m_properties;
         std::size_t m_next = 0;
         erebus::GetPropertyMappingReply m_response;
     };
@@ -434,13 +530,15 @@ private:
     };
 
     Er::Ipc::IService::Ptr findService(const std::string& id) const;
-    Er::PropertyBag unmarshalArgs(const erebus::ServiceRequest* request, std::uint32_t clientId);
-    static void marshalReplyProps(const Er::PropertyBag& props, erebus::ServiceReply* reply);
+    void unmarshalArgs(const erebus::ServiceRequest* request, std::uint32_t clientId, std::pmr::memory_resource* resource, Er::PropertyBag& bag);
+    static bool parseRequest(const grpc::ByteBuffer* buffer, erebus::ServiceRequest& request);
     static void marshalException(erebus::ServiceReply* reply, const std::exception& e);
     static void marshalException(erebus::ServiceReply* reply, const Er::Exception& e);
 
     const Er::Ipc::Grpc::ServerArgs m_params;
     Er::Log2::ILogger* const m_log;
+    PooledMessageAllocator<erebus::PingRequest, erebus::PingReply> m_pingAllocator;
+    PooledMessageAllocator<erebus::ServiceRequest, erebus::ServiceReply> m_callAllocator;
     std::unique_ptr<grpc::Server> m_server;
 
     struct
@@ -453,7 +551,7 @@ private:
     {
         SessionData() noexcept = default;
 
-        std::vector<const Er::PropertyInfo*> propertyMapping;
+        Erp::PropertyMappingTable propertyMapping;
         std::uint32_t mappingVersion = std::uint32_t(-1);
     };
 
@@ -1,20 +1,28 @@
+#include "protocol.hxx"
+
 #include <erebus/erebus.grpc.pb.h>
 #include <grpcpp/grpcpp.h>
 
-#include "protocol.hxx"
+#include "property_mapping.hxx"
 #include "trace.hxx"
 
 #include <erebus/ipc/grpc/grpc_client.hxx>
 #include <erebus/system/system/packed_time.hxx>
 #include <erebus/system/property_info.hxx>
 #include <erebus/system/util/exception_util.hxx>
+#include <erebus/system/util/object_pool.hxx>
 
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <limits>
+#include <map>
 #include <mutex>
+#include <optional>
 #include <random>
 #include <shared_mutex>
+#include <thread>
+#include <unordered_set>
 #include <vector>
 
 #include <boost/noncopyable.hpp>
@@ -51,6 +59,58 @@ static Er::ResultCode mapGrpcStatus(grpc::StatusCode status) noexcept
     }
 }
 
+static void recordSample(IClient::Histogram& h, std::chrono::microseconds value) noexcept
+{
+    if (!h.count || (value < h.min))
+        h.min = value;
+    if (!h.count || (value > h.max))
+        h.max = value;
+
+    ++h.buckets[IClient::Histogram::bucket(value)];
+    ++h.count;
+    h.sum += value;
+}
+
+// lock-free counterpart of IClient::Histogram for the call completion path
+class AtomicHistogram final
+    : public boost::noncopyable
+{
+public:
+    void record(std::chrono::microseconds value) noexcept
+    {
+        auto v = value.count();
+
+        m_buckets[IClient::Histogram::bucket(value)].fetch_add(1, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(v, std::memory_order_relaxed);
+
+        auto min = m_min.load(std::memory_order_relaxed);
+        while ((v < min) && !m_min.compare_exchange_weak(min, v, std::memory_order_relaxed));
+
+        auto max = m_max.load(std::memory_order_relaxed);
+        while ((v > max) && !m_max.compare_exchange_weak(max, v, std::memory_order_relaxed));
+    }
+
+    void snapshot(IClient::Histogram& to) const noexcept
+    {
+        // not an atomic snapshot; counters may be off by the samples recorded meanwhile
+        for (std::size_t i = 0; i < IClient::Histogram::BucketCount; ++i)
+            to.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+
+        to.count = m_count.load(std::memory_order_relaxed);
+        to.sum = std::chrono::microseconds(m_sum.load(std::memory_order_relaxed));
+        to.min = to.count ? std::chrono::microseconds(m_min.load(std::memory_order_relaxed)) : std::chrono::microseconds::zero();
+        to.max = std::chrono::microseconds(m_max.load(std::memory_order_relaxed));
+    }
+
+private:
+    std::array<std::atomic<std::uint64_t>, IClient::Histogram::BucketCount> m_buckets = {};
+    std::atomic<std::uint64_t> m_count = 0;
+    std::atomic<std::int64_t> m_sum = 0;
+    std::atomic<std::int64_t> m_min = std::numeric_limits<std::int64_t>::max();
+    std::atomic<std::int64_t> m_max = 0;
+};
+
 
 class ClientImpl final
     : public IClient
@@ -62,6 +122,8 @@ public:
     {
         ClientTrace2(m_log, "{}.ClientImpl::~ClientImpl()", Er::Format::ptr(this));
 
+        stopHealthMonitor();
+        cancelStreams();
         waitRunningContexts();
 
         ::grpc_shutdown();
@@ -100,20 +162,82 @@ private:
         Er::Log2::ILogger* const m_log;
     };
 
+    // unary call contexts are recycled through a per-thread pool
+    // protobuf messages are cleared rather than destroyed, so their allocated capacity is reused
+    struct ContextFinisher
+    {
+        template <class Context>
+        void operator()(Context* ctx) const noexcept
+        {
+            ctx->finish();
+        }
+    };
+
+    template <class Context>
+    using ContextPtr = std::unique_ptr<Context, ContextFinisher>;
+
+    // a context that has carried a huge message would hold on to its capacity in the pool, so it is dropped instead
+    // the sizes are wire sizes: the request has its size cached by the serializer, and only the parsed reply is measured
+    static constexpr std::size_t MaxRecycledMessageSize = 64 * 1024;
+
+    template <class Context>
+    static void recycle(Context* ctx, std::size_t spaceUsed) noexcept
+    {
+        if (spaceUsed > MaxRecycledMessageSize)
+            delete ctx;
+        else
+            Context::Pool::release(ctx);
+    }
+
     struct PingContext final
-        : public ContextBase
+        : public boost::noncopyable
     {
-        ~PingContext()
+        using Pool = Er::ObjectPool<PingContext>;
+
+        static ContextPtr<PingContext> acquire(ClientImpl* owner, Er::Log2::ILogger* log, std::uint32_t clientId, std::size_t payloadSize, IClient::IPingCompletion::Ptr handler)
         {
-            ClientTrace2(m_log, "{}.PingContext::~PingContext()", Er::Format::ptr(this));
+            ContextPtr<PingContext> ctx(Pool::acquire());
+            ctx->start(owner, log, clientId, payloadSize, handler);
+            return ctx;
         }
 
-        PingContext(ClientImpl* owner, Er::Log2::ILogger* log, std::uint32_t clientId, std::size_t payloadSize, IClient::IPingCompletion::Ptr handler)
-            : ContextBase(owner, log)
-            , handler(handler)
-            , started(Er::System::PackedTime::now())
+        void finish() noexcept
         {
-            ClientTrace2(m_log, "{}.PingContext::PingContext(clientId={})", Er::Format::ptr(this), clientId);
+            ClientTrace2(m_log, "{}.PingContext::finish()", Er::Format::ptr(this));
+
+            auto owner = m_owner;
+
+            auto spaceUsed = static_cast<std::size_t>(request.GetCachedSize()) + reply.ByteSizeLong();
+
+            handler.reset();
+            request.Clear();
+            reply.Clear();
+            context.reset();
+            recycle(this, spaceUsed);
+
+            owner->removeContext();
+        }
+
+        IClient::IPingCompletion::Ptr handler;
+        Er::System::PackedTime::ValueType started = 0;
+        std::chrono::steady_clock::time_point startedAt;
+        erebus::PingRequest request;
+        std::optional<grpc::ClientContext> context;
+        erebus::PingReply reply;
+
+    private:
+        void start(ClientImpl* owner, Er::Log2::ILogger* log, std::uint32_t clientId, std::size_t payloadSize, IClient::IPingCompletion::Ptr handler)
+        {
+            m_owner = owner;
+            m_log = log;
+            owner->addContext();
+
+            ClientTrace2(m_log, "{}.PingContext::start(clientId={})", Er::Format::ptr(this), clientId);
+
+            this->handler = handler;
+            started = Er::System::PackedTime::now();
+            startedAt = std::chrono::steady_clock::now();
+            context.emplace();
 
             request.set_clientid(clientId);
             request.set_timestamp(started);
@@ -124,46 +248,346 @@ private:
             }
         }
 
-        IClient::IPingCompletion::Ptr handler;
-        Er::System::PackedTime::ValueType started;
-        erebus::PingRequest request;
-        grpc::ClientContext context;
-        erebus::PingReply reply;
+        ClientImpl* m_owner = nullptr;
+        Er::Log2::ILogger* m_log = nullptr;
     };
 
-    struct CallContext final
-        : public ContextBase
+    // may outlive the client that prepared it, but then it may only be destroyed
+    // m_owner is never dereferenced, just compared in call(); the logger is held so the destructor can still trace
+    struct PreparedCall final
+        : public IPreparedCall
+        , public boost::noncopyable
     {
-        ~CallContext()
+        ~PreparedCall()
         {
-            ClientTrace2(m_log, "{}.CallContext::~CallContext()", Er::Format::ptr(this));
+            ClientTrace2(m_log, "{}.PreparedCall::~PreparedCall()", Er::Format::ptr(this));
         }
 
-        CallContext(ClientImpl* owner, Er::Log2::ILogger* log, std::string_view req, const Er::PropertyBag& args, std::uint32_t clientId, IClient::ICallCompletion::Ptr handler)
-            : ContextBase(owner, log)
-            , uri(req)
-            , handler(handler)
+        PreparedCall(ClientImpl* owner, Er::Log2::ILogger::Ptr log, std::string_view req, const Er::PropertyBag& args, std::uint32_t clientId)
+            : m_owner(owner)
+            , m_logRef(log)
+            , m_log(log.get())
+            , m_uri(req)
+            , m_argCount(args.size())
+            , m_message(std::make_shared<erebus::ServiceRequest>())
+        {
+            ClientTrace2(m_log, "{}.PreparedCall::PreparedCall(req={} clientId={})", Er::Format::ptr(this), req, clientId);
+
+            m_message->set_request(m_uri);
+            m_message->set_clientid(clientId);
+            m_message->set_mappingver(Erp::propertyMappingVersion());
+
+            m_message->mutable_args()->Reserve(static_cast<int>(args.size()));
+            for (auto& arg : args)
+            {
+                auto a = m_message->add_args();
+                Erp::Protocol::assignProperty(*a, arg);
+            }
+        }
+
+        std::string_view request() const noexcept override
+        {
+            return m_uri;
+        }
+
+        std::size_t argCount() const noexcept override
+        {
+            return m_argCount;
+        }
+
+        void updateArg(std::size_t index, const Er::Property& arg) override
+        {
+            if (index >= m_argCount)
+                ErThrow(Er::format("Argument index {} is out of range for {} arguments", index, m_argCount));
+
+            std::lock_guard l(m_lock);
+            Erp::Protocol::assignProperty(*mutableMessage()->mutable_args(static_cast<int>(index)), arg);
+        }
+
+        ClientImpl* owner() const noexcept
+        {
+            return m_owner;
+        }
+
+        // the message to send; only the mapping version may need patching since the last call
+        std::shared_ptr<const erebus::ServiceRequest> message()
         {
-            ClientTrace2(m_log, "{}.CallContext::CallContext(req={} clientId={})", Er::Format::ptr(this), req, clientId);
+            auto ver = Erp::propertyMappingVersion();
 
-            request.set_request(std::string(req));
+            std::lock_guard l(m_lock);
+
+            if (m_message->mappingver() != ver)
+                mutableMessage()->set_mappingver(ver);
+
+            return m_message;
+        }
+
+    private:
+        erebus::ServiceRequest* mutableMessage()
+        {
+            // calls still in flight share the message, so leave theirs alone
+            if (m_message.use_count() > 1)
+                m_message = std::make_shared<erebus::ServiceRequest>(*m_message);
+
+            return m_message.get();
+        }
+
+        ClientImpl* const m_owner;
+        Er::Log2::ILogger::Ptr m_logRef;
+        Er::Log2::ILogger* const m_log;
+        const std::string m_uri;
+        const std::size_t m_argCount; // arguments may be updated, but never added or removed
+        mutable std::mutex m_lock;
+        std::shared_ptr<erebus::ServiceRequest> m_message;
+    };
+
+    struct CallContext final
+        : public boost::noncopyable
+    {
+        using Pool = Er::ObjectPool<CallContext>;
+
+        static ContextPtr<CallContext> acquire(ClientImpl* owner, Er::Log2::ILogger* log, std::string_view req, const Er::PropertyBag& args, std::uint32_t clientId, IClient::ICallCompletion::Ptr handler)
+        {
+            ContextPtr<CallContext> ctx(Pool::acquire());
+            ctx->start(owner, log, req, handler);
+
+            ClientTrace2(log, "{}.CallContext::acquire(req={} clientId={})", Er::Format::ptr(ctx.get()), req, clientId);
+
+            auto& request = ctx->request;
+            request.set_request(req.data(), req.size());
             request.set_clientid(clientId);
             request.set_mappingver(Erp::propertyMappingVersion());
 
+            auto mutableArgs = request.mutable_args();
+            mutableArgs->Reserve(static_cast<int>(args.size()));
             for (auto& arg: args)
             {
-                auto a = request.add_args();
+                auto a = mutableArgs->Add();
                 Erp::Protocol::assignProperty(*a, arg);
             }
+
+            return ctx;
+        }
+
+        static ContextPtr<CallContext> acquire(ClientImpl* owner, Er::Log2::ILogger* log, PreparedCall* prepared, IClient::ICallCompletion::Ptr handler)
+        {
+            ContextPtr<CallContext> ctx(Pool::acquire());
+            ctx->start(owner, log, prepared->request(), handler);
+
+            ClientTrace2(log, "{}.CallContext::acquire(prepared req={})", Er::Format::ptr(ctx.get()), ctx->uri);
+
+            ctx->preparedRequest = prepared->message();
+
+            return ctx;
+        }
+
+        void finish() noexcept
+        {
+            ClientTrace2(m_log, "{}.CallContext::finish()", Er::Format::ptr(this));
+
+            auto owner = m_owner;
+
+            auto spaceUsed = static_cast<std::size_t>(request.GetCachedSize()) + reply.ByteSizeLong();
+
+            handler.reset();
+            preparedRequest.reset();
+            request.Clear();
+            reply.Clear();
+            context.reset();
+            recycle(this, spaceUsed);
+
+            owner->removeContext();
+        }
+
+        const erebus::ServiceRequest* message() const noexcept
+        {
+            return preparedRequest ? preparedRequest.get() : &request;
         }
 
         std::string uri;
+        std::chrono::steady_clock::time_point startedAt;
         IClient::ICallCompletion::Ptr handler;
         erebus::ServiceRequest request;
-        grpc::ClientContext context;
+        std::shared_ptr<const erebus::ServiceRequest> preparedRequest;
+        std::optional<grpc::ClientContext> context;
         erebus::ServiceReply reply;
+
+    private:
+        void start(ClientImpl* owner, Er::Log2::ILogger* log, std::string_view req, IClient::ICallCompletion::Ptr handler)
+        {
+            m_owner = owner;
+            m_log = log;
+            owner->addContext();
+
+            uri.assign(req);
+            startedAt = std::chrono::steady_clock::now();
+            this->handler = handler;
+            context.emplace();
+        }
+
+        ClientImpl* m_owner = nullptr;
+        Er::Log2::ILogger* m_log = nullptr;
     };
     
+    struct ServiceReplyStreamReader;
+
+    // credits shared by a stream reader and the IStreamControl handed out to the consumer
+    // the control may outlive the reader, so the reader is only reached through hold()
+    class StreamFlowControl final
+        : public boost::noncopyable
+    {
+    public:
+        StreamFlowControl(ServiceReplyStreamReader* reader, std::uint32_t credits) noexcept
+            : m_reader(reader)
+            , m_credits(credits)
+        {
+        }
+
+        // true if the first read may start right away
+        bool start() noexcept
+        {
+            std::lock_guard l(m_lock);
+            return mayRead();
+        }
+
+        // a frame has been delivered; true if the next read may start right away
+        bool consume() noexcept
+        {
+            std::lock_guard l(m_lock);
+
+            if (m_credits > 0)
+                --m_credits;
+
+            return mayRead();
+        }
+
+        void grant(std::uint32_t frames)
+        {
+            ReaderHold reader;
+
+            {
+                std::lock_guard l(m_lock);
+
+                if (!m_reader)
+                    return;
+
+                m_credits += frames;
+                if (!m_paused || (m_credits == 0))
+                    return;
+
+                m_paused = false;
+                reader = hold();
+            }
+
+            reader->resume();
+        }
+
+        // read everything that is left regardless of credits
+        void release()
+        {
+            ReaderHold reader;
+
+            {
+                std::lock_guard l(m_lock);
+
+                m_unlimited = true;
+                if (!m_reader || !m_paused)
+                    return;
+
+                m_paused = false;
+                reader = hold();
+            }
+
+            reader->resume();
+        }
+
+        void cancel()
+        {
+            ReaderHold reader;
+
+            {
+                std::lock_guard l(m_lock);
+
+                if (!m_reader)
+                    return;
+
+                reader = hold();
+            }
+
+            reader->cancel();
+            release();
+        }
+
+        // the reader is about to go away
+        void finish() noexcept
+        {
+            std::lock_guard l(m_lock);
+            m_reader = nullptr;
+        }
+
+    private:
+        struct HoldRemover
+        {
+            void operator()(ServiceReplyStreamReader* reader) const noexcept
+            {
+                reader->RemoveHold();
+            }
+        };
+
+        // keeps the reader alive while we call into it from outside of its reactions
+        using ReaderHold = std::unique_ptr<ServiceReplyStreamReader, HoldRemover>;
+
+        ReaderHold hold() noexcept
+        {
+            m_reader->AddHold();
+            return ReaderHold(m_reader);
+        }
+
+        bool mayRead() noexcept
+        {
+            if (m_unlimited || (m_credits > 0))
+                return true;
+
+            m_paused = true;
+            return false;
+        }
+
+        std::mutex m_lock;
+        ServiceReplyStreamReader* m_reader;
+        std::uint32_t m_credits;
+        bool m_unlimited = false;
+        bool m_paused = false;
+    };
+
+    class StreamControl final
+        : public IStreamControl
+        , public boost::noncopyable
+    {
+    public:
+        ~StreamControl()
+        {
+            m_flow->release();
+        }
+
+        explicit StreamControl(std::shared_ptr<StreamFlowControl> flow) noexcept
+            : m_flow(flow)
+        {
+        }
+
+        void grant(std::uint32_t frames) override
+        {
+            m_flow->grant(frames);
+        }
+
+        void cancel() override
+        {
+            m_flow->cancel();
+        }
+
+    private:
+        std::shared_ptr<StreamFlowControl> m_flow;
+    };
+
     struct ServiceReplyStreamReader final
         : public grpc::ClientReadReactor<erebus::ServiceReply>
         , public ContextBase
@@ -180,7 +604,9 @@ private:
             std::string_view req, 
             const Er::PropertyBag& args, 
             std::uint32_t clientId, 
-            IStreamCompletion::Ptr handler
+            IStreamCompletion::Ptr handler,
+            const StreamOptions& options = StreamOptions(),
+            IStreamControl::Ptr* control = nullptr
         )
             : ContextBase(owner, log)
             , m_uri(req)
@@ -201,17 +627,61 @@ private:
                 Erp::Protocol::assignProperty(*a, arg);
             }
 
+            if (options.stringDictionary)
+            {
+                m_request.set_stringdictionary(true);
+                m_strings = std::make_unique<Erp::Protocol::StringDecoder>(options.internStrings);
+            }
+
             stub->async()->GenericStream(&m_context, &m_request, this);
-            StartRead(&m_reply);
+
+            if (options.initialCredits > 0)
+            {
+                m_flow = std::make_shared<StreamFlowControl>(this, options.initialCredits);
+
+                // reads may be resumed from outside of the reactions
+                AddHold();
+                m_owner->addStream(m_flow);
+
+                if (control)
+                    *control = std::make_shared<StreamControl>(m_flow);
+            }
+
+            if (!m_flow || m_flow->start())
+                StartRead(&m_reply);
+
             StartCall();
         }
 
+        void resume()
+        {
+            ClientTrace2(m_log, "{}.ServiceReplyStreamReader::resume({})", Er::Format::ptr(this), m_uri);
+
+            StartRead(&m_reply);
+        }
+
+        void cancel()
+        {
+            ClientTrace2(m_log, "{}.ServiceReplyStreamReader::cancel({})", Er::Format::ptr(this), m_uri);
+
+            m_context.TryCancel();
+        }
+
         void OnReadDone(bool ok) override
         {
             ClientTraceIndent2(m_log, "{}.ServiceReplyStreamReader::OnReadDone({}, {})", Er::Format::ptr(this), m_uri, ok);
 
             if (!ok)
+            {
+                if (m_flow)
+                {
+                    m_flow->finish();
+                    m_owner->removeStream(m_flow);
+                    RemoveHold();
+                }
+
                 return;
+            }
 
             Er::Util::ExceptionLogger xcptLogger(m_log);
 
@@ -226,7 +696,7 @@ private:
                         m_handler->onServerPropertyMappingExpired();
                         
                         m_context.TryCancel();
-                        return StartRead(&m_reply);
+                        return drain();
                     }
                     else if (!m_reply.has_exception())
                     {
@@ -234,19 +704,19 @@ private:
                         m_handler->onTransportError(Er::Result::Failure, std::move(message));
 
                         m_context.TryCancel();
-                        return StartRead(&m_reply);
+                        return drain();
                     }
                 }
 
                 auto remoteMappingVer = m_reply.mappingver();
-                auto localMappingVer = m_owner-> m_propertyMapping.version;
+                auto localMappingVer = m_owner->m_propertyMapping.version.load(std::memory_order_acquire);
                 if (remoteMappingVer != localMappingVer)
                 {
                     ClientTrace2(m_log, "Client property mapping expired for {}:{} (remote v.{} local v.{})", m_context.peer(), m_uri, remoteMappingVer, localMappingVer);
                     m_handler->onClientPropertyMappingExpired();
 
                     m_context.TryCancel();
-                    return StartRead(&m_reply);
+                    return drain();
                 }
 
                 if (m_reply.has_exception())
@@ -257,13 +727,18 @@ private:
                     m_handler->onException(std::move(e));
                     
                     m_context.TryCancel();
-                    return StartRead(&m_reply);
+                    return drain();
                 }
                 
-                auto reply = m_owner->unmarshal(m_reply);
-                if (m_handler->onFrame(std::move(reply)) == Er::CallbackResult::Cancel)
+                // a batch counts as a single frame for flow control
+                auto result = m_reply.has_batch() ? 
+                    m_handler->onBatch(m_owner->unmarshalBatch(m_reply)) :
+                    m_handler->onFrame(m_owner->unmarshal(m_reply, m_strings.get()));
+
+                if (result == Er::CallbackResult::Cancel)
                 {
                     m_context.TryCancel();
+                    return drain();
                 }
                 
             }
@@ -272,8 +747,8 @@ private:
                 Er::dispatchException(std::current_exception(), xcptLogger);
             }
 
-            // we have to drain the completion queue even if we cancel
-            StartRead(&m_reply);
+            if (!m_flow || m_flow->consume())
+                StartRead(&m_reply);
         }
 
         void OnDone(const grpc::Status& status) override
@@ -306,11 +781,22 @@ private:
         }
 
     private:
+        void drain()
+        {
+            // we have to drain the completion queue even if we cancel
+            if (m_flow)
+                m_flow->release();
+
+            StartRead(&m_reply);
+        }
+
         std::string m_uri;
         IStreamCompletion::Ptr m_handler;
         erebus::ServiceRequest m_request;
         grpc::ClientContext m_context;
         erebus::ServiceReply m_reply;
+        std::shared_ptr<StreamFlowControl> m_flow;
+        std::unique_ptr<Erp::Protocol::StringDecoder> m_strings;
     };
 
     struct PropertyMappingStreamReader final
@@ -419,7 +905,7 @@ private:
             m_mappingVer = Er::enumerateProperties(
                 [this](const Er::PropertyInfo* pi) -> bool
                 {
-                    m_mapping.push_back(pi);
+                    m_mapping.emplace_back(pi);
                     return true;
                 });
 
@@ -480,7 +966,7 @@ private:
                 m_request.set_clientid(m_clientId);
                 m_request.set_mappingver(m_mappingVer);
 
-                auto prop = m_mapping[m_nextIndex++];
+                auto& prop = m_mapping[m_nextIndex++];
 
                 auto m = m_request.mutable_mapping();
                 m->set_id(prop->unique());
@@ -504,7 +990,7 @@ private:
         erebus::PutPropertyMappingRequest m_request;
         grpc::ClientContext m_context;
         erebus::Void m_reply;
-        std::vector<const Er::PropertyInfo*> m_mapping;
+        std::vector<Er::PropertyInfoRef> m_mapping;
         std::uint32_t m_mappingVer = std::uint32_t(-1);
         std::size_t m_nextIndex = 0;
     };
@@ -514,8 +1000,9 @@ private:
         {
             std::shared_lock l(m_propertyMapping.lock);
 
-            if (id < m_propertyMapping.map.size())
-                return m_propertyMapping.map[id];
+            auto info = m_propertyMapping.map.find(id);
+            if (info)
+                return info;
         }
 
         ErLogError2(m_log, "{}.ClientImpl::mapProperty({}) -> NULL", Er::Format::ptr(this), id);
@@ -526,17 +1013,20 @@ private:
     {
         ClientTraceIndent2(m_log, "{}.ClientImpl::ping()", Er::Format::ptr(this));
 
-        auto ctx = std::make_shared<PingContext>(this, m_log, m_clientId, payloadSize, handler);
-        ctx->context.set_deadline(std::chrono::system_clock::now() + timeout);
+        auto ctx = PingContext::acquire(this, m_log, m_clientId, payloadSize, handler);
+        ctx->context->set_deadline(std::chrono::system_clock::now() + timeout);
 
+        auto raw = ctx.get();
         m_stub->async()->Ping(
-            &ctx->context,
-            &ctx->request,
-            &ctx->reply,
-            [this, ctx, payloadSize](grpc::Status status)
+            &*raw->context,
+            &raw->request,
+            &raw->reply,
+            [this, raw, payloadSize](grpc::Status status)
             {
-                completePing(ctx, status, payloadSize);
+                completePing(ContextPtr<PingContext>(raw), status, payloadSize);
             });
+
+        ctx.release();
     }
 
     void getPropertyMapping(ICompletion::Ptr handler) override
@@ -557,17 +1047,42 @@ private:
     {
         ClientTraceIndent2(m_log, "{}.ClientImpl::call({})", Er::Format::ptr(this), request);
 
-        auto ctx = std::make_shared<CallContext>(this, m_log, request, args, m_clientId, handler);
-        ctx->context.set_deadline(std::chrono::system_clock::now() + timeout);
+        startCall(CallContext::acquire(this, m_log, request, args, m_clientId, handler), timeout);
+    }
+
+    IPreparedCall::Ptr prepareCall(std::string_view request, const Er::PropertyBag& args) override
+    {
+        ClientTraceIndent2(m_log, "{}.ClientImpl::prepareCall({})", Er::Format::ptr(this), request);
+
+        return std::make_shared<PreparedCall>(this, m_logRef, request, args, m_clientId);
+    }
+
+    void call(IPreparedCall::Ptr prepared, ICallCompletion::Ptr handler, std::chrono::milliseconds timeout) override
+    {
+        auto p = std::dynamic_pointer_cast<PreparedCall>(prepared);
+        if (!p || (p->owner() != this))
+            ErThrow("Prepared call belongs to another client");
+
+        ClientTraceIndent2(m_log, "{}.ClientImpl::call(prepared {})", Er::Format::ptr(this), p->request());
 
+        startCall(CallContext::acquire(this, m_log, p.get(), handler), timeout);
+    }
+
+    void startCall(ContextPtr<CallContext>&& ctx, std::chrono::milliseconds timeout)
+    {
+        ctx->context->set_deadline(std::chrono::system_clock::now() + timeout);
+
+        auto raw = ctx.get();
         m_stub->async()->GenericCall(
-            &ctx->context,
-            &ctx->request,
-            &ctx->reply,
-            [this, ctx](grpc::Status status)
+            &*raw->context,
+            raw->message(),
+            &raw->reply,
+            [this, raw](grpc::Status status)
             {
-                completeCall(ctx, status);
+                completeCall(ContextPtr<CallContext>(raw), status);
             });
+
+        ctx.release();
     }
 
     void stream(std::string_view request, const Er::PropertyBag& args, IStreamCompletion::Ptr handler) override
@@ -577,10 +1092,191 @@ private:
         new ServiceReplyStreamReader(this, m_log, m_stub.get(), request, args, m_clientId, handler);
     }
 
-    void completePing(std::shared_ptr<PingContext> ctx, grpc::Status status, std::size_t payloadSize)
+    IStreamControl::Ptr stream(std::string_view request, const Er::PropertyBag& args, IStreamCompletion::Ptr handler, const StreamOptions& options) override
+    {
+        ClientTraceIndent2(m_log, "{}.ClientImpl::stream({}, credits={})", Er::Format::ptr(this), request, options.initialCredits);
+
+        IStreamControl::Ptr control;
+        new ServiceReplyStreamReader(this, m_log, m_stub.get(), request, args, m_clientId, handler, options, &control);
+        return control;
+    }
+
+    void startHealthMonitor(const HealthMonitorOptions& options) override
+    {
+        ClientTraceIndent2(m_log, "{}.ClientImpl::startHealthMonitor({} ms)", Er::Format::ptr(this), options.interval.count());
+
+        ErAssert(options.interval.count() > 0);
+
+        std::lock_guard l(m_healthMonitor.control);
+
+        joinHealthMonitor();
+
+        m_healthMonitor.options = options;
+        m_healthMonitor.worker = std::jthread([this](std::stop_token stop) { runHealthMonitor(stop); });
+        m_healthMonitor.monitoring.store(true, std::memory_order_relaxed);
+    }
+
+    void stopHealthMonitor() override
+    {
+        std::lock_guard l(m_healthMonitor.control);
+
+        joinHealthMonitor();
+    }
+
+    HealthSnapshot health() const override
+    {
+        HealthSnapshot snapshot;
+        snapshot.taken = std::chrono::steady_clock::now();
+        snapshot.monitoring = m_healthMonitor.monitoring.load(std::memory_order_relaxed);
+
+        {
+            std::lock_guard l(m_pingStats.lock);
+
+            snapshot.pingsSucceeded = m_pingStats.succeeded;
+            snapshot.pingsFailed = m_pingStats.failed;
+            snapshot.pingsTimedOut = m_pingStats.timedOut;
+            snapshot.consecutivePingFailures = m_pingStats.consecutiveFailures;
+            snapshot.lastRtt = m_pingStats.lastRtt;
+            snapshot.smoothedJitter = std::chrono::microseconds(static_cast<std::int64_t>(m_pingStats.smoothedJitter));
+            snapshot.rtt = m_pingStats.rtt;
+            snapshot.jitter = m_pingStats.jitter;
+        }
+
+        {
+            std::shared_lock l(m_callStats.lock);
+
+            snapshot.calls.reserve(m_callStats.map.size());
+            for (auto& [uri, counters] : m_callStats.map)
+            {
+                auto& stats = snapshot.calls.emplace_back();
+                stats.request = uri;
+                stats.succeeded = counters.succeeded.load(std::memory_order_relaxed);
+                stats.failed = counters.failed.load(std::memory_order_relaxed);
+                stats.timedOut = counters.timedOut.load(std::memory_order_relaxed);
+                counters.latency.snapshot(stats.latency);
+            }
+        }
+
+        return snapshot;
+    }
+
+    void joinHealthMonitor()
+    {
+        if (m_healthMonitor.worker.joinable())
+        {
+            ClientTraceIndent2(m_log, "{}.ClientImpl::joinHealthMonitor()", Er::Format::ptr(this));
+
+            m_healthMonitor.worker.request_stop();
+            m_healthMonitor.worker.join();
+        }
+
+        m_healthMonitor.monitoring.store(false, std::memory_order_relaxed);
+    }
+
+    void runHealthMonitor(std::stop_token stop)
+    {
+        // a fixed schedule, so slow replies do not stretch the probing interval
+        auto next = std::chrono::steady_clock::now();
+        while (!stop.stop_requested())
+        {
+            ping(m_healthMonitor.options.payloadSize, m_healthMonitor.completion, m_healthMonitor.options.timeout);
+
+            next += m_healthMonitor.options.interval;
+
+            std::unique_lock l(m_healthMonitor.lock);
+            m_healthMonitor.cv.wait_until(l, stop, next, []() { return false; });
+        }
+    }
+
+    void recordPing(grpc::StatusCode status, std::chrono::microseconds rtt) noexcept
+    {
+        std::lock_guard l(m_pingStats.lock);
+
+        if (status != grpc::OK)
+        {
+            if (status == grpc::DEADLINE_EXCEEDED)
+                ++m_pingStats.timedOut;
+            else
+                ++m_pingStats.failed;
+
+            ++m_pingStats.consecutiveFailures;
+            return;
+        }
+
+        ++m_pingStats.succeeded;
+        m_pingStats.consecutiveFailures = 0;
+
+        recordSample(m_pingStats.rtt, rtt);
+
+        if (m_pingStats.rtt.count > 1)
+        {
+            auto delta = (rtt > m_pingStats.lastRtt) ? (rtt - m_pingStats.lastRtt) : (m_pingStats.lastRtt - rtt);
+            recordSample(m_pingStats.jitter, delta);
+
+            m_pingStats.smoothedJitter += (static_cast<double>(delta.count()) - m_pingStats.smoothedJitter) / 16.0;
+        }
+
+        m_pingStats.lastRtt = rtt;
+    }
+
+    void recordCall(const CallContext& ctx, grpc::StatusCode status)
+    {
+        auto& counters = callCounters(ctx.uri);
+
+        if (status != grpc::OK)
+        {
+            if (status == grpc::DEADLINE_EXCEEDED)
+                counters.timedOut.fetch_add(1, std::memory_order_relaxed);
+            else
+                counters.failed.fetch_add(1, std::memory_order_relaxed);
+
+            return;
+        }
+
+        counters.latency.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - ctx.startedAt));
+
+        auto& reply = ctx.reply;
+        bool succeeded = (reply.result() == erebus::CallResult::SUCCESS) && !reply.has_exception() && (reply.mappingver() == m_propertyMapping.version.load(std::memory_order_acquire));
+        if (succeeded)
+            counters.succeeded.fetch_add(1, std::memory_order_relaxed);
+        else
+            counters.failed.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    struct CallCounters
+    {
+        std::atomic<std::uint64_t> succeeded = 0;
+        std::atomic<std::uint64_t> failed = 0;
+        std::atomic<std::uint64_t> timedOut = 0;
+        AtomicHistogram latency;
+    };
+
+    CallCounters& callCounters(std::string_view uri)
+    {
+        {
+            std::shared_lock l(m_callStats.lock);
+
+            auto it = m_callStats.map.find(uri);
+            if (it != m_callStats.map.end())
+                return it->second;
+        }
+
+        // counters can't be evicted while completions hold them, so once the map is full the rest share one entry
+        std::unique_lock l(m_callStats.lock);
+        if (m_callStats.map.size() >= MaxTrackedRequests)
+            uri = {};
+
+        auto it = m_callStats.map.try_emplace(std::string(uri)).first;
+        return it->second;
+    }
+
+    void completePing(ContextPtr<PingContext> ctx, grpc::Status status, std::size_t payloadSize)
     {
         ClientTraceIndent2(m_log, "{}.ClientImpl::completePing({})", Er::Format::ptr(this), static_cast<int>(status.error_code()));
 
+        auto rtt = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - ctx->startedAt);
+        recordPing(status.error_code(), rtt);
+
         Er::Util::ExceptionLogger xcptLogger(m_log);
 
         try
@@ -589,16 +1285,13 @@ private:
             {
                 auto resultCode = mapGrpcStatus(status.error_code());
                 auto errorMsg = status.error_message();
-                ErLogError2(m_log, "Failed to ping {}: {} ({})", ctx->context.peer(), static_cast<int>(status.error_code()), errorMsg);
+                ErLogError2(m_log, "Failed to ping {}: {} ({})", ctx->context->peer(), static_cast<int>(status.error_code()), errorMsg);
 
                 ctx->handler->onTransportError(resultCode, std::move(errorMsg));
             }
             else
             {
-                auto finished = Er::System::PackedTime::now();
-                auto milliseconds = (finished - ctx->started) / 1000;
-
-                ctx->handler->onReply(payloadSize, std::chrono::milliseconds(milliseconds));
+                ctx->handler->onReply(payloadSize, std::chrono::duration_cast<std::chrono::milliseconds>(rtt));
             }
 
             ctx->handler->done();
@@ -609,10 +1302,12 @@ private:
         }
     }
 
-    void completeCall(std::shared_ptr<CallContext> ctx, grpc::Status status)
+    void completeCall(ContextPtr<CallContext> ctx, grpc::Status status)
     {
         ClientTraceIndent2(m_log, "{}.ClientImpl::completeCall({})", Er::Format::ptr(this), static_cast<int>(status.error_code()));
 
+        recordCall(*ctx, status.error_code());
+
         Er::Util::ExceptionLogger xcptLogger(m_log);
 
         try
@@ -621,7 +1316,7 @@ private:
             {
                 auto resultCode = mapGrpcStatus(status.error_code());
                 auto errorMsg = status.error_message();
-                ErLogError2(m_log, "Failed to call {}:{}: {} ({})", ctx->context.peer(), ctx->uri, resultCode, errorMsg);
+                ErLogError2(m_log, "Failed to call {}:{}: {} ({})", ctx->context->peer(), ctx->uri, resultCode, errorMsg);
 
                 ctx->handler->onTransportError(resultCode, std::move(errorMsg));
 
@@ -633,23 +1328,23 @@ private:
                 auto code = ctx->reply.result();
                 if (code == erebus::CallResult::PROPERTY_MAPPING_EXPIRED)
                 {
-                    ClientTrace2(m_log, "Server property mapping expired for {}:{}", ctx->context.peer(), ctx->uri);
+                    ClientTrace2(m_log, "Server property mapping expired for {}:{}", ctx->context->peer(), ctx->uri);
                     ctx->handler->onServerPropertyMappingExpired();
                     return ctx->handler->done();
                 }
                 else if (!ctx->reply.has_exception())
                 {
-                    auto message = Er::format("Unexpected error calling {}:{}: {}", ctx->context.peer(), ctx->uri, static_cast<int>(code));
+                    auto message = Er::format("Unexpected error calling {}:{}: {}", ctx->context->peer(), ctx->uri, static_cast<int>(code));
                     ctx->handler->onTransportError(Er::Result::Failure, std::move(message));
                     return ctx->handler->done();
                 }
             }
 
             auto remoteMappingVer = ctx->reply.mappingver();
-            auto localMappingVer = m_propertyMapping.version;
+            auto localMappingVer = m_propertyMapping.version.load(std::memory_order_acquire);
             if (remoteMappingVer != localMappingVer)
             {
-                ClientTrace2(m_log, "Client property mapping expired for {}:{} (remote v.{} local v.{})", ctx->context.peer(), ctx->uri, remoteMappingVer, localMappingVer);
+                ClientTrace2(m_log, "Client property mapping expired for {}:{} (remote v.{} local v.{})", ctx->context->peer(), ctx->uri, remoteMappingVer, localMappingVer);
                 ctx->handler->onClientPropertyMappingExpired();
                 return ctx->handler->done();
             }
@@ -657,7 +1352,7 @@ private:
             if (ctx->reply.has_exception())
             {
                 auto e = unmarshalException(ctx->reply);
-                ErLogError2(m_log, "Failed to call {}:{}: {}", ctx->context.peer(), ctx->uri, e.what());
+                ErLogError2(m_log, "Failed to call {}:{}: {}", ctx->context->peer(), ctx->uri, e.what());
 
                 ctx->handler->onException(std::move(e));
                 return ctx->handler->done();
@@ -697,20 +1392,30 @@ private:
         return unmarshaledException;
     }
 
-    Er::PropertyBag unmarshal(const erebus::ServiceReply& reply)
+    // the reply is consumed: large values are moved out of it
+    Er::PropertyBag unmarshal(erebus::ServiceReply& reply, Erp::Protocol::StringDecoder* strings = nullptr)
     {
         Er::PropertyBag bag;
         int count = reply.props_size();
+        bag.reserve(count);
         for (int i = 0; i < count; ++i)
         {
-            auto& prop = reply.props(i);
+            auto prop = reply.mutable_props(i);
 
-            bag.push_back(Erp::Protocol::getProperty(prop, this, m_clientId));
+            if (strings)
+                bag.push_back(strings->getProperty(std::move(*prop), this, m_clientId));
+            else
+                bag.push_back(Erp::Protocol::getProperty(std::move(*prop), this, m_clientId));
         }
 
         return bag;
     }
 
+    Er::PropertyBatch unmarshalBatch(const erebus::ServiceReply& reply)
+    {
+        return Erp::Protocol::getBatch(reply.batch(), this, m_clientId);
+    }
+
     void putPropertyMapping(std::uint32_t version, std::uint32_t id, Er::PropertyType type, const std::string& name, const std::string& readableName)
     {
         ClientTraceIndent2(m_log, "{}.ClientImpl::putPropertyMapping(v.{} {} -> {} [{}])", Er::Format::ptr(this), version, id, name, readableName);
@@ -719,12 +1424,8 @@ private:
 
         std::lock_guard l(m_propertyMapping.lock);
 
-        auto& m = m_propertyMapping.map;
-        if (m.size() <= id)
-            m.resize(id + 1);
-
-        m[id] = pi;
-        m_propertyMapping.version = version;
+        m_propertyMapping.map.set(id, std::move(pi));
+        m_propertyMapping.version.store(version, std::memory_order_release);
     }
 
     static std::string makeNoise(std::size_t length)
@@ -778,6 +1479,32 @@ private:
             m_runningContexts.cv.notify_all();
     }
 
+    void addStream(const std::shared_ptr<StreamFlowControl>& flow)
+    {
+        std::lock_guard l(m_flowControlledStreams.lock);
+        m_flowControlledStreams.streams.insert(flow);
+    }
+
+    void removeStream(const std::shared_ptr<StreamFlowControl>& flow)
+    {
+        std::lock_guard l(m_flowControlledStreams.lock);
+        m_flowControlledStreams.streams.erase(flow);
+    }
+
+    // a paused stream waits for credits that may never come, and we'd wait for it forever
+    void cancelStreams()
+    {
+        std::vector<std::shared_ptr<StreamFlowControl>> streams;
+
+        {
+            std::lock_guard l(m_flowControlledStreams.lock);
+            streams.assign(m_flowControlledStreams.streams.begin(), m_flowControlledStreams.streams.end());
+        }
+
+        for (auto& flow : streams)
+            flow->cancel();
+    }
+
     void waitRunningContexts()
     {
         while (m_runningContexts.count > 0)
@@ -798,8 +1525,8 @@ private:
     struct PropertyMapping
     {
         std::shared_mutex lock;
-        std::vector<Er::PropertyInfo const*> map;
-        std::uint32_t version = std::uint32_t(-1);
+        Erp::PropertyMappingTable map;
+        std::atomic<std::uint32_t> version = std::uint32_t(-1); // written under the lock, read by completions without it
     };
     
     PropertyMapping m_propertyMapping;
@@ -812,6 +1539,60 @@ private:
     };
 
     RunningContexts m_runningContexts;
+
+    struct FlowControlledStreams
+    {
+        std::mutex lock;
+        std::unordered_set<std::shared_ptr<StreamFlowControl>> streams;
+    };
+
+    FlowControlledStreams m_flowControlledStreams;
+
+    struct PingStatistics
+    {
+        mutable std::mutex lock;
+        std::uint64_t succeeded = 0;
+        std::uint64_t failed = 0;
+        std::uint64_t timedOut = 0;
+        std::uint64_t consecutiveFailures = 0;
+        std::chrono::microseconds lastRtt = std::chrono::microseconds::zero();
+        double smoothedJitter = 0.0;
+        Histogram rtt;
+        Histogram jitter;
+    };
+
+    PingStatistics m_pingStats;
+
+    struct CallStatisticsMap
+    {
+        mutable std::shared_mutex lock;
+        std::map<std::string, CallCounters, std::less<>> map; // nodes are stable, so counters are updated outside the lock
+    };
+
+    CallStatisticsMap m_callStats;
+
+    struct HealthPingCompletion final
+        : public IPingCompletion
+    {
+        void done() override {}
+        void onServerPropertyMappingExpired() override {}
+        void onClientPropertyMappingExpired() override {}
+        void onTransportError(Er::ResultCode, std::string&&) override {}
+        void onReply(std::size_t, std::chrono::milliseconds) override {}
+    };
+
+    struct HealthMonitor
+    {
+        HealthMonitorOptions options;
+        IPingCompletion::Ptr completion = std::make_shared<HealthPingCompletion>();
+        std::mutex lock;
+        std::condition_variable_any cv;
+        std::mutex control; // start and stop; the worker takes lock, so it cannot be held while joining
+        std::atomic<bool> monitoring = false; // health() reads it without taking control
+        std::jthread worker;
+    };
+
+    HealthMonitor m_healthMonitor;
 };
 
 
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <erebus/system/util/object_pool.hxx>
+
+#include <grpcpp/support/message_allocator.h>
+
+#include <boost/noncopyable.hpp>
+
+#include <cstddef>
+
+
+namespace Erp::Ipc::Grpc
+{
+
+//
+// supplies request and response of a callback unary method from a pool of recycled messages
+// messages are Clear()ed rather than destroyed, so strings and repeated fields keep their capacity
+// register with SetMessageAllocatorFor_<Method>(); a raw method calls AllocateMessages() itself and releases the holder when done
+//
+
+template <class Request, class Response>
+class PooledMessageAllocator final
+    : public grpc::MessageAllocator<Request, Response>
+    , public boost::noncopyable
+{
+public:
+    grpc::MessageHolder<Request, Response>* AllocateMessages() override
+    {
+        auto holder = Pool::acquire();
+        holder->assign();
+        return holder;
+    }
+
+    // messages that have carried a huge payload would hold on to its capacity in the pool, so they are dropped instead
+    static constexpr std::size_t MaxRecycledMessageSize = 64 * 1024;
+
+private:
+    class Holder final
+        : public grpc::MessageHolder<Request, Response>
+    {
+    public:
+        void assign() noexcept
+        {
+            this->set_request(&m_request);
+            this->set_response(&m_response);
+        }
+
+        void Release() override
+        {
+            // wire sizes; the response has been sent, so the serializer has cached its size
+            auto spaceUsed = m_request.ByteSizeLong() + static_cast<std::size_t>(m_response.GetCachedSize());
+            if (spaceUsed > MaxRecycledMessageSize)
+            {
+                delete this;
+                return;
+            }
+
+            m_request.Clear();
+            m_response.Clear();
+            Pool::release(this);
+        }
+
+    private:
+        Request m_request;
+        Response m_response;
+    };
+
+    // cached messages keep their memory, so don't hold too many of them
+    using Pool = Er::ObjectPool<Holder, 16, 64>;
+};
+
+
+} // namespace Erp::Ipc::Grpc {}
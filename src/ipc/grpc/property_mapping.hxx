@@ -0,0 +1,61 @@
+#pragma once
+
+#include <erebus/system/property_info.hxx>
+
+#include <unordered_map>
+#include <vector>
+
+
+namespace Erp
+{
+
+//
+// maps peer property IDs to local properties, keeping transient ones alive
+// persistent IDs are small and dense while transient ones are sparse, so they are stored apart
+//
+class PropertyMappingTable final
+{
+public:
+    [[nodiscard]] const Er::PropertyInfo* find(std::uint32_t id) const noexcept
+    {
+        if (id & Er::PropertyInfo::TransientBit)
+        {
+            auto it = m_transient.find(id);
+            return (it != m_transient.end()) ? it->second.get() : nullptr;
+        }
+
+        return (id < m_persistent.size()) ? m_persistent[id].get() : nullptr;
+    }
+
+    void set(std::uint32_t id, Er::PropertyInfoRef&& info)
+    {
+        if (id & Er::PropertyInfo::TransientBit)
+        {
+            m_transient.insert_or_assign(id, std::move(info));
+            return;
+        }
+
+        if (id >= m_persistent.size())
+            m_persistent.resize(id + 1);
+
+        m_persistent[id] = std::move(info);
+    }
+
+    [[nodiscard]] bool empty() const noexcept
+    {
+        return m_persistent.empty() && m_transient.empty();
+    }
+
+    void clear() noexcept
+    {
+        m_persistent.clear();
+        m_transient.clear();
+    }
+
+private:
+    std::vector<Er::PropertyInfoRef> m_persistent;
+    std::unordered_map<std::uint32_t, Er::PropertyInfoRef> m_transient;
+};
+
+
+} // namespace Erp {}
@@ -1,8 +1,13 @@
 #include <erebus/system/exception.hxx>
 #include <erebus/system/format.hxx>
+#include <erebus/system/string_pool.hxx>
 
 #include "protocol.hxx"
 
+#include <grpc/slice.h>
+
+#include <climits>
+
 namespace Erp::Protocol
 {
 
@@ -47,12 +52,53 @@ void assignPropertyDouble(erebus::Property& out, const Er::Property& in)
 
 void assignPropertyString(erebus::Property& out, const Er::Property& in)
 {
-    out.set_v_string(in.getString());
+    auto v = in.getStringView();
+    out.set_v_string(v.data(), v.size());
 }
 
 void assignPropertyBinary(erebus::Property& out, const Er::Property& in)
 {
-    out.set_v_binary(in.getBinary().bytes());
+    auto& v = in.getBinary();
+    out.set_v_binary(v.data(), v.size());
+}
+
+void assignPropertyInt32Array(erebus::Property& out, const Er::Property& in)
+{
+    auto& v = in.getInt32Array();
+    out.mutable_v_int32_array()->mutable_v()->Add(v.begin(), v.end());
+}
+
+void assignPropertyUInt32Array(erebus::Property& out, const Er::Property& in)
+{
+    auto& v = in.getUInt32Array();
+    out.mutable_v_uint32_array()->mutable_v()->Add(v.begin(), v.end());
+}
+
+void assignPropertyInt64Array(erebus::Property& out, const Er::Property& in)
+{
+    auto& v = in.getInt64Array();
+    out.mutable_v_int64_array()->mutable_v()->Add(v.begin(), v.end());
+}
+
+void assignPropertyUInt64Array(erebus::Property& out, const Er::Property& in)
+{
+    auto& v = in.getUInt64Array();
+    out.mutable_v_uint64_array()->mutable_v()->Add(v.begin(), v.end());
+}
+
+void assignPropertyDoubleArray(erebus::Property& out, const Er::Property& in)
+{
+    auto& v = in.getDoubleArray();
+    out.mutable_v_double_array()->mutable_v()->Add(v.begin(), v.end());
+}
+
+void assignPropertyMap(erebus::Property& out, const Er::Property& in)
+{
+    auto& v = in.getMap();
+    auto props = out.mutable_v_map()->mutable_v();
+    props->Reserve(static_cast<int>(v.size()));
+    for (auto& prop : v)
+        assignProperty(*props->Add(), prop);
 }
 
 Er::Property getPropertyEmpty(const erebus::Property& in, const Er::PropertyInfo* pi)
@@ -100,6 +146,128 @@ Er::Property getPropertyBinary(const erebus::Property& in, const Er::PropertyInf
     return Er::Property(Er::Binary(in.v_binary()), *pi);
 }
 
+// raw pointers let the vector copy the elements with a single memcpy
+Er::Property getPropertyInt32Array(const erebus::Property& in, const Er::PropertyInfo* pi)
+{
+    auto& v = in.v_int32_array().v();
+    return Er::Property(Er::Int32Array(v.data(), v.data() + v.size()), *pi);
+}
+
+Er::Property getPropertyUInt32Array(const erebus::Property& in, const Er::PropertyInfo* pi)
+{
+    auto& v = in.v_uint32_array().v();
+    return Er::Property(Er::UInt32Array(v.data(), v.data() + v.size()), *pi);
+}
+
+Er::Property getPropertyInt64Array(const erebus::Property& in, const Er::PropertyInfo* pi)
+{
+    auto& v = in.v_int64_array().v();
+    return Er::Property(Er::Int64Array(v.data(), v.data() + v.size()), *pi);
+}
+
+Er::Property getPropertyUInt64Array(const erebus::Property& in, const Er::PropertyInfo* pi)
+{
+    auto& v = in.v_uint64_array().v();
+    return Er::Property(Er::UInt64Array(v.data(), v.data() + v.size()), *pi);
+}
+
+Er::Property getPropertyDoubleArray(const erebus::Property& in, const Er::PropertyInfo* pi)
+{
+    auto& v = in.v_double_array().v();
+    return Er::Property(Er::DoubleArray(v.data(), v.data() + v.size()), *pi);
+}
+
+// nested properties are mapped like the top-level ones
+Er::Property getPropertyMap(const erebus::Property& in, const Er::PropertyInfo* pi, Er::IPropertyMapping* mapping, std::uint32_t context)
+{
+    auto& v = in.v_map().v();
+    Er::PropertyBag bag;
+    bag.reserve(v.size());
+    for (auto& prop : v)
+        bag.push_back(getProperty(prop, mapping, context));
+
+    return Er::Property(std::move(bag), *pi);
+}
+
+
+const Er::PropertyInfo* mapInfo(const erebus::Property& source, Er::IPropertyMapping* mapping, std::uint32_t context)
+{
+    auto info = mapping->mapProperty(source.id(), context);
+    if (!info)
+        ErThrow(Er::format("Unknown property {}", source.id()));
+
+    return info;
+}
+
+using google::protobuf::io::CodedOutputStream;
+
+constexpr std::uint32_t lengthDelimitedTag(int field) noexcept
+{
+    return (static_cast<std::uint32_t>(field) << 3) | 2;
+}
+
+constexpr std::uint32_t PropsTag = lengthDelimitedTag(erebus::ServiceReply::kPropsFieldNumber);
+constexpr std::uint32_t BinaryTag = lengthDelimitedTag(erebus::Property::kVBinaryFieldNumber);
+
+// the reply without its properties; repeated fields may come in any number of pieces
+grpc::Slice serializeReplyHead(erebus::ServiceReply& reply)
+{
+    google::protobuf::RepeatedPtrField<erebus::Property> props;
+    props.Swap(reply.mutable_props());
+
+    auto slice = ::grpc_slice_malloc(reply.ByteSizeLong());
+    reply.SerializeWithCachedSizesToArray(GRPC_SLICE_START_PTR(slice));
+
+    props.Swap(reply.mutable_props());
+    return grpc::Slice(slice, grpc::Slice::STEAL_REF);
+}
+
+// properties [from, to) with their tags and lengths, as sized by the last ByteSizeLong()
+// the bytes of an attached binary belong to the last one; only their tag and length are written here,
+// and they override the empty value in the message
+grpc::Slice serializeReplyProps(const google::protobuf::RepeatedPtrField<erebus::Property>& props, int from, int to, const Er::Binary* attached)
+{
+    auto attachedSize = attached ? static_cast<std::uint32_t>(attached->size()) : 0;
+    auto attachedHeader = attached ? CodedOutputStream::VarintSize32(BinaryTag) + CodedOutputStream::VarintSize32(attachedSize) : 0;
+
+    auto length = [&](int i)
+    {
+        auto n = static_cast<std::uint32_t>(props[i].GetCachedSize());
+        if (attached && (i == to - 1))
+            n += attachedHeader + attachedSize;
+
+        return n;
+    };
+
+    std::size_t size = attachedHeader;
+    for (int i = from; i < to; ++i)
+        size += CodedOutputStream::VarintSize32(PropsTag) + CodedOutputStream::VarintSize32(length(i)) + props[i].GetCachedSize();
+
+    auto slice = ::grpc_slice_malloc(size);
+    auto target = GRPC_SLICE_START_PTR(slice);
+    for (int i = from; i < to; ++i)
+    {
+        target = CodedOutputStream::WriteVarint32ToArray(PropsTag, target);
+        target = CodedOutputStream::WriteVarint32ToArray(length(i), target);
+        target = props[i].SerializeWithCachedSizesToArray(target);
+    }
+
+    if (attached)
+    {
+        target = CodedOutputStream::WriteVarint32ToArray(BinaryTag, target);
+        target = CodedOutputStream::WriteVarint32ToArray(attachedSize, target);
+    }
+
+    ErAssert(target == GRPC_SLICE_END_PTR(slice));
+    return grpc::Slice(slice, grpc::Slice::STEAL_REF);
+}
+
+// the slice holds a reference to the buffer of its own
+grpc::Slice attachBinary(const Er::Binary& data)
+{
+    auto keep = new Er::Binary(data);
+    return grpc::Slice(const_cast<char*>(keep->data()), keep->size(), [](void* p) { delete static_cast<Er::Binary*>(p); }, keep);
+}
 
 } // namespace {}
 
@@ -118,7 +286,13 @@ void assignProperty(erebus::Property& out, const Er::Property& source)
         &assignPropertyUInt64,
         &assignPropertyDouble,
         &assignPropertyString,
-        &assignPropertyBinary
+        &assignPropertyBinary,
+        &assignPropertyInt32Array,
+        &assignPropertyUInt32Array,
+        &assignPropertyInt64Array,
+        &assignPropertyUInt64Array,
+        &assignPropertyDoubleArray,
+        &assignPropertyMap
     };
 
     static_assert(static_cast<std::size_t>(Er::PropertyType::Empty) == 0);
@@ -130,6 +304,12 @@ void assignProperty(erebus::Property& out, const Er::Property& source)
     static_assert(static_cast<std::size_t>(Er::PropertyType::Double) == 6);
     static_assert(static_cast<std::size_t>(Er::PropertyType::String) == 7);
     static_assert(static_cast<std::size_t>(Er::PropertyType::Binary) == 8);
+    static_assert(static_cast<std::size_t>(Er::PropertyType::Int32Array) == 9);
+    static_assert(static_cast<std::size_t>(Er::PropertyType::UInt32Array) == 10);
+    static_assert(static_cast<std::size_t>(Er::PropertyType::Int64Array) == 11);
+    static_assert(static_cast<std::size_t>(Er::PropertyType::UInt64Array) == 12);
+    static_assert(static_cast<std::size_t>(Er::PropertyType::DoubleArray) == 13);
+    static_assert(static_cast<std::size_t>(Er::PropertyType::Map) == 14);
 
     out.set_id(source.unique());
 
@@ -140,9 +320,10 @@ void assignProperty(erebus::Property& out, const Er::Property& source)
 
 Er::Property getProperty(const erebus::Property& source, Er::IPropertyMapping* mapping, std::uint32_t context)
 {
-    auto info = mapping->mapProperty(source.id(), context);
-    if (!info)
-        ErThrow(Er::format("Unknown property {}", source.id()));
+    auto info = mapInfo(source, mapping, context);
+
+    if (source.value_case() == erebus::Property::kVMap)
+        return getPropertyMap(source, info, mapping, context);
 
     using GetPropertyFn = Er::Property(*)(const erebus::Property&, const Er::PropertyInfo*);
 
@@ -156,7 +337,12 @@ Er::Property getProperty(const erebus::Property& source, Er::IPropertyMapping* m
         &getPropertyUInt64,
         &getPropertyDouble,
         &getPropertyString,
-        &getPropertyBinary
+        &getPropertyBinary,
+        &getPropertyInt32Array,
+        &getPropertyUInt32Array,
+        &getPropertyInt64Array,
+        &getPropertyUInt64Array,
+        &getPropertyDoubleArray
     };
 
     static_assert(erebus::Property::kVVoid == 2);
@@ -168,6 +354,11 @@ Er::Property getProperty(const erebus::Property& source, Er::IPropertyMapping* m
     static_assert(erebus::Property::kVDouble == 8);
     static_assert(erebus::Property::kVString == 9);
     static_assert(erebus::Property::kVBinary == 10);
+    static_assert(erebus::Property::kVInt32Array == 11);
+    static_assert(erebus::Property::kVUint32Array == 12);
+    static_assert(erebus::Property::kVInt64Array == 13);
+    static_assert(erebus::Property::kVUint64Array == 14);
+    static_assert(erebus::Property::kVDoubleArray == 15);
     
     auto idx = static_cast<std::size_t>(source.value_case()) - 2;
     if (idx >= _countof(s_getPropertyFns))
@@ -176,5 +367,328 @@ Er::Property getProperty(const erebus::Property& source, Er::IPropertyMapping* m
     return std::invoke(s_getPropertyFns[idx], source, info);
 }
 
+Er::Property getProperty(erebus::Property&& source, Er::IPropertyMapping* mapping, std::uint32_t context)
+{
+    switch (source.value_case())
+    {
+    case erebus::Property::kVBinary:
+        return Er::Property(Er::Binary(std::move(*source.mutable_v_binary())), *mapInfo(source, mapping, context));
+
+    case erebus::Property::kVString:
+        return Er::Property(std::move(*source.mutable_v_string()), *mapInfo(source, mapping, context));
+
+    default:
+        break;
+    }
+
+    return getProperty(static_cast<const erebus::Property&>(source), mapping, context);
+}
+
+Er::Property getProperty(const erebus::Property& source, Er::IPropertyMapping* mapping, std::uint32_t context, std::pmr::memory_resource* resource)
+{
+    if (resource && (source.value_case() == erebus::Property::kVString))
+        return Er::Property(std::string_view(source.v_string()), *mapInfo(source, mapping, context), resource);
+
+    return getProperty(source, mapping, context);
+}
+
+void assignBatch(erebus::PropertyBatch& out, const Er::PropertyBatch& source)
+{
+    out.set_rows(static_cast<std::uint32_t>(source.rows()));
+
+    auto columns = out.mutable_columns();
+    columns->Reserve(static_cast<int>(source.columns()));
+
+    for (std::size_t i = 0; i < source.columns(); ++i)
+    {
+        auto& in = source.column(i);
+        auto column = columns->Add();
+        column->set_id(in.info->unique());
+
+        std::visit(
+            [column](auto& v)
+            {
+                using T = std::decay_t<decltype(v)>;
+                if constexpr (std::is_same_v<T, std::vector<Er::Bool>>)
+                {
+                    auto out = column->mutable_v_bool();
+                    out->Reserve(static_cast<int>(v.size()));
+                    for (auto b : v)
+                        out->AddAlreadyReserved(b == Er::True);
+                }
+                else if constexpr (std::is_same_v<T, std::vector<std::int32_t>>)
+                    column->mutable_v_int32()->Add(v.begin(), v.end());
+                else if constexpr (std::is_same_v<T, std::vector<std::uint32_t>>)
+                    column->mutable_v_uint32()->Add(v.begin(), v.end());
+                else if constexpr (std::is_same_v<T, std::vector<std::int64_t>>)
+                    column->mutable_v_int64()->Add(v.begin(), v.end());
+                else if constexpr (std::is_same_v<T, std::vector<std::uint64_t>>)
+                    column->mutable_v_uint64()->Add(v.begin(), v.end());
+                else if constexpr (std::is_same_v<T, std::vector<double>>)
+                    column->mutable_v_double()->Add(v.begin(), v.end());
+                else if constexpr (std::is_same_v<T, Er::PropertyBatch::Blobs>)
+                {
+                    column->set_v_blobs(v.data);
+
+                    auto lengths = column->mutable_v_lengths();
+                    lengths->Reserve(static_cast<int>(v.offsets.size() - 1));
+                    for (std::size_t k = 1; k < v.offsets.size(); ++k)
+                        lengths->AddAlreadyReserved(v.offsets[k] - v.offsets[k - 1]);
+                }
+            },
+            in.data);
+    }
+}
+
+Er::PropertyBatch getBatch(const erebus::PropertyBatch& source, Er::IPropertyMapping* mapping, std::uint32_t context)
+{
+    std::size_t rows = source.rows();
+
+    std::vector<Er::PropertyBatch::Column> columns;
+    columns.reserve(source.columns_size());
+
+    for (auto& in : source.columns())
+    {
+        auto info = mapping->mapProperty(in.id(), context);
+        if (!info)
+            ErThrow(Er::format("Unknown property {}", in.id()));
+
+        auto& column = columns.emplace_back();
+        column.info = info;
+
+        switch (info->type())
+        {
+        case Er::PropertyType::Empty:
+            break;
+
+        case Er::PropertyType::Bool:
+        {
+            std::vector<Er::Bool> v;
+            v.reserve(in.v_bool_size());
+            for (auto b : in.v_bool())
+                v.push_back(b ? Er::True : Er::False);
+            column.data = std::move(v);
+            break;
+        }
+
+        case Er::PropertyType::Int32:
+            column.data = std::vector<std::int32_t>(in.v_int32().begin(), in.v_int32().end());
+            break;
+
+        case Er::PropertyType::UInt32:
+            column.data = std::vector<std::uint32_t>(in.v_uint32().begin(), in.v_uint32().end());
+            break;
+
+        case Er::PropertyType::Int64:
+            column.data = std::vector<std::int64_t>(in.v_int64().begin(), in.v_int64().end());
+            break;
+
+        case Er::PropertyType::UInt64:
+            column.data = std::vector<std::uint64_t>(in.v_uint64().begin(), in.v_uint64().end());
+            break;
+
+        case Er::PropertyType::Double:
+            column.data = std::vector<double>(in.v_double().begin(), in.v_double().end());
+            break;
+
+        case Er::PropertyType::String:
+        case Er::PropertyType::Binary:
+        {
+            Er::PropertyBatch::Blobs blobs;
+            blobs.data = in.v_blobs();
+            blobs.offsets.reserve(in.v_lengths_size() + 1);
+
+            std::uint64_t offset = 0;
+            for (auto length : in.v_lengths())
+            {
+                offset += length;
+                if (offset > blobs.data.size())
+                    ErThrow(Er::format("Property batch column {} is truncated", info->name()));
+
+                blobs.offsets.push_back(static_cast<std::uint32_t>(offset));
+            }
+
+            column.data = std::move(blobs);
+            break;
+        }
+
+        default:
+            ErThrow(Er::format("Unsupported property type {}", static_cast<unsigned>(info->type())));
+        }
+    }
+
+    // validates the column sizes
+    return Er::PropertyBatch(std::move(columns), rows);
+}
+
+void StringEncoder::assignProperty(erebus::Property& out, const Er::Property& source)
+{
+    if (source.type() == Er::PropertyType::Map)
+    {
+        out.set_id(source.unique());
+
+        auto& v = source.getMap();
+        auto props = out.mutable_v_map()->mutable_v();
+        props->Reserve(static_cast<int>(v.size()));
+        for (auto& prop : v)
+            assignProperty(*props->Add(), prop);
+
+        return;
+    }
+
+    if (source.type() != Er::PropertyType::String)
+        return Protocol::assignProperty(out, source);
+
+    auto v = source.getStringView();
+    if ((v.size() < MinLength) || (v.size() > MaxLength))
+        return Protocol::assignProperty(out, source);
+
+    out.set_id(source.unique());
+
+    auto it = m_ids.find(v);
+    if (it != m_ids.end())
+    {
+        out.set_v_string_ref(it->second);
+        return;
+    }
+
+    out.set_v_string(v.data(), v.size());
+
+    if (m_ids.size() < MaxEntries)
+    {
+        auto id = static_cast<std::uint32_t>(m_ids.size() + 1);
+        m_ids.emplace(v, id);
+        out.set_stringid(id);
+    }
+}
+
+Er::Property StringDecoder::getProperty(erebus::Property&& source, Er::IPropertyMapping* mapping, std::uint32_t context)
+{
+    switch (source.value_case())
+    {
+    case erebus::Property::kVStringRef:
+    {
+        auto id = source.v_string_ref();
+        if ((id == 0) || (id > m_strings.size()))
+            ErThrow(Er::format("Unknown string reference {}", id));
+
+        return Er::Property(m_strings[id - 1], *mapInfo(source, mapping, context));
+    }
+
+    case erebus::Property::kVString:
+    {
+        auto id = source.stringid();
+        if (!id)
+            break;
+
+        if ((id != m_strings.size() + 1) || (id > StringEncoder::MaxEntries))
+            ErThrow(Er::format("Unexpected string id {}", id));
+
+        auto prop = Protocol::getProperty(std::move(source), mapping, context);
+        if (m_intern)
+            prop = Er::StringPool::intern(prop);
+
+        m_strings.push_back(prop);
+        return prop;
+    }
+
+    case erebus::Property::kVMap:
+    {
+        auto info = mapInfo(source, mapping, context);
+
+        auto v = source.mutable_v_map()->mutable_v();
+        Er::PropertyBag bag;
+        bag.reserve(v->size());
+        for (auto& prop : *v)
+            bag.push_back(getProperty(std::move(prop), mapping, context));
+
+        return Er::Property(std::move(bag), *info);
+    }
+
+    default:
+        break;
+    }
+
+    return Protocol::getProperty(std::move(source), mapping, context);
+}
+
+
+void ReplyWriter::assignProps(erebus::ServiceReply& reply, const Er::PropertyBag& props, StringEncoder* strings)
+{
+    if (props.empty())
+        return;
+
+    auto out = reply.mutable_props();
+    out->Reserve(out->size() + static_cast<int>(props.size()));
+    for (auto& prop : props)
+    {
+        auto& mutableProp = *out->Add();
+        if ((prop.type() == Er::PropertyType::Binary) && (prop.getBinary().size() >= MinAttachedSize))
+        {
+            // sent empty; serialize() puts the bytes after it
+            mutableProp.set_id(prop.unique());
+            mutableProp.mutable_v_binary();
+            m_attached.push_back(Attached{ out->size() - 1, prop.getBinary() });
+        }
+        else if (strings)
+        {
+            strings->assignProperty(mutableProp, prop);
+        }
+        else
+        {
+            assignProperty(mutableProp, prop);
+        }
+    }
+}
+
+grpc::Status ReplyWriter::serialize(erebus::ServiceReply& reply, grpc::ByteBuffer& out) const
+{
+    // a length that does not fit is rejected the same way the protobuf codec does it
+    auto tooLarge = []() { return grpc::Status(grpc::StatusCode::INTERNAL, "Protobuf serialization failed"); };
+
+    if (m_attached.empty())
+    {
+        auto size = reply.ByteSizeLong();
+        if (size > INT_MAX)
+            return tooLarge();
+
+        auto slice = ::grpc_slice_malloc(size);
+        reply.SerializeWithCachedSizesToArray(GRPC_SLICE_START_PTR(slice));
+
+        grpc::Slice single(slice, grpc::Slice::STEAL_REF);
+        grpc::ByteBuffer buffer(&single, 1);
+        out.Swap(&buffer);
+        return grpc::Status::OK;
+    }
+
+    std::vector<grpc::Slice> slices;
+    slices.reserve(2 * m_attached.size() + 2);
+    slices.push_back(serializeReplyHead(reply));
+
+    // sizes the properties, and leaves the size of the whole reply cached
+    auto size = reply.ByteSizeLong();
+    for (auto& a : m_attached)
+        size += a.data.size();
+
+    if (size > INT_MAX)
+        return tooLarge();
+
+    int from = 0;
+    for (auto& a : m_attached)
+    {
+        ErAssert((a.index >= from) && (a.index < reply.props_size()));
+        slices.push_back(serializeReplyProps(reply.props(), from, a.index + 1, &a.data));
+        slices.push_back(attachBinary(a.data));
+        from = a.index + 1;
+    }
+
+    if (from < reply.props_size())
+        slices.push_back(serializeReplyProps(reply.props(), from, reply.props_size(), nullptr));
+
+    grpc::ByteBuffer buffer(slices.data(), slices.size());
+    out.Swap(&buffer);
+    return grpc::Status::OK;
+}
+
 
-} // namespace Erp::Protocol {}
\ No newline at end of file
+} // namespace Erp::Protocol {}
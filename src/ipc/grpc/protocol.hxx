@@ -1,14 +1,344 @@
 #pragma once
 
+// the generated messages are exported with this too, so it comes before them
+#if ER_WINDOWS
+#ifdef ER_GRPC_PROTOCOL_EXPORTS
+#define ER_GRPC_PROTOCOL_EXPORT __declspec(dllexport)
+#else
+#define ER_GRPC_PROTOCOL_EXPORT __declspec(dllimport)
+#endif
+#else
+#define ER_GRPC_PROTOCOL_EXPORT __attribute__((visibility("default")))
+#endif
+
 #include <erebus/erebus.pb.h>
+#include <erebus/system/property_batch.hxx>
 #include <erebus/system/property_info.hxx>
+#include <erebus/system/property_schema.hxx>
+
+#include <grpcpp/support/byte_buffer.h>
+
+#include <array>
+#include <unordered_map>
 
 
 namespace Erp::Protocol
 {
 
-void assignProperty(erebus::Property& out, const Er::Property& source);
+// binaries are copied into the message, and the protobuf codec copies them again on the way to gRPC;
+// ReplyWriter sends long ones without copying
+ER_GRPC_PROTOCOL_EXPORT void assignProperty(erebus::Property& out, const Er::Property& source);
+
+ER_GRPC_PROTOCOL_EXPORT Er::Property getProperty(const erebus::Property& source, Er::IPropertyMapping* mapping, std::uint32_t context);
+
+// moves binaries and long strings out of the message instead of copying them
+ER_GRPC_PROTOCOL_EXPORT Er::Property getProperty(erebus::Property&& source, Er::IPropertyMapping* mapping, std::uint32_t context);
+
+// long strings are allocated from the memory resource, if there is one
+ER_GRPC_PROTOCOL_EXPORT Er::Property getProperty(const erebus::Property& source, Er::IPropertyMapping* mapping, std::uint32_t context, std::pmr::memory_resource* resource);
+
+ER_GRPC_PROTOCOL_EXPORT void assignBatch(erebus::PropertyBatch& out, const Er::PropertyBatch& source);
+
+ER_GRPC_PROTOCOL_EXPORT Er::PropertyBatch getBatch(const erebus::PropertyBatch& source, Er::IPropertyMapping* mapping, std::uint32_t context);
+
+//
+// strings repeated within one stream are sent once, with an id, and then as that id only
+// ids are given out in order, starting from 1, so the decoder can check them
+//
+
+class ER_GRPC_PROTOCOL_EXPORT StringEncoder final
+{
+public:
+    // shorter strings cost no more than a reference; longer ones rarely repeat
+    static constexpr std::size_t MinLength = 4;
+    static constexpr std::size_t MaxLength = 1024;
+    // once the dictionary is full, new strings are sent as they are
+    static constexpr std::size_t MaxEntries = 16384;
+
+    // same as Protocol::assignProperty() but for the strings, including those in nested maps
+    void assignProperty(erebus::Property& out, const Er::Property& source);
+
+    [[nodiscard]] std::size_t size() const noexcept
+    {
+        return m_ids.size();
+    }
+
+private:
+    struct Hash
+    {
+        using is_transparent = void;
+
+        std::size_t operator()(std::string_view s) const noexcept
+        {
+            return std::hash<std::string_view>{}(s);
+        }
+    };
+
+    std::unordered_map<std::string, std::uint32_t, Hash, std::equal_to<>> m_ids;
+};
+
+class ER_GRPC_PROTOCOL_EXPORT StringDecoder final
+{
+public:
+    // the strings belong to this stream and go when it does, unless they are also interned into Er::StringPool
+    explicit StringDecoder(bool intern = false) noexcept
+        : m_intern(intern)
+    {
+    }
+
+    // repeated strings share a single copy; throws on ids the encoder could not have sent
+    Er::Property getProperty(erebus::Property&& source, Er::IPropertyMapping* mapping, std::uint32_t context);
+
+    [[nodiscard]] std::size_t size() const noexcept
+    {
+        return m_strings.size();
+    }
+
+private:
+    bool m_intern;
+    std::vector<Er::Property> m_strings;
+};
+
+
+//
+// serializes a ServiceReply for gRPC without copying long binaries: their properties go into the message empty
+// and the bytes follow as slices of the Binary's own buffer, which they keep alive until gRPC has sent them
+// only top-level reply properties are sent this way; binaries in maps, exceptions and batches are copied
+//
+
+class ER_GRPC_PROTOCOL_EXPORT ReplyWriter final
+{
+public:
+    // shorter binaries cost less to copy than to hand over as slices of their own
+    static constexpr std::size_t MinAttachedSize = 16 * 1024;
+
+    // same as Protocol::assignProperty(), or StringEncoder::assignProperty(), for each of the properties,
+    // appended to those of the reply
+    void assignProps(erebus::ServiceReply& reply, const Er::PropertyBag& props, StringEncoder* strings = nullptr);
+
+    // leaves the size of the reply cached, as the protobuf codec does
+    grpc::Status serialize(erebus::ServiceReply& reply, grpc::ByteBuffer& out) const;
+
+    // for the next reply
+    void clear() noexcept
+    {
+        m_attached.clear();
+    }
+
+    [[nodiscard]] std::size_t attached() const noexcept
+    {
+        return m_attached.size();
+    }
+
+private:
+    struct Attached
+    {
+        int index;
+        Er::Binary data;
+    };
+
+    std::vector<Attached> m_attached;
+};
+
+
+//
+// records described by an Er::Schema go straight between structs and messages, without a PropertyBag in between
+//
+
+namespace Private
+{
+
+inline void setValue(erebus::Property& out, Er::Bool v) { out.set_v_bool(v == Er::True); }
+inline void setValue(erebus::Property& out, std::int32_t v) { out.set_v_int32(v); }
+inline void setValue(erebus::Property& out, std::uint32_t v) { out.set_v_uint32(v); }
+inline void setValue(erebus::Property& out, std::int64_t v) { out.set_v_int64(v); }
+inline void setValue(erebus::Property& out, std::uint64_t v) { out.set_v_uint64(v); }
+inline void setValue(erebus::Property& out, double v) { out.set_v_double(v); }
+inline void setValue(erebus::Property& out, const std::string& v) { out.set_v_string(v); }
+inline void setValue(erebus::Property& out, const Er::Binary& v) { out.set_v_binary(v.data(), v.size()); }
+inline void setValue(erebus::Property& out, const Er::Int32Array& v) { out.mutable_v_int32_array()->mutable_v()->Add(v.begin(), v.end()); }
+inline void setValue(erebus::Property& out, const Er::UInt32Array& v) { out.mutable_v_uint32_array()->mutable_v()->Add(v.begin(), v.end()); }
+inline void setValue(erebus::Property& out, const Er::Int64Array& v) { out.mutable_v_int64_array()->mutable_v()->Add(v.begin(), v.end()); }
+inline void setValue(erebus::Property& out, const Er::UInt64Array& v) { out.mutable_v_uint64_array()->mutable_v()->Add(v.begin(), v.end()); }
+inline void setValue(erebus::Property& out, const Er::DoubleArray& v) { out.mutable_v_double_array()->mutable_v()->Add(v.begin(), v.end()); }
+
+// false if the message carries a value of another type
+inline bool getValue(const erebus::Property& in, Er::Bool& v)
+{
+    if (in.value_case() != erebus::Property::kVBool)
+        return false;
+    v = in.v_bool() ? Er::True : Er::False;
+    return true;
+}
+
+inline bool getValue(const erebus::Property& in, std::int32_t& v)
+{
+    if (in.value_case() != erebus::Property::kVInt32)
+        return false;
+    v = in.v_int32();
+    return true;
+}
+
+inline bool getValue(const erebus::Property& in, std::uint32_t& v)
+{
+    if (in.value_case() != erebus::Property::kVUint32)
+        return false;
+    v = in.v_uint32();
+    return true;
+}
+
+inline bool getValue(const erebus::Property& in, std::int64_t& v)
+{
+    if (in.value_case() != erebus::Property::kVInt64)
+        return false;
+    v = in.v_int64();
+    return true;
+}
+
+inline bool getValue(const erebus::Property& in, std::uint64_t& v)
+{
+    if (in.value_case() != erebus::Property::kVUint64)
+        return false;
+    v = in.v_uint64();
+    return true;
+}
+
+inline bool getValue(const erebus::Property& in, double& v)
+{
+    if (in.value_case() != erebus::Property::kVDouble)
+        return false;
+    v = in.v_double();
+    return true;
+}
+
+inline bool getValue(const erebus::Property& in, std::string& v)
+{
+    if (in.value_case() != erebus::Property::kVString)
+        return false;
+    v = in.v_string();
+    return true;
+}
+
+inline bool getValue(const erebus::Property& in, Er::Binary& v)
+{
+    if (in.value_case() != erebus::Property::kVBinary)
+        return false;
+    v = Er::Binary(in.v_binary());
+    return true;
+}
+
+inline bool getValue(const erebus::Property& in, Er::Int32Array& v)
+{
+    if (in.value_case() != erebus::Property::kVInt32Array)
+        return false;
+    auto& a = in.v_int32_array().v();
+    v.assign(a.data(), a.data() + a.size());
+    return true;
+}
+
+inline bool getValue(const erebus::Property& in, Er::UInt32Array& v)
+{
+    if (in.value_case() != erebus::Property::kVUint32Array)
+        return false;
+    auto& a = in.v_uint32_array().v();
+    v.assign(a.data(), a.data() + a.size());
+    return true;
+}
+
+inline bool getValue(const erebus::Property& in, Er::Int64Array& v)
+{
+    if (in.value_case() != erebus::Property::kVInt64Array)
+        return false;
+    auto& a = in.v_int64_array().v();
+    v.assign(a.data(), a.data() + a.size());
+    return true;
+}
+
+inline bool getValue(const erebus::Property& in, Er::UInt64Array& v)
+{
+    if (in.value_case() != erebus::Property::kVUint64Array)
+        return false;
+    auto& a = in.v_uint64_array().v();
+    v.assign(a.data(), a.data() + a.size());
+    return true;
+}
+
+inline bool getValue(const erebus::Property& in, Er::DoubleArray& v)
+{
+    if (in.value_case() != erebus::Property::kVDoubleArray)
+        return false;
+    auto& a = in.v_double_array().v();
+    v.assign(a.data(), a.data() + a.size());
+    return true;
+}
+
+} // namespace Private {}
+
+
+template <typename Struct, typename... Fields>
+void assignStruct(google::protobuf::RepeatedPtrField<erebus::Property>& out, const Er::Schema<Struct, Fields...>& schema, const Struct& source)
+{
+    out.Reserve(out.size() + static_cast<int>(sizeof...(Fields)));
+
+    schema.forEach(
+        [&out, &source](auto& f)
+        {
+            if (auto v = f.value(source))
+            {
+                auto prop = out.Add();
+                prop->set_id(f.info->unique());
+                Private::setValue(*prop, *v);
+            }
+        });
+}
+
+// throws if a required field is missing or a field carries a value of another type
+template <typename Struct, typename... Fields>
+Struct getStruct(const google::protobuf::RepeatedPtrField<erebus::Property>& source, Er::IPropertyMapping* mapping, std::uint32_t context, const Er::Schema<Struct, Fields...>& schema)
+{
+    Struct result{};
+    std::array<bool, sizeof...(Fields)> seen = {};
+
+    for (auto& in : source)
+    {
+        auto info = mapping->mapProperty(in.id(), context);
+        if (!info)
+            ErThrow(Er::format("Unknown property {}", in.id()));
+
+        std::size_t index = 0;
+        schema.forEach(
+            [&](auto& f)
+            {
+                if (!seen[index] && (f.info->unique() == info->unique()))
+                {
+                    using F = std::decay_t<decltype(f)>;
+                    typename F::ValueType v{};
+                    if (!Private::getValue(in, v))
+                        ErThrow(Er::format("Property {} carries a value of another type", f.info->name()));
+
+                    f.get(result) = std::move(v);
+                    seen[index] = true;
+                }
+
+                ++index;
+            });
+    }
+
+    std::size_t index = 0;
+    schema.forEach(
+        [&](auto& f)
+        {
+            using F = std::decay_t<decltype(f)>;
+            if constexpr (!F::Optional)
+            {
+                if (!seen[index])
+                    ErThrow(Er::format("Property {} not found", f.info->name()));
+            }
+
+            ++index;
+        });
 
-Er::Property getProperty(const erebus::Property& source, Er::IPropertyMapping* mapping, std::uint32_t context);
+    return result;
+}
 
 } // namespace Erp::Protocol {}
\ No newline at end of file
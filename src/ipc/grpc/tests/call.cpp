@@ -188,6 +188,167 @@ TEST_F(TestCall, NormalCall)
     }
 }
 
+TEST_F(TestCall, LargeBinary)
+{
+    startServer();
+    startClient(1);
+
+    ASSERT_TRUE(putPropertyMapping(0));
+    ASSERT_TRUE(getPropertyMapping(0));
+
+    // long binaries go back as slices of the reply's own buffers; the order of the properties is kept
+    const std::string large(1024 * 1024, 'b');
+    const std::string medium(64 * 1024, 'm');
+
+    auto completion = std::make_shared<CallCompletion>();
+
+    Er::PropertyBag args;
+    args.push_back(Er::Property(Er::Binary(large), Er::Unspecified::Binary));
+    args.push_back(Er::Property(uint64_t(12), Er::Unspecified::UInt64));
+    args.push_back(Er::Property(Er::Binary(std::string("short")), Er::Unspecified::Binary));
+    args.push_back(Er::Property(Er::Binary(medium), Er::Unspecified::Binary));
+
+    m_clients.front()->call("echo", args, completion, g_callTimeout);
+
+    ASSERT_TRUE(completion->wait(g_callTimeout));
+
+    EXPECT_FALSE(completion->transportError());
+    ASSERT_TRUE(completion->reply);
+
+    auto& reply = *completion->reply;
+    ASSERT_EQ(reply.size(), 4);
+    EXPECT_EQ(reply[0].getBinary().bytes(), large);
+    EXPECT_EQ(reply[1].getUInt64(), 12);
+    EXPECT_EQ(reply[2].getBinary().bytes(), "short");
+    EXPECT_EQ(reply[3].getBinary().bytes(), medium);
+}
+
+TEST_F(TestCall, LongString)
+{
+    startServer();
+    startClient(1);
+
+    ASSERT_TRUE(putPropertyMapping(0));
+    ASSERT_TRUE(getPropertyMapping(0));
+
+    // long strings come from the call arena; the reply is made of heap copies, so the arena is empty when the call ends
+    const std::string longString(1000, 's');
+
+    for (int i = 0; i < 3; ++i)
+    {
+        auto completion = std::make_shared<CallCompletion>();
+
+        Er::PropertyBag args;
+        args.push_back(Er::Property(longString, Er::Unspecified::String));
+        args.push_back(Er::Property(std::to_string(i) + longString, Er::Unspecified::String));
+
+        m_clients.front()->call("echo", args, completion, g_callTimeout);
+
+        ASSERT_TRUE(completion->wait(g_callTimeout));
+
+        EXPECT_FALSE(completion->transportError());
+        ASSERT_TRUE(completion->reply);
+
+        auto& reply = *completion->reply;
+        ASSERT_EQ(reply.size(), 2);
+        EXPECT_EQ(reply[0].getString(), longString);
+        EXPECT_EQ(reply[1].getString(), std::to_string(i) + longString);
+    }
+}
+
+TEST_F(TestCall, TransientOutlivesClient)
+{
+    const std::string name = "Er.Test.Grpc.transient";
+
+    auto completion = std::make_shared<CallCompletion>();
+
+    {
+        auto info = Erp::allocateTransientProperty(Er::PropertyType::String, name, "Transient");
+
+        startServer();
+        startClient(1);
+
+        ASSERT_TRUE(putPropertyMapping(0));
+        ASSERT_TRUE(getPropertyMapping(0));
+
+        Er::PropertyBag args;
+        args.push_back(Er::Property(std::string("Hello"), *info.get()));
+
+        m_clients.front()->call("echo", args, completion, g_callTimeout);
+        ASSERT_TRUE(completion->wait(g_callTimeout));
+        ASSERT_TRUE(completion->reply);
+    }
+
+    stopClient();
+    stopServer();
+
+    // nobody but the reply refers to the property now
+    auto& reply = *completion->reply;
+    ASSERT_EQ(reply.size(), 1);
+    EXPECT_EQ(reply[0].info()->name(), name);
+    EXPECT_EQ(Er::lookupProperty(name), reply[0].info());
+
+    completion->reply.reset();
+    EXPECT_FALSE(Er::lookupProperty(name));
+}
+
+TEST_F(TestCall, PreparedCall)
+{
+    startServer();
+    startClient(1);
+
+    ASSERT_TRUE(putPropertyMapping(0));
+    ASSERT_TRUE(getPropertyMapping(0));
+
+    Er::PropertyBag args;
+    args.push_back(Er::Property(uint64_t(12), Er::Unspecified::UInt64));
+    args.push_back(Er::Property(std::string("Hello"), Er::Unspecified::String));
+
+    auto prepared = m_clients.front()->prepareCall("echo", args);
+    ASSERT_TRUE(prepared);
+    EXPECT_EQ(prepared->request(), "echo");
+    EXPECT_EQ(prepared->argCount(), 2);
+
+    for (uint64_t i = 0; i < 3; ++i)
+    {
+        prepared->updateArg(0, Er::Property(i, Er::Unspecified::UInt64));
+
+        auto completion = std::make_shared<CallCompletion>();
+        m_clients.front()->call(prepared, completion, g_callTimeout);
+
+        ASSERT_TRUE(completion->wait(g_callTimeout));
+
+        EXPECT_FALSE(completion->transportError());
+        EXPECT_FALSE(completion->hasServerPropertyMappingExpired());
+        EXPECT_FALSE(completion->hasClientPropertyMappingExpired());
+
+        ASSERT_TRUE(completion->reply);
+
+        auto& reply = *completion->reply;
+        ASSERT_EQ(reply.size(), 2);
+
+        {
+            auto v = Er::get<uint64_t>(reply, Er::Unspecified::UInt64);
+            ASSERT_TRUE(v);
+
+            EXPECT_EQ(*v, i);
+        }
+
+        {
+            auto v = Er::get<std::string>(reply, Er::Unspecified::String);
+            ASSERT_TRUE(v);
+
+            EXPECT_STREQ(v->c_str(), "Hello");
+        }
+    }
+
+    EXPECT_THROW(prepared->updateArg(2, Er::Property(uint64_t(0), Er::Unspecified::UInt64)), Er::Exception);
+
+    // released after its client is gone
+    stopClient();
+    prepared.reset();
+}
+
 TEST_F(TestCall, Timeout)
 {
     startServer();
@@ -214,6 +375,78 @@ TEST_F(TestCall, Timeout)
     }
 }
 
+TEST_F(TestCall, Statistics)
+{
+    startServer();
+    startClient(1);
+
+    ASSERT_TRUE(putPropertyMapping(0));
+    ASSERT_TRUE(getPropertyMapping(0));
+
+    Er::PropertyBag args;
+    args.push_back(Er::Property(uint64_t(12), Er::Unspecified::UInt64));
+
+    auto call = [this, &args](std::string_view request)
+    {
+        auto completion = std::make_shared<CallCompletion>();
+        m_clients.front()->call(request, args, completion, g_callTimeout);
+        return completion->wait(g_callTimeout * 3);
+    };
+
+    for (int i = 0; i < 3; ++i)
+        ASSERT_TRUE(call("echo"));
+
+    ASSERT_TRUE(call("throws"));
+    ASSERT_TRUE(call("slow"));
+
+    auto health = m_clients.front()->health();
+    ASSERT_EQ(health.calls.size(), 3);
+
+    auto find = [&health](std::string_view request) -> const Er::Ipc::IClient::CallStatistics*
+    {
+        for (auto& stats : health.calls)
+        {
+            if (stats.request == request)
+                return &stats;
+        }
+
+        return nullptr;
+    };
+
+    auto echo = find("echo");
+    ASSERT_TRUE(echo);
+    EXPECT_EQ(echo->succeeded, 3);
+    EXPECT_EQ(echo->failed, 0);
+    EXPECT_EQ(echo->timedOut, 0);
+    EXPECT_EQ(echo->latency.count, 3);
+
+    auto throws = find("throws");
+    ASSERT_TRUE(throws);
+    EXPECT_EQ(throws->succeeded, 0);
+    EXPECT_EQ(throws->failed, 1);
+    EXPECT_EQ(throws->latency.count, 1);
+
+    auto slow = find("slow");
+    ASSERT_TRUE(slow);
+    EXPECT_EQ(slow->succeeded, 0);
+    EXPECT_EQ(slow->timedOut, 1);
+    EXPECT_EQ(slow->latency.count, 0);
+
+    // requests beyond the limit are counted together; echo, throws and slow took 3 places
+    constexpr std::size_t Extra = 3;
+    for (std::size_t i = 0; i < Er::Ipc::IClient::MaxTrackedRequests; ++i)
+        ASSERT_TRUE(call(Er::format("unknown_{}", i)));
+
+    health = m_clients.front()->health();
+    EXPECT_EQ(health.calls.size(), Er::Ipc::IClient::MaxTrackedRequests + 1);
+
+    auto rest = find("");
+    ASSERT_TRUE(rest);
+    EXPECT_EQ(rest->failed, Extra);
+    EXPECT_TRUE(find(Er::format("unknown_{}", Er::Ipc::IClient::MaxTrackedRequests - Extra - 1)));
+    EXPECT_FALSE(find(Er::format("unknown_{}", Er::Ipc::IClient::MaxTrackedRequests - Extra)));
+}
+
 TEST_F(TestCall, NotImplemented)
 {
     startServer();
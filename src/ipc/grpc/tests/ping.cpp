@@ -107,6 +107,30 @@ TEST_F(TestPing, Ping)
             EXPECT_EQ(completions[i]->totalPayload, size);
         }
     }
+
+    // payloads too large for their contexts to be recycled
+    {
+        const long pingCount = 4;
+        const long size = 256 * 1024;
+
+        auto completions = makeCompletions(pingCount);
+
+        for (long i = 0; i < pingCount; ++i)
+        {
+            m_clients.front()->ping(size, completions[i], g_callTimeout);
+        }
+
+        for (long i = 0; i < pingCount; ++i)
+        {
+            ASSERT_TRUE(completions[i]->wait(g_callTimeout));
+        }
+
+        for (long i = 0; i < pingCount; ++i)
+        {
+            EXPECT_FALSE(completions[i]->transportError());
+            EXPECT_EQ(completions[i]->totalPayload, size);
+        }
+    }
 }
 
 TEST_F(TestPing, ConcurrentPing)
@@ -196,4 +220,39 @@ TEST_F(TestPing, ConcurrentPing)
     {
         EXPECT_TRUE(cli->check());
     }
-}
\ No newline at end of file
+}
+
+TEST_F(TestPing, HealthMonitor)
+{
+    startServer();
+    startClient(1);
+
+    auto& client = m_clients.front();
+
+    EXPECT_FALSE(client->health().monitoring);
+
+    Er::Ipc::IClient::HealthMonitorOptions options;
+    options.interval = std::chrono::milliseconds(10);
+    options.timeout = g_callTimeout;
+    client->startHealthMonitor(options);
+
+    auto deadline = std::chrono::steady_clock::now() + g_callTimeout * 2;
+    while ((client->health().pingsSucceeded < 10) && (std::chrono::steady_clock::now() < deadline))
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    client->stopHealthMonitor();
+
+    auto health = client->health();
+    EXPECT_FALSE(health.monitoring);
+    EXPECT_GE(health.pingsSucceeded, 10);
+    EXPECT_EQ(health.pingsFailed, 0);
+    EXPECT_EQ(health.pingsTimedOut, 0);
+    EXPECT_EQ(health.consecutivePingFailures, 0);
+
+    EXPECT_EQ(health.rtt.count, health.pingsSucceeded);
+    EXPECT_EQ(health.jitter.count, health.pingsSucceeded - 1);
+    EXPECT_GT(health.rtt.max.count(), 0);
+    EXPECT_LE(health.rtt.min, health.rtt.percentile(0.5));
+    EXPECT_LE(health.rtt.percentile(0.5), health.rtt.percentile(0.99));
+    EXPECT_LE(health.rtt.percentile(0.99), health.rtt.max);
+}
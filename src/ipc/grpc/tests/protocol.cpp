@@ -0,0 +1,363 @@
+#include "common.hpp"
+
+#include "../protocol.hxx"
+
+#include <erebus/system/string_pool.hxx>
+
+#include <grpcpp/support/proto_buffer_reader.h>
+
+
+namespace
+{
+
+const Er::TypedPropertyInfo<std::int32_t> Index{ "Er.Test.Grpc.Schema.index", "Index" };
+const Er::TypedPropertyInfo<std::string> Name{ "Er.Test.Grpc.Schema.name", "Name" };
+const Er::TypedPropertyInfo<Er::Binary> Data{ "Er.Test.Grpc.Schema.data", "Data" };
+const Er::TypedPropertyInfo<double> Weight{ "Er.Test.Grpc.Schema.weight", "Weight" };
+
+struct Record
+{
+    std::int32_t index = 0;
+    std::string name;
+    Er::Binary data;
+    std::optional<double> weight;
+};
+
+constexpr auto RecordSchema = Er::schema<Record>(
+    Er::field<&Record::index>(Index),
+    Er::field<&Record::name>(Name),
+    Er::field<&Record::data>(Data),
+    Er::field<&Record::weight>(Weight)
+);
+
+struct LocalMapping
+    : public Er::IPropertyMapping
+{
+    const Er::PropertyInfo* mapProperty(std::uint32_t id, std::uint32_t context) override
+    {
+        for (const Er::PropertyInfo* pi : { static_cast<const Er::PropertyInfo*>(&Index), static_cast<const Er::PropertyInfo*>(&Name), 
+            static_cast<const Er::PropertyInfo*>(&Data), static_cast<const Er::PropertyInfo*>(&Weight) })
+        {
+            if (pi->unique() == id)
+                return pi;
+        }
+
+        return nullptr;
+    }
+};
+
+} // namespace {}
+
+
+TEST(Protocol, Struct)
+{
+    Record r{ -3, "some rather long name", Er::Binary(std::string("\x01\x02\x03", 3)), std::nullopt };
+
+    erebus::ServiceReply reply;
+    Erp::Protocol::assignStruct(*reply.mutable_props(), RecordSchema, r);
+    ASSERT_EQ(reply.props_size(), 3);
+
+    // the same wire format as marshaling the bag
+    {
+        erebus::ServiceReply expected;
+        for (auto& prop : RecordSchema.toBag(r))
+            Erp::Protocol::assignProperty(*expected.add_props(), prop);
+
+        EXPECT_EQ(reply.SerializeAsString(), expected.SerializeAsString());
+    }
+
+    LocalMapping mapping;
+
+    auto s = Erp::Protocol::getStruct(reply.props(), &mapping, 0, RecordSchema);
+    EXPECT_EQ(s.index, r.index);
+    EXPECT_EQ(s.name, r.name);
+    EXPECT_EQ(s.data, r.data);
+    EXPECT_FALSE(s.weight);
+
+    r.weight = 0.25;
+    reply.Clear();
+    Erp::Protocol::assignStruct(*reply.mutable_props(), RecordSchema, r);
+    s = Erp::Protocol::getStruct(reply.props(), &mapping, 0, RecordSchema);
+    ASSERT_TRUE(s.weight);
+    EXPECT_EQ(*s.weight, 0.25);
+
+    // a field of the wrong type is malformed input, not a missing field
+    {
+        auto bad = reply;
+        bad.mutable_props(1)->set_v_int32(7);
+        EXPECT_THROW(Erp::Protocol::getStruct(bad.props(), &mapping, 0, RecordSchema), Er::Exception);
+
+        bad = reply;
+        bad.mutable_props(3)->set_v_string("0.25");
+        EXPECT_THROW(Erp::Protocol::getStruct(bad.props(), &mapping, 0, RecordSchema), Er::Exception);
+    }
+
+    // a required field is missing
+    reply.mutable_props()->DeleteSubrange(0, 1);
+    EXPECT_THROW(Erp::Protocol::getStruct(reply.props(), &mapping, 0, RecordSchema), Er::Exception);
+}
+
+TEST(Protocol, Arrays)
+{
+    struct Mapping
+        : public Er::IPropertyMapping
+    {
+        const Er::PropertyInfo* mapProperty(std::uint32_t id, std::uint32_t context) override
+        {
+            for (const Er::PropertyInfo* pi : { &Er::Unspecified::Int32Array, &Er::Unspecified::UInt64Array, &Er::Unspecified::DoubleArray })
+            {
+                if (pi->unique() == id)
+                    return pi;
+            }
+
+            return nullptr;
+        }
+    };
+
+    Mapping mapping;
+
+    for (auto& prop : {
+        Er::Property(Er::Int32Array{ -1, 0, 0x7FFFFFFF }, Er::Unspecified::Int32Array),
+        Er::Property(Er::UInt64Array{ 0xFFFFFFFFFFFFFFFFULL, 1 }, Er::Unspecified::UInt64Array),
+        Er::Property(Er::DoubleArray{ 0.5, -1.0e300 }, Er::Unspecified::DoubleArray),
+        Er::Property(Er::DoubleArray{}, Er::Unspecified::DoubleArray) })
+    {
+        erebus::Property out;
+        Erp::Protocol::assignProperty(out, prop);
+
+        erebus::Property in;
+        ASSERT_TRUE(in.ParseFromString(out.SerializeAsString()));
+
+        auto result = Erp::Protocol::getProperty(in, &mapping, 0);
+        EXPECT_EQ(result.type(), prop.type());
+        EXPECT_TRUE(result == prop);
+    }
+}
+
+TEST(Protocol, Map)
+{
+    struct Mapping
+        : public Er::IPropertyMapping
+    {
+        const Er::PropertyInfo* mapProperty(std::uint32_t id, std::uint32_t context) override
+        {
+            for (const Er::PropertyInfo* pi : { &Er::Unspecified::Map, &Er::Unspecified::UInt64, &Er::Unspecified::String })
+            {
+                if (pi->unique() == id)
+                    return pi;
+            }
+
+            return nullptr;
+        }
+    };
+
+    Er::PropertyBag threads;
+    for (std::uint64_t tid = 1; tid <= 3; ++tid)
+    {
+        Er::PropertyBag thread;
+        thread.push_back(Er::Property(tid, Er::Unspecified::UInt64));
+        thread.push_back(Er::Property(std::string("thread #") + std::to_string(tid), Er::Unspecified::String));
+        threads.push_back(Er::Property(std::move(thread), Er::Unspecified::Map));
+    }
+
+    Er::PropertyBag process;
+    process.push_back(Er::Property(std::uint64_t(42), Er::Unspecified::UInt64));
+    process.push_back(Er::Property(std::move(threads), Er::Unspecified::Map));
+    process.push_back(Er::Property(Er::PropertyBag{}, Er::Unspecified::Map));
+
+    Er::Property prop(std::move(process), Er::Unspecified::Map);
+
+    erebus::Property out;
+    Erp::Protocol::assignProperty(out, prop);
+
+    erebus::Property in;
+    ASSERT_TRUE(in.ParseFromString(out.SerializeAsString()));
+
+    Mapping mapping;
+    auto result = Erp::Protocol::getProperty(in, &mapping, 0);
+    EXPECT_TRUE(result == prop);
+    EXPECT_EQ(result.getMap()[1].getMap()[2].getMap()[1].getString(), "thread #3");
+}
+
+TEST(Protocol, ZeroCopyBinary)
+{
+    struct Mapping
+        : public Er::IPropertyMapping
+    {
+        const Er::PropertyInfo* mapProperty(std::uint32_t id, std::uint32_t context) override
+        {
+            return (id == Er::Unspecified::Binary.unique()) ? &Er::Unspecified::Binary : nullptr;
+        }
+    };
+
+    Mapping mapping;
+
+    // a consumed message gives away its bytes
+    erebus::Property in;
+    in.set_id(Er::Unspecified::Binary.unique());
+    in.set_v_binary(std::string(4096, 'z'));
+    auto data = in.v_binary().data();
+
+    auto prop = Erp::Protocol::getProperty(std::move(in), &mapping, 0);
+    EXPECT_EQ(prop.getBinary().data(), data);
+    EXPECT_EQ(prop.getBinary().size(), 4096);
+}
+
+TEST(Protocol, ReplyWriter)
+{
+    const std::string longBytes(Erp::Protocol::ReplyWriter::MinAttachedSize, 'a');
+    auto whole = Er::Binary(std::string(longBytes));
+    auto sliced = Er::Binary(std::string(longBytes) + std::string(longBytes)).slice(1, longBytes.size());
+
+    Er::PropertyBag props;
+    props.push_back(Er::Property(std::int32_t(1), Index));
+    props.push_back(Er::Property(whole, Data));
+    props.push_back(Er::Property(std::string("between"), Name));
+    props.push_back(Er::Property(Er::Binary(std::string("short")), Data));
+    props.push_back(Er::Property(sliced, Data));
+
+    erebus::ServiceReply reply;
+    reply.set_result(erebus::SUCCESS);
+    reply.set_mappingver(7);
+
+    grpc::ByteBuffer buffer;
+    {
+        Erp::Protocol::ReplyWriter writer;
+        writer.assignProps(reply, props, nullptr);
+        EXPECT_EQ(writer.attached(), 2);
+
+        ASSERT_TRUE(writer.serialize(reply, buffer).ok());
+    }
+
+    // the long binaries are slices of their own buffers, kept alive by the reply buffer
+    std::vector<grpc::Slice> slices;
+    ASSERT_TRUE(buffer.Dump(&slices).ok());
+    auto sliceOf = [&](const Er::Binary& b)
+    {
+        return std::any_of(slices.begin(), slices.end(), [&](auto& s) { return (s.begin() == reinterpret_cast<const std::uint8_t*>(b.data())) && (s.size() == b.size()); });
+    };
+
+    EXPECT_TRUE(sliceOf(whole));
+    EXPECT_TRUE(sliceOf(sliced));
+
+    whole = Er::Binary();
+    sliced = Er::Binary();
+    props.clear();
+
+    // the size is left cached for the message pools, as by the protobuf codec
+    auto cachedSize = static_cast<std::size_t>(reply.GetCachedSize());
+    EXPECT_EQ(cachedSize, reply.ByteSizeLong());
+
+    erebus::ServiceReply received;
+    grpc::ProtoBufferReader reader(&buffer);
+    ASSERT_TRUE(received.ParseFromZeroCopyStream(&reader));
+
+    EXPECT_EQ(received.result(), erebus::SUCCESS);
+    EXPECT_EQ(received.mappingver(), 7);
+    ASSERT_EQ(received.props_size(), 5);
+    EXPECT_EQ(received.props(0).v_int32(), 1);
+    EXPECT_EQ(received.props(1).v_binary(), longBytes);
+    EXPECT_EQ(received.props(2).v_string(), "between");
+    EXPECT_EQ(received.props(3).v_binary(), "short");
+    EXPECT_EQ(received.props(4).v_binary(), longBytes);
+    EXPECT_EQ(received.props(4).id(), Data.unique());
+}
+
+TEST(Protocol, MemoryResource)
+{
+    LocalMapping mapping;
+
+    erebus::Property in;
+    in.set_id(Name.unique());
+    in.set_v_string(std::string(100, 'n'));
+
+    std::array<std::byte, 1024> buffer;
+    std::pmr::monotonic_buffer_resource local(buffer.data(), buffer.size(), std::pmr::null_memory_resource());
+
+    auto prop = Erp::Protocol::getProperty(in, &mapping, 0, &local);
+    EXPECT_EQ(prop.getString(), in.v_string());
+
+    auto p = reinterpret_cast<const std::byte*>(prop.getStringView().data());
+    EXPECT_TRUE((p >= buffer.data()) && (p < buffer.data() + buffer.size()));
+
+    // without a resource the string goes to the heap as usual
+    auto heap = Erp::Protocol::getProperty(in, &mapping, 0, nullptr);
+    EXPECT_TRUE(heap == prop);
+}
+
+TEST(Protocol, StringDictionary)
+{
+    LocalMapping mapping;
+    Erp::Protocol::StringEncoder encoder;
+    Erp::Protocol::StringDecoder decoder;
+
+    const std::string path("/usr/lib/systemd/systemd-journald");
+    auto pooled = Er::StringPool::size();
+
+    std::vector<Er::PropertyBag> frames;
+    std::size_t plainBytes = 0;
+    std::size_t encodedBytes = 0;
+    for (std::int32_t i = 0; i < 10; ++i)
+    {
+        Er::PropertyBag bag{ Er::Property(i, Index), Er::Property(path, Name), Er::Property(std::string("ok"), Name) };
+
+        erebus::ServiceReply plain;
+        erebus::ServiceReply encoded;
+        for (auto& prop : bag)
+        {
+            Erp::Protocol::assignProperty(*plain.add_props(), prop);
+            encoder.assignProperty(*encoded.add_props(), prop);
+        }
+
+        plainBytes += plain.ByteSizeLong();
+        encodedBytes += encoded.ByteSizeLong();
+
+        // the first occurrence defines the string, the rest reference it; short strings are sent as they are
+        EXPECT_EQ(encoded.props(1).value_case(), (i == 0) ? erebus::Property::kVString : erebus::Property::kVStringRef);
+        EXPECT_EQ(encoded.props(2).value_case(), erebus::Property::kVString);
+
+        Er::PropertyBag back;
+        for (auto& prop : *encoded.mutable_props())
+            back.push_back(decoder.getProperty(std::move(prop), &mapping, 0));
+
+        EXPECT_EQ(back, bag);
+        frames.push_back(std::move(back));
+    }
+
+    EXPECT_EQ(encoder.size(), 1);
+    EXPECT_EQ(decoder.size(), 1);
+    EXPECT_LT(encodedBytes * 2, plainBytes);
+
+    // all the frames share a single copy
+    for (auto& frame : frames)
+    {
+        EXPECT_EQ(frame[1].info(), &Name);
+        EXPECT_EQ(frame[1].getStringView().data(), frames[0][1].getStringView().data());
+    }
+
+    // the strings stay with the stream unless the decoder is asked to intern them
+    EXPECT_EQ(Er::StringPool::size(), pooled);
+    {
+        Erp::Protocol::StringEncoder otherEncoder;
+        Erp::Protocol::StringDecoder interning(true);
+
+        erebus::Property out;
+        otherEncoder.assignProperty(out, Er::Property(path, Name));
+        auto prop = interning.getProperty(std::move(out), &mapping, 0);
+        EXPECT_EQ(prop.getStringView().data(), Er::StringPool::intern(path, Name).getStringView().data());
+    }
+
+    // references to strings never sent
+    erebus::Property bad;
+    bad.set_id(Name.unique());
+    bad.set_v_string_ref(2);
+    EXPECT_THROW(decoder.getProperty(erebus::Property(bad), &mapping, 0), Er::Exception);
+
+    bad.set_v_string(path);
+    bad.set_stringid(5);
+    EXPECT_THROW(decoder.getProperty(erebus::Property(bad), &mapping, 0), Er::Exception);
+
+    // a plain decoder does not know about references
+    bad.set_v_string_ref(1);
+    EXPECT_THROW(Erp::Protocol::getProperty(bad, &mapping, 0), Er::Exception);
+}
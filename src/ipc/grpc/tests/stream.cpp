@@ -24,6 +24,7 @@ public:
     void registerService(Er::Ipc::IServer* container) override
     {
         container->registerService("simple_stream", shared_from_this());
+        container->registerService("batch_stream", shared_from_this());
     }
 
     void unregisterService(Er::Ipc::IServer* container) override
@@ -39,7 +40,9 @@ public:
     StreamId beginStream(std::string_view request, std::uint32_t clientId, const Er::PropertyBag& args) override
     {
         if (request == "simple_stream")
-            return simpleStream(clientId, args);
+            return simpleStream(clientId, args, false);
+        else if (request == "batch_stream")
+            return simpleStream(clientId, args, true);
 
         ErThrow(Er::format("Unsupported request {}", request));
     }
@@ -69,6 +72,33 @@ public:
         return {};
     }
 
+    bool nextBatch(StreamId id, Er::PropertyBatch& batch) override
+    {
+        auto* s = findStream(id);
+        ErAssert(s);
+
+        if (s->type != SimpleStream::Type)
+            return false;
+
+        auto stream = static_cast<SimpleStream*>(s);
+        if (!stream->batched)
+            return false;
+
+        for (std::size_t i = 0; i < BatchSize; ++i)
+        {
+            auto bag = nextSimpleStream(stream);
+            if (bag.empty())
+                break;
+
+            if (!batch.append(bag))
+                ErThrow("Frame does not match the batch schema");
+        }
+
+        return true;
+    }
+
+    static constexpr std::size_t BatchSize = 4;
+
 private:
     struct StreamBase
     {
@@ -93,12 +123,14 @@ private:
         std::int32_t throwInFrame;
         std::int32_t frameCount;
         std::int32_t nextFrame = 0;
+        bool batched;
 
-        SimpleStream(StreamId id, const Er::PropertyBag& args, std::int32_t throwInFrame, std::int32_t frameCount)
+        SimpleStream(StreamId id, const Er::PropertyBag& args, std::int32_t throwInFrame, std::int32_t frameCount, bool batched)
             : StreamBase(Type, id)
             , throwInFrame(throwInFrame)
             , frameCount(frameCount)
             , args(args)
+            , batched(batched)
         {
         }
     };
@@ -133,7 +165,7 @@ private:
         }
     }
 
-    StreamId simpleStream(std::uint32_t clientId, const Er::PropertyBag& args)
+    StreamId simpleStream(std::uint32_t clientId, const Er::PropertyBag& args, bool batched)
     {
         auto fc = Er::get<std::int32_t>(args, ReplyFrameCount);
         if (!fc)
@@ -149,7 +181,7 @@ private:
         std::unique_lock l(m_mutex);
 
         auto id = m_nextStreamId++;
-        auto stream = std::make_unique<SimpleStream>(id, args, *tf, *fc);
+        auto stream = std::make_unique<SimpleStream>(id, args, *tf, *fc, batched);
         m_streams.insert({ id, std::move(stream) });
 
         ErLogDebug("Began SimpleStream {}", id);
@@ -264,6 +296,66 @@ struct StreamCompletion
     std::vector<Er::Exception> exceptions;
 };
 
+struct CountingStreamCompletion
+    : public CompletionBase<Er::Ipc::IClient::IStreamCompletion>
+{
+    Er::CallbackResult onFrame(Er::PropertyBag&& frame) override
+    {
+        receivedFrames.fetch_add(1, std::memory_order_release);
+        return Er::CallbackResult::Continue;
+    }
+
+    void onException(Er::Exception&& exception) override
+    {
+        receivedExceptions.fetch_add(1, std::memory_order_release);
+    }
+
+    bool waitFrames(std::uint32_t count, std::chrono::milliseconds timeout)
+    {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (receivedFrames.load(std::memory_order_acquire) < count)
+        {
+            if (std::chrono::steady_clock::now() > deadline)
+                return false;
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        return true;
+    }
+
+    std::atomic<std::uint32_t> receivedFrames = 0;
+    std::atomic<std::uint32_t> receivedExceptions = 0;
+};
+
+struct BatchStreamCompletion
+    : public CompletionBase<Er::Ipc::IClient::IStreamCompletion>
+{
+    Er::CallbackResult onFrame(Er::PropertyBag&& frame) override
+    {
+        ++receivedFrames;
+        return Er::CallbackResult::Continue;
+    }
+
+    Er::CallbackResult onBatch(Er::PropertyBatch&& batch) override
+    {
+        ++receivedBatches;
+        receivedFrames += static_cast<std::uint32_t>(batch.rows());
+        batches.push_back(std::move(batch));
+        return Er::CallbackResult::Continue;
+    }
+
+    void onException(Er::Exception&& exception) override
+    {
+        ++receivedExceptions;
+    }
+
+    std::uint32_t receivedBatches = 0;
+    std::uint32_t receivedFrames = 0;
+    std::uint32_t receivedExceptions = 0;
+    std::vector<Er::PropertyBatch> batches;
+};
+
 } // namespace {}
 
 
@@ -590,6 +682,182 @@ TEST_F(TestStream, Cancel)
     }
 }
 
+TEST_F(TestStream, FlowControl)
+{
+    startServer();
+    startClient(1);
+
+    ASSERT_TRUE(putPropertyMapping(0));
+    ASSERT_TRUE(getPropertyMapping(0));
+
+    const std::int32_t frameCount = 10;
+
+    Er::PropertyBag args;
+    args.push_back(Er::Property(int32_t(frameCount), ReplyFrameCount));
+    args.push_back(Er::Property(int32_t(ThrowNever), ThrowInFrame));
+
+    // frames are delivered only as long as there are credits
+    {
+        auto completion = std::make_shared<CountingStreamCompletion>();
+
+        auto control = m_clients.front()->stream("simple_stream", args, completion, Er::Ipc::IClient::StreamOptions(3));
+        ASSERT_TRUE(control);
+
+        ASSERT_TRUE(completion->waitFrames(3, g_streamTimeout));
+        EXPECT_FALSE(completion->wait(std::chrono::milliseconds(200)));
+        EXPECT_EQ(completion->receivedFrames, 3);
+
+        control->grant(4);
+        ASSERT_TRUE(completion->waitFrames(7, g_streamTimeout));
+        EXPECT_FALSE(completion->wait(std::chrono::milliseconds(200)));
+        EXPECT_EQ(completion->receivedFrames, 7);
+
+        control->grant(frameCount);
+        ASSERT_TRUE(completion->wait(g_streamTimeout));
+
+        EXPECT_FALSE(completion->transportError());
+        EXPECT_EQ(completion->receivedFrames, frameCount);
+        EXPECT_EQ(completion->receivedExceptions, 0);
+    }
+
+    // a paused stream can be canceled
+    {
+        auto completion = std::make_shared<CountingStreamCompletion>();
+
+        auto control = m_clients.front()->stream("simple_stream", args, completion, Er::Ipc::IClient::StreamOptions(2));
+        ASSERT_TRUE(control);
+
+        ASSERT_TRUE(completion->waitFrames(2, g_streamTimeout));
+
+        control->cancel();
+        ASSERT_TRUE(completion->wait(g_streamTimeout));
+
+        ASSERT_TRUE(completion->transportError());
+        EXPECT_EQ(*completion->transportError(), Er::Result::Canceled);
+        EXPECT_LT(completion->receivedFrames, frameCount);
+    }
+
+    // dropping the control lets the rest of the stream through
+    {
+        auto completion = std::make_shared<CountingStreamCompletion>();
+
+        {
+            auto control = m_clients.front()->stream("simple_stream", args, completion, Er::Ipc::IClient::StreamOptions(1));
+            ASSERT_TRUE(completion->waitFrames(1, g_streamTimeout));
+        }
+
+        ASSERT_TRUE(completion->wait(g_streamTimeout));
+
+        EXPECT_FALSE(completion->transportError());
+        EXPECT_EQ(completion->receivedFrames, frameCount);
+    }
+
+    // a paused stream does not keep the client from going away, and its control outlives it
+    {
+        auto completion = std::make_shared<CountingStreamCompletion>();
+
+        auto control = m_clients.front()->stream("simple_stream", args, completion, Er::Ipc::IClient::StreamOptions(1));
+        ASSERT_TRUE(completion->waitFrames(1, g_streamTimeout));
+
+        stopClient();
+        ASSERT_TRUE(completion->wait(g_streamTimeout));
+
+        ASSERT_TRUE(completion->transportError());
+        EXPECT_EQ(*completion->transportError(), Er::Result::Canceled);
+
+        control->grant(1);
+        control->cancel();
+    }
+}
+
+TEST_F(TestStream, StringDictionary)
+{
+    startServer();
+    startClient(1);
+
+    ASSERT_TRUE(putPropertyMapping(0));
+    ASSERT_TRUE(getPropertyMapping(0));
+
+    const std::uint32_t frameCount = 10;
+    const std::string path("/usr/lib/systemd/systemd-journald");
+
+    Er::PropertyBag args;
+    args.push_back(Er::Property(path, Er::Unspecified::String));
+    args.push_back(Er::Property(int32_t(frameCount), ReplyFrameCount));
+    args.push_back(Er::Property(int32_t(ThrowNever), ThrowInFrame));
+
+    auto completion = std::make_shared<StreamCompletion>(frameCount);
+
+    Er::Ipc::IClient::StreamOptions options;
+    options.stringDictionary = true;
+    m_clients.front()->stream("simple_stream", args, completion, options);
+
+    ASSERT_TRUE(completion->wait(g_streamTimeout));
+
+    EXPECT_FALSE(completion->transportError());
+    EXPECT_EQ(completion->receivedFrames, frameCount);
+    EXPECT_EQ(completion->receivedExceptions, 0);
+
+    for (std::uint32_t i = 0; i < frameCount; ++i)
+    {
+        auto& props = completion->frames[i];
+        ASSERT_EQ(props.size(), 4);
+
+        auto rfi = Er::get<std::int32_t>(props, ReplyFrameIndex);
+        ASSERT_TRUE(!!rfi);
+        EXPECT_EQ(*rfi, i);
+
+        // every frame references the string received with the first one
+        auto s = Er::find(props, Er::Unspecified::String);
+        ASSERT_TRUE(s);
+        EXPECT_EQ(s->getString(), path);
+        EXPECT_EQ(s->getStringView().data(), Er::find(completion->frames[0], Er::Unspecified::String)->getStringView().data());
+    }
+}
+
+TEST_F(TestStream, LargeFrames)
+{
+    startServer();
+    startClient(1);
+
+    ASSERT_TRUE(putPropertyMapping(0));
+    ASSERT_TRUE(getPropertyMapping(0));
+
+    const std::uint32_t frameCount = 3;
+
+    // frames too big for their reply message to go back to the pool, then small ones reusing it
+    for (auto size : { std::size_t(1024 * 1024), std::size_t(16) })
+    {
+        const std::string payload(size, 'x');
+
+        Er::PropertyBag args;
+        args.push_back(Er::Property(payload, Er::Unspecified::String));
+        args.push_back(Er::Property(Er::Binary(payload), Er::Unspecified::Binary));
+        args.push_back(Er::Property(int32_t(frameCount), ReplyFrameCount));
+        args.push_back(Er::Property(int32_t(ThrowNever), ThrowInFrame));
+
+        auto completion = std::make_shared<StreamCompletion>(frameCount);
+        m_clients.front()->stream("simple_stream", args, completion);
+
+        ASSERT_TRUE(completion->wait(g_streamTimeout));
+
+        EXPECT_FALSE(completion->transportError());
+        EXPECT_EQ(completion->receivedFrames, frameCount);
+        EXPECT_EQ(completion->receivedExceptions, 0);
+
+        for (std::uint32_t i = 0; i < frameCount; ++i)
+        {
+            auto s = Er::find(completion->frames[i], Er::Unspecified::String);
+            ASSERT_TRUE(s);
+            EXPECT_EQ(s->getStringView().size(), size);
+
+            // a long one goes out as a slice of the service's buffer
+            auto b = Er::find(completion->frames[i], Er::Unspecified::Binary);
+            ASSERT_TRUE(b);
+            EXPECT_EQ(b->getBinary().bytes(), payload);
+        }
+    }
+}
 
 TEST_F(TestStream, ConcurrentStreams)
 {
@@ -775,4 +1043,83 @@ TEST_F(TestStream, ConcurrentStreams)
     {
         ASSERT_TRUE(clients[i]->check());
     }
-}
\ No newline at end of file
+}
+
+TEST_F(TestStream, Batch)
+{
+    startServer();
+    startClient(1);
+
+    ASSERT_TRUE(putPropertyMapping(0));
+    ASSERT_TRUE(getPropertyMapping(0));
+
+    const std::uint32_t frameCount = 10;
+
+    Er::PropertyBag args;
+    args.push_back(Er::Property(int64_t(-12), Er::Unspecified::Int64));
+    args.push_back(Er::Property(std::string("Bye"), Er::Unspecified::String));
+    args.push_back(Er::Property(int32_t(frameCount), ReplyFrameCount));
+    args.push_back(Er::Property(int32_t(ThrowNever), ThrowInFrame));
+
+    // batches arrive as such
+    {
+        auto completion = std::make_shared<BatchStreamCompletion>();
+
+        m_clients.front()->stream("batch_stream", args, completion);
+
+        ASSERT_TRUE(completion->wait(g_streamTimeout));
+
+        EXPECT_FALSE(completion->transportError());
+        EXPECT_EQ(completion->receivedExceptions, 0);
+        EXPECT_EQ(completion->receivedFrames, frameCount);
+        EXPECT_EQ(completion->receivedBatches, (frameCount + TestService::BatchSize - 1) / TestService::BatchSize);
+
+        std::int32_t index = 0;
+        for (auto& batch : completion->batches)
+        {
+            EXPECT_EQ(batch.columns(), 5);
+
+            for (std::size_t row = 0; row < batch.rows(); ++row, ++index)
+            {
+                auto rfi = batch[row].find(ReplyFrameIndex);
+                ASSERT_TRUE(rfi);
+                EXPECT_EQ(rfi->getInt32(), index);
+
+                auto s = batch[row].find(Er::Unspecified::String);
+                ASSERT_TRUE(s);
+                EXPECT_EQ(s->getString(), "Bye");
+            }
+        }
+    }
+
+    // handlers that know nothing about batches get them frame by frame
+    {
+        auto completion = std::make_shared<StreamCompletion>(frameCount);
+
+        m_clients.front()->stream("batch_stream", args, completion);
+
+        ASSERT_TRUE(completion->wait(g_streamTimeout));
+
+        EXPECT_FALSE(completion->transportError());
+        EXPECT_EQ(completion->receivedFrames, frameCount);
+        EXPECT_EQ(completion->receivedExceptions, 0);
+
+        for (std::uint32_t i = 0; i < frameCount; ++i)
+        {
+            auto& props = completion->frames[i];
+            EXPECT_EQ(props.size(), 5);
+
+            auto rfi = Er::get<std::int32_t>(props, ReplyFrameIndex);
+            ASSERT_TRUE(!!rfi);
+            EXPECT_EQ(*rfi, i);
+
+            auto i64 = Er::get<std::int64_t>(props, Er::Unspecified::Int64);
+            ASSERT_TRUE(!!i64);
+            EXPECT_EQ(*i64, -12);
+
+            auto s = Er::get<std::string>(props, Er::Unspecified::String);
+            ASSERT_TRUE(!!s);
+            EXPECT_STREQ(s->c_str(), "Bye");
+        }
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+
+#include <erebus/system/property_bag.hxx>
+
+#include <atomic>
+
+
+// heap traffic of the whole process
+// counted by the global operator new/delete replacements in main.cpp
+struct AllocationCounters
+{
+    static std::atomic<std::uint64_t> allocations;
+    static std::atomic<std::uint64_t> frees;
+
+    AllocationCounters() noexcept
+        : m_allocations(allocations.load(std::memory_order_relaxed))
+        , m_frees(frees.load(std::memory_order_relaxed))
+    {
+    }
+
+    void report(benchmark::State& state) const
+    {
+        auto a = allocations.load(std::memory_order_relaxed) - m_allocations;
+        auto f = frees.load(std::memory_order_relaxed) - m_frees;
+
+        state.counters["allocs"] = benchmark::Counter(double(a), benchmark::Counter::kAvgIterations);
+        state.counters["frees"] = benchmark::Counter(double(f), benchmark::Counter::kAvgIterations);
+    }
+
+private:
+    std::uint64_t m_allocations;
+    std::uint64_t m_frees;
+};
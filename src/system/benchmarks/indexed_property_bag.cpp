@@ -0,0 +1,101 @@
+#include "common.hpp"
+
+#include <erebus/system/format.hxx>
+#include <erebus/system/indexed_property_bag.hxx>
+
+#include <memory>
+
+
+namespace
+{
+
+// a wide record of which a service reads a handful of fields
+constexpr std::size_t BagSize = 100;
+constexpr std::size_t FieldsRead = 16;
+
+const std::vector<std::unique_ptr<Er::PropertyInfo>>& infos()
+{
+    static std::vector<std::unique_ptr<Er::PropertyInfo>> infos = []()
+    {
+        std::vector<std::unique_ptr<Er::PropertyInfo>> v;
+        v.reserve(BagSize);
+        for (std::size_t i = 0; i < BagSize; ++i)
+        {
+            auto name = Er::format("Er.Benchmark.Indexed.{}", i);
+            v.push_back(std::make_unique<Er::PropertyInfo>(Er::PropertyType::UInt64, name, name));
+        }
+
+        return v;
+    }();
+
+    return infos;
+}
+
+Er::PropertyBag makeBag()
+{
+    Er::PropertyBag bag;
+    bag.reserve(BagSize);
+    for (std::size_t i = 0; i < BagSize; ++i)
+        bag.push_back(Er::Property(std::uint64_t(i), *infos()[i]));
+
+    return bag;
+}
+
+// fields spread over the whole record
+const Er::PropertyInfo& field(std::size_t i)
+{
+    return *infos()[(i * 37) % BagSize];
+}
+
+
+void PropertyBag_Get(benchmark::State& state)
+{
+    auto bag = makeBag();
+
+    for (auto _ : state)
+    {
+        std::uint64_t sum = 0;
+        for (std::size_t i = 0; i < FieldsRead; ++i)
+            sum += *Er::get<std::uint64_t>(bag, field(i));
+
+        benchmark::DoNotOptimize(sum);
+    }
+}
+
+void IndexedPropertyBag_Get(benchmark::State& state)
+{
+    Er::IndexedPropertyBag bag(makeBag());
+
+    for (auto _ : state)
+    {
+        std::uint64_t sum = 0;
+        for (std::size_t i = 0; i < FieldsRead; ++i)
+            sum += *Er::get<std::uint64_t>(bag, field(i));
+
+        benchmark::DoNotOptimize(sum);
+    }
+}
+
+// what it costs to index a bag before reading from it; includes copying the bag
+void IndexedPropertyBag_BuildAndGet(benchmark::State& state)
+{
+    auto source = makeBag();
+
+    for (auto _ : state)
+    {
+        Er::IndexedPropertyBag indexed(source);
+
+        std::uint64_t sum = 0;
+        for (std::size_t i = 0; i < FieldsRead; ++i)
+            sum += *Er::get<std::uint64_t>(indexed, field(i));
+
+        benchmark::DoNotOptimize(sum);
+    }
+}
+
+} // namespace {}
+
+
+BENCHMARK(PropertyBag_Get);
+BENCHMARK(IndexedPropertyBag_Get);
+BENCHMARK(IndexedPropertyBag_BuildAndGet);
@@ -0,0 +1,133 @@
+#include "common.hpp"
+
+#include <erebus/system/logger2.hxx>
+#include <erebus/system/logger/simple_formatter2.hxx>
+
+
+namespace
+{
+
+struct NullSink
+    : public Er::Log2::ISink
+{
+    void write(Er::Log2::Record::Ptr r) override
+    {
+        benchmark::DoNotOptimize(r.get());
+    }
+
+    void flush() override
+    {
+    }
+};
+
+Er::Log2::ILogger* logger()
+{
+    static auto s_logger = []()
+    {
+        auto log = Er::Log2::makeLogger();
+        log->addSink("null", std::make_shared<NullSink>());
+        return log;
+    }();
+
+    return s_logger.get();
+}
+
+// producers on different threads should not slow each other down
+// flushing keeps the records from piling up somewhere beyond the timed loop
+void Logger_Write(benchmark::State& state)
+{
+    constexpr std::size_t Batch = 256;
+
+    auto log = logger();
+    auto tid = Er::System::CurrentThread::id();
+
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < Batch; ++i)
+            log->write(Er::Log2::Record::make(Er::Log2::Level::Info, Er::System::PackedTime::now(), tid, std::string_view("benchmark record")));
+
+        log->flush();
+    }
+
+    state.SetItemsProcessed(state.iterations() * Batch);
+}
+
+// the cost on the calling thread for a burst that fits into its ring
+// the Logger thread formats the deferred ones afterwards
+void Logger_Format(benchmark::State& state)
+{
+    constexpr std::size_t Batch = 256;
+
+    auto log = logger();
+    std::uint64_t n = 0;
+    AllocationCounters counters;
+
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < Batch; ++i)
+            Er::Log2::info(log, "Process {} [{}] started at {:#x}", ++n, "/usr/bin/erebus-server", 0xdeadbeefull);
+
+        state.PauseTiming();
+        log->flush();
+        state.ResumeTiming();
+    }
+
+    counters.report(state);
+    state.SetItemsProcessed(state.iterations() * Batch);
+}
+
+void Logger_FormatDeferred(benchmark::State& state)
+{
+    constexpr std::size_t Batch = 256;
+
+    auto log = logger();
+    std::uint64_t n = 0;
+    AllocationCounters counters;
+
+    for (auto _ : state)
+    {
+        for (std::size_t i = 0; i < Batch; ++i)
+            Er::Log2::writeDeferred(log, Er::Log2::Level::Info, "Process {} [{}] started at {:#x}", ++n, "/usr/bin/erebus-server", 0xdeadbeefull);
+
+        state.PauseTiming();
+        log->flush();
+        state.ResumeTiming();
+    }
+
+    counters.report(state);
+    state.SetItemsProcessed(state.iterations() * Batch);
+}
+
+// records per second a sink can format on one core
+void SimpleFormatter_Format(benchmark::State& state)
+{
+    auto formatter = Er::Log2::SimpleFormatter::make();
+
+    // a few records a millisecond, so the seconds change now and then
+    std::vector<Er::Log2::Record::Ptr> records;
+    auto time = Er::System::PackedTime::now();
+    for (std::size_t i = 0; i < 1024; ++i)
+    {
+        time += 337;
+        records.push_back(Er::Log2::Record::make("benchmark", Er::Log2::Level::Info, time, 123456, Er::format("Process {} [/usr/bin/erebus-server] started", i)));
+    }
+
+    Er::FormatBuffer buffer;
+    std::size_t i = 0;
+    for (auto _ : state)
+    {
+        buffer.clear();
+        formatter->formatTo(records[i++ % records.size()].get(), buffer);
+        benchmark::DoNotOptimize(buffer.data());
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+} // namespace {}
+
+
+BENCHMARK(Logger_Write)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(Logger_Format);
+BENCHMARK(Logger_FormatDeferred);
+BENCHMARK(SimpleFormatter_Format);
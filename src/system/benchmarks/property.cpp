@@ -0,0 +1,282 @@
+#include "common.hpp"
+
+#include <erebus/system/string_pool.hxx>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+
+// a bag resembling a typical process snapshot: half numbers, half strings of the given length
+std::vector<std::string> makeStrings(std::size_t count, std::size_t length)
+{
+    std::vector<std::string> strings;
+    strings.reserve(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        auto s = std::to_string(i);
+        s.resize(length, 'x');
+        strings.push_back(std::move(s));
+    }
+
+    return strings;
+}
+
+constexpr std::size_t BagSize = 16;
+
+Er::PropertyBag makeBag(const std::vector<std::string>& strings)
+{
+    Er::PropertyBag bag;
+    bag.reserve(BagSize);
+    for (std::size_t i = 0; i < BagSize / 2; ++i)
+    {
+        bag.push_back(Er::Property(std::uint64_t(i), Er::Unspecified::UInt64));
+        bag.push_back(Er::Property(strings[i], Er::Unspecified::String));
+    }
+
+    return bag;
+}
+
+
+void PropertyBag_Make(benchmark::State& state)
+{
+    auto strings = makeStrings(BagSize / 2, static_cast<std::size_t>(state.range(0)));
+
+    AllocationCounters counters;
+
+    for (auto _ : state)
+    {
+        auto bag = makeBag(strings);
+        benchmark::DoNotOptimize(bag.data());
+    }
+
+    counters.report(state);
+}
+
+void PropertyBag_Copy(benchmark::State& state)
+{
+    auto strings = makeStrings(BagSize / 2, static_cast<std::size_t>(state.range(0)));
+    auto source = makeBag(strings);
+
+    AllocationCounters counters;
+
+    for (auto _ : state)
+    {
+        Er::PropertyBag bag(source);
+        benchmark::DoNotOptimize(bag.data());
+    }
+
+    counters.report(state);
+}
+
+void PropertyBag_Compare(benchmark::State& state)
+{
+    auto strings = makeStrings(BagSize / 2, static_cast<std::size_t>(state.range(0)));
+    auto a = makeBag(strings);
+    auto b = makeBag(strings);
+
+    for (auto _ : state)
+    {
+        bool eq = (a == b);
+        benchmark::DoNotOptimize(eq);
+    }
+}
+
+// equal strings are different nodes in a and b unless they are interned
+void PropertyBag_CompareInterned(benchmark::State& state)
+{
+    auto strings = makeStrings(BagSize / 2, static_cast<std::size_t>(state.range(0)));
+    auto a = makeBag(strings);
+    auto b = makeBag(strings);
+    for (auto bag : { &a, &b })
+    {
+        for (auto& prop : *bag)
+            prop = Er::StringPool::intern(prop);
+    }
+
+    for (auto _ : state)
+    {
+        bool eq = (a == b);
+        benchmark::DoNotOptimize(eq);
+    }
+}
+
+// a cache of 1024 records with a handful of distinct long values, e.g. executable paths
+constexpr std::size_t CacheRecords = 1024;
+constexpr std::size_t CacheValues = 16;
+
+void String_Cache(benchmark::State& state)
+{
+    auto strings = makeStrings(CacheValues, static_cast<std::size_t>(state.range(0)));
+
+    AllocationCounters counters;
+
+    for (auto _ : state)
+    {
+        std::vector<Er::Property> cache;
+        cache.reserve(CacheRecords);
+        for (std::size_t i = 0; i < CacheRecords; ++i)
+            cache.push_back(Er::Property(strings[i % CacheValues], Er::Unspecified::String));
+
+        benchmark::DoNotOptimize(cache.data());
+    }
+
+    counters.report(state);
+}
+
+void String_CacheInterned(benchmark::State& state)
+{
+    auto strings = makeStrings(CacheValues, static_cast<std::size_t>(state.range(0)));
+
+    AllocationCounters counters;
+
+    for (auto _ : state)
+    {
+        std::vector<Er::Property> cache;
+        cache.reserve(CacheRecords);
+        for (std::size_t i = 0; i < CacheRecords; ++i)
+            cache.push_back(Er::StringPool::intern(strings[i % CacheValues], Er::Unspecified::String));
+
+        benchmark::DoNotOptimize(cache.data());
+    }
+
+    counters.report(state);
+}
+
+// element hashes are cached after the first iteration, as they are for long-lived bags
+void PropertyBag_Hash(benchmark::State& state)
+{
+    auto strings = makeStrings(BagSize / 2, static_cast<std::size_t>(state.range(0)));
+    auto bag = makeBag(strings);
+
+    for (auto _ : state)
+    {
+        auto h = Er::hash(bag);
+        benchmark::DoNotOptimize(h);
+    }
+}
+
+// binaries that differ in the last byte only
+void Binary_CompareUnequal(benchmark::State& state)
+{
+    auto size = static_cast<std::size_t>(state.range(0));
+    Er::Property a(Er::Binary(std::string(size, 'b')), Er::Unspecified::Binary);
+    Er::Property b(Er::Binary(std::string(size - 1, 'b') + 'c'), Er::Unspecified::Binary);
+
+    for (auto _ : state)
+    {
+        bool eq = (a == b);
+        benchmark::DoNotOptimize(eq);
+    }
+}
+
+// the same once both hashes are cached
+void Binary_CompareUnequalHashed(benchmark::State& state)
+{
+    auto size = static_cast<std::size_t>(state.range(0));
+    Er::Property a(Er::Binary(std::string(size, 'b')), Er::Unspecified::Binary);
+    Er::Property b(Er::Binary(std::string(size - 1, 'b') + 'c'), Er::Unspecified::Binary);
+    benchmark::DoNotOptimize(a.hash() + b.hash());
+
+    for (auto _ : state)
+    {
+        bool eq = (a == b);
+        benchmark::DoNotOptimize(eq);
+    }
+}
+
+// formatting a bag one string at a time, the way it was done before formatTo()
+void PropertyBag_FormatStr(benchmark::State& state)
+{
+    auto strings = makeStrings(BagSize / 2, static_cast<std::size_t>(state.range(0)));
+    auto bag = makeBag(strings);
+
+    AllocationCounters counters;
+
+    for (auto _ : state)
+    {
+        std::string text;
+        for (auto& prop : bag)
+        {
+            text.append(prop.str());
+            text.push_back('\n');
+        }
+
+        benchmark::DoNotOptimize(text.data());
+    }
+
+    counters.report(state);
+}
+
+void PropertyBag_FormatTo(benchmark::State& state)
+{
+    auto strings = makeStrings(BagSize / 2, static_cast<std::size_t>(state.range(0)));
+    auto bag = makeBag(strings);
+
+    Er::FormatBuffer text;
+
+    AllocationCounters counters;
+
+    for (auto _ : state)
+    {
+        text.clear();
+        for (auto& prop : bag)
+        {
+            Er::formatTo(text, prop);
+            text.push_back('\n');
+        }
+
+        benchmark::DoNotOptimize(text.data());
+    }
+
+    counters.report(state);
+}
+
+void Binary_HexOstream(benchmark::State& state)
+{
+    Er::Binary b(std::string(static_cast<std::size_t>(state.range(0)), '\x5a'));
+
+    for (auto _ : state)
+    {
+        std::ostringstream ss;
+        ss << b;
+        benchmark::DoNotOptimize(ss.str().data());
+    }
+
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+void Binary_HexFormatTo(benchmark::State& state)
+{
+    Er::Property prop(Er::Binary(std::string(static_cast<std::size_t>(state.range(0)), '\x5a')), Er::Unspecified::Binary);
+    Er::FormatBuffer text;
+
+    for (auto _ : state)
+    {
+        text.clear();
+        prop.strTo(text);
+        benchmark::DoNotOptimize(text.data());
+    }
+
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+} // namespace {}
+
+
+BENCHMARK(PropertyBag_Make)->Arg(Er::Property::InlineCapacity)->Arg(15)->Arg(32);
+BENCHMARK(PropertyBag_Copy)->Arg(Er::Property::InlineCapacity)->Arg(15)->Arg(32);
+BENCHMARK(PropertyBag_Compare)->Arg(Er::Property::InlineCapacity)->Arg(15)->Arg(32);
+BENCHMARK(PropertyBag_CompareInterned)->Arg(32)->Arg(256);
+BENCHMARK(String_Cache)->Arg(32)->Arg(256);
+BENCHMARK(String_CacheInterned)->Arg(32)->Arg(256);
+BENCHMARK(PropertyBag_Hash)->Arg(Er::Property::InlineCapacity)->Arg(32);
+BENCHMARK(Binary_CompareUnequal)->Arg(64)->Arg(1 << 20);
+BENCHMARK(Binary_CompareUnequalHashed)->Arg(64)->Arg(1 << 20);
+BENCHMARK(PropertyBag_FormatStr)->Arg(Er::Property::InlineCapacity)->Arg(32);
+BENCHMARK(PropertyBag_FormatTo)->Arg(Er::Property::InlineCapacity)->Arg(32);
+BENCHMARK(Binary_HexOstream)->Arg(64)->Arg(4096);
+BENCHMARK(Binary_HexFormatTo)->Arg(64)->Arg(4096);
@@ -0,0 +1,28 @@
+#include "common.hpp"
+
+#include <erebus/system/property.hxx>
+
+
+namespace
+{
+
+// every reply reads the mapping version; with many threads this used to bounce the registry lock
+void PropertyInfo_MappingVersion(benchmark::State& state)
+{
+    for (auto _ : state)
+        benchmark::DoNotOptimize(Erp::propertyMappingVersion());
+}
+
+void PropertyInfo_Lookup(benchmark::State& state)
+{
+    const std::string name = Er::Unspecified::UInt64.name();
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(Er::lookupProperty(name));
+}
+
+} // namespace {}
+
+
+BENCHMARK(PropertyInfo_MappingVersion)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK(PropertyInfo_Lookup)->ThreadRange(1, 16)->UseRealTime();
@@ -2,10 +2,13 @@
 #include <erebus/system/system/thread.hxx>
 #include <erebus/system/util/thread_data.hxx>
 
-#include <condition_variable>
+#include <algorithm>
+#include <memory>
+#include <atomic>
+#include <bit>
 #include <mutex>
-#include <queue>
 #include <thread>
+#include <vector>
 
 
 namespace Er::Log2
@@ -14,6 +17,65 @@ namespace Er::Log2
 namespace
 {
 
+//
+// records of a single thread on their way to the Logger thread
+// the producer only moves tail, the consumer only moves head
+//
+
+struct Ring
+    : public boost::noncopyable
+{
+    explicit Ring(std::size_t capacity)
+        : capacity(std::bit_ceil(std::max<std::size_t>(capacity, 2)))
+        , slots(std::make_unique<Record::Ptr[]>(this->capacity))
+    {
+    }
+
+    const std::size_t capacity;
+    std::unique_ptr<Record::Ptr[]> slots;
+    alignas(64) std::atomic<std::size_t> head = 0;
+    alignas(64) std::atomic<std::size_t> tail = 0;
+    std::size_t cachedHead = 0; // the producer looks at head only when the ring seems full
+    bool overflowing = false; // the producer has waited for room in vain; it drops records until the Logger thread takes some
+    std::atomic<bool> closed = false; // the thread is gone, or it has moved on to a bigger ring
+
+    // false if full
+    bool push(Record::Ptr& r) noexcept
+    {
+        auto t = tail.load(std::memory_order_relaxed);
+        if (t - cachedHead == capacity)
+        {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t - cachedHead == capacity)
+                return false;
+
+            overflowing = false;
+        }
+
+        slots[t & (capacity - 1)] = std::move(r);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const noexcept
+    {
+        return head.load(std::memory_order_relaxed) == tail.load(std::memory_order_acquire);
+    }
+
+    void drain(std::vector<Record::Ptr>& out)
+    {
+        auto h = head.load(std::memory_order_relaxed);
+        auto t = tail.load(std::memory_order_acquire);
+        if (h == t)
+            return;
+
+        for (auto i = h; i != t; ++i)
+            out.push_back(std::move(slots[i & (capacity - 1)]));
+
+        head.store(t, std::memory_order_release);
+    }
+};
+
 
 class AsyncLogger
     : public ILogger
@@ -22,29 +84,32 @@ class AsyncLogger
 public:
     ~AsyncLogger()
     {
+        m_worker.request_stop();
+        wake();
     }
 
-    AsyncLogger(std::string_view component, std::chrono::milliseconds threshold)
+    AsyncLogger(std::string_view component, std::chrono::milliseconds threshold, const AsyncLoggerOptions& options)
         : m_component(component)
         , m_threshold(threshold)
+        , m_options(options)
         , m_tee(makeTee(ThreadSafe::Yes))
         , m_worker([this](std::stop_token stop) { run(stop); })
     {
     }
-    
+
     void indent() noexcept override
     {
         auto& td = m_threadData.data();
         ++td.indent;
     }
-    
+
     void unindent() noexcept override
     {
         auto& td = m_threadData.data();
         ErAssert(td.indent > 0);
         --td.indent;
     }
-    
+
     void write(Record::Ptr r) override
     {
         if (!r) [[unlikely]]
@@ -56,65 +121,54 @@ public:
         if (!m_component.empty() && r->component().empty())
             r->setComponent(m_component);
 
-        auto indent = m_threadData.data().indent;
-        if (indent > 0)
-            r->setIndent(indent);
+        auto& td = m_threadData.data();
+        if (td.indent > 0)
+            r->setIndent(td.indent);
 
-        bool thresholdReached = false;
+        auto& ring = threadRing(td);
+        if (!ring.push(r) && !pushToFull(td, r)) [[unlikely]]
         {
-            std::unique_lock l(m_mutexQueue);
-            m_queue.push(r);
-
-            if (m_queue.size() == 1)
-            {
-                // remember the oldest record's timestamp
-                m_last = std::chrono::steady_clock::now(); 
-            }
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
 
+        // the Logger thread sleeps after finding every ring empty; see run()
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_sleeping.load(std::memory_order_relaxed))
+        {
             // don't send out records too often
-            if (m_threshold != std::chrono::milliseconds{})
-            {
-                auto now = std::chrono::steady_clock::now();
-                auto delta = now - m_last;
-                if (std::chrono::duration_cast<std::chrono::milliseconds>(delta) >= m_threshold)
-                    thresholdReached = true;
-            }
+            if ((m_threshold == std::chrono::milliseconds{}) || (std::chrono::steady_clock::now() - lastDrain() >= m_threshold))
+                wake();
         }
-
-        if (thresholdReached)
-            m_queueNotEmpty.notify_one();
     }
-    
+
     void flush() override
     {
-        {
-            std::unique_lock l(m_mutexQueue);
-
-            // issue an empty record to force flushing all sinks
-            m_queue.push(Record::Ptr{});
-        }
-
-        m_queueNotEmpty.notify_one();
+        auto ticket = m_flushRequested.fetch_add(1, std::memory_order_acq_rel) + 1;
+        wake();
 
         // wait until really flushed
+        auto stop = m_worker.get_stop_token();
+        for (;;)
         {
-            auto stop = m_worker.get_stop_token();
-            
-            std::unique_lock l(m_mutexQueue);
-            m_queueEmpty.wait(l, stop, [this]() { return m_queue.empty(); });
+            auto done = m_flushed.load(std::memory_order_acquire);
+            if (flushed(done, ticket) || stop.stop_requested())
+                break;
+
+            m_flushed.wait(done, std::memory_order_acquire);
         }
     }
-    
+
     void addSink(std::string_view name, ISink::Ptr sink) override
     {
         m_tee->addSink(name, sink);
     }
-    
+
     void removeSink(std::string_view name) override
     {
         m_tee->removeSink(name);
     }
-    
+
     ISink::Ptr findSink(std::string_view name) override
     {
         return m_tee->findSink(name);
@@ -124,67 +178,267 @@ private:
     struct PerThread
     {
         unsigned indent = 0;
+        std::uint64_t owner = 0; // AsyncLogger::m_id, since instance IDs of ThreadData are reused
+        std::shared_ptr<Ring> ring;
+
+        ~PerThread()
+        {
+            if (ring)
+                ring->closed.store(true, std::memory_order_release);
+        }
+
+        PerThread() noexcept = default;
+        PerThread(PerThread&&) noexcept = default;
+        PerThread& operator=(PerThread&&) noexcept = default;
     };
 
     using ThreadDataHolder = ThreadData<PerThread>;
 
+    Ring& threadRing(PerThread& td)
+    {
+        if (td.owner != m_id) [[unlikely]]
+        {
+            td.owner = m_id;
+            newRing(td, m_options.capacity);
+        }
+
+        return *td.ring;
+    }
+
+    // the old ring is drained before the new one, since it comes first in m_rings
+    void newRing(PerThread& td, std::size_t capacity)
+    {
+        if (td.ring)
+            td.ring->closed.store(true, std::memory_order_release);
+
+        td.ring = std::make_shared<Ring>(capacity);
+
+        std::lock_guard l(m_ringsLock);
+        m_rings.push_back(td.ring);
+        m_ringsVersion.fetch_add(1, std::memory_order_release);
+    }
+
+    // false if the record is to be dropped
+    bool pushToFull(PerThread& td, Record::Ptr& r)
+    {
+        if (m_options.overflow == Overflow::Grow)
+        {
+            newRing(td, td.ring->capacity * 2);
+            return td.ring->push(r);
+        }
+
+        // the Logger thread would be waiting for itself, and a stopped one does not drain anything
+        if ((System::CurrentThread::id() == m_loggerTid.load(std::memory_order_relaxed)) || m_worker.get_stop_token().stop_requested())
+            return false;
+
+        // one wait per overflow: the records that follow are dropped at once until there is room again
+        auto& ring = *td.ring;
+        bool block = (m_options.overflow == Overflow::Block);
+        if (!block && ring.overflowing)
+            return false;
+
+        wake();
+
+        auto deadline = std::chrono::steady_clock::now() + m_options.maxWait;
+        do
+        {
+            std::this_thread::yield();
+
+            if (ring.push(r))
+                return true;
+
+        } while ((block || (std::chrono::steady_clock::now() < deadline)) && !m_worker.get_stop_token().stop_requested());
+
+        ring.overflowing = true;
+        return false;
+    }
+
+    void wake() noexcept
+    {
+        m_signal.fetch_add(1, std::memory_order_release);
+        m_signal.notify_one();
+    }
+
+    // the counters are 32-bit to wait on them with a bare futex and may wrap around
+    static bool flushed(std::uint32_t done, std::uint32_t ticket) noexcept
+    {
+        return std::int32_t(done - ticket) >= 0;
+    }
+
+    std::chrono::steady_clock::time_point lastDrain() const noexcept
+    {
+        return std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(m_lastDrain.load(std::memory_order_relaxed)));
+    }
+
     void run(std::stop_token stop)
     {
         System::CurrentThread::setName("Logger");
+        m_loggerTid.store(System::CurrentThread::id(), std::memory_order_relaxed);
 
-        do
+        std::vector<std::shared_ptr<Ring>> rings;
+        std::uint64_t ringsVersion = 0;
+        std::vector<Record::Ptr> batch;
+
+        while (!stop.stop_requested())
         {
-            std::queue<Record::Ptr> q;
+            auto signal = m_signal.load(std::memory_order_acquire);
+            auto flushRequested = m_flushRequested.load(std::memory_order_acquire);
+
+            auto version = m_ringsVersion.load(std::memory_order_acquire);
+            if (version != ringsVersion)
+            {
+                std::lock_guard l(m_ringsLock);
+                rings = m_rings;
+                ringsVersion = m_ringsVersion.load(std::memory_order_relaxed);
+            }
 
+            // records written before a flush request are visible here, since the request was read first
+            bool closed = false;
+            std::size_t sources = 0;
+            for (auto& ring : rings)
             {
-                std::unique_lock lw(m_mutexQueue);
-                
-                if (m_queue.empty())
-                    m_queueEmpty.notify_all();
+                closed = ring->closed.load(std::memory_order_acquire) || closed;
+
+                auto before = batch.size();
+                ring->drain(batch);
+                if (batch.size() > before)
+                    ++sources;
+            }
 
-                m_queueNotEmpty.wait(lw, stop, [this]() { return !m_queue.empty(); });
+            sendToSinks(batch, sources > 1);
+            reportDropped();
 
-                q.swap(m_queue);
+            m_lastDrain.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
 
-                // clean the oldest record's timestamp
-                m_last = std::chrono::time_point<std::chrono::steady_clock>::min();
+            if (!flushed(m_flushed.load(std::memory_order_relaxed), flushRequested))
+            {
+                m_tee->flush();
+                m_flushed.store(flushRequested, std::memory_order_release);
+                m_flushed.notify_all();
             }
 
-            // queue is now unlocked
-            if (!q.empty())
+            if (closed)
+                dropClosedRings(rings, ringsVersion);
+
+            // records tend to come in bursts, so look again a few times before going to sleep
+            for (unsigned spin = 0; spin < SpinCount; ++spin)
             {
-                sendToSinks(q, stop);
+                if ((m_signal.load(std::memory_order_relaxed) != signal) || std::any_of(rings.begin(), rings.end(), [](auto& ring) { return !ring->empty(); }))
+                    break;
+
+                std::this_thread::yield();
             }
 
-        } while (!stop.stop_requested());
+            // producers check m_sleeping after pushing, so either they see it or we see their records
+            m_sleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            bool idle = std::all_of(rings.begin(), rings.end(), [](auto& ring) { return ring->empty(); });
+            if (idle && (m_ringsVersion.load(std::memory_order_acquire) == ringsVersion) && (m_flushRequested.load(std::memory_order_acquire) == flushRequested))
+                m_signal.wait(signal, std::memory_order_acquire);
+
+            m_sleeping.store(false, std::memory_order_relaxed);
+        }
+
+        // whatever is left, including the rings of threads that started writing since the last pass
+        {
+            std::lock_guard l(m_ringsLock);
+            rings = m_rings;
+        }
+
+        batch.clear();
+        for (auto& ring : rings)
+            ring->drain(batch);
+
+        sendToSinks(batch, true);
+        reportDropped();
+        m_tee->flush();
+
+        // flush() stops waiting on its own once stop is requested
+        m_flushed.fetch_add(1, std::memory_order_release);
+        m_flushed.notify_all();
     }
 
-    void sendToSinks(std::queue<Record::Ptr>& records, std::stop_token stop)
+    void sendToSinks(std::vector<Record::Ptr>& records, bool merge)
     {
-        while (!records.empty())
+        if (records.empty())
+            return;
+
+        // each ring is in order; this restores the order between threads
+        if (merge)
+            std::stable_sort(records.begin(), records.end(), [](const Record::Ptr& a, const Record::Ptr& b) { return a->time() < b->time(); });
+
+        for (auto& record : records)
         {
-            auto record = records.front();
-            records.pop();
+            // formatted here rather than by the thread that wrote it
+            if (record->deferred())
+            {
+                if (!m_tee->accepts(record.get()))
+                    continue;
 
-            if (!record)
-                m_tee->flush(); // empty record means forced flush
-            else
-                m_tee->write(record);
+                record->render();
+            }
 
-            if (stop.stop_requested())
-                break;
+            m_tee->write(record);
         }
+
+        records.clear();
     }
 
+    void reportDropped()
+    {
+        auto dropped = m_dropped.exchange(0, std::memory_order_relaxed);
+        if (dropped > 0) [[unlikely]]
+        {
+            m_tee->write(Record::make(
+                m_component,
+                Level::Warning,
+                System::PackedTime::now(),
+                System::CurrentThread::id(),
+                Er::format("{} log records dropped", dropped)
+            ));
+        }
+    }
+
+    void dropClosedRings(std::vector<std::shared_ptr<Ring>>& rings, std::uint64_t& ringsVersion)
+    {
+        std::lock_guard l(m_ringsLock);
+
+        // a closed ring gets no more records, so an empty one can go
+        std::erase_if(m_rings, [](auto& ring) { return ring->closed.load(std::memory_order_acquire) && ring->empty(); });
+        m_ringsVersion.fetch_add(1, std::memory_order_release);
+
+        rings = m_rings;
+        ringsVersion = m_ringsVersion.load(std::memory_order_relaxed);
+    }
+
+    static constexpr unsigned SpinCount = 64;
+
+    static std::uint64_t nextId() noexcept
+    {
+        static std::atomic<std::uint64_t> s_id = 0;
+        return s_id.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    const std::uint64_t m_id = nextId();
     std::string_view m_component;
     std::chrono::milliseconds m_threshold;
+    const AsyncLoggerOptions m_options;
     ITee::Ptr m_tee;
     ThreadDataHolder m_threadData;
-    std::mutex m_mutexQueue;
-    std::condition_variable_any m_queueNotEmpty;
-    std::condition_variable_any m_queueEmpty;
-    std::queue<Record::Ptr> m_queue;
-    std::chrono::time_point<std::chrono::steady_clock> m_last = std::chrono::time_point<std::chrono::steady_clock>::min();
+
+    std::mutex m_ringsLock; // new threads only; the records go around it
+    std::vector<std::shared_ptr<Ring>> m_rings;
+    std::atomic<std::uint64_t> m_ringsVersion = 0;
+
+    alignas(64) std::atomic<std::uint32_t> m_signal = 0; // futex the Logger thread sleeps on
+    std::atomic<bool> m_sleeping = false;
+    std::atomic<std::chrono::steady_clock::rep> m_lastDrain = 0;
+    std::atomic<std::uint32_t> m_flushRequested = 0;
+    std::atomic<std::uint32_t> m_flushed = 0;
+    std::atomic<std::uint64_t> m_dropped = 0;
+    std::atomic<System::Tid> m_loggerTid = 0;
+
     std::jthread m_worker;
 };
 
@@ -192,9 +446,9 @@ private:
 } // namespace {}
 
 
-ER_SYSTEM_EXPORT ILogger::Ptr makeLogger(std::string_view component, std::chrono::milliseconds threshold)
+ER_SYSTEM_EXPORT ILogger::Ptr makeLogger(std::string_view component, std::chrono::milliseconds threshold, const AsyncLoggerOptions& options)
 {
-    return std::make_shared<AsyncLogger>(component, threshold);
+    return std::make_shared<AsyncLogger>(component, threshold, options);
 }
 
-} // namespace Er::Log2 {}
\ No newline at end of file
+} // namespace Er::Log2 {}
@@ -74,7 +74,8 @@ public:
         if (!filter(r.get()))
             return;
         
-        auto formatted = format(r.get());
+        FormatBuffer buffer;
+        auto formatted = format(r.get(), buffer);
         const auto available = formatted.length();
         if (!available)
             return;
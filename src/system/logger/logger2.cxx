@@ -1,4 +1,5 @@
 #include <erebus/system/logger/null_logger2.hxx>
+#include <erebus/system/util/object_pool.hxx>
 
 
 
@@ -23,6 +24,43 @@ ER_SYSTEM_EXPORT ILogger::Ptr global() noexcept
 namespace Erp::Log2
 {
 
+namespace
+{
+
+// most records fit into the small blocks, the long ones get the large blocks
+using SmallBlock = Er::PoolBlock<256, alignof(std::max_align_t)>;
+using LargeBlock = Er::PoolBlock<1024, alignof(std::max_align_t)>;
+
+} // namespace {}
+
+
+ER_SYSTEM_EXPORT void* allocateRecord(std::size_t& size)
+{
+    if (size <= sizeof(SmallBlock))
+    {
+        size = sizeof(SmallBlock);
+        return Er::ObjectPool<SmallBlock>::acquire();
+    }
+
+    if (size <= sizeof(LargeBlock))
+    {
+        size = sizeof(LargeBlock);
+        return Er::ObjectPool<LargeBlock>::acquire();
+    }
+
+    return ::operator new(size);
+}
+
+ER_SYSTEM_EXPORT void freeRecord(void* p, std::size_t size) noexcept
+{
+    if (size == sizeof(SmallBlock))
+        Er::ObjectPool<SmallBlock>::release(static_cast<SmallBlock*>(p));
+    else if (size == sizeof(LargeBlock))
+        Er::ObjectPool<LargeBlock>::release(static_cast<LargeBlock*>(p));
+    else
+        ::operator delete(p);
+}
+
 ER_SYSTEM_EXPORT void setGlobal(Er::Log2::ILogger::Ptr log) noexcept
 {
     bool drainPending = (Er::Log2::g_global == &s_null) && !!log;
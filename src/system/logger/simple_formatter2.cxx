@@ -1,6 +1,7 @@
 #include <erebus/system/logger/simple_formatter2.hxx>
 
 #include <algorithm>
+#include <charconv>
 
 namespace Er::Log2
 {
@@ -17,50 +18,39 @@ public:
 
     std::string format(const Record* r) const override
     {
-        std::tm time{};
-        std::uint32_t msec = 0;
+        thread_local FormatBuffer buffer;
+        buffer.clear();
 
-        if (m_options[Option::DateTime] || m_options[Option::Time])
-        {
-            System::PackedTime pt(r->time());
-            if (m_options[Option::TzUtc])
-                time = pt.toUtc();
-            else
-                time = pt.toLocalTime();
-
-            msec = pt.subSecond() / 1000;
-        }
+        formatTo(r, buffer);
+        return std::string(buffer.data(), buffer.size());
+    }
 
-        std::ostringstream ss;
+    void formatTo(const Record* r, FormatBuffer& out) const override
+    {
         bool prefixEmpty = true;
 
         if (m_needPrefix)
-            ss << "[";
+            out.push_back('[');
 
-        if (m_options[Option::DateTime])
-        {
-            ss << Er::format("{:04}/{:02}/{:02} {:02}:{:02}:{:02}.{:03}", time.tm_year + 1900, time.tm_mon + 1, time.tm_mday, time.tm_hour, time.tm_min, time.tm_sec, msec);
-            prefixEmpty = false;
-        }
-        else if (m_options[Option::Time])
+        if (m_options[Option::DateTime] || m_options[Option::Time])
         {
-            ss << Er::format("{:02}:{:02}:{:02}.{:03}", time.tm_hour, time.tm_min, time.tm_sec, msec);
+            appendTime(r->time(), out);
             prefixEmpty = false;
         }
 
         if (m_options[Option::Level])
         {
             if (!prefixEmpty)
-                ss << " ";
+                out.push_back(' ');
 
             switch (r->level())
             {
-            case Log2::Level::Debug: ss << "D"; break;
-            case Log2::Level::Info: ss << "I"; break;
-            case Log2::Level::Warning: ss << "W"; break;
-            case Log2::Level::Error: ss << "E"; break;
-            case Log2::Level::Fatal: ss << "!"; break;
-            default: ss << "?"; break;
+            case Log2::Level::Debug: out.push_back('D'); break;
+            case Log2::Level::Info: out.push_back('I'); break;
+            case Log2::Level::Warning: out.push_back('W'); break;
+            case Log2::Level::Error: out.push_back('E'); break;
+            case Log2::Level::Fatal: out.push_back('!'); break;
+            default: out.push_back('?'); break;
             }
 
             prefixEmpty = false;
@@ -69,47 +59,49 @@ public:
         if (m_options[Option::Component] && !r->component().empty())
         {
             if (!prefixEmpty)
-                ss << " ";
+                out.push_back(' ');
 
-            ss << r->component();
+            append(r->component(), out);
             prefixEmpty = false;
         }
 
         if (m_options[Option::Tid])
         {
             if (!prefixEmpty)
-                ss << " ";
+                out.push_back(' ');
 
-            ss << "@" << r->tid();
+            char tid[24];
+            tid[0] = '@';
+            auto end = std::to_chars(tid + 1, tid + sizeof(tid), r->tid()).ptr;
+            out.append(tid, end);
             prefixEmpty = false;
         }
 
         if (m_needPrefix)
         {
-            ss << "]";
+            out.push_back(']');
             prefixEmpty = false;
         }
 
-        if (!r->message().empty())
+        auto message = r->message();
+        if (!message.empty())
         {
             if (!prefixEmpty)
-                ss << " ";
+                out.push_back(' ');
 
             for (unsigned i = 0; i < r->indent(); ++i)
-                ss << m_indent;
+                append(m_indent, out);
 
-            ss << r->message();
+            append(message, out);
         }
 
         if (!m_options[Option::NoLf])
         {
             if (m_options[Option::CrLf])
-                ss << "\r\n";
+                append("\r\n", out);
             else
-                ss << "\n";
+                out.push_back('\n');
         }
-
-        return ss.str();
     }
     
     SimpleFormatterImpl(Options options, unsigned indentSize)
@@ -123,6 +115,51 @@ public:
 private:
     static constexpr unsigned MaxIndent = 64;
 
+    // the last rendered second, without the milliseconds
+    struct TimeCache
+    {
+        std::time_t second = -1;
+        bool utc = false;
+        bool date = false;
+        std::size_t length = 0;
+        char text[32];
+    };
+
+    static void append(std::string_view s, FormatBuffer& out)
+    {
+        out.append(s.data(), s.data() + s.size());
+    }
+
+    void appendTime(System::PackedTime::ValueType value, FormatBuffer& out) const
+    {
+        System::PackedTime pt(value);
+        bool utc = m_options[Option::TzUtc];
+        bool date = m_options[Option::DateTime];
+
+        // converting through the time zone rules is slow, so it's done once a second
+        thread_local TimeCache cache;
+        auto second = pt.toPosixTime();
+        if ((cache.second != second) || (cache.utc != utc) || (cache.date != date))
+        {
+            auto time = utc ? pt.toUtc() : pt.toLocalTime();
+
+            auto end = date ?
+                Format::format_to_n(cache.text, sizeof(cache.text), "{:04}/{:02}/{:02} {:02}:{:02}:{:02}.", time.tm_year + 1900, time.tm_mon + 1, time.tm_mday, time.tm_hour, time.tm_min, time.tm_sec).out :
+                Format::format_to_n(cache.text, sizeof(cache.text), "{:02}:{:02}:{:02}.", time.tm_hour, time.tm_min, time.tm_sec).out;
+
+            cache.second = second;
+            cache.utc = utc;
+            cache.date = date;
+            cache.length = std::size_t(end - cache.text);
+        }
+
+        out.append(cache.text, cache.text + cache.length);
+
+        auto msec = pt.subSecond() / 1000;
+        char digits[3] = { char('0' + msec / 100), char('0' + msec / 10 % 10), char('0' + msec % 10) };
+        out.append(digits, digits + 3);
+    }
+
     const Options m_options;
     const std::string m_indent;
     bool m_needPrefix;
@@ -136,4 +173,4 @@ IFormatter::Ptr SimpleFormatter::make(SimpleFormatter::Options options, unsigned
     return std::make_unique<SimpleFormatterImpl>(options, indentSize);
 }
 
-} // namespace Er::Log2 {}
\ No newline at end of file
+} // namespace Er::Log2 {}
@@ -58,6 +58,14 @@ public:
         if (!m_component.empty() && r->component().empty())
             r->setComponent(m_component);
 
+        if (r->deferred())
+        {
+            if (!m_tee->accepts(r.get()))
+                return;
+
+            r->render();
+        }
+
         m_tee->write(r);
     }
 
@@ -27,6 +27,18 @@ public:
         }
     }
 
+    bool accepts(const Record* r) const override
+    {
+        std::shared_lock l(m_mutex);
+        for (auto& sink : m_sinks)
+        {
+            if (sink.second->accepts(r))
+                return true;
+        }
+
+        return false;
+    }
+
     void flush() override
     {
         std::shared_lock l(m_mutex);
@@ -57,7 +69,7 @@ public:
     }
 
 private:
-    MutexT m_mutex;
+    mutable MutexT m_mutex;
     std::unordered_map<std::string, ISink::Ptr> m_sinks;
 };
 
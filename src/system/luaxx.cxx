@@ -1,6 +1,8 @@
 #include <erebus/system/exception.hxx>
 #include <erebus/system/luaxx.hxx>
+#include <erebus/system/luaxx/luaxx_array.hxx>
 #include <erebus/system/luaxx/luaxx_int64.hxx>
+#include <erebus/system/luaxx/luaxx_map.hxx>
 #include <erebus/system/luaxx/luaxx_property.hxx>
 
 #include <sstream>
@@ -35,6 +37,8 @@ LuaState::LuaState(Er::Log2::ILogger* log)
 
     Er::Lua::registerInt64(*this);
     Er::Lua::registerUInt64(*this);
+    Er::Lua::registerArrays(*this);
+    Er::Lua::registerMap(*this);
     Er::Lua::registerPropertyTypes(*this);
 }
 
@@ -0,0 +1,34 @@
+#include <erebus/system/luaxx/luaxx_array.hxx>
+#include <erebus/system/luaxx/luaxx_state.hxx>
+
+namespace Er::Lua
+{
+
+namespace
+{
+
+template <ArrayElement T>
+void registerArray(State& state, const char* name)
+{
+    Selector s = state["Er"][name];
+    s.SetClass<ArrayWrapper<T>>(
+        "size", &ArrayWrapper<T>::size,
+        "get", &ArrayWrapper<T>::get,
+        "__len", &ArrayWrapper<T>::__len,
+        "__tostring", &ArrayWrapper<T>::__tostring
+    );
+}
+
+} // namespace {}
+
+
+ER_SYSTEM_EXPORT void registerArrays(State& state)
+{
+    registerArray<std::int32_t>(state, "Int32Array");
+    registerArray<std::uint32_t>(state, "UInt32Array");
+    registerArray<std::int64_t>(state, "Int64Array");
+    registerArray<std::uint64_t>(state, "UInt64Array");
+    registerArray<double>(state, "DoubleArray");
+}
+
+} // namespace Er::Lua {}
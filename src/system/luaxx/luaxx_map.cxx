@@ -0,0 +1,19 @@
+#include <erebus/system/luaxx/luaxx_map.hxx>
+#include <erebus/system/luaxx/luaxx_state.hxx>
+
+namespace Er::Lua
+{
+
+ER_SYSTEM_EXPORT void registerMap(State& state)
+{
+    Selector s = state["Er"]["Map"];
+    s.SetClass<MapWrapper>(
+        "size", &MapWrapper::size,
+        "get", &MapWrapper::get,
+        "find", &MapWrapper::find,
+        "__len", &MapWrapper::__len,
+        "__tostring", &MapWrapper::__tostring
+    );
+}
+
+} // namespace Er::Lua {}
@@ -1,8 +1,11 @@
 #include <erebus/system/exception.hxx>
 #include <erebus/system/property.hxx>
+#include <erebus/system/string_pool.hxx>
 #include <erebus/system/util/exception_util.hxx>
 
+#include <erebus/system/luaxx/luaxx_array.hxx>
 #include <erebus/system/luaxx/luaxx_int64.hxx>
+#include <erebus/system/luaxx/luaxx_map.hxx>
 #include <erebus/system/luaxx/luaxx_property.hxx>
 #include <erebus/system/luaxx/luaxx_state.hxx>
 
@@ -132,11 +135,11 @@ void setPropertyDouble(Er::Property& prop, double val)
     prop = Property(val, *prop.info());
 }
 
-const std::string& getPropertyString(const Er::Property& prop)
+std::string getPropertyString(const Er::Property& prop)
 {
     if (prop.type() != PropertyType::String) [[unlikely]]
         throw PropertyException(std::source_location::current(), "get", prop, "String", Er::propertyTypeToString(prop.type()));
-    return prop.getString();
+    return std::string(prop.getStringView());
 }
 
 void setPropertyString(Er::Property& prop, const std::string& val)
@@ -146,11 +149,19 @@ void setPropertyString(Er::Property& prop, const std::string& val)
     prop = Property(val, *prop.info());
 }
 
-const std::string& getPropertyBinary(const Er::Property& prop)
+// for values that repeat a lot and live long
+void setPropertyInternedString(Er::Property& prop, const std::string& val)
+{
+    if (prop.type() != PropertyType::String) [[unlikely]]
+        throw PropertyException(std::source_location::current(), "set", prop, "String", Er::propertyTypeToString(prop.type()));
+    prop = StringPool::intern(val, *prop.info());
+}
+
+std::string getPropertyBinary(const Er::Property& prop)
 {
     if (prop.type() != PropertyType::Binary) [[unlikely]]
         throw PropertyException(std::source_location::current(), "get", prop, "Binary", Er::propertyTypeToString(prop.type()));
-    return prop.getBinary().bytes();
+    return std::string(prop.getBinary().bytes());
 }
 
 void setPropertyBinary(Er::Property& prop, const std::string& val)
@@ -160,6 +171,54 @@ void setPropertyBinary(Er::Property& prop, const std::string& val)
     prop = Property(Binary(val), *prop.info());
 }
 
+Er::Lua::Int32ArrayWrapper getPropertyInt32Array(const Er::Property& prop)
+{
+    if (prop.type() != PropertyType::Int32Array) [[unlikely]]
+        throw PropertyException(std::source_location::current(), "get", prop, "Int32Array", Er::propertyTypeToString(prop.type()));
+
+    return Er::Lua::Int32ArrayWrapper(prop);
+}
+
+Er::Lua::UInt32ArrayWrapper getPropertyUInt32Array(const Er::Property& prop)
+{
+    if (prop.type() != PropertyType::UInt32Array) [[unlikely]]
+        throw PropertyException(std::source_location::current(), "get", prop, "UInt32Array", Er::propertyTypeToString(prop.type()));
+
+    return Er::Lua::UInt32ArrayWrapper(prop);
+}
+
+Er::Lua::Int64ArrayWrapper getPropertyInt64Array(const Er::Property& prop)
+{
+    if (prop.type() != PropertyType::Int64Array) [[unlikely]]
+        throw PropertyException(std::source_location::current(), "get", prop, "Int64Array", Er::propertyTypeToString(prop.type()));
+
+    return Er::Lua::Int64ArrayWrapper(prop);
+}
+
+Er::Lua::UInt64ArrayWrapper getPropertyUInt64Array(const Er::Property& prop)
+{
+    if (prop.type() != PropertyType::UInt64Array) [[unlikely]]
+        throw PropertyException(std::source_location::current(), "get", prop, "UInt64Array", Er::propertyTypeToString(prop.type()));
+
+    return Er::Lua::UInt64ArrayWrapper(prop);
+}
+
+Er::Lua::DoubleArrayWrapper getPropertyDoubleArray(const Er::Property& prop)
+{
+    if (prop.type() != PropertyType::DoubleArray) [[unlikely]]
+        throw PropertyException(std::source_location::current(), "get", prop, "DoubleArray", Er::propertyTypeToString(prop.type()));
+
+    return Er::Lua::DoubleArrayWrapper(prop);
+}
+
+Er::Lua::MapWrapper getPropertyMap(const Er::Property& prop)
+{
+    if (prop.type() != PropertyType::Map) [[unlikely]]
+        throw PropertyException(std::source_location::current(), "get", prop, "Map", Er::propertyTypeToString(prop.type()));
+
+    return Er::Lua::MapWrapper(prop);
+}
+
 std::string formatProperty(const Er::Property& prop)
 {
     return prop.info() ? prop.info()->format(prop) : prop.str();
@@ -212,13 +271,21 @@ ER_SYSTEM_EXPORT void registerPropertyTypes(State& state)
         s["Double"] = static_cast<uint32_t>(Er::PropertyType::Double);
         s["String"] = static_cast<uint32_t>(Er::PropertyType::String);
         s["Binary"] = static_cast<uint32_t>(Er::PropertyType::Binary);
+        s["Int32Array"] = static_cast<uint32_t>(Er::PropertyType::Int32Array);
+        s["UInt32Array"] = static_cast<uint32_t>(Er::PropertyType::UInt32Array);
+        s["Int64Array"] = static_cast<uint32_t>(Er::PropertyType::Int64Array);
+        s["UInt64Array"] = static_cast<uint32_t>(Er::PropertyType::UInt64Array);
+        s["DoubleArray"] = static_cast<uint32_t>(Er::PropertyType::DoubleArray);
+        s["Map"] = static_cast<uint32_t>(Er::PropertyType::Map);
     }
         
     // add the registered properties
     {
         enumerateProperties([&state](const Er::PropertyInfo* pi) ->bool
         {
-            registerPropertyInfo(state, pi);
+            // transient properties belong to IPC sessions and may go away while the state lives
+            if (!pi->isTransient())
+                registerPropertyInfo(state, pi);
             return true;
         });
     }
@@ -242,8 +309,15 @@ ER_SYSTEM_EXPORT void registerPropertyTypes(State& state)
         s["setDouble"] = &setPropertyDouble;
         s["getString"] = &getPropertyString;
         s["setString"] = &setPropertyString;
+        s["setInternedString"] = &setPropertyInternedString;
         s["getBinary"] = &getPropertyBinary;
         s["setBinary"] = &setPropertyBinary;
+        s["getInt32Array"] = &getPropertyInt32Array;
+        s["getUInt32Array"] = &getPropertyUInt32Array;
+        s["getInt64Array"] = &getPropertyInt64Array;
+        s["getUInt64Array"] = &getPropertyUInt64Array;
+        s["getDoubleArray"] = &getPropertyDoubleArray;
+        s["getMap"] = &getPropertyMap;
         s["getName"] = &getPropertyName;
         s["getReadableName"] = &getPropertyReadableName;
         s["format"] = &formatProperty;
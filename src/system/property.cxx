@@ -1,13 +1,51 @@
-#include <erebus/system/property.hxx>
+#include <erebus/system/property_bag.hxx>
+#include <erebus/system/util/hex.hxx>
 
-#include <sstream>
+#include <charconv>
 
 namespace Er
 {
 
+namespace
+{
+
+constexpr std::uint64_t HashPrime1 = 0x9E3779B185EBCA87ULL;
+constexpr std::uint64_t HashPrime2 = 0xC2B2AE3D27D4EB4FULL;
+
+constexpr std::uint64_t mix(std::uint64_t h) noexcept
+{
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// never 0, which marks a hash that has not been computed yet
+constexpr std::size_t typedHash(std::uint64_t h, PropertyType type) noexcept
+{
+    auto r = static_cast<std::size_t>(mix(h + (static_cast<std::uint64_t>(type) + 1) * HashPrime1));
+    return r ? r : 1;
+}
+
+std::uint64_t hashBytes(std::string_view v) noexcept
+{
+    return std::hash<std::string_view>{}(v);
+}
+
+} // namespace {}
+
+
 void Property::_free() noexcept
 {
-    auto ty = type();
+    auto ty = m_type.rawType();
+
+    if (ty == InfoAndType::InlineString)
+    {
+        delete m_u._inline.heap;
+        return;
+    }
 
     if (!_allocatesStorage(ty))
     {
@@ -21,13 +59,23 @@ void Property::_free() noexcept
 
 void Property::_clone(const Property& other)
 {
-    auto ty = other.type();
+    auto ty = other.m_type.rawType();
     m_type = other.m_type;
     m_u._largest = other.m_u._largest;
 
-    if (_allocatesStorage(ty))
+    // the copy makes its own std::string if it needs one
+    if (ty == InfoAndType::InlineString)
+        m_u._inline.heap = nullptr;
+    else if (_allocatesStorage(ty))
     {
-        m_u._shared->addRef();
+        // nodes from a memory resource are not shared, since the copy may outlive the resource
+        if (m_u._shared->resource)
+            m_u._shared = std::make_unique<SharedData>(std::string(std::get<std::string_view>(m_u._shared->data))).release();
+        // the source may still change a bag handed out by mutableMap(), so the copy gets a bag of its own
+        else if (m_u._shared->mutableBag)
+            m_u._shared = std::make_unique<SharedData>(std::get<PropertyBag>(m_u._shared->data)).release();
+        else
+            m_u._shared->addRef();
     }
 }
 
@@ -38,17 +86,25 @@ bool Property::_eq(const Property& other) const noexcept
     static EqFn s_eqFns[] =
     {
         &Property::_eqString,
-        &Property::_eqBinary
+        &Property::_eqBinary,
+        &Property::_eqArray<std::int32_t>,
+        &Property::_eqArray<std::uint32_t>,
+        &Property::_eqArray<std::int64_t>,
+        &Property::_eqArray<std::uint64_t>,
+        &Property::_eqArray<double>,
+        &Property::_eqMap
     };
 
     auto ty = type();
     if (ty != other.type())
         return false;
 
-    if (!_allocatesStorage(ty))
-    {
+    if (ty < PropertyType::String)
         return m_u._largest == other.m_u._largest;
-    }
+
+    // inline strings are zero-padded, so their bytes are equal iff the strings are; the std::string made by getString() is not compared
+    if (isInline() && other.isInline())
+        return (m_u._inline.size == other.m_u._inline.size) && !std::memcmp(m_u._inline.data, other.m_u._inline.data, sizeof(m_u._inline.data));
 
     auto idx = static_cast<std::size_t>(ty) - static_cast<std::size_t>(PropertyType::String);
     ErAssert(idx < _countof(s_eqFns));
@@ -57,21 +113,157 @@ bool Property::_eq(const Property& other) const noexcept
 
 bool Property::_eqString(const Property& other) const noexcept
 {
-    auto& v1 = getString();
-    auto& v2 = other.getString();
+    if (!isInline() && !other.isInline())
+    {
+        if (auto r = _eqShared(m_u._shared, other.m_u._shared))
+            return *r;
+    }
+
+    auto v1 = getStringView();
+    auto v2 = other.getStringView();
     return v1 == v2;
 }
 
 bool Property::_eqBinary(const Property& other) const noexcept
 {
+    if (auto r = _eqShared(m_u._shared, other.m_u._shared))
+        return *r;
+
     auto& v1 = getBinary();
     auto& v2 = other.getBinary();
     return v1 == v2;
 }
 
-std::string Property::_str() const
+// bitwise, like scalar doubles are compared
+template <ArrayElement T>
+bool Property::_eqArray(const Property& other) const noexcept
+{
+    if (auto r = _eqShared(m_u._shared, other.m_u._shared))
+        return *r;
+
+    auto& v1 = getArray<T>();
+    auto& v2 = other.getArray<T>();
+    return (v1.size() == v2.size()) && (v1.empty() || !std::memcmp(v1.data(), v2.data(), v1.size() * sizeof(T)));
+}
+
+// nested properties must match in order, including their PropertyInfo
+bool Property::_eqMap(const Property& other) const noexcept
+{
+    if (auto r = _eqShared(m_u._shared, other.m_u._shared))
+        return *r;
+
+    return equal(getMap(), other.getMap());
+}
+
+std::size_t Property::hash() const noexcept
+{
+    auto ty = m_type.rawType();
+    if (ty == InfoAndType::InlineString)
+        return typedHash(hashBytes(getStringView()), PropertyType::String);
+
+    if (!_allocatesStorage(ty))
+        return typedHash(m_u._largest.lo ^ (m_u._largest.hi * HashPrime2), type());
+
+    if (m_u._shared->mutableBag)
+        return _hashShared();
+
+    // computing it twice in a race is harmless
+    auto h = m_u._shared->hash.load(std::memory_order_relaxed);
+    if (!h)
+    {
+        h = _hashShared();
+        m_u._shared->hash.store(h, std::memory_order_relaxed);
+    }
+
+    return h;
+}
+
+// must agree with the inline string hash for strings and with _eqArray for arrays, which compares bits
+std::size_t Property::_hashShared() const noexcept
 {
-    using StrFn = std::string (Property::*)() const;
+    auto h = std::visit(
+        [](auto& v) -> std::uint64_t
+        {
+            using V = std::decay_t<decltype(v)>;
+            if constexpr (std::is_same_v<V, PropertyBag>)
+                return Er::hash(v);
+            else if constexpr (std::is_same_v<V, Binary>)
+                return hashBytes(v.bytes());
+            else if constexpr (std::is_same_v<V, std::string> || std::is_same_v<V, std::string_view>)
+                return hashBytes(v);
+            else
+                return hashBytes(std::string_view(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(typename V::value_type)));
+        },
+        m_u._shared->data);
+
+    return typedHash(h, type());
+}
+
+std::size_t hash(const PropertyBag& bag) noexcept
+{
+    constexpr std::size_t Lanes = 4;
+    std::uint64_t acc[Lanes] = { HashPrime1 + HashPrime2, HashPrime2, 0, std::uint64_t(0) - HashPrime1 };
+
+    auto n = bag.size();
+    std::size_t i = 0;
+    for (; i + Lanes <= n; i += Lanes)
+    {
+        for (std::size_t lane = 0; lane < Lanes; ++lane)
+        {
+            auto& prop = bag[i + lane];
+            auto h = prop.hash() ^ (std::uint64_t(prop.unique()) * HashPrime1);
+            acc[lane] = std::rotl(acc[lane] + h * HashPrime2, 31) * HashPrime1;
+        }
+    }
+
+    for (; i < n; ++i)
+    {
+        auto& prop = bag[i];
+        auto h = prop.hash() ^ (std::uint64_t(prop.unique()) * HashPrime1);
+        acc[0] = std::rotl(acc[0] + h * HashPrime2, 31) * HashPrime1;
+    }
+
+    std::uint64_t h = std::rotl(acc[0], 1) + std::rotl(acc[1], 7) + std::rotl(acc[2], 12) + std::rotl(acc[3], 18);
+    return static_cast<std::size_t>(mix(h + n));
+}
+
+bool equal(const PropertyBag& a, const PropertyBag& b) noexcept
+{
+    if (a.size() != b.size())
+        return false;
+
+    for (std::size_t i = 0; i < a.size(); ++i)
+    {
+        if ((a[i].info() != b[i].info()) || !(a[i] == b[i]))
+            return false;
+    }
+
+    return true;
+}
+
+PropertyBag& Property::mutableMap()
+{
+    ErAssert(type() == PropertyType::Map);
+    ErAssert(m_u._shared);
+
+    // once handed out, the bag is never shared again, since copies of this Property clone it
+    if (m_u._shared->refs.load(std::memory_order_acquire) > 1)
+    {
+        auto copy = std::make_unique<SharedData>(std::get<PropertyBag>(m_u._shared->data));
+        m_u._shared->release();
+        m_u._shared = copy.release();
+    }
+
+    // the caller may keep the reference and change the bag at any time
+    m_u._shared->mutableBag = true;
+    m_u._shared->hash.store(0, std::memory_order_relaxed);
+
+    return std::get<PropertyBag>(m_u._shared->data);
+}
+
+void Property::_str(FormatBuffer& out) const
+{
+    using StrFn = void (Property::*)(FormatBuffer&) const;
 
     static StrFn s_strFns[] =
     {
@@ -83,67 +275,125 @@ std::string Property::_str() const
         &Property::_strUInt64,
         &Property::_strDouble,
         &Property::_strString,
-        &Property::_strBinary
+        &Property::_strBinary,
+        &Property::_strArray<std::int32_t>,
+        &Property::_strArray<std::uint32_t>,
+        &Property::_strArray<std::int64_t>,
+        &Property::_strArray<std::uint64_t>,
+        &Property::_strArray<double>,
+        &Property::_strMap
     };
 
     auto ty = type();
     auto idx = static_cast<std::size_t>(ty);
     ErAssert(idx < _countof(s_strFns));
-    return std::invoke(s_strFns[idx], *this);
+    std::invoke(s_strFns[idx], *this, out);
 }
 
-std::string Property::_strEmpty() const
+namespace
+{
+
+void append(FormatBuffer& out, std::string_view s)
 {
-    return "[empty]";
+    out.append(s.data(), s.data() + s.size());
 }
 
-std::string Property::_strBool() const
+template <typename T>
+void appendNumber(FormatBuffer& out, T v)
+{
+    if constexpr (std::is_floating_point_v<T>)
+    {
+        // same as std::to_string()
+        Format::format_to(std::back_inserter(out), "{:f}", v);
+    }
+    else
+    {
+        char buffer[24];
+        auto r = std::to_chars(buffer, buffer + sizeof(buffer), v);
+        out.append(buffer, r.ptr);
+    }
+}
+
+} // namespace {}
+
+void Property::_strEmpty(FormatBuffer& out) const
+{
+    append(out, "[empty]");
+}
+
+void Property::_strBool(FormatBuffer& out) const
 {
     auto v = getBool();
-    return v ? "True" : "False";
+    append(out, v ? "True" : "False");
 }
 
-std::string Property::_strInt32() const
+void Property::_strInt32(FormatBuffer& out) const
 {
-    auto v = getInt32();
-    return std::to_string(v);
+    appendNumber(out, getInt32());
 }
 
-std::string Property::_strUInt32() const
+void Property::_strUInt32(FormatBuffer& out) const
 {
-    auto v = getUInt32();
-    return std::to_string(v);
+    appendNumber(out, getUInt32());
 }
 
-std::string Property::_strInt64() const
+void Property::_strInt64(FormatBuffer& out) const
 {
-    auto v = getInt64();
-    return std::to_string(v);
+    appendNumber(out, getInt64());
 }
 
-std::string Property::_strUInt64() const
+void Property::_strUInt64(FormatBuffer& out) const
 {
-    auto v = getUInt64();
-    return std::to_string(v);
+    appendNumber(out, getUInt64());
 }
 
-std::string Property::_strDouble() const
+void Property::_strDouble(FormatBuffer& out) const
 {
-    auto v = getDouble();
-    return std::to_string(v);
+    appendNumber(out, getDouble());
 }
 
-std::string Property::_strString() const
+void Property::_strString(FormatBuffer& out) const
 {
-    return getString();
+    append(out, getStringView());
 }
 
-std::string Property::_strBinary() const
+void Property::_strBinary(FormatBuffer& out) const
 {
     auto& v = getBinary();
-    std::ostringstream ss;
-    ss << v;
-    return ss.str();
+    Util::hexEncodeTo(out, v.data(), v.size());
+}
+
+template <ArrayElement T>
+void Property::_strArray(FormatBuffer& out) const
+{
+    auto& v = getArray<T>();
+    out.push_back('[');
+    for (std::size_t i = 0; i < v.size(); ++i)
+    {
+        if (i > 0)
+            append(out, ", ");
+
+        appendNumber(out, v[i]);
+    }
+
+    out.push_back(']');
+}
+
+void Property::_strMap(FormatBuffer& out) const
+{
+    auto& v = getMap();
+    out.push_back('{');
+    for (std::size_t i = 0; i < v.size(); ++i)
+    {
+        if (i > 0)
+            append(out, ", ");
+
+        append(out, v[i].name());
+        append(out, ": ");
+        v[i]._str(out);
+    }
+
+    out.push_back('}');
 }
 
 std::string_view propertyTypeToString(PropertyType type)
@@ -159,6 +409,13 @@ std::string_view propertyTypeToString(PropertyType type)
     case PropertyType::Double: return "Double";
     case PropertyType::String: return "String";
     case PropertyType::Binary: return "Binary";
+    case PropertyType::Int32Array: return "Int32Array";
+    case PropertyType::UInt32Array: return "UInt32Array";
+    case PropertyType::Int64Array: return "Int64Array";
+    case PropertyType::UInt64Array: return "UInt64Array";
+    case PropertyType::DoubleArray: return "DoubleArray";
+    case PropertyType::Map: return "Map";
+    case PropertyType::Max: break;
     }
 
     return "\?\?\?";
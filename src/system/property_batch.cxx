@@ -0,0 +1,282 @@
+#include <erebus/system/exception.hxx>
+#include <erebus/system/format.hxx>
+#include <erebus/system/property_batch.hxx>
+
+#include <limits>
+
+namespace Er
+{
+
+namespace
+{
+
+PropertyBatch::ColumnData makeColumnData(PropertyType type)
+{
+    switch (type)
+    {
+    case PropertyType::Empty: return std::monostate{};
+    case PropertyType::Bool: return std::vector<Bool>{};
+    case PropertyType::Int32: return std::vector<std::int32_t>{};
+    case PropertyType::UInt32: return std::vector<std::uint32_t>{};
+    case PropertyType::Int64: return std::vector<std::int64_t>{};
+    case PropertyType::UInt64: return std::vector<std::uint64_t>{};
+    case PropertyType::Double: return std::vector<double>{};
+    case PropertyType::String: return PropertyBatch::Blobs{};
+    case PropertyType::Binary: return PropertyBatch::Blobs{};
+    default: break;
+    }
+
+    ErThrow(Er::format("Unsupported property type {}", static_cast<unsigned>(type)));
+}
+
+// arrays and maps have no column representation
+bool columnTypeSupported(PropertyType type) noexcept
+{
+    return type <= PropertyType::Binary;
+}
+
+bool columnTypeMatches(PropertyType type, const PropertyBatch::ColumnData& data) noexcept
+{
+    switch (type)
+    {
+    case PropertyType::Empty: return std::holds_alternative<std::monostate>(data);
+    case PropertyType::Bool: return std::holds_alternative<std::vector<Bool>>(data);
+    case PropertyType::Int32: return std::holds_alternative<std::vector<std::int32_t>>(data);
+    case PropertyType::UInt32: return std::holds_alternative<std::vector<std::uint32_t>>(data);
+    case PropertyType::Int64: return std::holds_alternative<std::vector<std::int64_t>>(data);
+    case PropertyType::UInt64: return std::holds_alternative<std::vector<std::uint64_t>>(data);
+    case PropertyType::Double: return std::holds_alternative<std::vector<double>>(data);
+    case PropertyType::String: return std::holds_alternative<PropertyBatch::Blobs>(data);
+    case PropertyType::Binary: return std::holds_alternative<PropertyBatch::Blobs>(data);
+    default: break;
+    }
+
+    return false;
+}
+
+std::size_t columnRows(const PropertyBatch::ColumnData& data, std::size_t emptyRows) noexcept
+{
+    return std::visit(
+        [emptyRows](auto& v) -> std::size_t
+        {
+            using T = std::decay_t<decltype(v)>;
+            if constexpr (std::is_same_v<T, std::monostate>)
+                return emptyRows;
+            else if constexpr (std::is_same_v<T, PropertyBatch::Blobs>)
+                return v.offsets.empty() ? 0 : v.offsets.size() - 1;
+            else
+                return v.size();
+        },
+        data);
+}
+
+void appendBlob(PropertyBatch::Blobs& blobs, std::string_view v)
+{
+    if (blobs.data.size() + v.size() > std::numeric_limits<std::uint32_t>::max())
+        ErThrow("Property batch column is too large");
+
+    blobs.data.append(v);
+    blobs.offsets.push_back(static_cast<std::uint32_t>(blobs.data.size()));
+}
+
+} // namespace {}
+
+
+PropertyBatch::PropertyBatch(Schema schema)
+{
+    setSchema(schema);
+}
+
+PropertyBatch::PropertyBatch(std::vector<Column>&& columns, std::size_t rows)
+    : m_columns(std::move(columns))
+    , m_rows(rows)
+{
+    for (auto& column : m_columns)
+    {
+        if (!column.info)
+            ErThrow("Property batch column has no property info");
+
+        if (!columnTypeMatches(column.info->type(), column.data))
+            ErThrow(Er::format("Property batch column {} does not match its type", column.info->name()));
+
+        if (auto blobs = std::get_if<Blobs>(&column.data))
+        {
+            if (blobs->offsets.empty() || (blobs->offsets.front() != 0) || (blobs->offsets.back() != blobs->data.size()) ||
+                !std::is_sorted(blobs->offsets.begin(), blobs->offsets.end()))
+            {
+                ErThrow(Er::format("Property batch column {} has invalid offsets", column.info->name()));
+            }
+        }
+
+        if (columnRows(column.data, rows) != rows)
+            ErThrow(Er::format("Property batch column {} has {} rows instead of {}", column.info->name(), columnRows(column.data, rows), rows));
+    }
+}
+
+std::size_t PropertyBatch::columnOf(const PropertyInfo& info) const noexcept
+{
+    auto unique = info.unique();
+    for (std::size_t i = 0; i < m_columns.size(); ++i)
+    {
+        if (m_columns[i].info->unique() == unique)
+            return i;
+    }
+
+    return NotFound;
+}
+
+Property PropertyBatch::get(std::size_t row, std::size_t column) const
+{
+    ErAssert(row < m_rows);
+    ErAssert(column < m_columns.size());
+
+    auto& c = m_columns[column];
+    auto& info = *c.info;
+
+    return std::visit(
+        [row, &info](auto& v) -> Property
+        {
+            using T = std::decay_t<decltype(v)>;
+            if constexpr (std::is_same_v<T, std::monostate>)
+                return Property();
+            else if constexpr (std::is_same_v<T, Blobs>)
+                return (info.type() == PropertyType::String) ? Property(v.at(row), info) : Property(Binary(v.at(row)), info);
+            else
+                return Property(v[row], info);
+        },
+        c.data);
+}
+
+PropertyBag PropertyBatch::row(std::size_t row) const
+{
+    PropertyBag bag;
+    bag.reserve(m_columns.size());
+
+    for (std::size_t i = 0; i < m_columns.size(); ++i)
+        bag.push_back(get(row, i));
+
+    return bag;
+}
+
+bool PropertyBatch::append(const PropertyBag& row)
+{
+    if (m_columns.empty() && (m_rows == 0))
+    {
+        Schema schema;
+        schema.reserve(row.size());
+        for (auto& prop : row)
+        {
+            if (!columnTypeSupported(prop.type()))
+                return false;
+
+            schema.push_back(prop.info());
+        }
+
+        setSchema(schema);
+    }
+
+    if (!matches(row))
+        return false;
+
+    for (std::size_t i = 0; i < m_columns.size(); ++i)
+    {
+        auto& prop = row[i];
+
+        std::visit(
+            [&prop](auto& v)
+            {
+                using T = std::decay_t<decltype(v)>;
+                if constexpr (std::is_same_v<T, std::monostate>)
+                    return;
+                else if constexpr (std::is_same_v<T, Blobs>)
+                    appendBlob(v, (prop.type() == PropertyType::String) ? prop.getStringView() : prop.getBinary().bytes());
+                else
+                    v.push_back(Er::get<typename T::value_type>(prop));
+            },
+            m_columns[i].data);
+    }
+
+    ++m_rows;
+    return true;
+}
+
+void PropertyBatch::reserve(std::size_t rows, std::size_t bytesPerBlob)
+{
+    for (auto& column : m_columns)
+    {
+        std::visit(
+            [rows, bytesPerBlob](auto& v)
+            {
+                using T = std::decay_t<decltype(v)>;
+                if constexpr (std::is_same_v<T, std::monostate>)
+                    return;
+                else if constexpr (std::is_same_v<T, Blobs>)
+                {
+                    v.offsets.reserve(rows + 1);
+                    v.data.reserve(rows * bytesPerBlob);
+                }
+                else
+                    v.reserve(rows);
+            },
+            column.data);
+    }
+}
+
+void PropertyBatch::clear() noexcept
+{
+    for (auto& column : m_columns)
+    {
+        std::visit(
+            [](auto& v)
+            {
+                using T = std::decay_t<decltype(v)>;
+                if constexpr (std::is_same_v<T, std::monostate>)
+                    return;
+                else if constexpr (std::is_same_v<T, Blobs>)
+                {
+                    v.data.clear();
+                    v.offsets.resize(1);
+                }
+                else
+                    v.clear();
+            },
+            column.data);
+    }
+
+    m_rows = 0;
+}
+
+void PropertyBatch::setSchema(const Schema& schema)
+{
+    m_columns.clear();
+    m_columns.reserve(schema.size());
+
+    for (auto info : schema)
+    {
+        ErAssert(info);
+        m_columns.push_back(Column{ info, makeColumnData(info->type()) });
+    }
+
+    m_rows = 0;
+}
+
+bool PropertyBatch::matches(const PropertyBag& row) const noexcept
+{
+    if (row.size() != m_columns.size())
+        return false;
+
+    for (std::size_t i = 0; i < m_columns.size(); ++i)
+    {
+        auto info = row[i].info();
+        if ((info != m_columns[i].info) && (!info || (info->unique() != m_columns[i].info->unique())))
+            return false;
+
+        if (row[i].type() != m_columns[i].info->type())
+            return false;
+    }
+
+    return true;
+}
+
+
+} // namespace Er {}
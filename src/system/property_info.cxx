@@ -3,10 +3,16 @@
 #include <erebus/system/logger2.hxx>
 #include <erebus/system/property.hxx>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <limits>
 #include <mutex>
-#include <shared_mutex>
+#include <new>
 #include <unordered_map>
 
+#include <boost/noncopyable.hpp>
+
 namespace
 {
 
@@ -21,12 +27,72 @@ struct Registration
     {}
 };
 
+// an immutable snapshot of the names
+// persistent keys point to the keys of the persistent map, which are never erased;
+// transient names may go away, so the index keeps its own copies of them
+struct NameIndex
+{
+    using Ptr = std::unique_ptr<NameIndex>;
+
+    struct Entry
+    {
+        const Er::PropertyInfo* info;
+        bool transient;
+    };
+
+    std::uint32_t version = 0;
+    std::uint64_t transientVersion = 0;
+    std::vector<std::string> transientNames;
+    std::unordered_map<std::string_view, Entry> byName;
+};
+
+//
+// readers never lock: the versions are atomics and lookups go to the published NameIndex
+// writers serialize on the mutex; a new index is published lazily by the first lookup that finds the current one stale,
+// so registering many properties in a row costs a single rebuild
+// transient properties are refcounted and get IDs of their own
+//
+// a replaced index, and the released transient properties it still pointed to, are retired
+// and freed after a grace period: each reader thread has a slot of its own where it announces the epoch it came in at,
+// and what was retired in an epoch is freed once no reader is left from that epoch or an earlier one
+// writers never wait for readers; while too much is waiting for its grace period, no new index is published
+// and lookups the current one cannot answer take the lock
+//
 struct Registry
 {
-    std::shared_mutex mutex;
+    // past this, publishing stops until the readers have moved on
+    static constexpr std::size_t MaxRetired = 8;
+
+    // released transient properties kept for the current index before it is rebuilt without them
+    static constexpr std::size_t MaxReleased = 64;
+
+    // owned by one thread at a time and never freed, so that the list can be walked without locking
+    struct alignas(64) ReaderSlot
+    {
+        std::atomic<std::uint64_t> epoch = 0; // 0 when not reading
+        std::atomic<bool> owned = false;
+        ReaderSlot* next = nullptr;
+    };
+
+    struct Retired
+    {
+        std::uint64_t epoch;
+        NameIndex::Ptr index;
+        std::vector<std::unique_ptr<Er::PropertyInfo>> infos;
+    };
+
+    std::mutex mutex;
     std::unordered_map<std::string, const Er::PropertyInfo*> persistentProps;
     std::unordered_map<std::string, std::unique_ptr<Er::PropertyInfo>> transientProps;
-    std::uint32_t unique = 0;
+    std::atomic<std::uint32_t> unique = 0;
+    std::atomic<std::uint64_t> transientVersion = 0; // bumped whenever a transient property comes or goes
+    std::uint32_t nextTransient = 0;
+    std::atomic<const NameIndex*> index = nullptr;
+    NameIndex::Ptr current;
+    std::vector<std::unique_ptr<Er::PropertyInfo>> released; // gone from transientProps, but not from the current index
+    std::vector<Retired> retired; // oldest first
+    std::atomic<std::uint64_t> epoch = 1;
+    std::atomic<ReaderSlot*> readers = nullptr;
 };
 
 
@@ -36,6 +102,152 @@ Registry& registry()
     return *r;
 }
 
+// the calling thread's slot, or nullptr if there's no memory for one
+Registry::ReaderSlot* readerSlot(Registry& r) noexcept
+{
+    struct Owner
+    {
+        Registry::ReaderSlot* slot = nullptr;
+
+        ~Owner()
+        {
+            if (slot)
+                slot->owned.store(false, std::memory_order_release);
+        }
+    };
+
+    thread_local Owner owner;
+    if (owner.slot) [[likely]]
+        return owner.slot;
+
+    // reuse the slot of a thread that has exited
+    for (auto slot = r.readers.load(std::memory_order_acquire); slot; slot = slot->next)
+    {
+        bool owned = false;
+        if (!slot->owned.load(std::memory_order_relaxed) && slot->owned.compare_exchange_strong(owned, true, std::memory_order_acquire))
+            return owner.slot = slot;
+    }
+
+    auto slot = new (std::nothrow) Registry::ReaderSlot();
+    if (!slot)
+        return nullptr;
+
+    slot->owned.store(true, std::memory_order_relaxed);
+    slot->next = r.readers.load(std::memory_order_relaxed);
+    while (!r.readers.compare_exchange_weak(slot->next, slot, std::memory_order_release, std::memory_order_relaxed))
+    {
+    }
+
+    return owner.slot = slot;
+}
+
+// keeps the index a reader has loaded, and the transient properties it points to, from being freed
+class ReaderGuard final
+    : public boost::noncopyable
+{
+public:
+    ~ReaderGuard()
+    {
+        if (m_slot)
+            m_slot->epoch.store(0, std::memory_order_release);
+    }
+
+    explicit ReaderGuard(Registry& r) noexcept
+        : m_slot(readerSlot(r))
+    {
+        // a writer that retires something after this store sees us; one that did before has already unpublished it
+        if (m_slot)
+            m_slot->epoch.store(r.epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return m_slot != nullptr;
+    }
+
+private:
+    Registry::ReaderSlot* m_slot;
+};
+
+// must be called with the mutex held
+// frees whatever was retired before the epoch of the oldest reader still reading
+void reclaimLocked(Registry& r) noexcept
+{
+    if (r.retired.empty())
+        return;
+
+    auto oldest = std::numeric_limits<std::uint64_t>::max();
+    for (auto slot = r.readers.load(std::memory_order_acquire); slot; slot = slot->next)
+    {
+        auto epoch = slot->epoch.load(std::memory_order_seq_cst);
+        if (epoch)
+            oldest = std::min(oldest, epoch);
+    }
+
+    auto it = std::find_if(r.retired.begin(), r.retired.end(), [oldest](auto& retired) { return retired.epoch >= oldest; });
+    r.retired.erase(r.retired.begin(), it);
+}
+
+// must be called with the mutex held
+const Er::PropertyInfo* findLocked(Registry& r, const std::string& name) noexcept
+{
+    auto it = r.persistentProps.find(name);
+    if (it != r.persistentProps.end())
+        return it->second;
+
+    auto it2 = r.transientProps.find(name);
+    if (it2 != r.transientProps.end())
+        return it2->second.get();
+
+    return nullptr;
+}
+
+// must be called with the mutex held
+void publishLocked(Registry& r)
+{
+    auto version = r.unique.load(std::memory_order_relaxed);
+    auto transientVersion = r.transientVersion.load(std::memory_order_relaxed);
+
+    auto current = r.current.get();
+    if (current && (current->version == version) && (current->transientVersion == transientVersion))
+        return;
+
+    // don't pile up indices some slow reader may still be using
+    reclaimLocked(r);
+    if (r.retired.size() >= Registry::MaxRetired)
+        return;
+
+    auto index = std::make_unique<NameIndex>();
+    index->version = version;
+    index->transientVersion = transientVersion;
+    index->byName.reserve(r.persistentProps.size() + r.transientProps.size());
+
+    for (auto& pi : r.persistentProps)
+        index->byName.insert({ std::string_view(pi.first), NameIndex::Entry{ pi.second, false } });
+
+    // reserved up front, so the strings don't move
+    index->transientNames.reserve(r.transientProps.size());
+    for (auto& pi : r.transientProps)
+    {
+        auto& name = index->transientNames.emplace_back(pi.first);
+        index->byName.insert({ std::string_view(name), NameIndex::Entry{ pi.second.get(), true } });
+    }
+
+    r.retired.reserve(r.retired.size() + 1);
+    r.index.store(index.get(), std::memory_order_seq_cst);
+
+    // any reader that may still hold the old index has announced this epoch or an earlier one
+    auto epoch = r.epoch.fetch_add(1, std::memory_order_seq_cst);
+
+    // the new index does not know about the released properties
+    if (r.current)
+        r.retired.push_back(Registry::Retired{ epoch, std::move(r.current), std::move(r.released) });
+    r.released.clear();
+    r.current = std::move(index);
+
+    reclaimLocked(r);
+}
+
 
 } // namespace {}
 
@@ -48,7 +260,7 @@ ER_SYSTEM_EXPORT std::uint32_t registerPersistentProperty(const Er::PropertyInfo
 {
     auto& r = registry();
 
-    std::unique_lock l(r.mutex);
+    std::lock_guard l(r.mutex);
 
     // maybe already there
     auto it = r.persistentProps.find(info->name());
@@ -64,10 +276,13 @@ ER_SYSTEM_EXPORT std::uint32_t registerPersistentProperty(const Er::PropertyInfo
         return it->second->unique();
     }
 
-    auto id = r.unique++;
+    auto id = r.unique.load(std::memory_order_relaxed);
     auto result = r.persistentProps.insert({ info->name(), info });
     ErAssert(result.second);
 
+    // the new name has to be in the map before the version says so
+    r.unique.store(id + 1, std::memory_order_release);
+
     ErLogDebug2(Er::Log2::get(), "Property {} registered: {} [{}] of type {}", id, info->name(), info->readableName(), Er::propertyTypeToString(info->type()));
     
     return id;
@@ -76,26 +291,39 @@ ER_SYSTEM_EXPORT std::uint32_t registerPersistentProperty(const Er::PropertyInfo
 ER_SYSTEM_EXPORT std::string formatProperty(const Er::PropertyInfo* info, const Er::Property& prop)
 {
     auto& f = info->formatter();
-    if (!f)
-        return prop.str();
+    if (f)
+        return f(prop);
 
-    return f(prop);
+    Er::FormatBuffer out;
+    formatPropertyTo(info, prop, out);
+    return Er::Format::to_string(out);
 }
 
-ER_SYSTEM_EXPORT std::uint32_t propertyMappingVersion() noexcept
+ER_SYSTEM_EXPORT void formatPropertyTo(const Er::PropertyInfo* info, const Er::Property& prop, Er::FormatBuffer& out)
 {
-    auto& r = registry();
+    if (auto& f = info->bufferFormatter())
+        return f(prop, out);
+
+    if (auto& f = info->formatter())
+    {
+        auto s = f(prop);
+        out.append(s.data(), s.data() + s.size());
+        return;
+    }
 
-    std::shared_lock l(r.mutex);
+    prop.strTo(out);
+}
 
-    return r.unique;
+ER_SYSTEM_EXPORT std::uint32_t propertyMappingVersion() noexcept
+{
+    return registry().unique.load(std::memory_order_acquire);
 }
 
-ER_SYSTEM_EXPORT const Er::PropertyInfo* allocateTransientProperty(Er::PropertyType type, const std::string& name, const std::string& readableName)
+ER_SYSTEM_EXPORT Er::PropertyInfoRef allocateTransientProperty(Er::PropertyType type, const std::string& name, const std::string& readableName)
 {
     auto& r = registry();
 
-    std::unique_lock l(r.mutex);
+    std::lock_guard l(r.mutex);
 
     // maybe already there
     auto it = r.persistentProps.find(name);
@@ -108,7 +336,7 @@ ER_SYSTEM_EXPORT const Er::PropertyInfo* allocateTransientProperty(Er::PropertyT
         }
 
         ErLogDebug2(Er::Log2::get(), "Transient property mapped to persistent property {} [{}] of type {}", name, readableName, Er::propertyTypeToString(type));
-        return it->second;
+        return Er::PropertyInfoRef(Er::PropertyInfoRef::Adopt{}, it->second);
     }
 
     auto it2 = r.transientProps.find(name);
@@ -121,19 +349,134 @@ ER_SYSTEM_EXPORT const Er::PropertyInfo* allocateTransientProperty(Er::PropertyT
         }
 
         ErLogDebug2(Er::Log2::get(), "Transient property found: {} [{}] of type {}", name, readableName, Er::propertyTypeToString(type));
-        return it2->second.get();
+
+        // may be on its way out, but the releaser has to take the lock we hold to erase it
+        it2->second->m_refs.fetch_add(1, std::memory_order_relaxed);
+        return Er::PropertyInfoRef(Er::PropertyInfoRef::Adopt{}, it2->second.get());
     }
 
     // allocate a new transient property
-    auto id = r.unique++;
+    // IDs are not reused so that a peer holding a stale mapping cannot confuse two properties
+    if (r.nextTransient >= (Er::PropertyInfo::InvalidUnique & ~Er::PropertyInfo::TransientBit))
+        ErThrow("Transient property IDs exhausted");
+
+    auto id = Er::PropertyInfo::TransientBit | r.nextTransient++;
     auto prop = std::make_unique<Er::PropertyInfo>(Er::PropertyInfo::Transient{}, id, type, name, readableName);
     auto pi = prop.get();
+    pi->m_refs.store(1, std::memory_order_relaxed);
 
     r.transientProps.insert({ name, std::move(prop) });
+    r.transientVersion.fetch_add(1, std::memory_order_release);
 
     ErLogDebug2(Er::Log2::get(), "Transient property registered: {} [{}] of type {}", name, readableName, Er::propertyTypeToString(type));
 
-    return pi;
+    return Er::PropertyInfoRef(Er::PropertyInfoRef::Adopt{}, pi);
+}
+
+ER_SYSTEM_EXPORT void retainTransientProperty(const Er::PropertyInfo* info) noexcept
+{
+    if (!info || !info->isTransient())
+        return;
+
+    info->m_refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+ER_SYSTEM_EXPORT bool retainTransientPropertyIfAlive(const Er::PropertyInfo* info) noexcept
+{
+    if (!info || !info->isTransient())
+        return true;
+
+    // a property whose count has dropped to zero is being erased and is never revived
+    auto refs = info->m_refs.load(std::memory_order_relaxed);
+    while (refs > 0)
+    {
+        if (info->m_refs.compare_exchange_weak(refs, refs + 1, std::memory_order_acquire, std::memory_order_relaxed))
+            return true;
+    }
+
+    return false;
+}
+
+ER_SYSTEM_EXPORT std::size_t retiredPropertyIndices() noexcept
+{
+    auto& r = registry();
+
+    std::lock_guard l(r.mutex);
+    return r.retired.size();
+}
+
+ER_SYSTEM_EXPORT void releaseTransientProperty(const Er::PropertyInfo* info) noexcept
+{
+    if (!info || !info->isTransient())
+        return;
+
+    // not the last reference
+    auto refs = info->m_refs.load(std::memory_order_relaxed);
+    while (refs > 1)
+    {
+        if (info->m_refs.compare_exchange_weak(refs, refs - 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+            return;
+    }
+
+    // maybe the last one; dropping it under the lock keeps allocateTransientProperty() from reviving it halfway
+    auto& r = registry();
+
+    std::lock_guard l(r.mutex);
+
+    auto prev = info->m_refs.fetch_sub(1, std::memory_order_acq_rel);
+    ErAssert(prev > 0);
+    if (prev != 1)
+        return;
+
+    auto it = r.transientProps.find(info->name());
+    ErAssert(it != r.transientProps.end() && (it->second.get() == info));
+
+    ErLogDebug2(Er::Log2::get(), "Transient property released: {}", info->name());
+
+    r.transientVersion.fetch_add(1, std::memory_order_seq_cst);
+
+    // lookups may still find it in the current index, if that one has it, and have to fail to retain it
+    // rather than touch freed memory; see reclaimLocked()
+    auto reachable = r.current && [&]()
+    {
+        auto found = r.current->byName.find(std::string_view(info->name()));
+        return (found != r.current->byName.end()) && (found->second.info == info);
+    }();
+
+    if (!reachable)
+    {
+        r.transientProps.erase(it);
+        return;
+    }
+
+    try
+    {
+        r.released.reserve(r.released.size() + 1);
+    }
+    catch (std::exception& e)
+    {
+        // readers may still find it, so it cannot be freed; a small leak is better than waiting for them here
+        ErLogError2(Er::Log2::get(), "Failed to retire a transient property: {}", e.what());
+        it->second.release();
+        r.transientProps.erase(it);
+        return;
+    }
+
+    r.released.push_back(std::move(it->second));
+    r.transientProps.erase(it);
+
+    // don't let released properties pile up while nobody rebuilds the index
+    if (r.released.size() >= Registry::MaxReleased)
+    {
+        try
+        {
+            publishLocked(r);
+        }
+        catch (std::exception& e)
+        {
+            ErLogError2(Er::Log2::get(), "Failed to publish the property index: {}", e.what());
+        }
+    }
 }
 
 } // namespace Erp {}
@@ -141,28 +484,55 @@ ER_SYSTEM_EXPORT const Er::PropertyInfo* allocateTransientProperty(Er::PropertyT
 namespace Er
 {
 
-ER_SYSTEM_EXPORT const PropertyInfo* lookupProperty(const std::string& name) noexcept
+ER_SYSTEM_EXPORT PropertyInfoRef lookupProperty(const std::string& name) noexcept
 {
     auto& r = registry();
 
-    std::shared_lock l(r.mutex);
+    {
+        ReaderGuard guard(r);
 
-    auto it = r.persistentProps.find(name);
-    if (it != r.persistentProps.end())
-        return it->second;
+        auto index = guard ? r.index.load(std::memory_order_seq_cst) : nullptr;
+        if (index)
+        {
+            auto it = index->byName.find(std::string_view(name));
+            if (it != index->byName.end())
+            {
+                // persistent properties never go away, so even a stale index is right about them
+                if (!it->second.transient)
+                    return PropertyInfoRef(PropertyInfoRef::Adopt{}, it->second.info);
+
+                // the guard keeps it from being freed; if it is still referenced, it is the only one of that name
+                if (Erp::retainTransientPropertyIfAlive(it->second.info))
+                    return PropertyInfoRef(PropertyInfoRef::Adopt{}, it->second.info);
+            }
+            else if ((index->transientVersion == r.transientVersion.load(std::memory_order_seq_cst)) && (index->version == r.unique.load(std::memory_order_acquire)))
+            {
+                // the index is up to date, so there's no such property
+                return PropertyInfoRef();
+            }
+        }
+    }
 
-    auto it2 = r.transientProps.find(name);
-    if (it2 != r.transientProps.end())
-        return it2->second.get();
+    std::lock_guard l(r.mutex);
 
-    return nullptr;
+    try
+    {
+        publishLocked(r);
+    }
+    catch (std::exception& e)
+    {
+        ErLogError2(Er::Log2::get(), "Failed to publish the property index: {}", e.what());
+    }
+
+    // a transient property found here is still referenced, and the releaser needs the lock we hold to erase it
+    return PropertyInfoRef(findLocked(r, name));
 }
 
 ER_SYSTEM_EXPORT std::uint32_t enumerateProperties(std::function<bool(const PropertyInfo*)> cb) noexcept
 {
     auto& r = registry();
 
-    std::shared_lock l(r.mutex);
+    std::lock_guard l(r.mutex);
 
     for (auto& pi : r.persistentProps)
     {
@@ -176,7 +546,7 @@ ER_SYSTEM_EXPORT std::uint32_t enumerateProperties(std::function<bool(const Prop
             break;
     }
 
-    return r.unique;
+    return r.unique.load(std::memory_order_relaxed);
 }
 
 
@@ -192,6 +562,12 @@ const PropertyInfo UInt64{ PropertyType::UInt64, "Er.Unspecified.UInt64", "UInt6
 const PropertyInfo Double{ PropertyType::Double, "Er.Unspecified.Double", "Double" };
 const PropertyInfo String{ PropertyType::String, "Er.Unspecified.String", "String" };
 const PropertyInfo Binary{ PropertyType::Binary, "Er.Unspecified.Binary", "Binary" };
+const PropertyInfo Int32Array{ PropertyType::Int32Array, "Er.Unspecified.Int32Array", "Int32Array" };
+const PropertyInfo UInt32Array{ PropertyType::UInt32Array, "Er.Unspecified.UInt32Array", "UInt32Array" };
+const PropertyInfo Int64Array{ PropertyType::Int64Array, "Er.Unspecified.Int64Array", "Int64Array" };
+const PropertyInfo UInt64Array{ PropertyType::UInt64Array, "Er.Unspecified.UInt64Array", "UInt64Array" };
+const PropertyInfo DoubleArray{ PropertyType::DoubleArray, "Er.Unspecified.DoubleArray", "DoubleArray" };
+const PropertyInfo Map{ PropertyType::Map, "Er.Unspecified.Map", "Map" };
 
 
 } // namespace Unspecified {}
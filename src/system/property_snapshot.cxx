@@ -0,0 +1,453 @@
+#include <erebus/system/format.hxx>
+#include <erebus/system/property_snapshot.hxx>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+static_assert(std::endian::native == std::endian::little, "Property snapshots are stored little-endian");
+static_assert(sizeof(Er::PropertySnapshot::Header) % Er::PropertySnapshot::Alignment == 0);
+
+namespace Er
+{
+
+namespace
+{
+
+constexpr std::size_t padding(std::size_t size) noexcept
+{
+    return (PropertySnapshot::Alignment - size % PropertySnapshot::Alignment) % PropertySnapshot::Alignment;
+}
+
+constexpr std::size_t aligned(std::size_t size) noexcept
+{
+    return size + padding(size);
+}
+
+template <typename T>
+void append(std::string& out, T v)
+{
+    out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+template <typename T>
+void patch(std::string& out, std::size_t at, T v)
+{
+    std::memcpy(out.data() + at, &v, sizeof(v));
+}
+
+void pad(std::string& out)
+{
+    out.append(padding(out.size()), '\0');
+}
+
+std::uint32_t checkedLength(std::size_t length)
+{
+    if (length > std::numeric_limits<std::uint32_t>::max())
+        ErThrow(Er::format("Property of {} bytes is too large for a snapshot", length));
+
+    return static_cast<std::uint32_t>(length);
+}
+
+template <typename T>
+T read(const char* data) noexcept
+{
+    T v;
+    std::memcpy(&v, data, sizeof(T));
+    return v;
+}
+
+template <typename T>
+void appendArray(std::string& out, const std::vector<T>& a)
+{
+    auto bytes = a.size() * sizeof(T);
+    append(out, checkedLength(bytes));
+    out.append(reinterpret_cast<const char*>(a.data()), bytes);
+}
+
+} // namespace {}
+
+
+PropertySnapshotWriter::~PropertySnapshotWriter()
+{
+    if (!m_closed)
+    {
+        try
+        {
+            close();
+        }
+        catch (...)
+        {
+        }
+    }
+}
+
+PropertySnapshotWriter::PropertySnapshotWriter(const std::string& path)
+    : m_file(path, std::ios::binary | std::ios::out | std::ios::trunc)
+    , m_path(path)
+{
+    if (!m_file)
+        ErThrow(Er::format("Failed to create {}", path));
+
+    // rewritten on close
+    PropertySnapshot::Header header = {};
+    m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    m_offset = sizeof(header);
+}
+
+void PropertySnapshotWriter::write(const PropertyBag& bag)
+{
+    ErAssert(!m_closed);
+
+    m_buffer.clear();
+    encodeRecord(bag);
+
+    m_index.push_back(m_offset);
+    writeBlock(m_buffer);
+}
+
+void PropertySnapshotWriter::close()
+{
+    ErAssert(!m_closed);
+    m_closed = true;
+
+    PropertySnapshot::Header header = {};
+    std::memcpy(header.magic, PropertySnapshot::Magic, sizeof(header.magic));
+    header.version = PropertySnapshot::Version;
+    header.dictionarySize = static_cast<std::uint32_t>(m_dictionary.size());
+    header.recordCount = m_index.size();
+
+    header.dictionaryOffset = m_offset;
+    m_buffer.clear();
+    for (auto& entry : m_dictionary)
+    {
+        append(m_buffer, static_cast<std::uint32_t>(entry.type));
+        append(m_buffer, checkedLength(entry.name.size()));
+        append(m_buffer, checkedLength(entry.readableName.size()));
+        m_buffer.append(entry.name);
+        m_buffer.append(entry.readableName);
+        pad(m_buffer);
+    }
+
+    writeBlock(m_buffer);
+
+    header.indexOffset = m_offset;
+    m_buffer.assign(reinterpret_cast<const char*>(m_index.data()), m_index.size() * sizeof(std::uint64_t));
+    writeBlock(m_buffer);
+
+    m_file.seekp(0);
+    m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    m_file.close();
+
+    if (m_file.fail())
+        ErThrow(Er::format("Failed to write {}", m_path));
+}
+
+std::uint32_t PropertySnapshotWriter::keyOf(const PropertyInfo* info)
+{
+    auto [it, inserted] = m_keys.try_emplace(info->unique(), static_cast<std::uint32_t>(m_dictionary.size()));
+    if (inserted)
+        m_dictionary.push_back({ info->type(), info->name(), info->readableName() });
+
+    return it->second;
+}
+
+void PropertySnapshotWriter::encodeRecord(const PropertyBag& bag)
+{
+    auto start = m_buffer.size();
+    append(m_buffer, std::uint32_t(0));
+    append(m_buffer, std::uint32_t(0));
+
+    std::uint32_t count = 0;
+    for (auto& prop : bag)
+    {
+        if (prop.empty() || !prop.info())
+            continue;
+
+        encodeField(prop);
+        ++count;
+    }
+
+    patch(m_buffer, start, count);
+    patch(m_buffer, start + sizeof(std::uint32_t), checkedLength(m_buffer.size() - start - 2 * sizeof(std::uint32_t)));
+}
+
+void PropertySnapshotWriter::encodeField(const Property& prop)
+{
+    append(m_buffer, keyOf(prop.info()));
+
+    switch (prop.type())
+    {
+    case PropertyType::Bool:
+        append(m_buffer, std::uint32_t(1));
+        append(m_buffer, std::uint8_t(prop.getBool() ? 1 : 0));
+        break;
+    case PropertyType::Int32:
+        append(m_buffer, std::uint32_t(sizeof(std::int32_t)));
+        append(m_buffer, prop.getInt32());
+        break;
+    case PropertyType::UInt32:
+        append(m_buffer, std::uint32_t(sizeof(std::uint32_t)));
+        append(m_buffer, prop.getUInt32());
+        break;
+    case PropertyType::Int64:
+        append(m_buffer, std::uint32_t(sizeof(std::int64_t)));
+        append(m_buffer, prop.getInt64());
+        break;
+    case PropertyType::UInt64:
+        append(m_buffer, std::uint32_t(sizeof(std::uint64_t)));
+        append(m_buffer, prop.getUInt64());
+        break;
+    case PropertyType::Double:
+        append(m_buffer, std::uint32_t(sizeof(double)));
+        append(m_buffer, prop.getDouble());
+        break;
+    case PropertyType::String:
+    {
+        auto s = prop.getStringView();
+        append(m_buffer, checkedLength(s.size()));
+        m_buffer.append(s);
+        break;
+    }
+    case PropertyType::Binary:
+    {
+        auto b = prop.getBinary().bytes();
+        append(m_buffer, checkedLength(b.size()));
+        m_buffer.append(b);
+        break;
+    }
+    case PropertyType::Int32Array: appendArray(m_buffer, prop.getInt32Array()); break;
+    case PropertyType::UInt32Array: appendArray(m_buffer, prop.getUInt32Array()); break;
+    case PropertyType::Int64Array: appendArray(m_buffer, prop.getInt64Array()); break;
+    case PropertyType::UInt64Array: appendArray(m_buffer, prop.getUInt64Array()); break;
+    case PropertyType::DoubleArray: appendArray(m_buffer, prop.getDoubleArray()); break;
+    case PropertyType::Map:
+    {
+        auto start = m_buffer.size();
+        append(m_buffer, std::uint32_t(0));
+        encodeRecord(prop.getMap());
+        patch(m_buffer, start, checkedLength(m_buffer.size() - start - sizeof(std::uint32_t)));
+        break;
+    }
+    default:
+        ErThrow(Er::format("Unsupported property type {}", static_cast<unsigned>(prop.type())));
+    }
+
+    pad(m_buffer);
+}
+
+void PropertySnapshotWriter::writeBlock(const std::string& data)
+{
+    ErAssert(data.size() % PropertySnapshot::Alignment == 0);
+
+    m_file.write(data.data(), data.size());
+    if (!m_file)
+        ErThrow(Er::format("Failed to write {}", m_path));
+
+    m_offset += data.size();
+}
+
+
+struct PropertySnapshotReader::Mapping
+{
+    boost::interprocess::file_mapping file;
+    boost::interprocess::mapped_region region;
+
+    explicit Mapping(const std::string& path)
+        : file(path.c_str(), boost::interprocess::read_only)
+        , region(file, boost::interprocess::read_only)
+    {
+    }
+};
+
+PropertySnapshotReader::~PropertySnapshotReader() = default;
+
+PropertySnapshotReader::PropertySnapshotReader(const std::string& path)
+{
+    try
+    {
+        m_mapping = std::make_shared<const Mapping>(path);
+    }
+    catch (boost::interprocess::interprocess_exception& e)
+    {
+        ErThrow(Er::format("Failed to map {}: {}", path, e.what()));
+    }
+
+    m_data = static_cast<const char*>(m_mapping->region.get_address());
+    auto size = m_mapping->region.get_size();
+
+    if (size < sizeof(PropertySnapshot::Header))
+        ErThrow(Er::format("{} is not a property snapshot", path));
+
+    auto header = read<PropertySnapshot::Header>(m_data);
+    if (std::memcmp(header.magic, PropertySnapshot::Magic, sizeof(header.magic)) != 0)
+        ErThrow(Er::format("{} is not a property snapshot", path));
+
+    if (header.version != PropertySnapshot::Version)
+        ErThrow(Er::format("{} has unsupported snapshot version {}", path, header.version));
+
+    if ((header.dictionaryOffset < sizeof(header)) || (header.dictionaryOffset > header.indexOffset) || (header.indexOffset > size) ||
+        (header.indexOffset % PropertySnapshot::Alignment) || (header.recordCount > (size - header.indexOffset) / sizeof(std::uint64_t)))
+    {
+        ErThrow(Er::format("{} is truncated or corrupt", path));
+    }
+
+    m_records = m_data + sizeof(header);
+    m_recordsEnd = m_data + header.dictionaryOffset;
+    m_index = std::span<const std::uint64_t>(reinterpret_cast<const std::uint64_t*>(m_data + header.indexOffset), header.recordCount);
+
+    // properties are looked up by name so the file does not depend on the IDs of the process that wrote it
+    m_properties.reserve(header.dictionarySize);
+    auto pos = m_recordsEnd;
+    auto end = m_data + header.indexOffset;
+    for (std::uint32_t i = 0; i < header.dictionarySize; ++i)
+    {
+        if (end - pos < 3 * std::ptrdiff_t(sizeof(std::uint32_t)))
+            ErThrow(Er::format("{} is truncated or corrupt", path));
+
+        auto type = read<std::uint32_t>(pos);
+        std::size_t nameLength = read<std::uint32_t>(pos + sizeof(std::uint32_t));
+        std::size_t readableLength = read<std::uint32_t>(pos + 2 * sizeof(std::uint32_t));
+        pos += 3 * sizeof(std::uint32_t);
+
+        if ((type == 0) || (type >= static_cast<std::uint32_t>(PropertyType::Max)) || (std::size_t(end - pos) < nameLength + readableLength))
+            ErThrow(Er::format("{} is truncated or corrupt", path));
+
+        std::string name(pos, nameLength);
+        std::string readableName(pos + nameLength, readableLength);
+        pos += nameLength + readableLength;
+        pos += padding(pos - m_data);
+
+        auto info = Erp::allocateTransientProperty(static_cast<PropertyType>(type), name, readableName);
+        if (info->type() != static_cast<PropertyType>(type))
+            ErThrow(Er::format("Property {} in {} does not match the registered type", name, path));
+
+        m_properties.push_back(std::move(info));
+    }
+}
+
+PropertySnapshotReader::Record PropertySnapshotReader::operator[](std::size_t index) const
+{
+    ErAssert(index < m_index.size());
+
+    auto offset = m_index[index];
+    if ((offset % PropertySnapshot::Alignment) || (offset < std::size_t(m_records - m_data)) || (offset >= std::size_t(m_recordsEnd - m_data)))
+        ErThrow(Er::format("Malformed property snapshot record offset {}", offset));
+
+    return recordAt(m_data + offset, m_recordsEnd);
+}
+
+PropertySnapshotReader::Record PropertySnapshotReader::recordAt(const char* pos, const char* limit) const
+{
+    if (limit - pos < 2 * std::ptrdiff_t(sizeof(std::uint32_t)))
+        ErThrow("Malformed property snapshot record");
+
+    auto count = read<std::uint32_t>(pos);
+    std::size_t size = read<std::uint32_t>(pos + sizeof(std::uint32_t));
+    pos += 2 * sizeof(std::uint32_t);
+
+    if ((size % PropertySnapshot::Alignment) || (std::size_t(limit - pos) < size))
+        ErThrow("Malformed property snapshot record");
+
+    return Record(this, count, pos, pos + size);
+}
+
+Binary PropertySnapshotReader::binary(const char* data, std::size_t length) const
+{
+    return Binary(std::shared_ptr<const void>(m_mapping), std::string_view(data, length));
+}
+
+PropertySnapshotReader::Field PropertySnapshotReader::Record::Iterator::operator*() const
+{
+    ErAssert(m_pos < m_end);
+
+    // records are validated lazily, so a corrupt file fails here rather than at load time
+    if (m_end - m_pos < 2 * std::ptrdiff_t(sizeof(std::uint32_t)))
+        ErThrow("Malformed property snapshot field");
+
+    auto key = read<std::uint32_t>(m_pos);
+    auto length = read<std::uint32_t>(m_pos + sizeof(std::uint32_t));
+    if ((key >= m_reader->m_properties.size()) || (std::size_t(m_end - m_pos) - 2 * sizeof(std::uint32_t) < length))
+        ErThrow("Malformed property snapshot field");
+
+    return Field(m_reader, key, m_pos + 2 * sizeof(std::uint32_t), length);
+}
+
+PropertySnapshotReader::Record::Iterator& PropertySnapshotReader::Record::Iterator::operator++()
+{
+    if (m_end - m_pos < 2 * std::ptrdiff_t(sizeof(std::uint32_t)))
+        ErThrow("Malformed property snapshot field");
+
+    std::size_t length = read<std::uint32_t>(m_pos + sizeof(std::uint32_t));
+    auto step = 2 * sizeof(std::uint32_t) + aligned(length);
+    if (std::size_t(m_end - m_pos) < step)
+        ErThrow("Malformed property snapshot field");
+
+    m_pos += step;
+    return *this;
+}
+
+PropertyBag PropertySnapshotReader::Record::bag() const
+{
+    return bag(0);
+}
+
+PropertyBag PropertySnapshotReader::Record::bag(unsigned depth) const
+{
+    if (depth > MaxDepth)
+        ErThrow("Malformed property snapshot record: nested too deep");
+
+    // the count is not trusted, but every field takes at least its key and length
+    PropertyBag bag;
+    bag.reserve(std::min<std::size_t>(m_count, std::size_t(m_end - m_begin) / (2 * sizeof(std::uint32_t))));
+
+    for (auto field : *this)
+        bag.push_back(field.property(depth));
+
+    if (bag.size() != m_count)
+        ErThrow("Malformed property snapshot record");
+
+    return bag;
+}
+
+PropertySnapshotReader::Record PropertySnapshotReader::Field::record() const
+{
+    ErAssert(type() == PropertyType::Map);
+    return m_reader->recordAt(m_data, m_data + m_length);
+}
+
+Property PropertySnapshotReader::Field::property() const
+{
+    return property(0);
+}
+
+Property PropertySnapshotReader::Field::property(unsigned depth) const
+{
+    auto& inf = *info();
+
+    switch (inf.type())
+    {
+    case PropertyType::Bool: return Property(get<Bool>(), inf);
+    case PropertyType::Int32: return Property(get<std::int32_t>(), inf);
+    case PropertyType::UInt32: return Property(get<std::uint32_t>(), inf);
+    case PropertyType::Int64: return Property(get<std::int64_t>(), inf);
+    case PropertyType::UInt64: return Property(get<std::uint64_t>(), inf);
+    case PropertyType::Double: return Property(get<double>(), inf);
+    case PropertyType::String: return Property(raw(), inf);
+    case PropertyType::Binary: return Property(get<Binary>(), inf);
+    case PropertyType::Int32Array: return Property(get<std::span<const std::int32_t>>(), inf);
+    case PropertyType::UInt32Array: return Property(get<std::span<const std::uint32_t>>(), inf);
+    case PropertyType::Int64Array: return Property(get<std::span<const std::int64_t>>(), inf);
+    case PropertyType::UInt64Array: return Property(get<std::span<const std::uint64_t>>(), inf);
+    case PropertyType::DoubleArray: return Property(get<std::span<const double>>(), inf);
+    case PropertyType::Map: return Property(record().bag(depth + 1), inf);
+    default: break;
+    }
+
+    ErThrow(Er::format("Unsupported property type {}", static_cast<unsigned>(inf.type())));
+}
+
+} // namespace Er {}
@@ -0,0 +1,249 @@
+#include <erebus/system/exception.hxx>
+#include <erebus/system/format.hxx>
+#include <erebus/system/snapshot_diff.hxx>
+
+
+namespace Er
+{
+
+namespace
+{
+
+Property changeOf(SnapshotDiff::Change change)
+{
+    return Property(static_cast<std::uint32_t>(change), SnapshotDiff::ChangeProperty);
+}
+
+// properties usually keep their positions between snapshots, so the expected one is tried first
+const Property* findAt(const PropertyBag& bag, std::size_t& position, std::uint32_t unique) noexcept
+{
+    if ((position < bag.size()) && (bag[position].unique() == unique))
+        return &bag[position++];
+
+    for (std::size_t i = 0; i < bag.size(); ++i)
+    {
+        if (bag[i].unique() == unique)
+        {
+            position = i + 1;
+            return &bag[i];
+        }
+    }
+
+    return nullptr;
+}
+
+PropertyBag addedFrame(const PropertyBag& record)
+{
+    PropertyBag frame;
+    frame.reserve(record.size() + 1);
+    frame.push_back(changeOf(SnapshotDiff::Change::Added));
+    frame.insert(frame.end(), record.begin(), record.end());
+    return frame;
+}
+
+} // namespace {}
+
+
+const PropertyInfo SnapshotDiff::ChangeProperty{ PropertyType::UInt32, "Er.Snapshot.change", "Snapshot change" };
+
+
+SnapshotDiff::Delta::~Delta()
+{
+    if (m_owner)
+        m_owner->abandon(m_generation);
+}
+
+SnapshotDiff::Delta::Delta(Delta&& other) noexcept
+    : m_owner(std::exchange(other.m_owner, nullptr))
+    , m_generation(other.m_generation)
+    , m_frames(std::move(other.m_frames))
+    , m_next(other.m_next)
+{
+}
+
+SnapshotDiff::Delta& SnapshotDiff::Delta::operator=(Delta&& other) noexcept
+{
+    if (this != &other)
+    {
+        if (m_owner)
+            m_owner->abandon(m_generation);
+
+        m_owner = std::exchange(other.m_owner, nullptr);
+        m_generation = other.m_generation;
+        m_frames = std::move(other.m_frames);
+        m_next = other.m_next;
+    }
+
+    return *this;
+}
+
+PropertyBag SnapshotDiff::Delta::next()
+{
+    PropertyBag frame;
+    if (m_next < m_frames.size())
+        frame = std::move(m_frames[m_next++]);
+
+    if ((m_next == m_frames.size()) && m_owner)
+    {
+        m_owner->commit(m_generation);
+        m_owner = nullptr;
+    }
+
+    return frame;
+}
+
+SnapshotDiff::Delta SnapshotDiff::diff(const std::vector<PropertyBag>& snapshot)
+{
+    // the client may be applying the frames of the outstanding diff right now
+    if (m_outstanding)
+        reset();
+
+    Records current;
+    current.reserve(snapshot.size());
+
+    std::vector<PropertyBag> frames;
+    if (!m_valid)
+        frames.push_back(PropertyBag{ changeOf(Change::Reset) });
+
+    PropertyBag changed;
+    for (auto& record : snapshot)
+    {
+        auto key = Er::find(record, *m_key);
+        if (!key)
+            ErThrow(Er::format("Snapshot record has no {}", m_key->name()));
+
+        if (!current.try_emplace(*key, record).second)
+            ErThrow(Er::format("Duplicate snapshot record {}", key->str()));
+
+        auto prev = m_valid ? m_base.find(*key) : m_base.end();
+        if (prev == m_base.end())
+        {
+            frames.push_back(addedFrame(record));
+            continue;
+        }
+
+        changed.clear();
+        std::size_t matched = 0;
+        std::size_t position = 0;
+        for (auto& prop : record)
+        {
+            auto old = findAt(prev->second, position, prop.unique());
+            if (old)
+                ++matched;
+
+            if (!old || !(*old == prop))
+                changed.push_back(prop);
+        }
+
+        if (matched < prev->second.size())
+        {
+            // properties cannot be removed one by one
+            frames.push_back(addedFrame(record));
+        }
+        else if (!changed.empty())
+        {
+            PropertyBag frame;
+            frame.reserve(changed.size() + 2);
+            frame.push_back(changeOf(Change::Modified));
+            frame.push_back(*key);
+            frame.insert(frame.end(), changed.begin(), changed.end());
+            frames.push_back(std::move(frame));
+        }
+    }
+
+    if (m_valid)
+    {
+        for (auto& [key, record] : m_base)
+        {
+            if (!current.contains(key))
+                frames.push_back(PropertyBag{ changeOf(Change::Removed), key });
+        }
+    }
+
+    m_pending = std::move(current);
+    m_outstanding = true;
+    return Delta(this, ++m_generation, std::move(frames));
+}
+
+void SnapshotDiff::reset() noexcept
+{
+    m_base.clear();
+    m_pending.clear();
+    m_valid = false;
+    m_outstanding = false;
+    ++m_generation;
+}
+
+void SnapshotDiff::commit(std::uint64_t generation) noexcept
+{
+    if (generation != m_generation)
+        return;
+
+    m_base = std::move(m_pending);
+    m_pending.clear();
+    m_valid = true;
+    m_outstanding = false;
+}
+
+void SnapshotDiff::abandon(std::uint64_t generation) noexcept
+{
+    if (generation == m_generation)
+        reset();
+}
+
+
+void SnapshotMirror::apply(const PropertyBag& frame)
+{
+    if (frame.empty() || (frame[0].unique() != SnapshotDiff::ChangeProperty.unique()) || (frame[0].type() != PropertyType::UInt32))
+        ErThrow("Snapshot frame has no change");
+
+    auto change = static_cast<SnapshotDiff::Change>(frame[0].getUInt32());
+    if (change == SnapshotDiff::Change::Reset)
+    {
+        m_records.clear();
+        return;
+    }
+
+    auto key = Er::find(frame, *m_key);
+    if (!key)
+        ErThrow(Er::format("Snapshot frame has no {}", m_key->name()));
+
+    switch (change)
+    {
+    case SnapshotDiff::Change::Added:
+        m_records.insert_or_assign(*key, PropertyBag(frame.begin() + 1, frame.end()));
+        break;
+
+    case SnapshotDiff::Change::Modified:
+    {
+        auto it = m_records.find(*key);
+        if (it == m_records.end())
+            ErThrow(Er::format("Modified snapshot record {} does not exist", key->str()));
+
+        auto& record = it->second;
+        std::size_t position = 0;
+        for (std::size_t i = 1; i < frame.size(); ++i)
+        {
+            auto& prop = frame[i];
+            if (&prop == key)
+                continue;
+
+            if (auto old = findAt(record, position, prop.unique()))
+                record[old - record.data()] = prop;
+            else
+                record.push_back(prop);
+        }
+
+        break;
+    }
+
+    case SnapshotDiff::Change::Removed:
+        m_records.erase(*key);
+        break;
+
+    default:
+        ErThrow(Er::format("Unknown snapshot change {}", frame[0].getUInt32()));
+    }
+}
+
+} // namespace Er {}
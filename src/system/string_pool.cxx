@@ -0,0 +1,180 @@
+#include <erebus/system/string_pool.hxx>
+
+#include <array>
+#include <mutex>
+#include <unordered_set>
+
+
+namespace Er
+{
+
+namespace
+{
+
+// a shard is swept for unreferenced strings whenever it doubles in size
+constexpr std::size_t MinSweep = 256;
+
+} // namespace {}
+
+
+struct alignas(64) StringPool::Shard
+{
+    static std::string_view view(const Node* node) noexcept
+    {
+        return std::get<std::string>(node->data);
+    }
+
+    struct Hash
+    {
+        using is_transparent = void;
+
+        std::size_t operator()(std::string_view v) const noexcept
+        {
+            return std::hash<std::string_view>{}(v);
+        }
+
+        std::size_t operator()(const Node* node) const noexcept
+        {
+            return (*this)(view(node));
+        }
+    };
+
+    struct Equal
+    {
+        using is_transparent = void;
+
+        bool operator()(const Node* a, const Node* b) const noexcept
+        {
+            return a == b;
+        }
+
+        bool operator()(std::string_view a, const Node* b) const noexcept
+        {
+            return a == view(b);
+        }
+
+        bool operator()(const Node* a, std::string_view b) const noexcept
+        {
+            return view(a) == b;
+        }
+    };
+
+    std::mutex lock;
+    std::unordered_set<Node*, Hash, Equal> nodes;
+    std::size_t sweepAt = MinSweep;
+
+    // a node referenced by the pool alone stays that way: new references are only given out under the lock
+    std::size_t sweep() noexcept
+    {
+        std::size_t freed = 0;
+        for (auto it = nodes.begin(); it != nodes.end();)
+        {
+            auto node = *it;
+            if (node->refs.load(std::memory_order_acquire) == 1)
+            {
+                it = nodes.erase(it);
+                node->release();
+                ++freed;
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        return freed;
+    }
+};
+
+
+StringPool::Shard* StringPool::shards() noexcept
+{
+    static std::array<Shard, ShardCount> s_shards;
+    return s_shards.data();
+}
+
+StringPool::Shard& StringPool::shard(std::string_view v) noexcept
+{
+    // the low bits pick the bucket within the shard, so fold the high half in; size_t may be 32-bit
+    auto h = Shard::Hash{}(v);
+    return shards()[(h ^ (h >> (sizeof(h) * 4))) % ShardCount];
+}
+
+Property StringPool::intern(std::string_view v, const PropertyInfo& info)
+{
+    ErAssert(info.type() == PropertyType::String);
+
+    if (v.size() <= Property::InlineCapacity)
+        return Property(v, info);
+
+    auto& s = shard(v);
+    Node* node = nullptr;
+
+    {
+        std::lock_guard l(s.lock);
+
+        auto it = s.nodes.find(v);
+        if (it != s.nodes.end())
+        {
+            node = *it;
+            node->addRef();
+        }
+        else
+        {
+            if (s.nodes.size() >= s.sweepAt)
+            {
+                s.sweep();
+                s.sweepAt = std::max(MinSweep, s.nodes.size() * 2);
+            }
+
+            auto fresh = std::make_unique<Node>(std::string(v));
+            fresh->interned = true;
+            fresh->addRef(); // the one the pool keeps
+
+            s.nodes.insert(fresh.get());
+            node = fresh.release();
+        }
+    }
+
+    Property prop;
+    prop._setShared(node, info);
+    return prop;
+}
+
+Property StringPool::intern(const Property& prop)
+{
+    if ((prop.type() != PropertyType::String) || prop.isInline() || prop.m_u._shared->interned)
+        return prop;
+
+    // a short value comes back inline, as from the other overload
+    return intern(prop.getStringView(), *prop.info());
+}
+
+std::size_t StringPool::size() noexcept
+{
+    std::size_t n = 0;
+    for (std::size_t i = 0; i < ShardCount; ++i)
+    {
+        auto& s = shards()[i];
+        std::lock_guard l(s.lock);
+        n += s.nodes.size();
+    }
+
+    return n;
+}
+
+std::size_t StringPool::purge() noexcept
+{
+    std::size_t freed = 0;
+    for (std::size_t i = 0; i < ShardCount; ++i)
+    {
+        auto& s = shards()[i];
+        std::lock_guard l(s.lock);
+        freed += s.sweep();
+        s.sweepAt = std::max(MinSweep, s.nodes.size() * 2);
+    }
+
+    return freed;
+}
+
+} // namespace Er {}
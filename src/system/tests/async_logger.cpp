@@ -0,0 +1,370 @@
+#include "common.hpp"
+
+#include <map>
+#include <thread>
+
+
+namespace
+{
+
+class CountingSink
+    : public Er::Log2::ISink
+{
+public:
+    explicit CountingSink(Er::Log2::Level level = Er::Log2::Level::Debug)
+        : m_level(level)
+    {
+    }
+
+    bool accepts(const Er::Log2::Record* r) const override
+    {
+        return r->level() >= m_level;
+    }
+
+    void write(Er::Log2::Record::Ptr r) override
+    {
+        std::lock_guard l(m_mutex);
+        m_records.push_back(r);
+    }
+
+    void flush() override
+    {
+    }
+
+    std::vector<Er::Log2::Record::Ptr> grab()
+    {
+        std::lock_guard l(m_mutex);
+        return std::move(m_records);
+    }
+
+private:
+    const Er::Log2::Level m_level;
+    std::mutex m_mutex;
+    std::vector<Er::Log2::Record::Ptr> m_records;
+};
+
+struct Formatted
+{
+    static std::atomic<int> count;
+    int value = 0;
+};
+
+std::atomic<int> Formatted::count = 0;
+
+struct Throwing
+{
+};
+
+} // namespace {}
+
+
+template <>
+struct fmt::formatter<Formatted>
+    : fmt::formatter<int>
+{
+    auto format(const Formatted& v, format_context& ctx) const
+    {
+        ++Formatted::count;
+        return fmt::formatter<int>::format(v.value, ctx);
+    }
+};
+
+template <>
+struct fmt::formatter<Throwing>
+    : fmt::formatter<int>
+{
+    auto format(const Throwing&, format_context& ctx) const -> decltype(ctx.out())
+    {
+        throw std::runtime_error("no way");
+    }
+};
+
+template <>
+struct Er::Log2::IsDeferrable<Formatted>
+    : public std::true_type
+{
+};
+
+template <>
+struct Er::Log2::IsDeferrable<Throwing>
+    : public std::true_type
+{
+};
+
+
+TEST(AsyncLogger, Flush)
+{
+    auto sink = std::make_shared<CountingSink>();
+    auto log = Er::Log2::makeLogger({}, std::chrono::milliseconds(1000));
+    log->addSink("counting", sink);
+
+    for (int i = 0; i < 10; ++i)
+        log->write(Er::Log2::Record::make(Er::Log2::Level::Info, Er::System::PackedTime::now(), Er::System::CurrentThread::id(), std::to_string(i)));
+
+    // the threshold is not reached, but flush() sends them out anyway
+    log->flush();
+
+    auto records = sink->grab();
+    ASSERT_EQ(records.size(), 10);
+    for (int i = 0; i < 10; ++i)
+        EXPECT_EQ(records[i]->message(), std::to_string(i));
+}
+
+TEST(AsyncLogger, Threads)
+{
+    constexpr std::size_t Threads = 8;
+    constexpr std::size_t Records = 5000; // more than a ring holds
+
+    auto sink = std::make_shared<CountingSink>();
+    auto log = Er::Log2::makeLogger();
+    log->addSink("counting", sink);
+
+    std::vector<std::jthread> workers;
+    for (std::size_t t = 0; t < Threads; ++t)
+    {
+        workers.emplace_back(
+            [log, t]()
+            {
+                for (std::size_t i = 0; i < Records; ++i)
+                    log->write(Er::Log2::Record::make(Er::Log2::Level::Info, Er::System::PackedTime::now(), t, std::to_string(i)));
+            });
+    }
+
+    workers.clear();
+    log->flush();
+
+    auto records = sink->grab();
+    ASSERT_EQ(records.size(), Threads * Records);
+
+    // each thread's records come out in the order they were written
+    std::map<std::uintptr_t, std::size_t> next;
+    for (auto& r : records)
+    {
+        auto& n = next[r->tid()];
+        EXPECT_EQ(r->message(), std::to_string(n));
+        ++n;
+    }
+}
+
+TEST(AsyncLogger, Deferred)
+{
+    auto sink = std::make_shared<CountingSink>(Er::Log2::Level::Warning);
+    auto log = Er::Log2::makeLogger();
+    log->addSink("counting", sink);
+
+    Formatted::count = 0;
+
+    {
+        std::string temporary("copied");
+        Er::Log2::writeDeferred(log.get(), Er::Log2::Level::Info, "{} {}", Formatted{ 1 }, temporary);
+        Er::Log2::writeDeferred(log.get(), Er::Log2::Level::Warning, "{} {}", Formatted{ 2 }, temporary);
+    }
+
+    log->flush();
+
+    // nobody wanted the first one, so it was never formatted
+    EXPECT_EQ(Formatted::count, 1);
+
+    auto records = sink->grab();
+    ASSERT_EQ(records.size(), 1);
+    EXPECT_FALSE(records[0]->deferred());
+    EXPECT_EQ(records[0]->message(), "2 copied");
+}
+
+TEST(AsyncLogger, FullRing)
+{
+    // writes to the logger it is attached to, from the Logger thread
+    class EchoSink
+        : public CountingSink
+    {
+    public:
+        explicit EchoSink(Er::Log2::ILogger* log)
+            : m_log(log)
+        {
+        }
+
+        void write(Er::Log2::Record::Ptr r) override
+        {
+            if (r->message() == "echo")
+            {
+                for (std::size_t i = 0; i < 3000; ++i)
+                    m_log->write(Er::Log2::Record::make(Er::Log2::Level::Info, Er::System::PackedTime::now(), Er::System::CurrentThread::id(), "echoed"));
+            }
+
+            CountingSink::write(r);
+        }
+
+    private:
+        Er::Log2::ILogger* m_log;
+    };
+
+    auto log = Er::Log2::makeLogger();
+    auto sink = std::make_shared<EchoSink>(log.get());
+    log->addSink("echo", sink);
+
+    log->write(Er::Log2::Record::make(Er::Log2::Level::Info, Er::System::PackedTime::now(), Er::System::CurrentThread::id(), "echo"));
+
+    // the Logger thread cannot wait for itself, so what does not fit is dropped
+    log->flush();
+    log->flush();
+
+    auto records = sink->grab();
+    ASSERT_GT(records.size(), 2);
+    EXPECT_LT(records.size(), 3002);
+    EXPECT_TRUE(std::any_of(records.begin(), records.end(), [](auto& r) { return r->message().ends_with("log records dropped"); }));
+}
+
+TEST(AsyncLogger, Block)
+{
+    // takes its time, so that the writer gets ahead of the Logger thread
+    class SlowSink
+        : public CountingSink
+    {
+    public:
+        void write(Er::Log2::Record::Ptr r) override
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            CountingSink::write(r);
+        }
+    };
+
+    constexpr std::size_t Records = 200;
+
+    Er::Log2::AsyncLoggerOptions options;
+    options.capacity = 8;
+    options.overflow = Er::Log2::Overflow::Block;
+    options.maxWait = std::chrono::milliseconds(1);
+
+    auto sink = std::make_shared<SlowSink>();
+    auto log = Er::Log2::makeLogger({}, {}, options);
+    log->addSink("slow", sink);
+
+    for (std::size_t i = 0; i < Records; ++i)
+        log->write(Er::Log2::Record::make(Er::Log2::Level::Info, Er::System::PackedTime::now(), Er::System::CurrentThread::id(), std::to_string(i)));
+
+    log->flush();
+
+    // nothing dropped, however long it took
+    auto records = sink->grab();
+    ASSERT_EQ(records.size(), Records);
+    for (std::size_t i = 0; i < Records; ++i)
+        EXPECT_EQ(records[i]->message(), std::to_string(i));
+}
+
+TEST(AsyncLogger, DropWaitsOnce)
+{
+    // holds the Logger thread until released
+    class StuckSink
+        : public CountingSink
+    {
+    public:
+        void write(Er::Log2::Record::Ptr r) override
+        {
+            released.wait(false);
+            CountingSink::write(r);
+        }
+
+        std::atomic<bool> released = false;
+    };
+
+    constexpr std::size_t Records = 40;
+
+    Er::Log2::AsyncLoggerOptions options;
+    options.capacity = 8;
+    options.overflow = Er::Log2::Overflow::Drop;
+    options.maxWait = std::chrono::milliseconds(50);
+
+    auto sink = std::make_shared<StuckSink>();
+    auto log = Er::Log2::makeLogger({}, {}, options);
+    log->addSink("stuck", sink);
+
+    auto started = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < Records; ++i)
+        log->write(Er::Log2::Record::make(Er::Log2::Level::Info, Er::System::PackedTime::now(), Er::System::CurrentThread::id(), std::to_string(i)));
+
+    // the first record that did not fit waited, the rest were dropped at once
+    auto elapsed = std::chrono::steady_clock::now() - started;
+    EXPECT_GE(elapsed, options.maxWait);
+    EXPECT_LT(elapsed, options.maxWait * 10);
+
+    sink->released = true;
+    sink->released.notify_all();
+    log->flush();
+
+    auto records = sink->grab();
+    ASSERT_GT(records.size(), options.capacity);
+    EXPECT_LT(records.size(), Records);
+    EXPECT_TRUE(std::any_of(records.begin(), records.end(), [](auto& r) { return r->message().ends_with("log records dropped"); }));
+
+    // there is room again, so nothing is dropped any more
+    log->write(Er::Log2::Record::make(Er::Log2::Level::Info, Er::System::PackedTime::now(), Er::System::CurrentThread::id(), "after"));
+    log->flush();
+
+    records = sink->grab();
+    ASSERT_EQ(records.size(), 1);
+    EXPECT_EQ(records[0]->message(), "after");
+}
+
+TEST(AsyncLogger, Grow)
+{
+    class EchoSink
+        : public CountingSink
+    {
+    public:
+        explicit EchoSink(Er::Log2::ILogger* log)
+            : m_log(log)
+        {
+        }
+
+        void write(Er::Log2::Record::Ptr r) override
+        {
+            if (r->message() == "echo")
+            {
+                for (std::size_t i = 0; i < 3000; ++i)
+                    m_log->write(Er::Log2::Record::make(Er::Log2::Level::Info, Er::System::PackedTime::now(), Er::System::CurrentThread::id(), std::to_string(i)));
+            }
+
+            CountingSink::write(r);
+        }
+
+    private:
+        Er::Log2::ILogger* m_log;
+    };
+
+    Er::Log2::AsyncLoggerOptions options;
+    options.capacity = 16;
+    options.overflow = Er::Log2::Overflow::Grow;
+
+    auto log = Er::Log2::makeLogger({}, {}, options);
+    auto sink = std::make_shared<EchoSink>(log.get());
+    log->addSink("echo", sink);
+
+    log->write(Er::Log2::Record::make(Er::Log2::Level::Info, Er::System::PackedTime::now(), Er::System::CurrentThread::id(), "echo"));
+
+    // even the Logger thread itself gets all its records through, in order
+    log->flush();
+    log->flush();
+
+    auto records = sink->grab();
+    ASSERT_EQ(records.size(), 3001);
+    EXPECT_EQ(records[0]->message(), "echo");
+    for (std::size_t i = 0; i < 3000; ++i)
+        EXPECT_EQ(records[i + 1]->message(), std::to_string(i));
+}
+
+TEST(AsyncLogger, DeferredFailure)
+{
+    auto sink = std::make_shared<CountingSink>();
+    auto log = Er::Log2::makeLogger();
+    log->addSink("counting", sink);
+
+    // the Logger thread survives a formatter that throws
+    Er::Log2::writeDeferred(log.get(), Er::Log2::Level::Info, "value {}", Throwing{});
+    Er::Log2::writeDeferred(log.get(), Er::Log2::Level::Info, "value {}", 1);
+    log->flush();
+
+    auto records = sink->grab();
+    ASSERT_EQ(records.size(), 2);
+    EXPECT_EQ(records[0]->message(), "value {} [failed to format: no way]");
+    EXPECT_EQ(records[1]->message(), "value 1");
+}
@@ -0,0 +1,100 @@
+#include "common.hpp"
+
+#include <erebus/system/property.hxx>
+#include <erebus/system/util/hex.hxx>
+
+#include <sstream>
+
+
+TEST(Binary, Sharing)
+{
+    std::string s(1024, 'x');
+    auto data = s.data();
+
+    // the string buffer is taken over
+    Er::Binary b1(std::move(s));
+    EXPECT_EQ(b1.data(), data);
+    EXPECT_EQ(b1.size(), 1024);
+
+    // copies share it
+    Er::Binary b2(b1);
+    EXPECT_EQ(b2.data(), data);
+    EXPECT_EQ(b2.owner(), b1.owner());
+    EXPECT_TRUE(b1 == b2);
+
+    Er::Property p(b2, Er::Unspecified::Binary);
+    EXPECT_EQ(p.getBinary().data(), data);
+
+    Er::Binary b3(std::move(b2));
+    EXPECT_TRUE(b2.empty());
+    EXPECT_FALSE(b2.owner());
+    EXPECT_EQ(b3.data(), data);
+}
+
+TEST(Binary, Slice)
+{
+    Er::Binary b(std::string_view("0123456789"));
+
+    auto s1 = b.slice(2, 3);
+    EXPECT_EQ(s1.bytes(), "234");
+    EXPECT_EQ(s1.data(), b.data() + 2);
+    EXPECT_EQ(s1.owner(), b.owner());
+
+    auto s2 = s1.slice(1);
+    EXPECT_EQ(s2.bytes(), "34");
+
+    // out of range slices are clamped
+    EXPECT_EQ(b.slice(8, 100).bytes(), "89");
+    EXPECT_TRUE(b.slice(100).empty());
+
+    // a slice outlives the Binary it was taken from
+    Er::Binary s3;
+    {
+        Er::Binary tmp(std::string(100, 'y'));
+        s3 = tmp.slice(90);
+    }
+    EXPECT_EQ(s3.bytes(), std::string(10, 'y'));
+}
+
+TEST(Binary, ForeignBuffer)
+{
+    static const char Mapped[] = "mapped bytes";
+    bool released = false;
+
+    {
+        std::shared_ptr<const void> owner(Mapped, [&released](const void*) { released = true; });
+        Er::Binary b(std::move(owner), std::string_view(Mapped, sizeof(Mapped) - 1));
+        EXPECT_EQ(b.data(), Mapped);
+
+        auto s = b.slice(7);
+        b = Er::Binary();
+        EXPECT_FALSE(released);
+        EXPECT_EQ(s.bytes(), "bytes");
+    }
+
+    EXPECT_TRUE(released);
+}
+
+TEST(Binary, Hex)
+{
+    // lengths around the 16-byte vector width, checked against the ostream output
+    for (std::size_t length : { 0, 1, 15, 16, 17, 31, 32, 33, 100 })
+    {
+        std::string bytes;
+        for (std::size_t i = 0; i < length; ++i)
+            bytes.push_back(static_cast<char>(i * 37 + 5));
+
+        Er::Binary b(bytes);
+
+        std::ostringstream expected;
+        expected << b;
+
+        Er::FormatBuffer out;
+        out.push_back('>');
+        Er::Util::hexEncodeTo(out, b.data(), b.size());
+        EXPECT_EQ(Er::Format::to_string(out), ">" + expected.str());
+
+        Er::Property prop(b, Er::Unspecified::Binary);
+        EXPECT_EQ(prop.str(), expected.str());
+    }
+}
@@ -0,0 +1,116 @@
+#include "common.hpp"
+
+#include <erebus/system/format.hxx>
+#include <erebus/system/indexed_property_bag.hxx>
+
+#include <memory>
+
+
+namespace
+{
+
+const std::size_t InfoCount = 100;
+
+// persistent properties stay in the registry for good, so they must outlive every test
+const std::vector<std::unique_ptr<Er::PropertyInfo>>& makeInfos()
+{
+    static std::vector<std::unique_ptr<Er::PropertyInfo>> infos = []()
+    {
+        std::vector<std::unique_ptr<Er::PropertyInfo>> v;
+        v.reserve(InfoCount);
+        for (std::size_t i = 0; i < InfoCount; ++i)
+        {
+            auto name = Er::format("Er.Test.IndexedPropertyBag.{}", i);
+            v.push_back(std::make_unique<Er::PropertyInfo>(Er::PropertyType::UInt32, name, name));
+        }
+
+        return v;
+    }();
+
+    return infos;
+}
+
+} // namespace {}
+
+
+TEST(Er_IndexedPropertyBag, find)
+{
+    const std::size_t count = InfoCount;
+    auto& infos = makeInfos();
+
+    Er::IndexedPropertyBag bag;
+    EXPECT_FALSE(bag.find(*infos[0]));
+
+    for (std::size_t i = 0; i < count; ++i)
+        bag.push_back(Er::Property(std::uint32_t(i), *infos[i]));
+
+    ASSERT_EQ(bag.size(), count);
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        auto prop = bag.find(*infos[i]);
+        ASSERT_TRUE(prop);
+        EXPECT_EQ(prop->info(), infos[i].get());
+        EXPECT_EQ(prop->getUInt32(), i);
+
+        auto v = Er::get<std::uint32_t>(bag, *infos[i]);
+        ASSERT_TRUE(v);
+        EXPECT_EQ(*v, i);
+    }
+
+    EXPECT_FALSE(bag.find(Er::Unspecified::String));
+    EXPECT_FALSE(Er::get<std::string>(bag, Er::Unspecified::String));
+
+    // iteration order is insertion order
+    std::uint32_t expected = 0;
+    for (auto& prop : bag)
+        EXPECT_EQ(prop.getUInt32(), expected++);
+}
+
+TEST(Er_IndexedPropertyBag, fromBag)
+{
+    Er::PropertyBag source;
+    source.push_back(Er::Property(std::string("first"), Er::Unspecified::String));
+    source.push_back(Er::Property(std::int32_t(-1), Er::Unspecified::Int32));
+    source.push_back(Er::Property(std::string("second"), Er::Unspecified::String));
+
+    Er::IndexedPropertyBag bag(source);
+    EXPECT_EQ(bag.size(), source.size());
+    EXPECT_EQ(bag.bag(), source);
+
+    // duplicates resolve to the first occurrence, as with a plain bag
+    auto s = Er::get<std::string>(bag, Er::Unspecified::String);
+    ASSERT_TRUE(s);
+    EXPECT_EQ(*s, "first");
+    EXPECT_EQ(*Er::get<std::string>(source, Er::Unspecified::String), *s);
+
+    auto i = Er::get<std::int32_t>(bag, Er::Unspecified::Int32);
+    ASSERT_TRUE(i);
+    EXPECT_EQ(*i, -1);
+
+    auto released = bag.release();
+    EXPECT_EQ(released, source);
+    EXPECT_TRUE(bag.empty());
+    EXPECT_FALSE(bag.find(Er::Unspecified::Int32));
+}
+
+TEST(Er_IndexedPropertyBag, update)
+{
+    Er::IndexedPropertyBag bag;
+
+    EXPECT_TRUE(Er::update(bag, Er::Property(std::uint64_t(1), Er::Unspecified::UInt64)));
+    EXPECT_TRUE(Er::update(bag, Er::Property(std::string("a"), Er::Unspecified::String)));
+    EXPECT_EQ(bag.size(), 2);
+
+    EXPECT_FALSE(Er::update(bag, Er::Property(std::uint64_t(1), Er::Unspecified::UInt64)));
+    EXPECT_TRUE(Er::update(bag, Er::Property(std::uint64_t(2), Er::Unspecified::UInt64)));
+    EXPECT_EQ(bag.size(), 2);
+    EXPECT_EQ(*Er::get<std::uint64_t>(bag, Er::Unspecified::UInt64), 2);
+
+    bag.clear();
+    EXPECT_TRUE(bag.empty());
+    EXPECT_FALSE(bag.find(Er::Unspecified::UInt64));
+
+    EXPECT_TRUE(Er::update(bag, Er::Property(std::uint64_t(3), Er::Unspecified::UInt64)));
+    EXPECT_EQ(*Er::get<std::uint64_t>(bag, Er::Unspecified::UInt64), 3);
+}
@@ -0,0 +1,49 @@
+#include "common.hpp"
+
+
+namespace
+{
+
+Er::Log2::Record::Ptr makeRecord(std::string_view text)
+{
+    return Er::Log2::Record::make(Er::Log2::Level::Info, Er::System::PackedTime::now(), Er::System::CurrentThread::id(), text);
+}
+
+} // namespace {}
+
+
+TEST(Log2_Record, Reuse)
+{
+    const void* first = nullptr;
+
+    {
+        auto r = makeRecord("first");
+        auto copy = r;
+        EXPECT_EQ(copy->message(), "first");
+
+        first = r.get();
+    }
+
+    // the block went back to this thread's free list
+    auto r = makeRecord("second");
+    EXPECT_EQ(r.get(), first);
+    EXPECT_EQ(r->message(), "second");
+}
+
+TEST(Log2_Record, LongMessages)
+{
+    // from a large block, and from the heap
+    for (std::size_t length : { 200, 700, 5000 })
+    {
+        std::string text(length, 'x');
+        auto r = makeRecord(text);
+        EXPECT_EQ(r->message(), text);
+    }
+
+    // formatted text that does not fit into the block
+    std::string arg(3000, 'y');
+    auto r = Er::Log2::Record::makeDeferred(Er::Log2::Level::Info, Er::System::PackedTime::now(), Er::System::CurrentThread::id(), "<{}>", arg);
+    EXPECT_TRUE(r->deferred());
+    EXPECT_EQ(r->message(), "<" + arg + ">");
+    EXPECT_FALSE(r->deferred());
+}
@@ -3,6 +3,7 @@
 #include <erebus/system/luaxx.hxx>
 #include <erebus/system/luaxx/luaxx_tuple.hxx>
 #include <erebus/system/luaxx/luaxx_int64.hxx>
+#include <erebus/system/string_pool.hxx>
 
 TEST(Er_Lua, PropertyTypes)
 {
@@ -34,6 +35,12 @@ TEST(Er_Lua, PropertyTypes)
 
     type = state["Er"]["PropertyType"]["Binary"];
     EXPECT_EQ(type, static_cast<uint32_t>(Er::PropertyType::Binary));
+
+    type = state["Er"]["PropertyType"]["Int32Array"];
+    EXPECT_EQ(type, static_cast<uint32_t>(Er::PropertyType::Int32Array));
+
+    type = state["Er"]["PropertyType"]["DoubleArray"];
+    EXPECT_EQ(type, static_cast<uint32_t>(Er::PropertyType::DoubleArray));
 }
 
 
@@ -303,6 +310,11 @@ function set_binary(prop, v)
     Er.Property.setBinary(prop, v)
     return old
 end
+function set_interned_string(prop, v)
+    local old = Er.Property.getString(prop)
+    Er.Property.setInternedString(prop, v)
+    return old
+end
 )";
 
 
@@ -375,4 +387,102 @@ TEST(Er_Lua, PropertySet)
         std::string old2 = state["set_binary"](prop, std::string("ccc"));
         EXPECT_STREQ(old2.c_str(), "bbb");
     }
-}
\ No newline at end of file
+
+    {
+        const std::string value("/usr/lib/erebus/test/lua/interned-string");
+        Er::Property prop(std::string("aaa"), Er::Unspecified::String);
+        std::string old = state["set_interned_string"](prop, value);
+        EXPECT_STREQ(old.c_str(), "aaa");
+        EXPECT_EQ(prop.getStringView(), value);
+        EXPECT_EQ(prop.info(), &Er::Unspecified::String);
+
+        // the script stored the pooled copy
+        auto pooled = Er::StringPool::intern(value, Er::Unspecified::String);
+        EXPECT_EQ(prop.getStringView().data(), pooled.getStringView().data());
+    }
+
+    {
+        // too short to be pooled, so it is stored inline
+        const std::string value("ddd");
+        Er::Property prop(std::string("aaa"), Er::Unspecified::String);
+        std::string old = state["set_interned_string"](prop, value);
+        EXPECT_STREQ(old.c_str(), "aaa");
+        EXPECT_TRUE(prop.isInline());
+        EXPECT_EQ(prop.getString(), value);
+        EXPECT_EQ(*Er::get<std::string>(Er::PropertyBag{ prop }, Er::Unspecified::String), value);
+    }
+}
+
+static const std::string test_array_property = R"(
+    function array_sum(prop)
+        local a = Er.Property.getInt32Array(prop)
+        local sum = 0
+        for i = 1, #a do
+            sum = sum + a:get(i)
+        end
+        return sum
+    end
+
+    function array_last(prop)
+        local a = Er.Property.getUInt64Array(prop)
+        return a:get(a:size())
+    end
+)";
+
+TEST(Er_Lua, PropertyArray)
+{
+    Er::LuaState state(Er::Log2::get());
+
+    state.loadString(test_array_property, "test_array_property");
+
+    {
+        Er::Property prop(Er::Int32Array{ 1, -2, 3, 40 }, Er::Unspecified::Int32Array);
+        int sum = state["array_sum"](prop);
+        EXPECT_EQ(sum, 42);
+    }
+
+    {
+        Er::Property prop(Er::UInt64Array{ 1, 0x8000000000000005ULL }, Er::Unspecified::UInt64Array);
+        Er::Lua::UInt64Wrapper last = state["array_last"](prop);
+        EXPECT_EQ(last.value, 0x8000000000000005ULL);
+    }
+}
+
+static const std::string test_map_property = R"(
+    function map_lookup(prop, name)
+        local m = Er.Property.getMap(prop)
+        return Er.Property.getString(m:find(name))
+    end
+
+    function map_size(prop)
+        local m = Er.Property.getMap(prop)
+        return #m
+    end
+
+    function map_set(prop, name, value)
+        local m = Er.Property.getMap(prop)
+        Er.Property.setString(m:find(name), value)
+        return Er.Property.getString(m:find(name))
+    end
+)";
+
+TEST(Er_Lua, PropertyMap)
+{
+    Er::LuaState state(Er::Log2::get());
+
+    state.loadString(test_map_property, "test_map_property");
+
+    Er::Property prop(Er::PropertyBag{
+        Er::Property(std::int32_t(1), Er::Unspecified::Int32),
+        Er::Property(std::string("nested"), Er::Unspecified::String) }, Er::Unspecified::Map);
+
+    int size = state["map_size"](prop);
+    EXPECT_EQ(size, 2);
+
+    std::string s = state["map_lookup"](prop, std::string("Er.Unspecified.String"));
+    EXPECT_EQ(s, "nested");
+    // the script changes its own copy only
+    std::string changed = state["map_set"](prop, std::string("Er.Unspecified.String"), std::string("changed"));
+    EXPECT_EQ(changed, "changed");
+    EXPECT_EQ(Er::find(prop.getMap(), Er::Unspecified::String)->getString(), "nested");
+}
@@ -0,0 +1,99 @@
+#include "common.hpp"
+
+#include <erebus/system/util/object_pool.hxx>
+
+#include <algorithm>
+#include <thread>
+
+
+namespace
+{
+
+struct Pooled
+{
+    int value = 0;
+};
+
+struct Allocated
+    : public Er::PooledAllocation<Allocated>
+{
+    std::uint64_t a = 1;
+    std::uint64_t b = 2;
+};
+
+} // namespace {}
+
+
+TEST(Er_ObjectPool, reuse)
+{
+    using Pool = Er::ObjectPool<Pooled>;
+
+    auto p = Pool::acquire();
+    ASSERT_TRUE(p);
+    p->value = 42;
+    Pool::release(p);
+
+    // the same object comes back with its state untouched
+    auto q = Pool::acquire();
+    EXPECT_EQ(q, p);
+    EXPECT_EQ(q->value, 42);
+    Pool::release(q);
+}
+
+TEST(Er_ObjectPool, crossThread)
+{
+    using Pool = Er::ObjectPool<Pooled, 4>;
+
+    std::vector<Pooled*> objects;
+    for (int i = 0; i < 16; ++i)
+        objects.push_back(Pool::acquire());
+
+    // release everything on another thread; it ends up in the depot
+    std::thread([&objects]()
+    {
+        for (auto p : objects)
+            Pool::release(p);
+    }).join();
+
+    auto p = Pool::acquire();
+    EXPECT_NE(std::find(objects.begin(), objects.end(), p), objects.end());
+    Pool::release(p);
+}
+
+TEST(Er_ObjectPool, lateRelease)
+{
+    using Pool = Er::ObjectPool<Pooled, 8>;
+
+    struct Holder
+    {
+        Pooled* p = nullptr;
+
+        ~Holder()
+        {
+            // runs after the thread cache is destroyed
+            Pool::release(p);
+        }
+    };
+
+    std::thread([]()
+    {
+        thread_local Holder holder;
+        holder.p = Pool::acquire();
+    }).join();
+
+    auto p = Pool::acquire();
+    EXPECT_TRUE(p);
+    Pool::release(p);
+}
+
+TEST(Er_ObjectPool, pooledAllocation)
+{
+    auto p = new Allocated;
+    EXPECT_EQ(p->a, 1);
+    EXPECT_EQ(p->b, 2);
+    delete p;
+
+    auto q = new Allocated;
+    EXPECT_EQ(q, p);
+    delete q;
+}
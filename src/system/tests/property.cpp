@@ -508,4 +508,347 @@ TEST(Property, Compare)
         EXPECT_FALSE(v1 != v3);
     }
 
-}
\ No newline at end of file
+}
+
+TEST(Property, InlineString)
+{
+    const std::string shortest;
+    const std::string longestInline(Er::Property::InlineCapacity, 'a');
+    const std::string shortestShared(Er::Property::InlineCapacity + 1, 'b');
+
+    for (auto& s : { shortest, longestInline, shortestShared })
+    {
+        bool expectInline = (s.size() <= Er::Property::InlineCapacity);
+
+        Er::Property v1(std::string_view(s), Er::Unspecified::String);
+        EXPECT_EQ(v1.type(), Er::PropertyType::String);
+        EXPECT_EQ(v1.isInline(), expectInline);
+        EXPECT_EQ(v1.getStringView(), s);
+        EXPECT_EQ(v1.getStringView().size(), s.size());
+        EXPECT_EQ(Er::get<std::string_view>(v1), s);
+        EXPECT_EQ(v1.str(), s);
+
+        Er::Property v2(s, Er::Unspecified::String);
+        EXPECT_EQ(v2.isInline(), expectInline);
+        EXPECT_TRUE(v1 == v2);
+        EXPECT_EQ(v1.hash(), v2.hash());
+
+        // getString() works on inline strings too, and makes their std::string once
+        auto& str = v1.getString();
+        EXPECT_EQ(str, s);
+        EXPECT_EQ(&v1.getString(), &str);
+        EXPECT_EQ(Er::get<std::string>(v2), s);
+        EXPECT_TRUE(v1 == v2);
+
+        Er::Property vc1(v1);
+        EXPECT_EQ(vc1.isInline(), expectInline);
+        EXPECT_EQ(vc1.getStringView(), s);
+        EXPECT_EQ(vc1.getString(), s);
+        EXPECT_TRUE(vc1 == v1);
+
+        // a move keeps the std::string
+        Er::Property vc2(std::move(v1));
+        EXPECT_TRUE(v1.empty());
+        EXPECT_EQ(vc2.getStringView(), s);
+        EXPECT_EQ(&vc2.getString(), &str);
+
+        // overwrite inline with shared and vice versa
+        vc2 = Er::Property(shortestShared, Er::Unspecified::String);
+        EXPECT_FALSE(vc2.isInline());
+        EXPECT_EQ(vc2.getString(), shortestShared);
+
+        vc2 = Er::Property(longestInline, Er::Unspecified::String);
+        EXPECT_TRUE(vc2.isInline());
+        EXPECT_EQ(vc2.getStringView(), longestInline);
+        EXPECT_EQ(vc2.getString(), longestInline);
+    }
+
+    // inline strings don't compare equal to properties of other types sharing the same bits
+    {
+        Er::Property v1("", Er::Unspecified::String);
+        Er::Property v2(int64_t(0), Er::Unspecified::Int64);
+        EXPECT_FALSE(v1 == v2);
+    }
+}
+
+TEST(Property, Arrays)
+{
+    {
+        Er::Int32Array a{ 1, -2, 3 };
+        auto data = a.data();
+
+        // moving a vector in takes over its buffer
+        Er::Property v1(std::move(a), Er::Unspecified::Int32Array);
+        EXPECT_EQ(v1.type(), Er::PropertyType::Int32Array);
+        EXPECT_EQ(v1.getInt32Array().data(), data);
+        EXPECT_EQ(v1.str(), "[1, -2, 3]");
+
+        // copies share the array
+        Er::Property v2(v1);
+        EXPECT_EQ(v2.getInt32Array().data(), data);
+        EXPECT_TRUE(v1 == v2);
+
+        const std::int32_t raw[] = { 1, -2, 3 };
+        Er::Property v3(std::span<const std::int32_t>(raw), Er::Unspecified::Int32Array);
+        EXPECT_NE(v3.getInt32Array().data(), data);
+        EXPECT_TRUE(v1 == v3);
+
+        Er::Property v4(Er::Int32Array{ 1, -2 }, Er::Unspecified::Int32Array);
+        EXPECT_FALSE(v1 == v4);
+    }
+
+    {
+        const Er::UInt64Array a{ 0, 0xFFFFFFFFFFFFFFFFULL };
+        Er::Property v(a, Er::Unspecified::UInt64Array);
+        EXPECT_EQ(Er::get<Er::UInt64Array>(v), a);
+        EXPECT_EQ(v.getArray<std::uint64_t>().size(), 2);
+    }
+
+    {
+        Er::Property v1(Er::DoubleArray{}, Er::Unspecified::DoubleArray);
+        Er::Property v2(Er::DoubleArray{}, Er::Unspecified::DoubleArray);
+        EXPECT_TRUE(v1 == v2);
+        EXPECT_EQ(v1.str(), "[]");
+
+        // arrays of different element types never compare equal
+        Er::Property v3(Er::Int64Array{}, Er::Unspecified::Int64Array);
+        EXPECT_FALSE(v1 == v3);
+    }
+
+    {
+        Er::Property v(Er::UInt32Array{ 7 }, Er::Unspecified::UInt32Array);
+        v = Er::Property(std::uint32_t(7), Er::Unspecified::UInt32);
+        EXPECT_EQ(v.getUInt32(), 7);
+    }
+}
+
+TEST(Property, Map)
+{
+    Er::PropertyBag threads;
+    threads.push_back(Er::Property(std::uint64_t(101), Er::Unspecified::UInt64));
+    threads.push_back(Er::Property(std::string("worker"), Er::Unspecified::String));
+
+    Er::PropertyBag process;
+    process.push_back(Er::Property(std::uint64_t(100), Er::Unspecified::UInt64));
+    process.push_back(Er::Property(std::move(threads), Er::Unspecified::Map));
+
+    Er::Property v1(std::move(process), Er::Unspecified::Map);
+    EXPECT_EQ(v1.type(), Er::PropertyType::Map);
+    ASSERT_EQ(v1.getMap().size(), 2);
+    EXPECT_EQ(v1.getMap()[1].getMap()[1].getString(), "worker");
+    EXPECT_EQ(v1.str(), "{Er.Unspecified.UInt64: 100, Er.Unspecified.Map: {Er.Unspecified.UInt64: 101, Er.Unspecified.String: worker}}");
+
+    // copies share the bag until one of them is modified
+    Er::Property v2(v1);
+    EXPECT_EQ(&v2.getMap(), &v1.getMap());
+    EXPECT_TRUE(v1 == v2);
+
+    auto& m = v2.mutableMap();
+    EXPECT_NE(&m, &v1.getMap());
+    EXPECT_TRUE(v1 == v2);
+
+    m[0] = Er::Property(std::uint64_t(200), Er::Unspecified::UInt64);
+    EXPECT_EQ(v1.getMap()[0].getUInt64(), 100);
+    EXPECT_EQ(v2.getMap()[0].getUInt64(), 200);
+    EXPECT_FALSE(v1 == v2);
+
+    // a Property that is the only owner is modified in place
+    EXPECT_EQ(&v2.mutableMap(), &m);
+
+    // copies made after mutableMap() do not see later changes through the kept reference
+    {
+        Er::Property v3(v2);
+        Er::Property v4;
+        v4 = v2;
+        EXPECT_NE(&v3.getMap(), &m);
+        EXPECT_NE(&v4.getMap(), &m);
+        EXPECT_TRUE(v3 == v2);
+
+        m.push_back(Er::Property(std::uint32_t(7), Er::Unspecified::UInt32));
+        ASSERT_EQ(v2.getMap().size(), 3);
+        EXPECT_EQ(v3.getMap().size(), 2);
+        EXPECT_EQ(v4.getMap().size(), 2);
+        EXPECT_FALSE(v3 == v2);
+        EXPECT_TRUE(v3 == v4);
+
+        // and the kept reference still is the bag of v2
+        EXPECT_EQ(&v2.mutableMap(), &m);
+        m.pop_back();
+    }
+
+    // same values under other properties are different maps
+    {
+        Er::Property a(Er::PropertyBag{ Er::Property(std::uint32_t(1), Er::Unspecified::UInt32) }, Er::Unspecified::Map);
+        Er::Property b(Er::PropertyBag{ Er::Property(std::uint32_t(1), Er::Unspecified::UInt32) }, Er::Unspecified::Map);
+        EXPECT_TRUE(a == b);
+
+        const Er::PropertyInfo other{ Er::PropertyType::UInt32, "Er.Test.Property.other", "Other" };
+        Er::Property c(Er::PropertyBag{ Er::Property(std::uint32_t(1), other) }, Er::Unspecified::Map);
+        EXPECT_FALSE(a == c);
+    }
+}
+
+TEST(Property, FormatTo)
+{
+    Er::FormatBuffer out;
+
+    // raw values, same as str()
+    for (auto& prop : {
+        Er::Property(),
+        Er::Property(Er::True, Er::Unspecified::Bool),
+        Er::Property(std::int32_t(-2147483647 - 1), Er::Unspecified::Int32),
+        Er::Property(std::uint64_t(18446744073709551615ULL), Er::Unspecified::UInt64),
+        Er::Property(-0.125, Er::Unspecified::Double),
+        Er::Property(std::string("some string"), Er::Unspecified::String),
+        Er::Property(Er::Int64Array{ -1, 2 }, Er::Unspecified::Int64Array) })
+    {
+        out.clear();
+        Er::formatTo(out, prop);
+        EXPECT_EQ(Er::Format::to_string(out), prop.str());
+    }
+
+    EXPECT_EQ(Er::Property(-0.125, Er::Unspecified::Double).str(), std::to_string(-0.125));
+
+    // formatters of both kinds append to what is already there
+    const Er::PropertyInfo stringFormatted{ Er::PropertyType::UInt32, "Er.Test.Property.stringFormatted", "String formatted",
+        [](const Er::Property& prop) { return Er::format("{} KB", prop.getUInt32()); } };
+
+    const Er::PropertyInfo bufferFormatted{ Er::PropertyType::UInt32, "Er.Test.Property.bufferFormatted", "Buffer formatted",
+        [](const Er::Property& prop, Er::FormatBuffer& out) { Er::Format::format_to(std::back_inserter(out), "{:#x}", prop.getUInt32()); } };
+
+    out.clear();
+    Er::formatTo(out, Er::Property(std::uint32_t(64), stringFormatted));
+    out.push_back(' ');
+    Er::formatTo(out, Er::Property(std::uint32_t(255), bufferFormatted));
+    EXPECT_EQ(Er::Format::to_string(out), "64 KB 0xff");
+
+    EXPECT_EQ(bufferFormatted.format(Er::Property(std::uint32_t(16), bufferFormatted)), "0x10");
+}
+
+TEST(Property, MemoryResource)
+{
+    struct CountingResource
+        : public std::pmr::memory_resource
+    {
+        std::size_t allocated = 0;
+        std::size_t deallocated = 0;
+
+        void* do_allocate(std::size_t bytes, std::size_t alignment) override
+        {
+            ++allocated;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+        {
+            ++deallocated;
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            return this == &other;
+        }
+    };
+
+    const std::string longString(100, 's');
+    const std::string shortestShared(Er::Property::InlineCapacity + 1, 'm');
+
+    Er::Property copy;
+    Er::PropertyBag bagCopy;
+    Er::Property map;
+
+    {
+        CountingResource resource;
+
+        {
+            Er::PropertyBag bag;
+            bag.reserve(3);
+            bag.push_back(Er::Property(std::string_view(longString), Er::Unspecified::String, &resource));
+            bag.push_back(Er::Property(std::string_view(shortestShared), Er::Unspecified::String, &resource));
+            bag.push_back(Er::Property(std::string_view("short"), Er::Unspecified::String, &resource));
+
+            // one for each node and its characters; short strings stay inline
+            EXPECT_EQ(resource.allocated, 2);
+            EXPECT_EQ(bag[0].getStringView(), longString);
+            EXPECT_FALSE(bag[1].isInline());
+            EXPECT_TRUE(bag[2].isInline());
+
+            // a std::string is made on demand, once
+            auto& str = bag[1].getString();
+            EXPECT_EQ(str, shortestShared);
+            EXPECT_EQ(&bag[1].getString(), &str);
+            EXPECT_EQ(resource.allocated, 2);
+
+            // copies don't share nodes from the resource
+            copy = bag[0];
+            EXPECT_NE(copy.getStringView().data(), bag[0].getStringView().data());
+            EXPECT_TRUE(copy == bag[0]);
+
+            bagCopy = bag;
+
+            // a move keeps the node where it is, so the moved-to Property must not outlive the resource
+            const auto data = bag[0].getStringView().data();
+            Er::Property moved(std::move(bag[0]));
+            EXPECT_EQ(moved.getStringView().data(), data);
+            EXPECT_EQ(resource.allocated, 2);
+            bag[0] = std::move(moved);
+
+            // a Map may outlive the resource, so it takes its properties to the heap
+            map = Er::Property(std::move(bag), Er::Unspecified::Map);
+            EXPECT_EQ(resource.allocated, 2);
+            EXPECT_EQ(resource.deallocated, 2);
+        }
+
+        EXPECT_EQ(resource.deallocated, 2);
+    }
+
+    EXPECT_EQ(copy.getString(), longString);
+    EXPECT_EQ(bagCopy[0].getString(), longString);
+    EXPECT_EQ(map.getMap()[0].getString(), longString);
+    EXPECT_EQ(map.getMap()[1].getString(), shortestShared);
+    EXPECT_EQ(map.getMap()[2].getString(), "short");
+}
+
+TEST(Property, Hash)
+{
+    const std::string longString(100, 'h');
+
+    // equal values hash equally, wherever they are stored
+    EXPECT_EQ(Er::Property(std::int32_t(7), Er::Unspecified::Int32).hash(), Er::Property(std::int32_t(7), Er::Unspecified::Int32).hash());
+    EXPECT_EQ(Er::Property(longString, Er::Unspecified::String).hash(), Er::Property(longString, Er::Unspecified::String).hash());
+
+    std::pmr::monotonic_buffer_resource arena;
+    EXPECT_EQ(Er::Property(longString, Er::Unspecified::String).hash(), Er::Property(std::string_view(longString), Er::Unspecified::String, &arena).hash());
+
+    // types are part of the hash, like they are part of ==
+    EXPECT_NE(Er::Property(std::int32_t(7), Er::Unspecified::Int32).hash(), Er::Property(std::uint32_t(7), Er::Unspecified::UInt32).hash());
+    EXPECT_NE(Er::Property(std::string("abc"), Er::Unspecified::String).hash(), Er::Property(Er::Binary("abc"), Er::Unspecified::Binary).hash());
+
+    // cached values still compare by value
+    Er::Property b1(Er::Binary(std::string(4096, 'b')), Er::Unspecified::Binary);
+    Er::Property b2(Er::Binary(std::string(4096, 'b')), Er::Unspecified::Binary);
+    Er::Property b3(Er::Binary(std::string(4095, 'b') + 'c'), Er::Unspecified::Binary);
+    EXPECT_EQ(b1.hash(), b2.hash());
+    EXPECT_NE(b1.hash(), b3.hash());
+    EXPECT_TRUE(b1 == b2);
+    EXPECT_FALSE(b1 == b3);
+
+    Er::Property a1(Er::DoubleArray{ 1.0, -0.0 }, Er::Unspecified::DoubleArray);
+    EXPECT_EQ(a1.hash(), Er::Property(Er::DoubleArray{ 1.0, -0.0 }, Er::Unspecified::DoubleArray).hash());
+    EXPECT_NE(a1.hash(), Er::Property(Er::DoubleArray{ 1.0, 0.0 }, Er::Unspecified::DoubleArray).hash());
+
+    // a modified map is hashed again
+    Er::Property m(Er::PropertyBag{ Er::Property(std::uint32_t(1), Er::Unspecified::UInt32) }, Er::Unspecified::Map);
+    auto h = m.hash();
+    auto& bag = m.mutableMap();
+    bag[0] = Er::Property(std::uint32_t(2), Er::Unspecified::UInt32);
+    auto h2 = m.hash();
+    EXPECT_NE(h2, h);
+    EXPECT_EQ(std::hash<Er::Property>{}(m), h2);
+
+    // and so is one changed later through a kept reference
+    bag[0] = Er::Property(std::uint32_t(3), Er::Unspecified::UInt32);
+    EXPECT_NE(m.hash(), h2);
+    EXPECT_FALSE(m == Er::Property(Er::PropertyBag{ Er::Property(std::uint32_t(2), Er::Unspecified::UInt32) }, Er::Unspecified::Map));
+}
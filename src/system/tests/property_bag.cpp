@@ -2,6 +2,8 @@
 
 #include <erebus/system/property_bag.hxx>
 
+#include <unordered_map>
+
 
 TEST(Er_PropertyBag, simple)
 {
@@ -37,6 +39,66 @@ TEST(Er_PropertyBag, simple)
    ps = Er::get<std::string>(bag, Er::Unspecified::String);
    ASSERT_TRUE(ps);
    EXPECT_STREQ(ps->c_str(), "test 2");
+   EXPECT_EQ(ps, &bag[1].getString());
+
+   auto psv = Er::get<std::string_view>(bag, Er::Unspecified::String);
+   ASSERT_TRUE(psv);
+   EXPECT_EQ(*psv, "test 2");
+}
+
+TEST(Er_PropertyBag, find)
+{
+    Er::PropertyBag bag;
+    bag.push_back(Er::Property(std::int32_t(-1), Er::Unspecified::Int32));
 
+    auto prop = Er::find(bag, Er::Unspecified::Int32);
+    ASSERT_TRUE(prop);
+    EXPECT_EQ(prop->getInt32(), -1);
+
+    EXPECT_FALSE(Er::find(bag, Er::Unspecified::UInt32));
 }
 
+TEST(Er_PropertyBag, hash)
+{
+    const Er::PropertyInfo other{ Er::PropertyType::UInt32, "Er.Test.PropertyBag.other", "Other" };
+
+    auto make = [](const Er::PropertyInfo& info, std::size_t count)
+    {
+        Er::PropertyBag bag;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            bag.push_back(Er::Property(std::uint32_t(i), info));
+            bag.push_back(Er::Property(std::string(std::size_t(20), char('a' + i)), Er::Unspecified::String));
+        }
+
+        return bag;
+    };
+
+    // all lane counts, including the tail
+    for (std::size_t count = 0; count < 6; ++count)
+    {
+        auto a = make(Er::Unspecified::UInt32, count);
+        auto b = make(Er::Unspecified::UInt32, count);
+        EXPECT_TRUE(Er::equal(a, b));
+        EXPECT_EQ(Er::hash(a), Er::hash(b));
+
+        if (count > 0)
+        {
+            // same values under another property
+            auto c = make(other, count);
+            EXPECT_TRUE(a == c);
+            EXPECT_FALSE(Er::equal(a, c));
+            EXPECT_NE(Er::hash(a), Er::hash(c));
+
+            // order matters
+            std::swap(b.front(), b.back());
+            EXPECT_FALSE(Er::equal(a, b));
+            EXPECT_NE(Er::hash(a), Er::hash(b));
+        }
+    }
+
+    std::unordered_map<Er::PropertyBag, int, Er::PropertyBagHash, Er::PropertyBagEqual> cache;
+    cache[make(Er::Unspecified::UInt32, 3)] = 3;
+    EXPECT_EQ(cache.count(make(Er::Unspecified::UInt32, 3)), 1);
+    EXPECT_EQ(cache.count(make(other, 3)), 0);
+}
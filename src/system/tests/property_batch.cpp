@@ -0,0 +1,138 @@
+#include "common.hpp"
+
+#include <erebus/system/exception.hxx>
+#include <erebus/system/property_batch.hxx>
+
+
+namespace
+{
+
+Er::PropertyBag makeRow(std::int32_t index)
+{
+    Er::PropertyBag bag;
+    bag.push_back(Er::Property(index, Er::Unspecified::Int32));
+    bag.push_back(Er::Property(std::string(index, 'x'), Er::Unspecified::String));
+    bag.push_back(Er::Property(index * 0.5, Er::Unspecified::Double));
+    bag.push_back(Er::Property((index % 2) ? Er::True : Er::False, Er::Unspecified::Bool));
+    return bag;
+}
+
+} // namespace {}
+
+
+TEST(Er_PropertyBatch, append)
+{
+    const std::int32_t count = 20;
+
+    Er::PropertyBatch batch;
+    EXPECT_TRUE(batch.empty());
+
+    for (std::int32_t i = 0; i < count; ++i)
+        ASSERT_TRUE(batch.append(makeRow(i)));
+
+    ASSERT_EQ(batch.rows(), count);
+    ASSERT_EQ(batch.columns(), 4);
+    EXPECT_EQ(batch.columnOf(Er::Unspecified::String), 1);
+    EXPECT_EQ(batch.columnOf(Er::Unspecified::UInt64), Er::PropertyBatch::NotFound);
+
+    auto ints = batch.values<std::int32_t>(0);
+    ASSERT_EQ(ints.size(), count);
+
+    for (std::int32_t i = 0; i < count; ++i)
+    {
+        EXPECT_EQ(ints[i], i);
+        EXPECT_EQ(batch.blob(i, 1), std::string(i, 'x'));
+
+        auto row = batch.row(i);
+        EXPECT_EQ(row, makeRow(i));
+
+        auto d = batch[i].find(Er::Unspecified::Double);
+        ASSERT_TRUE(d);
+        EXPECT_EQ(d->getDouble(), i * 0.5);
+
+        EXPECT_FALSE(batch[i].find(Er::Unspecified::UInt64));
+    }
+}
+
+TEST(Er_PropertyBatch, schema)
+{
+    Er::PropertyBatch batch;
+    ASSERT_TRUE(batch.append(makeRow(1)));
+
+    // different property set
+    Er::PropertyBag other;
+    other.push_back(Er::Property(std::int32_t(1), Er::Unspecified::Int32));
+    EXPECT_FALSE(batch.append(other));
+
+    // same properties in a different order
+    auto reordered = makeRow(2);
+    std::swap(reordered[0], reordered[1]);
+    EXPECT_FALSE(batch.append(reordered));
+
+    EXPECT_EQ(batch.rows(), 1);
+
+    // the schema survives clear()
+    batch.clear();
+    EXPECT_TRUE(batch.empty());
+    EXPECT_EQ(batch.columns(), 4);
+    EXPECT_FALSE(batch.append(other));
+    EXPECT_TRUE(batch.append(makeRow(3)));
+    EXPECT_EQ(batch.row(0), makeRow(3));
+
+    // an explicit schema
+    Er::PropertyBatch typed({ &Er::Unspecified::Int32, &Er::Unspecified::String, &Er::Unspecified::Double, &Er::Unspecified::Bool });
+    EXPECT_TRUE(typed.append(makeRow(4)));
+    EXPECT_FALSE(typed.append(other));
+
+    // arrays and maps don't fit in columns
+    for (auto& prop : {
+        Er::Property(Er::Int32Array{ 1, 2 }, Er::Unspecified::Int32Array),
+        Er::Property(Er::PropertyBag{ Er::Property(std::int32_t(1), Er::Unspecified::Int32) }, Er::Unspecified::Map) })
+    {
+        Er::PropertyBatch unsupported;
+        EXPECT_FALSE(unsupported.append(Er::PropertyBag{ Er::Property(std::int32_t(1), Er::Unspecified::Int32), prop }));
+        EXPECT_EQ(unsupported.columns(), 0);
+        EXPECT_TRUE(unsupported.append(makeRow(5)));
+    }
+}
+
+TEST(Er_PropertyBatch, columns)
+{
+    std::vector<Er::PropertyBatch::Column> columns;
+    columns.push_back({ &Er::Unspecified::UInt32, std::vector<std::uint32_t>{ 1, 2, 3 } });
+
+    Er::PropertyBatch::Blobs blobs;
+    blobs.data = "abbccc";
+    blobs.offsets = { 0, 1, 3, 6 };
+    columns.push_back({ &Er::Unspecified::Binary, blobs });
+
+    Er::PropertyBatch batch(std::move(columns), 3);
+    ASSERT_EQ(batch.rows(), 3);
+    EXPECT_EQ(batch.get(2, 0).getUInt32(), 3);
+    EXPECT_EQ(batch.get(2, 1).getBinary(), Er::Binary(std::string("ccc")));
+
+    // row count mismatch
+    {
+        std::vector<Er::PropertyBatch::Column> bad;
+        bad.push_back({ &Er::Unspecified::UInt32, std::vector<std::uint32_t>{ 1, 2 } });
+        EXPECT_THROW(Er::PropertyBatch(std::move(bad), 3), Er::Exception);
+    }
+
+    // column type mismatch
+    {
+        std::vector<Er::PropertyBatch::Column> bad;
+        bad.push_back({ &Er::Unspecified::UInt32, std::vector<std::int64_t>{ 1, 2, 3 } });
+        EXPECT_THROW(Er::PropertyBatch(std::move(bad), 3), Er::Exception);
+    }
+
+    // offsets out of range
+    {
+        Er::PropertyBatch::Blobs broken;
+        broken.data = "ab";
+        broken.offsets = { 0, 1, 5 };
+
+        std::vector<Er::PropertyBatch::Column> bad;
+        bad.push_back({ &Er::Unspecified::String, broken });
+        EXPECT_THROW(Er::PropertyBatch(std::move(bad), 2), Er::Exception);
+    }
+}
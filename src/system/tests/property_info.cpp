@@ -0,0 +1,216 @@
+#include "common.hpp"
+
+#include <erebus/system/exception.hxx>
+#include <erebus/system/format.hxx>
+#include <erebus/system/property.hxx>
+
+#include <atomic>
+#include <thread>
+
+
+TEST(Er_PropertyInfo, lookup)
+{
+    EXPECT_EQ(Er::lookupProperty(Er::Unspecified::String.name()), &Er::Unspecified::String);
+    EXPECT_FALSE(Er::lookupProperty("Er.Test.PropertyInfo.NoSuchProperty"));
+
+    auto version = Erp::propertyMappingVersion();
+
+    // new names are visible right away but leave the version alone
+    auto pi = Erp::allocateTransientProperty(Er::PropertyType::Int32, "Er.Test.PropertyInfo.lookup", "lookup");
+    ASSERT_TRUE(pi);
+    EXPECT_TRUE(pi->isTransient());
+    EXPECT_EQ(Er::lookupProperty("Er.Test.PropertyInfo.lookup"), pi.get());
+    EXPECT_EQ(Erp::propertyMappingVersion(), version);
+
+    EXPECT_EQ(Erp::allocateTransientProperty(Er::PropertyType::Int32, "Er.Test.PropertyInfo.lookup", "lookup"), pi.get());
+    EXPECT_THROW(Erp::allocateTransientProperty(Er::PropertyType::String, "Er.Test.PropertyInfo.lookup", "lookup"), Er::Exception);
+
+    // persistent names map to persistent properties
+    auto persistent = Erp::allocateTransientProperty(Er::PropertyType::String, Er::Unspecified::String.name(), "String");
+    EXPECT_EQ(persistent, &Er::Unspecified::String);
+    EXPECT_FALSE(persistent->isTransient());
+}
+
+TEST(Er_PropertyInfo, transientLifetime)
+{
+    const std::string name = "Er.Test.PropertyInfo.transientLifetime";
+
+    std::uint32_t unique = 0;
+    {
+        auto a = Erp::allocateTransientProperty(Er::PropertyType::UInt64, name, "transientLifetime");
+        unique = a->unique();
+
+        Er::PropertyInfoRef b;
+        {
+            auto c = Erp::allocateTransientProperty(Er::PropertyType::UInt64, name, "transientLifetime");
+            EXPECT_EQ(c, a.get());
+            b = c;
+        }
+
+        a = Er::PropertyInfoRef();
+        EXPECT_EQ(Er::lookupProperty(name), b.get());
+    }
+
+    // the last reference is gone
+    EXPECT_FALSE(Er::lookupProperty(name));
+
+    // a new one gets a new ID
+    auto d = Erp::allocateTransientProperty(Er::PropertyType::UInt64, name, "transientLifetime");
+    EXPECT_NE(d->unique(), unique);
+    EXPECT_TRUE(d->isTransient());
+}
+
+TEST(Er_PropertyInfo, transientHeldByProperty)
+{
+    const std::string name = "Er.Test.PropertyInfo.transientHeldByProperty";
+
+    Er::PropertyBag bag;
+    {
+        auto info = Erp::allocateTransientProperty(Er::PropertyType::String, name, "transientHeldByProperty");
+        bag.push_back(Er::Property(std::string("value"), *info.get()));
+    }
+
+    // properties count as references, and so do their copies
+    auto copy = bag;
+    bag.clear();
+
+    ASSERT_EQ(Er::lookupProperty(name), copy[0].info());
+    EXPECT_EQ(copy[0].info()->name(), name);
+
+    copy.clear();
+    EXPECT_FALSE(Er::lookupProperty(name));
+}
+
+TEST(Er_PropertyInfo, concurrentLookup)
+{
+    const std::size_t count = 200;
+    std::atomic<std::size_t> registered = 0;
+    std::atomic<bool> failed = false;
+
+    // readers must see every name registered before they looked
+    auto reader = [&]()
+    {
+        while (registered.load(std::memory_order_acquire) < count)
+        {
+            auto n = registered.load(std::memory_order_acquire);
+            if (n == 0)
+                continue;
+
+            auto name = Er::format("Er.Test.PropertyInfo.concurrent.{}", n - 1);
+            auto pi = Er::lookupProperty(name);
+            if (!pi || (pi->name() != name))
+                failed = true;
+        }
+    };
+
+    std::jthread r1(reader);
+    std::jthread r2(reader);
+
+    std::vector<Er::PropertyInfoRef> refs;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        refs.push_back(Erp::allocateTransientProperty(Er::PropertyType::UInt64, Er::format("Er.Test.PropertyInfo.concurrent.{}", i), "concurrent"));
+        registered.store(i + 1, std::memory_order_release);
+    }
+
+    r1.join();
+    r2.join();
+
+    EXPECT_FALSE(failed);
+
+    // concurrent retain and release of the same property
+    {
+        auto shared = Erp::allocateTransientProperty(Er::PropertyType::Int32, "Er.Test.PropertyInfo.concurrent.shared", "shared");
+
+        auto churn = [&]()
+        {
+            for (int i = 0; i < 1000; ++i)
+            {
+                auto a = Erp::allocateTransientProperty(Er::PropertyType::Int32, "Er.Test.PropertyInfo.concurrent.shared", "shared");
+                auto b = a;
+                if (a != shared.get())
+                    failed = true;
+            }
+        };
+
+        std::jthread c1(churn);
+        std::jthread c2(churn);
+        c1.join();
+        c2.join();
+
+        EXPECT_FALSE(failed);
+        EXPECT_EQ(Er::lookupProperty("Er.Test.PropertyInfo.concurrent.shared"), shared.get());
+    }
+    // lookups of a held transient stay right while other transients come and go
+    {
+        auto held = Erp::allocateTransientProperty(Er::PropertyType::Int32, "Er.Test.PropertyInfo.concurrent.held", "held");
+        std::atomic<bool> done = false;
+
+        auto lookup = [&]()
+        {
+            while (!done.load(std::memory_order_acquire))
+            {
+                if (Er::lookupProperty("Er.Test.PropertyInfo.concurrent.held") != held.get())
+                    failed = true;
+
+                if (Er::lookupProperty("Er.Test.PropertyInfo.concurrent.gone"))
+                    failed = true;
+            }
+        };
+
+        std::jthread l1(lookup);
+        std::jthread l2(lookup);
+
+        for (int i = 0; i < 1000; ++i)
+            auto temporary = Erp::allocateTransientProperty(Er::PropertyType::Int32, Er::format("Er.Test.PropertyInfo.concurrent.temporary.{}", i), "temporary");
+
+        done.store(true, std::memory_order_release);
+        l1.join();
+        l2.join();
+
+        EXPECT_FALSE(failed);
+    }
+}
+
+TEST(Er_PropertyInfo, lookupWhileReleased)
+{
+    const std::string name = "Er.Test.PropertyInfo.lookupWhileReleased";
+    std::atomic<bool> done = false;
+    std::atomic<bool> failed = false;
+    std::atomic<std::size_t> maxRetired = 0;
+
+    // a lookup either misses or returns a reference that keeps the property usable
+    auto lookup = [&]()
+    {
+        while (!done.load(std::memory_order_acquire))
+        {
+            auto pi = Er::lookupProperty(name);
+            if (pi && ((pi->name() != name) || !pi->isTransient()))
+                failed = true;
+        }
+    };
+
+    std::jthread l1(lookup);
+    std::jthread l2(lookup);
+
+    for (int i = 0; i < 2000; ++i)
+    {
+        // every release retires the current index with the next lookup
+        auto a = Erp::allocateTransientProperty(Er::PropertyType::Int32, name, "lookupWhileReleased");
+        auto b = Erp::allocateTransientProperty(Er::PropertyType::Int32, Er::format("{}.{}", name, i), "lookupWhileReleased");
+
+        auto retired = Erp::retiredPropertyIndices();
+        if (retired > maxRetired)
+            maxRetired = retired;
+    }
+
+    done.store(true, std::memory_order_release);
+    l1.join();
+    l2.join();
+
+    EXPECT_FALSE(failed);
+    EXPECT_FALSE(Er::lookupProperty(name));
+
+    // replaced indices are freed even though there is always someone looking
+    EXPECT_LE(maxRetired.load(), 8);
+}
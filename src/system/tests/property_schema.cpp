@@ -0,0 +1,88 @@
+#include "common.hpp"
+
+#include <erebus/system/property_schema.hxx>
+
+
+namespace
+{
+
+const Er::TypedPropertyInfo<std::uint64_t> Pid{ "Er.Test.Schema.pid", "PID" };
+const Er::TypedPropertyInfo<std::string> Comm{ "Er.Test.Schema.comm", "Command" };
+const Er::TypedPropertyInfo<Er::Bool> Kernel{ "Er.Test.Schema.kernel", "Kernel thread" };
+const Er::TypedPropertyInfo<double> Cpu{ "Er.Test.Schema.cpu", "CPU usage" };
+const Er::TypedPropertyInfo<std::uint64_t> PPid{ "Er.Test.Schema.ppid", "Parent PID" };
+
+struct Process
+{
+    std::uint64_t pid = 0;
+    std::string comm;
+    Er::Bool kernel = Er::False;
+    double cpu = 0.0;
+    std::optional<std::uint64_t> ppid;
+};
+
+constexpr auto ProcessSchema = Er::schema<Process>(
+    Er::field<&Process::pid>(Pid),
+    Er::field<&Process::comm>(Comm),
+    Er::field<&Process::kernel>(Kernel),
+    Er::field<&Process::cpu>(Cpu),
+    Er::field<&Process::ppid>(PPid)
+);
+
+static_assert(decltype(ProcessSchema)::FieldCount == 5);
+
+} // namespace {}
+
+
+TEST(Er_PropertySchema, toBag)
+{
+    Process p{ 42, "init", Er::False, 0.5, 1 };
+
+    auto bag = ProcessSchema.toBag(p);
+    ASSERT_EQ(bag.size(), 5);
+    EXPECT_EQ(bag[0].info(), &Pid);
+    EXPECT_EQ(bag[0].getUInt64(), 42);
+    EXPECT_EQ(bag[1].getString(), "init");
+    EXPECT_EQ(bag[2].getBool(), Er::False);
+    EXPECT_EQ(bag[3].getDouble(), 0.5);
+    EXPECT_EQ(bag[4].getUInt64(), 1);
+
+    // empty optionals are left out
+    p.ppid.reset();
+    bag = ProcessSchema.toBag(p);
+    EXPECT_EQ(bag.size(), 4);
+    EXPECT_FALSE(Er::find(bag, PPid));
+}
+
+TEST(Er_PropertySchema, fromBag)
+{
+    Process p{ 42, "kthreadd", Er::True, 1.5, 2 };
+
+    auto q = ProcessSchema.fromBag(ProcessSchema.toBag(p));
+    EXPECT_EQ(q.pid, p.pid);
+    EXPECT_EQ(q.comm, p.comm);
+    EXPECT_EQ(q.kernel, p.kernel);
+    EXPECT_EQ(q.cpu, p.cpu);
+    EXPECT_EQ(q.ppid, p.ppid);
+
+    // order does not matter
+    Er::PropertyBag shuffled;
+    shuffled.push_back(Er::Property(3.0, Cpu));
+    shuffled.push_back(Er::Property(std::string("bash"), Comm));
+    shuffled.push_back(Er::Property(Er::False, Kernel));
+    shuffled.push_back(Er::Property(std::uint64_t(7), Pid));
+
+    q = ProcessSchema.fromBag(shuffled);
+    EXPECT_EQ(q.pid, 7);
+    EXPECT_EQ(q.comm, "bash");
+    EXPECT_EQ(q.cpu, 3.0);
+    EXPECT_FALSE(q.ppid);
+
+    // required fields must be there
+    shuffled.pop_back();
+    EXPECT_THROW(ProcessSchema.fromBag(shuffled), Er::Exception);
+
+    Process r;
+    EXPECT_FALSE(ProcessSchema.tryFromBag(shuffled, r));
+    EXPECT_EQ(r.comm, "bash");
+}
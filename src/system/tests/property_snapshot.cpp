@@ -0,0 +1,285 @@
+#include "common.hpp"
+
+#include <erebus/system/property_snapshot.hxx>
+
+#include <filesystem>
+#include <fstream>
+
+
+namespace
+{
+
+const Er::TypedPropertyInfo<Er::Bool> Flag{ "Er.Test.Snapshot.flag", "Flag" };
+const Er::TypedPropertyInfo<std::int32_t> I32{ "Er.Test.Snapshot.i32", "Int32" };
+const Er::TypedPropertyInfo<std::uint32_t> U32{ "Er.Test.Snapshot.u32", "UInt32" };
+const Er::TypedPropertyInfo<std::int64_t> I64{ "Er.Test.Snapshot.i64", "Int64" };
+const Er::TypedPropertyInfo<std::uint64_t> U64{ "Er.Test.Snapshot.u64", "UInt64" };
+const Er::TypedPropertyInfo<double> Dbl{ "Er.Test.Snapshot.double", "Double" };
+const Er::TypedPropertyInfo<std::string> Str{ "Er.Test.Snapshot.string", "String" };
+const Er::TypedPropertyInfo<Er::Binary> Bin{ "Er.Test.Snapshot.binary", "Binary" };
+const Er::TypedPropertyInfo<Er::Int32Array> I32s{ "Er.Test.Snapshot.i32s", "Int32 array" };
+const Er::TypedPropertyInfo<Er::DoubleArray> Dbls{ "Er.Test.Snapshot.doubles", "Double array" };
+const Er::PropertyInfo Nested{ Er::PropertyType::Map, "Er.Test.Snapshot.nested", "Nested" };
+
+struct TempFile
+{
+    std::string path;
+
+    explicit TempFile(const char* name)
+        : path((std::filesystem::temp_directory_path() / name).string())
+    {
+    }
+
+    ~TempFile()
+    {
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+    }
+};
+
+Er::PropertyBag makeBag(std::int32_t i)
+{
+    Er::PropertyBag inner;
+    inner.emplace_back(std::uint64_t(i) * 10, U64);
+    inner.emplace_back(std::string("inner"), Str);
+
+    Er::PropertyBag bag;
+    bag.emplace_back(Er::Bool(i % 2 == 0), Flag);
+    bag.emplace_back(i, I32);
+    bag.emplace_back(std::uint32_t(i + 1), U32);
+    bag.emplace_back(std::int64_t(-i), I64);
+    bag.emplace_back(0.5 * i, Dbl);
+    bag.emplace_back(std::string(std::size_t(i), 'x'), Str);
+    bag.emplace_back(Er::Binary(std::string("\x00\x01\x02", 3)), Bin);
+    bag.emplace_back(Er::Int32Array{ i, i + 1, i + 2 }, I32s);
+    bag.emplace_back(Er::DoubleArray{}, Dbls);
+    bag.emplace_back(std::move(inner), Nested);
+    return bag;
+}
+
+} // namespace {}
+
+
+TEST(PropertySnapshot, RoundTrip)
+{
+    TempFile file("erebus-snapshot-roundtrip");
+
+    std::vector<Er::PropertyBag> bags;
+    for (std::int32_t i = 0; i < 20; ++i)
+        bags.push_back(makeBag(i));
+
+    {
+        Er::PropertySnapshotWriter writer(file.path);
+        for (auto& bag : bags)
+            writer.write(bag);
+
+        EXPECT_EQ(writer.records(), bags.size());
+    }
+
+    Er::PropertySnapshotReader reader(file.path);
+    ASSERT_EQ(reader.size(), bags.size());
+
+    for (std::size_t i = 0; i < bags.size(); ++i)
+    {
+        EXPECT_EQ(reader[i].size(), bags[i].size());
+        EXPECT_EQ(reader[i].bag(), bags[i]);
+    }
+}
+
+TEST(PropertySnapshot, InPlace)
+{
+    TempFile file("erebus-snapshot-inplace");
+
+    {
+        Er::PropertySnapshotWriter writer(file.path);
+        writer.write(makeBag(5));
+        writer.close();
+    }
+
+    Er::PropertySnapshotReader reader(file.path);
+    ASSERT_EQ(reader.size(), 1);
+
+    std::vector<Er::PropertyType> types;
+    for (auto field : reader[0])
+    {
+        types.push_back(field.type());
+
+        if (field.info() == &I32)
+        {
+            EXPECT_EQ(field.get<std::int32_t>(), 5);
+        }
+        else if (field.info() == &Flag)
+        {
+            EXPECT_EQ(field.get<Er::Bool>(), Er::False);
+        }
+        else if (field.info() == &Str)
+        {
+            EXPECT_EQ(field.get<std::string_view>(), "xxxxx");
+        }
+        else if (field.info() == &I32s)
+        {
+            auto a = field.get<std::span<const std::int32_t>>();
+            ASSERT_EQ(a.size(), 3);
+            EXPECT_EQ(a[0], 5);
+            EXPECT_EQ(a[2], 7);
+            EXPECT_EQ(reinterpret_cast<std::uintptr_t>(a.data()) % alignof(std::int32_t), 0);
+        }
+        else if (field.info() == &Bin)
+        {
+            // points into the mapping and keeps it alive
+            auto b = field.get<Er::Binary>();
+            EXPECT_EQ(b.bytes(), std::string_view("\x00\x01\x02", 3));
+            EXPECT_EQ(b.data(), field.raw().data());
+            EXPECT_TRUE(b.owner());
+        }
+        else if (field.info() == &Nested)
+        {
+            auto inner = field.record();
+            ASSERT_EQ(inner.size(), 2);
+            auto it = inner.begin();
+            EXPECT_EQ((*it).get<std::uint64_t>(), 50);
+            ++it;
+            EXPECT_EQ((*it).get<std::string_view>(), "inner");
+            ++it;
+            EXPECT_TRUE(it == inner.end());
+        }
+    }
+
+    EXPECT_EQ(types.size(), 10);
+}
+
+TEST(PropertySnapshot, BinaryOutlivesReader)
+{
+    TempFile file("erebus-snapshot-binary");
+
+    {
+        Er::PropertySnapshotWriter writer(file.path);
+        writer.write(makeBag(1));
+    }
+
+    Er::PropertyBag bag;
+    {
+        Er::PropertySnapshotReader reader(file.path);
+        bag = reader[0].bag();
+    }
+
+    auto bin = Er::find(bag, Bin);
+    ASSERT_TRUE(bin);
+    EXPECT_EQ(bin->getBinary().bytes(), std::string_view("\x00\x01\x02", 3));
+}
+
+TEST(PropertySnapshot, TransientOutlivesReader)
+{
+    TempFile file("erebus-snapshot-transient");
+
+    // a property this process doesn't know once the file is written
+    const std::string name = "Er.Test.Snapshot.transient";
+    {
+        auto info = Erp::allocateTransientProperty(Er::PropertyType::String, name, "Transient");
+
+        Er::PropertyBag bag;
+        bag.emplace_back(std::string("value"), *info.get());
+
+        Er::PropertySnapshotWriter writer(file.path);
+        writer.write(bag);
+    }
+
+    ASSERT_FALSE(Er::lookupProperty(name));
+
+    Er::PropertyBag bag;
+    {
+        Er::PropertySnapshotReader reader(file.path);
+        bag = reader[0].bag();
+    }
+
+    ASSERT_EQ(bag.size(), 1);
+    EXPECT_EQ(bag[0].info()->name(), name);
+    EXPECT_EQ(Er::lookupProperty(name), bag[0].info());
+    EXPECT_EQ(bag[0].getString(), "value");
+}
+
+TEST(PropertySnapshot, TooDeep)
+{
+    TempFile file("erebus-snapshot-deep");
+
+    Er::PropertyBag bag;
+    for (unsigned i = 0; i <= Er::PropertySnapshotReader::MaxDepth + 1; ++i)
+    {
+        Er::PropertyBag outer;
+        outer.emplace_back(std::move(bag), Nested);
+        bag = std::move(outer);
+    }
+
+    {
+        Er::PropertySnapshotWriter writer(file.path);
+        writer.write(bag);
+    }
+
+    Er::PropertySnapshotReader reader(file.path);
+    EXPECT_THROW(reader[0].bag(), Er::Exception);
+}
+
+TEST(PropertySnapshot, Corrupt)
+{
+    TempFile file("erebus-snapshot-corrupt");
+
+    EXPECT_THROW(Er::PropertySnapshotReader reader(file.path), Er::Exception);
+
+    {
+        Er::PropertySnapshotWriter writer(file.path);
+        writer.write(makeBag(3));
+    }
+
+    std::string contents;
+    {
+        std::ifstream in(file.path, std::ios::binary);
+        contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    auto rewrite = [&file](const std::string& data)
+    {
+        std::ofstream out(file.path, std::ios::binary | std::ios::trunc);
+        out.write(data.data(), data.size());
+    };
+
+    // bad magic
+    {
+        auto data = contents;
+        data[0] = 'X';
+        rewrite(data);
+        EXPECT_THROW(Er::PropertySnapshotReader reader(file.path), Er::Exception);
+    }
+
+    // truncated: the index is gone
+    {
+        rewrite(contents.substr(0, contents.size() - 8));
+        EXPECT_THROW(Er::PropertySnapshotReader reader(file.path), Er::Exception);
+    }
+
+    // a field count that doesn't match the fields
+    {
+        auto data = contents;
+        auto count = std::uint32_t(0xFFFFFFFF);
+        std::memcpy(data.data() + sizeof(Er::PropertySnapshot::Header), &count, sizeof(count));
+        rewrite(data);
+
+        Er::PropertySnapshotReader reader(file.path);
+        EXPECT_THROW(reader[0].bag(), Er::Exception);
+    }
+
+    // a field length running past its record
+    {
+        auto data = contents;
+        auto length = std::uint32_t(0x10000);
+        std::memcpy(data.data() + sizeof(Er::PropertySnapshot::Header) + 12, &length, sizeof(length));
+        rewrite(data);
+
+        Er::PropertySnapshotReader reader(file.path);
+        EXPECT_THROW(
+            {
+                for (auto field : reader[0])
+                    (void)field;
+            },
+            Er::Exception);
+    }
+}
@@ -0,0 +1,44 @@
+#include "common.hpp"
+
+#include <erebus/system/logger/simple_formatter2.hxx>
+
+
+namespace
+{
+
+using Option = Er::Log2::SimpleFormatter::Option;
+using Options = Er::Log2::SimpleFormatter::Options;
+
+// 2024/01/02 03:04:05 UTC
+constexpr Er::System::PackedTime::ValueType Time = 1704164645ULL * 1000000;
+
+Er::Log2::Record::Ptr makeRecord(Er::System::PackedTime::ValueType time, std::string_view text)
+{
+    return Er::Log2::Record::make("comp", Er::Log2::Level::Warning, time, 42, text);
+}
+
+} // namespace {}
+
+
+TEST(SimpleFormatter, Format)
+{
+    auto formatter = Er::Log2::SimpleFormatter::make(Options{ Option::DateTime, Option::Level, Option::Tid, Option::TzUtc, Option::Lf, Option::Component });
+
+    EXPECT_EQ(formatter->format(makeRecord(Time + 678000, "hello").get()), "[2024/01/02 03:04:05.678 W comp @42] hello\n");
+
+    // the same second, then the next one
+    EXPECT_EQ(formatter->format(makeRecord(Time + 9000, "a").get()), "[2024/01/02 03:04:05.009 W comp @42] a\n");
+    EXPECT_EQ(formatter->format(makeRecord(Time + 1000000, "b").get()), "[2024/01/02 03:04:06.000 W comp @42] b\n");
+
+    // the cached date is not reused for another layout
+    auto timeOnly = Er::Log2::SimpleFormatter::make(Options{ Option::Time, Option::TzUtc, Option::CrLf });
+    EXPECT_EQ(timeOnly->format(makeRecord(Time + 1000000, "c").get()), "[03:04:06.000] c\r\n");
+
+    auto record = makeRecord(Time, "indented");
+    record->setIndent(2);
+    auto plain = Er::Log2::SimpleFormatter::make(Options{ Option::NoLf }, 2);
+
+    Er::FormatBuffer buffer;
+    plain->formatTo(record.get(), buffer);
+    EXPECT_EQ(std::string_view(buffer.data(), buffer.size()), "    indented");
+}
@@ -0,0 +1,179 @@
+#include "common.hpp"
+
+#include <erebus/system/exception.hxx>
+#include <erebus/system/snapshot_diff.hxx>
+
+
+namespace
+{
+
+const Er::PropertyInfo Pid{ Er::PropertyType::UInt64, "Er.Test.SnapshotDiff.pid", "PID" };
+const Er::PropertyInfo Comm{ Er::PropertyType::String, "Er.Test.SnapshotDiff.comm", "Command" };
+const Er::PropertyInfo Cpu{ Er::PropertyType::Double, "Er.Test.SnapshotDiff.cpu", "CPU usage" };
+const Er::PropertyInfo Exe{ Er::PropertyType::String, "Er.Test.SnapshotDiff.exe", "Executable" };
+
+Er::PropertyBag process(std::uint64_t pid, const std::string& comm, double cpu)
+{
+    return Er::PropertyBag{ Er::Property(pid, Pid), Er::Property(comm, Comm), Er::Property(cpu, Cpu) };
+}
+
+Er::SnapshotDiff::Change changeOf(const Er::PropertyBag& frame)
+{
+    EXPECT_FALSE(frame.empty());
+    EXPECT_EQ(frame[0].info(), &Er::SnapshotDiff::ChangeProperty);
+    return static_cast<Er::SnapshotDiff::Change>(frame[0].getUInt32());
+}
+
+// applies all frames and checks the mirror matches the snapshot
+void deliver(Er::SnapshotDiff::Delta& delta, Er::SnapshotMirror& mirror, const std::vector<Er::PropertyBag>& snapshot)
+{
+    while (true)
+    {
+        auto frame = delta.next();
+        if (frame.empty())
+            break;
+
+        mirror.apply(frame);
+    }
+
+    ASSERT_EQ(mirror.records().size(), snapshot.size());
+    for (auto& record : snapshot)
+    {
+        auto mirrored = mirror.find(*Er::find(record, Pid));
+        ASSERT_TRUE(mirrored);
+        EXPECT_TRUE(Er::equal(*mirrored, record));
+    }
+}
+
+} // namespace {}
+
+
+TEST(SnapshotDiff, Changes)
+{
+    Er::SnapshotDiff diff(Pid);
+    Er::SnapshotMirror mirror(Pid);
+
+    std::vector<Er::PropertyBag> snapshot{ process(1, "init", 0.0), process(2, "kthreadd", 0.5), process(3, "bash", 1.0) };
+
+    // the first snapshot is sent in full
+    {
+        auto delta = diff.diff(snapshot);
+        ASSERT_EQ(delta.size(), 4);
+        EXPECT_EQ(changeOf(delta.frames()[0]), Er::SnapshotDiff::Change::Reset);
+        EXPECT_EQ(delta.frames()[0].size(), 1);
+        EXPECT_EQ(changeOf(delta.frames()[1]), Er::SnapshotDiff::Change::Added);
+        EXPECT_EQ(delta.frames()[1].size(), 4);
+
+        deliver(delta, mirror, snapshot);
+    }
+
+    // nothing changed
+    {
+        auto delta = diff.diff(snapshot);
+        EXPECT_EQ(delta.size(), 0);
+        deliver(delta, mirror, snapshot);
+    }
+
+    // one property changed, one process exited, another one started
+    snapshot[1] = process(2, "kthreadd", 0.75);
+    snapshot.erase(snapshot.begin() + 2);
+    snapshot.push_back(process(4, "vim", 2.0));
+    {
+        auto delta = diff.diff(snapshot);
+        ASSERT_EQ(delta.size(), 3);
+
+        auto& modified = delta.frames()[0];
+        EXPECT_EQ(changeOf(modified), Er::SnapshotDiff::Change::Modified);
+        ASSERT_EQ(modified.size(), 3);
+        EXPECT_EQ(modified[1].getUInt64(), 2);
+        EXPECT_EQ(modified[2].info(), &Cpu);
+        EXPECT_EQ(modified[2].getDouble(), 0.75);
+
+        EXPECT_EQ(changeOf(delta.frames()[1]), Er::SnapshotDiff::Change::Added);
+
+        auto& removed = delta.frames()[2];
+        EXPECT_EQ(changeOf(removed), Er::SnapshotDiff::Change::Removed);
+        ASSERT_EQ(removed.size(), 2);
+        EXPECT_EQ(removed[1].getUInt64(), 3);
+
+        deliver(delta, mirror, snapshot);
+    }
+
+    // a new property is a modification; a lost one replaces the whole record
+    snapshot[0].push_back(Er::Property(std::string("/sbin/init"), Exe));
+    {
+        auto delta = diff.diff(snapshot);
+        ASSERT_EQ(delta.size(), 1);
+        EXPECT_EQ(changeOf(delta.frames()[0]), Er::SnapshotDiff::Change::Modified);
+        deliver(delta, mirror, snapshot);
+    }
+
+    snapshot[0].erase(snapshot[0].begin() + 1);
+    {
+        auto delta = diff.diff(snapshot);
+        ASSERT_EQ(delta.size(), 1);
+        EXPECT_EQ(changeOf(delta.frames()[0]), Er::SnapshotDiff::Change::Added);
+        deliver(delta, mirror, snapshot);
+    }
+}
+
+TEST(SnapshotDiff, Interrupted)
+{
+    Er::SnapshotDiff diff(Pid);
+    Er::SnapshotMirror mirror(Pid);
+
+    std::vector<Er::PropertyBag> snapshot{ process(1, "init", 0.0), process(2, "kthreadd", 0.5) };
+
+    {
+        auto delta = diff.diff(snapshot);
+        deliver(delta, mirror, snapshot);
+    }
+
+    // the client got only a part of the changes
+    snapshot[0] = process(1, "init", 0.25);
+    snapshot[1] = process(2, "kthreadd", 0.75);
+    {
+        auto delta = diff.diff(snapshot);
+        ASSERT_EQ(delta.size(), 2);
+        mirror.apply(delta.next());
+    }
+
+    // so it gets the whole snapshot again
+    snapshot[0] = process(1, "init", 0.0);
+    {
+        auto delta = diff.diff(snapshot);
+        ASSERT_EQ(delta.size(), 3);
+        EXPECT_EQ(changeOf(delta.frames()[0]), Er::SnapshotDiff::Change::Reset);
+        deliver(delta, mirror, snapshot);
+    }
+
+    // a diff taken while another one is pending
+    {
+        auto stale = diff.diff(snapshot);
+        auto delta = diff.diff(snapshot);
+        EXPECT_EQ(delta.size(), 3);
+
+        // finishing the stale one changes nothing
+        while (!stale.next().empty())
+            ;
+
+        deliver(delta, mirror, snapshot);
+    }
+
+    {
+        auto delta = diff.diff(snapshot);
+        EXPECT_EQ(delta.size(), 0);
+    }
+}
+
+TEST(SnapshotDiff, BadRecords)
+{
+    Er::SnapshotDiff diff(Pid);
+
+    EXPECT_THROW((void)diff.diff({ Er::PropertyBag{ Er::Property(std::string("no pid"), Comm) } }), Er::Exception);
+    EXPECT_THROW((void)diff.diff({ process(1, "a", 0.0), process(1, "b", 0.0) }), Er::Exception);
+
+    Er::SnapshotMirror mirror(Pid);
+    EXPECT_THROW(mirror.apply(process(1, "a", 0.0)), Er::Exception);
+    EXPECT_THROW(mirror.apply(Er::PropertyBag{ Er::Property(std::uint32_t(2), Er::SnapshotDiff::ChangeProperty), Er::Property(std::uint64_t(1), Pid) }), Er::Exception);
+}
@@ -0,0 +1,120 @@
+#include "common.hpp"
+
+#include <erebus/system/string_pool.hxx>
+
+#include <thread>
+
+
+namespace
+{
+
+const Er::PropertyInfo Exe{ Er::PropertyType::String, "Er.Test.StringPool.exe", "Executable" };
+const Er::PropertyInfo User{ Er::PropertyType::String, "Er.Test.StringPool.user", "User" };
+const Er::PropertyInfo Pid{ Er::PropertyType::UInt64, "Er.Test.StringPool.pid", "PID" };
+
+std::string longString(std::size_t i)
+{
+    return Er::format("/usr/lib/erebus/test/string-pool/{}", i);
+}
+
+} // namespace {}
+
+
+TEST(StringPool, Intern)
+{
+    auto a = Er::StringPool::intern(longString(1), Exe);
+    auto b = Er::StringPool::intern(longString(1), User);
+    auto c = Er::StringPool::intern(longString(2), Exe);
+
+    EXPECT_EQ(a.getString(), longString(1));
+    EXPECT_EQ(b.info(), &User);
+
+    // one copy for all the equal values
+    EXPECT_EQ(a.getStringView().data(), b.getStringView().data());
+    EXPECT_NE(a.getStringView().data(), c.getStringView().data());
+    EXPECT_TRUE(a == b);
+    EXPECT_FALSE(a == c);
+    EXPECT_EQ(a.hash(), b.hash());
+
+    // interned strings still compare and hash like the others
+    Er::Property plain(longString(1), Exe);
+    EXPECT_TRUE(a == plain);
+    EXPECT_FALSE(c == plain);
+    EXPECT_EQ(a.hash(), plain.hash());
+
+    auto d = Er::StringPool::intern(plain);
+    EXPECT_EQ(d.getStringView().data(), a.getStringView().data());
+    EXPECT_EQ(Er::StringPool::intern(d).getStringView().data(), a.getStringView().data());
+
+    // nothing to share
+    auto inlined = Er::StringPool::intern("short", Exe);
+    EXPECT_TRUE(inlined.isInline());
+    EXPECT_EQ(inlined.getString(), "short");
+
+    auto shortPlain = Er::StringPool::intern(Er::Property(std::string("short"), Exe));
+    EXPECT_TRUE(shortPlain.isInline());
+    EXPECT_EQ(shortPlain.getString(), "short");
+
+    Er::Property number(std::uint64_t(42), Pid);
+    EXPECT_TRUE(Er::StringPool::intern(number) == number);
+}
+
+TEST(StringPool, Purge)
+{
+    Er::StringPool::purge();
+    auto before = Er::StringPool::size();
+
+    {
+        std::vector<Er::Property> props;
+        for (std::size_t i = 0; i < 100; ++i)
+        {
+            props.push_back(Er::StringPool::intern(longString(1000 + i), Exe));
+            props.push_back(Er::StringPool::intern(longString(1000 + i), User));
+        }
+
+        EXPECT_EQ(Er::StringPool::size(), before + 100);
+
+        // still referenced
+        EXPECT_EQ(Er::StringPool::purge(), 0);
+        EXPECT_EQ(Er::StringPool::size(), before + 100);
+    }
+
+    EXPECT_EQ(Er::StringPool::purge(), 100);
+    EXPECT_EQ(Er::StringPool::size(), before);
+}
+
+TEST(StringPool, Concurrent)
+{
+    constexpr std::size_t Threads = 4;
+    constexpr std::size_t Values = 64;
+    constexpr std::size_t Rounds = 2000;
+
+    std::vector<std::vector<Er::Property>> results(Threads);
+    std::vector<std::jthread> workers;
+    for (std::size_t t = 0; t < Threads; ++t)
+    {
+        workers.emplace_back(
+            [&result = results[t]]()
+            {
+                for (std::size_t i = 0; i < Rounds; ++i)
+                {
+                    // most of these die right away, so the pool sweeps them while others are interned
+                    auto prop = Er::StringPool::intern(longString(2000 + i % Values), Exe);
+                    if (i >= Rounds - Values)
+                        result.push_back(std::move(prop));
+                }
+            });
+    }
+
+    workers.clear();
+
+    for (std::size_t t = 1; t < Threads; ++t)
+    {
+        ASSERT_EQ(results[t].size(), Values);
+        for (std::size_t i = 0; i < Values; ++i)
+        {
+            EXPECT_EQ(results[t][i].getString(), results[0][i].getString());
+            EXPECT_EQ(results[t][i].getStringView().data(), results[0][i].getStringView().data());
+        }
+    }
+}
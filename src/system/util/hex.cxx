@@ -0,0 +1,120 @@
+#include <erebus/system/util/hex.hxx>
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+    #define ER_HEX_SSSE3 1
+    #include <immintrin.h>
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #endif
+#endif
+
+#if defined(ER_HEX_SSSE3) && defined(__GNUC__)
+    #define ER_TARGET_SSSE3 __attribute__((target("ssse3")))
+#else
+    #define ER_TARGET_SSSE3
+#endif
+
+
+namespace Er::Util
+{
+
+namespace
+{
+
+const char HexDigits[] = "0123456789ABCDEF";
+
+// writes "XX " for each byte, the trailing space included
+void hexEncodeScalar(char* out, const std::uint8_t* in, std::size_t size) noexcept
+{
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        out[0] = HexDigits[in[i] >> 4];
+        out[1] = HexDigits[in[i] & 0x0f];
+        out[2] = ' ';
+        out += 3;
+    }
+}
+
+#if ER_HEX_SSSE3
+
+bool hasSsse3() noexcept
+{
+#if defined(_MSC_VER)
+    int info[4] = {};
+    __cpuid(info, 1);
+    return (info[2] & (1 << 9)) != 0;
+#else
+    return __builtin_cpu_supports("ssse3");
+#endif
+}
+
+// 16 bytes in, 48 chars out
+ER_TARGET_SSSE3 std::size_t hexEncodeSsse3(char* out, const std::uint8_t* in, std::size_t size) noexcept
+{
+    const __m128i digits = _mm_loadu_si128(reinterpret_cast<const __m128i*>(HexDigits));
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+
+    // spread 16 "XY" pairs over three 16-char blocks of "XY " triplets; -1 yields a zero byte to be replaced with a space
+    const __m128i fromLo0 = _mm_setr_epi8(0, 1, -1, 2, 3, -1, 4, 5, -1, 6, 7, -1, 8, 9, -1, 10);
+    const __m128i fromLo1 = _mm_setr_epi8(11, -1, 12, 13, -1, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i fromHi1 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, 0, 1, -1, 2, 3, -1, 4, 5);
+    const __m128i fromHi2 = _mm_setr_epi8(-1, 6, 7, -1, 8, 9, -1, 10, 11, -1, 12, 13, -1, 14, 15, -1);
+    const __m128i spaces0 = _mm_setr_epi8(0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0);
+    const __m128i spaces1 = _mm_setr_epi8(0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0);
+    const __m128i spaces2 = _mm_setr_epi8(' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ', 0, 0, ' ');
+
+    std::size_t done = 0;
+    for (; done + 16 <= size; done += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + done));
+        __m128i hi = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+        __m128i lo = _mm_shuffle_epi8(digits, _mm_and_si128(v, nibble));
+
+        __m128i pairsLo = _mm_unpacklo_epi8(hi, lo); // bytes 0..7
+        __m128i pairsHi = _mm_unpackhi_epi8(hi, lo); // bytes 8..15
+
+        __m128i out0 = _mm_or_si128(_mm_shuffle_epi8(pairsLo, fromLo0), spaces0);
+        __m128i out1 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(pairsLo, fromLo1), _mm_shuffle_epi8(pairsHi, fromHi1)), spaces1);
+        __m128i out2 = _mm_or_si128(_mm_shuffle_epi8(pairsHi, fromHi2), spaces2);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), out0);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16), out1);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 32), out2);
+        out += 48;
+    }
+
+    return done;
+}
+
+#endif // ER_HEX_SSSE3
+
+} // namespace {}
+
+
+ER_SYSTEM_EXPORT void hexEncodeTo(FormatBuffer& out, const void* data, std::size_t size)
+{
+    if (!size)
+        return;
+
+    auto in = static_cast<const std::uint8_t*>(data);
+    auto start = out.size();
+    out.resize(start + size * 3);
+    auto dest = out.data() + start;
+
+    std::size_t done = 0;
+
+#if ER_HEX_SSSE3
+    static const bool simd = hasSsse3();
+    if (simd)
+        done = hexEncodeSsse3(dest, in, size);
+#endif
+
+    hexEncodeScalar(dest + done * 3, in + done, size - done);
+
+    // no space after the last byte
+    out.resize(out.size() - 1);
+}
+
+} // namespace Er::Util {}